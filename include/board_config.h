@@ -0,0 +1,198 @@
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Motor wiring of the board, fixed at compile time. A rig with more pumps
+// adds a line to PUMP_CHANNELS, and a line to MOTOR_DRIVERS for each extra
+// TB6612; the checks at the bottom fail the build if two outputs share a
+// pin, an LEDC channel or a driver channel.
+
+// One TB6612FNG dual H-bridge
+struct DriverConfig {
+  uint8_t stbyPin;  // Shared by the chip's two channels
+};
+
+static const uint8_t NO_ENCODER_PIN = 0xFF;
+
+// Speed feedback from a tach or hall output on the pump head or motor shaft,
+// counted by a PCNT unit. With one fitted the channel's speed setting is a
+// head speed, held by a PI loop; without, it is a plain duty.
+struct EncoderConfig {
+  uint8_t pin;            // NO_ENCODER_PIN when none is fitted
+  uint8_t pcntUnit;
+  uint16_t pulsesPerRev;  // Rising edges per head revolution, gearbox included
+  uint16_t maxRpm;        // Head speed asked for at full-scale speed. Keep it below what the
+                          // motor reaches at full duty on a low supply and a stiff tube, so
+                          // the loop has headroom.
+  float kp;               // Duty fraction per full-scale speed error
+  float ki;               // The same, per second of error
+};
+
+constexpr EncoderConfig NO_ENCODER = { NO_ENCODER_PIN, 0, 0, 0, 0.0f, 0.0f };
+
+// One motor output: a driver channel and the LEDC channel that makes its PWM
+struct ChannelConfig {
+  uint8_t pwmPin;         // PWMA / PWMB
+  uint8_t in1Pin;         // AIN1 / BIN1
+  uint8_t in2Pin;         // AIN2 / BIN2
+  uint8_t ledcChannel;
+  uint32_t pwmFreq;       // Hz; 20 kHz is above hearing
+  uint8_t pwmRes;         // Bits
+  uint8_t driver;         // Index into MOTOR_DRIVERS
+  uint8_t driverChannel;  // 0 = A, 1 = B
+  EncoderConfig encoder;
+};
+
+constexpr DriverConfig MOTOR_DRIVERS[] = {
+  { 10 },
+};
+
+// Peristaltic pumps, by channel id. Channel 0 is the pump that the
+// single-pump interfaces drive: /api/control, doses, calibration, protocols,
+// the UDP protocol and the console. An entry for a 30:1 gearmotor with an
+// 11-pulse hall sensor on GPIO 17, gains as tuned in tools/speed_loop_sim.cpp:
+//
+//   { 13, 11, 12, 2, 20000, 10, 0, 0, { 17, 0, 330, 120, 1.5f, 8.0f } },
+constexpr ChannelConfig PUMP_CHANNELS[] = {
+  { 13, 11, 12, 2, 20000, 10, 0, 0, NO_ENCODER },
+};
+
+// Vacuum pump; BO1 goes to its positive terminal, BO2 to the negative
+constexpr ChannelConfig VACUUM_CHANNEL = { 14, 15, 16, 1, 20000, 10, 0, 1, NO_ENCODER };
+
+// Vacuum gauge on the vacuum line, read by the ADC. Its output is taken as
+// linear in vacuum (pressure below atmospheric) between the two points
+// given; a reading well outside that range is a wiring fault.
+struct PressureSensorConfig {
+  uint8_t adcPin;         // An ADC1 pin: continuous (DMA) sampling only reaches ADC1
+  uint16_t zeroMv;        // At the pin, with the line open to air
+  uint16_t fullScaleMv;   // At the pin, at fullScalePa of vacuum
+  uint32_t fullScalePa;
+  uint32_t cutoffPa;      // Hard limit: the pump is cut as soon as a reading reaches it
+  uint32_t hysteresisPa;  // It may run again once the vacuum is this far below the cutoff
+  float kp;               // Duty fraction per full-scale vacuum error
+  float ki;               // The same, per second of error
+};
+
+// MPXV6115V (4.6 V open to air, 0.2 V at 115 kPa of vacuum on a 5 V supply)
+// behind a 3:5 divider, on GPIO 4. Gains as tuned in tools/vacuum_sim.cpp.
+constexpr PressureSensorConfig VACUUM_SENSOR = { 4, 2760, 120, 115000, 80000, 5000, 24.0f, 4.0f };
+
+static const uint8_t MOTOR_DRIVER_COUNT = sizeof(MOTOR_DRIVERS) / sizeof(MOTOR_DRIVERS[0]);
+static const uint8_t PUMP_CHANNEL_COUNT = sizeof(PUMP_CHANNELS) / sizeof(PUMP_CHANNELS[0]);
+
+// ESP32-S3 limits
+static const uint8_t BOARD_GPIO_COUNT = 49;
+static const uint8_t BOARD_LEDC_CHANNELS = 8;
+static const uint8_t BOARD_PCNT_UNITS = 4;
+static const uint8_t BOARD_ADC1_FIRST_PIN = 1;  // ADC1 channel n is GPIO n + 1
+static const uint8_t BOARD_ADC1_LAST_PIN = 10;
+static const uint16_t BOARD_ADC_MAX_MV = 3100;  // Top of the 11 dB range
+static const uint32_t BOARD_LEDC_CLOCK_HZ = 80000000;  // APB clock the LEDC timers divide
+
+// Compile-time checks. Every motor output is numbered: the pump channels in
+// order, then the vacuum channel. C++11 constexpr functions are a single
+// expression, hence the recursion.
+namespace board_check {
+
+constexpr uint8_t MOTOR_COUNT = PUMP_CHANNEL_COUNT + 1;
+
+constexpr const ChannelConfig& motor(uint8_t i) {
+  return i < PUMP_CHANNEL_COUNT ? PUMP_CHANNELS[i] : VACUUM_CHANNEL;
+}
+
+// GPIOs in use: four per motor (the encoder one may be absent), one STBY
+// per driver, then the vacuum gauge
+constexpr uint8_t PIN_COUNT = MOTOR_COUNT * 4 + MOTOR_DRIVER_COUNT + 1;
+
+constexpr uint8_t pin(uint8_t i) {
+  return i == PIN_COUNT - 1 ? VACUUM_SENSOR.adcPin
+       : i >= MOTOR_COUNT * 4 ? MOTOR_DRIVERS[i - MOTOR_COUNT * 4].stbyPin
+       : i % 4 == 0 ? motor(i / 4).pwmPin
+       : i % 4 == 1 ? motor(i / 4).in1Pin
+       : i % 4 == 2 ? motor(i / 4).in2Pin
+       : motor(i / 4).encoder.pin;
+}
+
+constexpr bool pinFreeAfter(uint8_t i, uint8_t j) {
+  return j >= PIN_COUNT || ((pin(j) == NO_ENCODER_PIN || pin(i) != pin(j)) && pinFreeAfter(i, j + 1));
+}
+
+constexpr bool pinsUnique(uint8_t i = 0) {
+  return i >= PIN_COUNT ||
+         ((pin(i) == NO_ENCODER_PIN || (pin(i) < BOARD_GPIO_COUNT && pinFreeAfter(i, i + 1))) && pinsUnique(i + 1));
+}
+
+constexpr bool hasEncoder(const ChannelConfig& config) {
+  return config.encoder.pin != NO_ENCODER_PIN;
+}
+
+constexpr bool motorFreeAfter(uint8_t i, uint8_t j) {
+  return j >= MOTOR_COUNT ||
+         (motor(i).ledcChannel != motor(j).ledcChannel &&
+          (motor(i).driver != motor(j).driver || motor(i).driverChannel != motor(j).driverChannel) &&
+          (!hasEncoder(motor(i)) || !hasEncoder(motor(j)) || motor(i).encoder.pcntUnit != motor(j).encoder.pcntUnit) &&
+          motorFreeAfter(i, j + 1));
+}
+
+constexpr bool encoderValid(const EncoderConfig& encoder) {
+  return encoder.pcntUnit < BOARD_PCNT_UNITS && encoder.pulsesPerRev > 0 && encoder.maxRpm > 0 &&
+         encoder.kp >= 0.0f && encoder.ki >= 0.0f;
+}
+
+// IN1 and IN2 in the same GPIO bank, so both change in one register write
+constexpr bool motorValid(const ChannelConfig& config) {
+  return config.in1Pin / 32 == config.in2Pin / 32 && config.ledcChannel < BOARD_LEDC_CHANNELS &&
+         config.driver < MOTOR_DRIVER_COUNT && config.driverChannel < 2 &&
+         config.pwmRes >= 1 && config.pwmRes <= 14 &&
+         config.pwmFreq > 0 && config.pwmFreq <= (BOARD_LEDC_CLOCK_HZ >> config.pwmRes) &&
+         (!hasEncoder(config) || encoderValid(config.encoder));
+}
+
+constexpr bool motorsValid(uint8_t i = 0) {
+  return i >= MOTOR_COUNT || (motorValid(motor(i)) && motorsValid(i + 1));
+}
+
+constexpr bool motorsUnique(uint8_t i = 0) {
+  return i >= MOTOR_COUNT || (motorFreeAfter(i, i + 1) && motorsUnique(i + 1));
+}
+
+// LEDC channels 2n and 2n+1 are clocked by the same timer, so whichever is
+// set up last would impose its frequency and resolution on the other
+constexpr bool timerAgreesAfter(uint8_t i, uint8_t j) {
+  return j >= MOTOR_COUNT ||
+         ((motor(i).ledcChannel / 2 != motor(j).ledcChannel / 2 ||
+           (motor(i).pwmFreq == motor(j).pwmFreq && motor(i).pwmRes == motor(j).pwmRes)) &&
+          timerAgreesAfter(i, j + 1));
+}
+
+constexpr bool timersAgree(uint8_t i = 0) {
+  return i >= MOTOR_COUNT || (timerAgreesAfter(i, i + 1) && timersAgree(i + 1));
+}
+
+constexpr bool pressureSensorValid(const PressureSensorConfig& sensor) {
+  return sensor.adcPin >= BOARD_ADC1_FIRST_PIN && sensor.adcPin <= BOARD_ADC1_LAST_PIN &&
+         sensor.zeroMv != sensor.fullScaleMv && sensor.zeroMv <= BOARD_ADC_MAX_MV &&
+         sensor.fullScaleMv <= BOARD_ADC_MAX_MV && sensor.cutoffPa > 0 && sensor.cutoffPa < sensor.fullScalePa &&
+         sensor.hysteresisPa < sensor.cutoffPa && sensor.kp >= 0.0f && sensor.ki >= 0.0f;
+}
+
+}  // namespace board_check
+
+static_assert(PUMP_CHANNEL_COUNT >= 1, "Channel 0 is the default pump and must exist");
+static_assert(PUMP_CHANNEL_COUNT <= 16, "The event log records the channel in four bits");
+static_assert(board_check::pinsUnique(), "A GPIO is used twice (or doesn't exist) in the motor and gauge wiring");
+static_assert(board_check::motorsValid(),
+              "A motor has IN1 and IN2 in different GPIO banks, a bad LEDC channel, driver index or "
+              "driver channel, a PWM frequency its resolution can't reach, or a bad encoder entry");
+static_assert(board_check::motorsUnique(), "Two motors share an LEDC channel, a driver channel or a PCNT unit");
+static_assert(board_check::timersAgree(),
+              "Motors on LEDC channels 2n and 2n+1 share a timer and need the same PWM frequency and resolution");
+static_assert(!board_check::hasEncoder(VACUUM_CHANNEL),
+              "The vacuum pump runs open loop; its encoder entry must be NO_ENCODER");
+static_assert(board_check::pressureSensorValid(VACUUM_SENSOR),
+              "The vacuum gauge needs an ADC1 pin, a non-empty range the ADC can read and a cutoff within it");
+
+#endif // BOARD_CONFIG_H
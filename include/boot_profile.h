@@ -0,0 +1,54 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Where setup() spends its time. Each mark() closes a stage at the current
+// time since boot; finish() logs the breakdown and keeps a JSON copy for
+// /api/status. The network comes up later, in the background, and is
+// recorded separately with markNetworkUp().
+class BootProfile {
+public:
+  static const uint8_t MAX_STAGES = 12;
+
+private:
+  struct Stage {
+    const char* name;
+    uint32_t endUs;  // Since boot
+  };
+
+  Hal& hal;
+  uint32_t startUs;  // setup() entry; the time before it is the ROM, bootloader and core
+  Stage stages[MAX_STAGES];
+  uint8_t stageCount;
+  std::atomic<uint32_t> networkUs;  // 0 until the first IP
+  std::atomic<bool> finished;
+  char json[256];  // Written once by finish(), read-only after
+
+public:
+  explicit BootProfile(Hal& halInstance);
+
+  // Call first thing in setup()
+  void begin();
+
+  // Close the stage that ran since the previous mark (or begin())
+  void mark(const char* name);
+
+  // Report the stages; the time of this call is when the device is ready
+  void finish();
+
+  // First time the network is usable; later calls are ignored
+  void markNetworkUp();
+
+  uint32_t readyUs() const;
+  uint32_t networkUpUs() const { return networkUs.load(std::memory_order_relaxed); }
+
+  // {"setupStartUs":..,"stages":{"name":us,..},"readyUs":..}, or "null"
+  // before finish()
+  const char* stagesJson() const;
+};
+
+#endif // BOOT_PROFILE_H
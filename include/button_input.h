@@ -0,0 +1,50 @@
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <Arduino.h>
+#include "command_console.h"
+#include "scheduler.h"
+
+// A push button to ground and the console line it runs when pressed
+struct ButtonBinding {
+  uint8_t pin;
+  const char* line;
+};
+
+// Front-panel buttons. An edge interrupt wakes the main loop job, which
+// debounces and, on a press, runs the bound line through the console, so a
+// button is just another front end of the shared dispatcher.
+class ButtonInput {
+public:
+  static const uint8_t MAX_BUTTONS = 4;
+  static const uint32_t DEBOUNCE_MS = 30;
+
+private:
+  struct Button {
+    ButtonBinding binding;
+    bool stablePressed;
+    bool lastPressed;
+    uint32_t changedMs;
+  };
+
+  CommandConsole& console;
+  Button buttons[MAX_BUTTONS];
+  uint8_t buttonCount;
+  void (*wakeListener)(void* arg);
+  void* wakeListenerArg;
+
+  static void IRAM_ATTR onEdge(void* arg);
+
+public:
+  explicit ButtonInput(CommandConsole& consoleInstance);
+
+  // Configure the pins (with pull-ups) and their interrupts; listener is
+  // called from the ISR
+  void begin(const ButtonBinding* bindings, uint8_t count, void (*listener)(void* arg), void* arg);
+
+  // Main loop job: returns the ms until a bouncing input settles, or
+  // SCHEDULE_NEVER when all are quiet
+  uint32_t service();
+};
+
+#endif // BUTTON_INPUT_H
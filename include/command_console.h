@@ -0,0 +1,73 @@
+#ifndef COMMAND_CONSOLE_H
+#define COMMAND_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "command_dispatcher.h"
+#include "hal.h"
+#include "pump_command.h"
+
+// Line commands, for when there is no network:
+//
+//   pump forward|reverse [speed=N] [duration=S | durationMs=MS]
+//   pump stop
+//   vacuum start [speed=N] [duration=S | durationMs=MS]
+//   vacuum stop
+//   estop          (vacuum emergency stop, and every pump channel stopped)
+//   status
+//   help
+//
+// Fields mean the same as in an /api/control or /api/vacuum body (speed is
+// 0-1023 for both motors) and anything left out is filled in the same way.
+enum ConsoleVerb {
+  CONSOLE_COMMAND,
+  CONSOLE_ESTOP,
+  CONSOLE_STATUS,
+  CONSOLE_HELP
+};
+
+struct ConsoleRequest {
+  ConsoleVerb verb;
+  PumpCommand command;  // CONSOLE_COMMAND only; raw values, as parsed
+};
+
+// Parse one line, without its line ending. Words are separated by spaces
+// or tabs; unknown keys are an error rather than ignored, as they are
+// usually typos.
+CommandParseError parseConsoleLine(const char* line, size_t length, ConsoleRequest& request);
+
+// Writes one reply line, without a line ending
+typedef void (*ConsoleWriter)(void* arg, const char* line);
+
+// Assembles lines from a byte stream and runs them through the shared
+// dispatcher, so a command typed here is checked, limited and queued
+// exactly like the same command sent over HTTP. One task feeds it.
+class CommandConsole {
+public:
+  static const size_t LINE_SIZE = 96;
+
+private:
+  CommandDispatcher& dispatcher;
+  Hal& hal;
+  ConsoleWriter writer;
+  void* writerArg;
+  char line[LINE_SIZE];
+  size_t lineLength;
+  bool overflowed;  // Dropping the rest of a line that didn't fit
+
+  void reply(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  void replyStatus();
+
+public:
+  CommandConsole(CommandDispatcher& dispatcherInstance, Hal& halInstance,
+                 ConsoleWriter writerFunction, void* writerArgument);
+
+  // Bytes as they arrive from the port. CR, LF and CRLF all end a line;
+  // backspace edits it.
+  void feed(const char* data, size_t length);
+
+  // Run one complete line, on behalf of source
+  void execute(const char* text, size_t length, CommandSource source);
+};
+
+#endif // COMMAND_CONSOLE_H
@@ -0,0 +1,54 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <stdint.h>
+#include "pump_command.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+
+// Hands commands to whatever applies them: the control task's queue on the
+// device, the controller itself in host builds. False means the batch could
+// not be taken right now.
+typedef bool (*CommandSink)(void* arg, const CommandBatch& batch);
+
+// The one way into the pumps for every front end (web, UDP, serial
+// console, buttons). resolve() applies the same limits and defaults to a
+// parsed command whatever it came from; submit() stops a running protocol
+// before an emergency stop and queues the command.
+class CommandDispatcher {
+public:
+  static const uint32_t MAX_RUN_MS = 300000;  // Longest run any request may ask for
+  static const uint32_t MIN_TARGET_PA = 1000;  // Below this the regulator would only chatter
+
+private:
+  PumpController& controller;
+  ProtocolSequencer& sequencer;
+  CommandSink sink;
+  void* sinkArg;
+
+  static const ChannelStatus& channelOf(const PumpCommand& command, const PumpStatus& status);
+  uint16_t pumpSpeedFrom(const PumpCommand& command, const PumpStatus& status) const;
+  uint8_t vacuumSpeedFrom(const PumpCommand& command, const PumpStatus& status) const;
+  uint32_t vacuumTargetFrom(const PumpCommand& command) const;
+  uint32_t durationFrom(const PumpCommand& command, const PumpStatus& status) const;
+
+public:
+  CommandDispatcher(PumpController& controllerInstance, ProtocolSequencer& sequencerInstance,
+                    CommandSink sinkFunction, void* sinkArgument);
+
+  // Fill in what the sender left out from the current state of the channel
+  // addressed and clamp the rest: pump speed 100-1023, vacuum speed from 0-1023 to 10-100 %, run
+  // length 1 ms to MAX_RUN_MS, vacuum target MIN_TARGET_PA up to the gauge's cutoff less its
+  // hysteresis. Calibration runs use the pump's limits.
+  void resolve(PumpCommand& command, const PumpStatus& status, CommandSource source) const;
+
+  // Non-blocking; false if the control task's queue is full
+  bool submit(const PumpCommand& command);
+  bool submitBatch(const CommandBatch& batch);
+  // Vacuum emergency stop and every pump channel stopped, in one batch
+  bool emergencyStop(CommandSource source);
+
+  PumpStatus status() const { return controller.status(); }
+};
+
+#endif // COMMAND_DISPATCHER_H
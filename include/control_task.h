@@ -0,0 +1,47 @@
+#ifndef CONTROL_TASK_H
+#define CONTROL_TASK_H
+
+#include <Arduino.h>
+#include "pump_controller.h"
+
+// Runs the PumpController in its own FreeRTOS task, pinned to the APP core
+// at a priority above loop(), so commands are applied promptly no matter how
+// long the web server takes. Other tasks hand over commands through a queue
+// and read the state through PumpController::status(). Each queue entry is a
+// batch; a single command is a batch of one.
+class ControlTask {
+private:
+  static const int TASK_CORE = 1;
+  static const UBaseType_t TASK_PRIORITY = 10;  // Above loop() (1), below esp_timer (22)
+  static const uint32_t TASK_STACK_SIZE = 4096;
+  static const UBaseType_t QUEUE_LENGTH = 8;
+  static const uint32_t SERVICE_PERIOD_MS = 20;  // Backstop check for timed runs
+
+  // Queue entry: the batch and when it was queued, for the latency metric
+  struct QueuedBatch {
+    CommandBatch batch;
+    uint64_t queuedUs;
+  };
+
+  PumpController& controller;
+  QueueHandle_t commandQueue;
+  TaskHandle_t taskHandle;
+
+  static void taskEntry(void* param);
+  void run();
+
+public:
+  explicit ControlTask(PumpController& controllerInstance);
+  bool begin();
+
+  // Non-blocking. Returns false if the queue is full.
+  bool submit(const PumpCommand& command);
+
+  // Queue commands to be applied together, in order, in one pass of the
+  // control task. Non-blocking like submit().
+  bool submitBatch(const CommandBatch& batch);
+
+  PumpStatus status() const { return controller.status(); }
+};
+
+#endif // CONTROL_TASK_H
@@ -0,0 +1,124 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+#include "pump_command.h"
+#include "scheduler.h"
+
+enum EventKind {
+  EVENT_BOOT = 1,
+  EVENT_PUMP = 2,       // state = PumpState, duty = 0-1023, channel = pump channel
+  EVENT_VACUUM = 3,     // state = VacuumPumpState, duty = percent, or target kPa when regulating
+  EVENT_EMERGENCY = 4
+};
+
+struct EventRecord {
+  uint32_t seq;         // Increases by one per record, across reboots
+  uint32_t timeMs;      // Uptime; EVENT_BOOT marks where it restarts
+  uint32_t durationMs;  // Timed run length, 0 if untimed
+  uint8_t kind;         // EventKind
+  uint8_t source;       // CommandSource
+  uint8_t state;
+  uint8_t channel;      // EVENT_PUMP only
+  uint16_t duty;
+};
+
+const char* eventKindName(uint8_t kind);
+
+// Append-only log of what the pumps did, kept in the raw log flash region.
+//
+// Records are 16 bytes with a CRC-8, 256 to a 4 KiB sector, and the region
+// is used as a ring of sectors: the oldest sector is erased only when the
+// writer reaches it, so every sector sees the same number of erase cycles.
+// The 1.5 MiB partition holds about 98,000 records - over three months at a
+// thousand pump events a day - and each sector is erased once per lap.
+//
+// record() only queues the record in RAM and may be called from any task;
+// service() writes the queue out a flash page (16 records) at a time, or
+// when the oldest queued record is FLUSH_INTERVAL_MS old, so flash is
+// written in a few large programs instead of many small ones. The wake
+// listener tells the flushing task when there is something to wait for.
+//
+// Nothing on flash is ever rewritten, which keeps recovery simple: begin()
+// finds the newest record by sequence number and continues after the last
+// programmed slot. A record torn by a power cut fails its CRC and is skipped
+// by readers, as is anything in a sector whose erase was interrupted.
+class EventLog {
+public:
+  static const size_t RECORD_SIZE = 16;
+  static const size_t RECORDS_PER_SECTOR = LOG_FLASH_SECTOR_SIZE / RECORD_SIZE;
+  static const uint8_t QUEUE_SIZE = 64;
+  static const uint8_t FLUSH_RECORDS = 16;  // One 256-byte flash page
+  static const uint32_t FLUSH_INTERVAL_MS = 5000;
+
+private:
+  Hal& hal;
+  bool ready;
+  size_t sectorCount;
+
+  // Where the next record goes and where the oldest ones are. Written only
+  // by the flushing task; readers take a copy under the HAL lock.
+  size_t headSector;
+  size_t headSlot;
+  size_t oldestSector;
+  uint32_t writtenSeq;  // Sequence number after the last record on flash
+
+  EventRecord queue[QUEUE_SIZE];
+  uint8_t queueHead;
+  uint8_t queueCount;
+  uint32_t queuedSinceMs;
+  uint32_t nextSeq;
+  uint32_t droppedRecords;
+  void (*wakeListener)(void* arg);
+  void* wakeListenerArg;
+
+  struct Position {
+    size_t headSector;
+    size_t headSlot;
+    size_t oldestSector;
+  };
+
+  Position position();
+  bool readSlot(size_t sector, size_t slot, EventRecord& record, bool& empty);
+  bool firstSeqIn(size_t sector, uint32_t& seq);
+  bool trustedSector(size_t sector);
+  bool writeRecords(const EventRecord* records, uint8_t count);
+
+public:
+  explicit EventLog(Hal& halInstance);
+
+  // Recover the write position from flash and log the boot. False if
+  // there is no log region; record() then does nothing.
+  bool begin();
+
+  void record(EventKind kind, CommandSource source, uint8_t state, uint16_t duty, uint32_t durationMs,
+              uint8_t channel = 0);
+
+  // Called from record() when the queue becomes non-empty and when a full
+  // page is waiting
+  void setWakeListener(void (*listener)(void* arg), void* arg);
+
+  // From a low-priority task: write queued records once enough are waiting.
+  // Returns the ms until it needs calling again, or SCHEDULE_NEVER.
+  uint32_t service();
+  void flush();
+
+  // Sequence numbers of the oldest record on flash and one past the newest
+  uint32_t firstSeq();
+  uint32_t endSeq();
+
+  // Copy up to maxRecords records with seq >= fromSeq, oldest first, and
+  // set resumeSeq to where a following read should start. Safe alongside
+  // the writer: a record being written or erased is simply not returned.
+  size_t read(uint32_t fromSeq, EventRecord* out, size_t maxRecords, uint32_t& resumeSeq);
+
+  uint32_t droppedCount() const { return droppedRecords; }
+};
+
+// Pack / unpack the on-flash form. decode() fails on an erased or torn slot.
+void encodeEventRecord(const EventRecord& record, uint8_t* out);
+bool decodeEventRecord(const uint8_t* data, EventRecord& record);
+
+#endif // EVENT_LOG_H
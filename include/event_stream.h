@@ -0,0 +1,58 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include "http_server.h"
+#include "scheduler.h"
+#include "status_delta.h"
+
+// Server-Sent Events fan-out for live status. Each observer is an event
+// stream on the HTTP server and gets a full snapshot first and then only
+// the fields that changed, at most once per its own interval. An event the
+// connection has no room for is retried on the next poll with a fresh
+// delta, so a slow observer never holds up the others.
+class StatusEventStream {
+public:
+  // Fewer than the server's connections: an open dashboard holds its
+  // connection for good, and one slot is left for a dashboard being turned
+  // away and one for a control request
+  static const uint8_t MAX_OBSERVERS = HttpServer::MAX_CONNECTIONS - 2;
+  static const uint32_t DEFAULT_INTERVAL_MS = 250;
+  static const uint32_t MIN_INTERVAL_MS = 100;
+  static const uint32_t MAX_INTERVAL_MS = 10000;
+
+private:
+  static const uint32_t KEEPALIVE_MS = 15000;  // Comment line that detects dead peers
+  static const size_t EVENT_SIZE = 384;
+
+  struct Observer {
+    HttpStreamId stream;
+    bool open;
+    bool hasLast;
+    uint32_t intervalMs;
+    uint32_t lastWriteMs;
+    StatusView last;
+  };
+
+  HttpServer& server;
+  Observer observers[MAX_OBSERVERS];
+  char event[EVENT_SIZE];
+
+public:
+  explicit StatusEventStream(HttpServer& serverInstance);
+
+  // Turn the request into an event stream for a new observer; false when
+  // all observer slots are in use
+  bool add(HttpExchange& exchange, uint32_t intervalMs);
+
+  // Push pending changes to every observer that is due. Returns the ms
+  // until the next observer is due, or SCHEDULE_NEVER with none open.
+  uint32_t poll(const StatusView& current, uint32_t nowMs);
+
+  uint8_t count() const;
+};
+
+static_assert(StatusEventStream::MAX_OBSERVERS >= 1 &&
+              StatusEventStream::MAX_OBSERVERS + 2 <= HttpServer::MAX_CONNECTIONS,
+              "Event streams must leave connections free for control requests");
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,74 @@
+#ifndef FLOW_CALIBRATION_H
+#define FLOW_CALIBRATION_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// Run profile for delivering a volume at a calibrated flow rate
+struct DosePlan {
+  uint16_t duty;
+  uint32_t flowRate;    // uL/min actually expected at that duty
+  uint32_t durationMs;
+};
+
+// Measured flow rate of the peristaltic pump at a set of PWM duties.
+// Points are kept sorted by duty with flow strictly increasing, so the
+// piecewise-linear curve through them can be inverted to find the duty for
+// a requested flow. Persisted through the Hal settings store.
+class FlowCalibration {
+public:
+  static const uint8_t MAX_POINTS = 8;
+
+  struct Point {
+    uint16_t duty;
+    uint32_t flowRate;  // uL/min
+  };
+
+private:
+  static const uint8_t STORAGE_VERSION = 1;
+
+  struct Stored {
+    uint8_t version;
+    uint8_t count;
+    Point points[MAX_POINTS];
+  };
+
+  Hal& hal;
+  Point points[MAX_POINTS];
+  uint8_t pointCount;
+
+  uint16_t dutyFor(uint32_t flowRate) const;
+
+public:
+  explicit FlowCalibration(Hal& halInstance);
+
+  bool load();
+  bool save() const;
+
+  // Add or replace the point for a duty. Fails when the table is full or
+  // the point would make flow non-increasing in duty.
+  bool addPoint(uint16_t duty, uint32_t flowRate);
+  void clear() { pointCount = 0; }
+
+  uint8_t count() const { return pointCount; }
+  const Point& point(uint8_t index) const { return points[index]; }
+  bool isCalibrated() const { return pointCount >= 2; }
+  uint32_t minFlowRate() const { return pointCount > 0 ? points[0].flowRate : 0; }
+  uint32_t maxFlowRate() const { return pointCount > 0 ? points[pointCount - 1].flowRate : 0; }
+
+  // Interpolated flow at a duty, clamped to the calibrated range
+  uint32_t flowAt(uint16_t duty) const;
+
+  // Duty and run time for a volume at a flow rate inside the calibrated
+  // range. The run time is computed from the flow at the rounded duty, so
+  // duty quantization does not show up as a volume error.
+  bool planDose(uint32_t volumeUl, uint32_t flowRate, DosePlan& plan) const;
+};
+
+// Volume pumped in elapsedMs at flowRate uL/min
+uint32_t volumeDelivered(uint32_t flowRate, uint32_t elapsedMs);
+
+// Flow rate in uL/min that pumped volumeUl in elapsedMs
+uint32_t flowRateFor(uint32_t volumeUl, uint32_t elapsedMs);
+
+#endif // FLOW_CALIBRATION_H
@@ -0,0 +1,106 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware abstraction used by the pump drivers. Everything the drivers need
+// from the chip - GPIO, pulse counters, the ADC, LEDC PWM, clock, timers,
+// settings storage, the log flash region and the main loop's wakeups - goes
+// through this interface so the same driver code runs on the ESP32
+// (Esp32Hal) and on a Linux host against a simulated board (SimHal).
+static const size_t LOG_FLASH_SECTOR_SIZE = 4096;
+
+typedef void* HalTimer;
+typedef void (*HalTimerCallback)(void* arg);
+typedef void (*HalAdcCallback)(void* arg, uint32_t millivolts);
+
+class Hal {
+public:
+  virtual ~Hal() {}
+
+  // GPIO
+  virtual void pinModeOutput(uint8_t pin) = 0;
+  virtual void writePin(uint8_t pin, bool high) = 0;
+  virtual bool readPin(uint8_t pin) = 0;
+
+  // Several outputs at once; bit n of a mask is GPIO n. Every pin in
+  // clearMask goes low before any pin in setMask goes high, and pins in the
+  // same bank (GPIO 0-31, 32-48) change together, in one register write, so
+  // a pair that swaps levels only ever passes through both-low.
+  virtual void writePins(uint64_t setMask, uint64_t clearMask) = 0;
+
+  // Pulse counters (PCNT). counterSetup() counts rising edges on pin, with
+  // a pull-up and a glitch filter, in unit; counterRead() returns the edges
+  // since then, wrapping at 2^32. Read at least every 32767 edges, which is
+  // what the hardware counter holds.
+  virtual bool counterSetup(uint8_t unit, uint8_t pin) = 0;
+  virtual uint32_t counterRead(uint8_t unit) = 0;
+
+  // Continuous ADC (DMA on the board): pin sampled at sampleHz in the
+  // background, and after every blockSamples samples the callback gets
+  // their mean in calibrated millivolts. It runs in a task of its own at a
+  // priority above the control task, so readings keep coming whatever the
+  // rest of the firmware is doing. One stream, started once.
+  virtual bool adcStartContinuous(uint8_t pin, uint32_t sampleHz, uint16_t blockSamples,
+                                  HalAdcCallback callback, void* arg) = 0;
+
+  // PWM (LEDC). pwmSetup returns the frequency actually configured.
+  virtual uint32_t pwmSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) = 0;
+  virtual void pwmAttachPin(uint8_t pin, uint8_t channel) = 0;
+  virtual void pwmWrite(uint8_t channel, uint32_t duty) = 0;
+
+  // Clock
+  virtual uint32_t nowMs() = 0;
+  virtual uint64_t nowUs() = 0;
+  virtual void delayMs(uint32_t ms) = 0;
+  virtual void delayUs(uint32_t us) = 0;
+
+  // Microsecond timers. Callbacks run in timer task context (not an ISR)
+  // and may use the drivers, taking lock() like any other task. Starting a
+  // timer that is already armed re-arms it.
+  virtual HalTimer createTimer(HalTimerCallback callback, void* arg, const char* name) = 0;
+  virtual void startTimerOnce(HalTimer timer, uint64_t delayUs) = 0;
+  virtual void startTimerPeriodic(HalTimer timer, uint64_t periodUs) = 0;
+  virtual void stopTimer(HalTimer timer) = 0;
+
+  // Persistent settings (NVS on the board). loadBlob() only succeeds when a
+  // blob of exactly len bytes is stored under key.
+  virtual bool loadBlob(const char* key, void* data, size_t len) = 0;
+  virtual bool saveBlob(const char* key, const void* data, size_t len) = 0;
+
+  // Raw flash region holding the event log ("evlog" partition on the
+  // board). NOR semantics: erased bytes read 0xFF, a write can only clear
+  // bits, and erases cover whole LOG_FLASH_SECTOR_SIZE sectors. Size 0 when
+  // there is no such region.
+  virtual size_t logFlashSize() = 0;
+  virtual bool logFlashErase(size_t offset, size_t len) = 0;
+  virtual bool logFlashWrite(size_t offset, const void* data, size_t len) = 0;
+  virtual bool logFlashRead(size_t offset, void* data, size_t len) = 0;
+
+  // Main loop sleep. waitForEvent() blocks the calling task until
+  // signalEvent() or until timeoutMs has passed (0xFFFFFFFF: no timeout).
+  // signalEvent() may be called from any task or ISR; a signal sent while
+  // nobody waits ends the next wait at once.
+  virtual void waitForEvent(uint32_t timeoutMs) = 0;
+  virtual void signalEvent() = 0;
+
+  // Recursive lock serializing driver state between the control task and
+  // timer callbacks
+  virtual void lock() = 0;
+  virtual void unlock() = 0;
+};
+
+// Scoped hal.lock()
+class HalLock {
+private:
+  Hal& hal;
+  HalLock(const HalLock&);
+  HalLock& operator=(const HalLock&);
+
+public:
+  explicit HalLock(Hal& halInstance) : hal(halInstance) { hal.lock(); }
+  ~HalLock() { hal.unlock(); }
+};
+
+#endif // HAL_H
@@ -0,0 +1,87 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <Arduino.h>
+#include <esp_adc_cal.h>
+#include <esp_partition.h>
+#include "hal.h"
+
+// Hal backed by the Arduino-ESP32 core (ledc*, millis), the GPIO set and
+// clear registers, the PCNT and continuous ADC drivers, esp_timer, Preferences (NVS), the "evlog" data partition and FreeRTOS
+// semaphores for the lock and the loop's wakeups
+class Esp32Hal : public Hal {
+private:
+  SemaphoreHandle_t mutex;
+  SemaphoreHandle_t wakeSemaphore;
+  const esp_partition_t* logPartition;
+
+  // The hardware counters are 16-bit and restart at COUNTER_LIMIT; the
+  // totals carry on from the last reading
+  static const uint8_t COUNTER_UNITS = 4;
+  static const int16_t COUNTER_LIMIT = 32767;
+  int16_t counterLast[COUNTER_UNITS];
+  uint32_t counterTotal[COUNTER_UNITS];
+
+  // Continuous ADC: the DMA driver fills a ring that adcTask drains in
+  // ADC_FRAME_BYTES frames, averaging adcBlockSamples samples per callback
+  static const UBaseType_t ADC_TASK_PRIORITY = 12;  // Above the control task (10)
+  static const uint8_t ADC1_FIRST_PIN = 1;          // ADC1 channel n is GPIO n + 1
+  static const uint8_t ADC1_LAST_PIN = 10;
+  static const uint32_t ADC_FRAME_BYTES = 256;      // 64 samples of 4 bytes
+  TaskHandle_t adcTask;
+  uint8_t adcChannel;
+  uint16_t adcBlockSamples;
+  HalAdcCallback adcCallback;
+  void* adcArg;
+  esp_adc_cal_characteristics_t adcCalibration;
+  static void adcTaskEntry(void* param);
+  void adcRun();
+
+public:
+  Esp32Hal();
+
+  void pinModeOutput(uint8_t pin) override;
+  void writePin(uint8_t pin, bool high) override;
+  bool readPin(uint8_t pin) override;
+  void writePins(uint64_t setMask, uint64_t clearMask) override;
+
+  bool counterSetup(uint8_t unit, uint8_t pin) override;
+  uint32_t counterRead(uint8_t unit) override;
+
+  bool adcStartContinuous(uint8_t pin, uint32_t sampleHz, uint16_t blockSamples,
+                          HalAdcCallback callback, void* arg) override;
+
+  uint32_t pwmSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) override;
+  void pwmAttachPin(uint8_t pin, uint8_t channel) override;
+  void pwmWrite(uint8_t channel, uint32_t duty) override;
+
+  uint32_t nowMs() override;
+  uint64_t nowUs() override;
+  void delayMs(uint32_t ms) override;
+  void delayUs(uint32_t us) override;
+
+  HalTimer createTimer(HalTimerCallback callback, void* arg, const char* name) override;
+  void startTimerOnce(HalTimer timer, uint64_t delayUs) override;
+  void startTimerPeriodic(HalTimer timer, uint64_t periodUs) override;
+  void stopTimer(HalTimer timer) override;
+
+  bool loadBlob(const char* key, void* data, size_t len) override;
+  bool saveBlob(const char* key, const void* data, size_t len) override;
+
+  size_t logFlashSize() override;
+  bool logFlashErase(size_t offset, size_t len) override;
+  bool logFlashWrite(size_t offset, const void* data, size_t len) override;
+  bool logFlashRead(size_t offset, void* data, size_t len) override;
+
+  void waitForEvent(uint32_t timeoutMs) override;
+  void signalEvent() override;
+
+  void lock() override;
+  void unlock() override;
+
+  // Let the CPU clock drop to 80 MHz while every task is blocked. The idle
+  // task already halts the core (WAITI) between interrupts.
+  void enablePowerSaving();
+};
+
+#endif // HAL_ESP32_H
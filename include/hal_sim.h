@@ -0,0 +1,145 @@
+#ifndef HAL_SIM_H
+#define HAL_SIM_H
+
+#include "hal.h"
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Simulated board for running the pump drivers on a Linux host. Time only
+// moves when advanceUs() or a delay is called; timers that fall due while
+// time advances fire at their exact deadline. Every output change is
+// recorded with its timestamp so tests and tools can inspect exactly what
+// the drivers did to the pins. Single-threaded, so lock() is a no-op.
+class SimHal : public Hal {
+public:
+  enum EventKind {
+    EVENT_PIN,   // GPIO level change: index = pin, value = 0/1
+    EVENT_PWM    // LEDC duty change: index = channel, value = duty
+  };
+
+  struct Event {
+    uint64_t timeUs;
+    EventKind kind;
+    uint8_t index;
+    uint32_t value;
+    uint32_t write;  // Output write it came from; changes sharing one happened in the same instant
+  };
+
+  static const int NUM_PINS = 49;
+  static const int NUM_PWM_CHANNELS = 8;
+  static const int NUM_COUNTERS = 4;
+
+  SimHal();
+  ~SimHal();
+
+  void pinModeOutput(uint8_t pin) override;
+  void writePin(uint8_t pin, bool high) override;
+  bool readPin(uint8_t pin) override;
+  // Modelled on the register pair: the clear lands as one write, then the
+  // set as another
+  void writePins(uint64_t setMask, uint64_t clearMask) override;
+
+  bool counterSetup(uint8_t unit, uint8_t pin) override;
+  uint32_t counterRead(uint8_t unit) override;
+
+  // Modelled without the samples: each block period a timer hands over the
+  // level set with setAnalogInput() as the block's mean
+  bool adcStartContinuous(uint8_t pin, uint32_t sampleHz, uint16_t blockSamples,
+                          HalAdcCallback callback, void* arg) override;
+
+  uint32_t pwmSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) override;
+  void pwmAttachPin(uint8_t pin, uint8_t channel) override;
+  void pwmWrite(uint8_t channel, uint32_t duty) override;
+
+  uint32_t nowMs() override;
+  uint64_t nowUs() override;
+  void delayMs(uint32_t ms) override;
+  void delayUs(uint32_t us) override;
+
+  HalTimer createTimer(HalTimerCallback callback, void* arg, const char* name) override;
+  void startTimerOnce(HalTimer timer, uint64_t delayUs) override;
+  void startTimerPeriodic(HalTimer timer, uint64_t periodUs) override;
+  void stopTimer(HalTimer timer) override;
+
+  bool loadBlob(const char* key, void* data, size_t len) override;
+  bool saveBlob(const char* key, const void* data, size_t len) override;
+
+  size_t logFlashSize() override { return logFlash.size(); }
+  bool logFlashErase(size_t offset, size_t len) override;
+  bool logFlashWrite(size_t offset, const void* data, size_t len) override;
+  bool logFlashRead(size_t offset, void* data, size_t len) override;
+
+  // Single-threaded: waiting advances simulated time, firing timers, until
+  // one of them signals or the timeout is reached
+  void waitForEvent(uint32_t timeoutMs) override;
+  void signalEvent() override { signaled = true; }
+
+  void lock() override {}
+  void unlock() override {}
+
+  // Simulation control and inspection
+  void advanceUs(uint64_t us);
+  void advanceMs(uint32_t ms) { advanceUs((uint64_t)ms * 1000); }
+  bool isOutput(uint8_t pin) const;
+  bool pinLevel(uint8_t pin) const;
+  uint32_t pwmDuty(uint8_t channel) const;
+  int pwmPin(uint8_t channel) const;
+  // Edges arriving at the pin a counter was set up on; a model of whatever
+  // drives the pin calls this as time advances
+  void addPulses(uint8_t unit, uint32_t count);
+  int counterPin(uint8_t unit) const;
+  // Level at an analog input, 0 until set
+  void setAnalogInput(uint8_t pin, uint32_t millivolts);
+  // A stalled ADC stream delivers nothing, as if its DMA had stopped
+  void setAdcStalled(bool stalled);
+  const std::vector<Event>& events() const { return eventLog; }
+  void clearEvents() { eventLog.clear(); }
+
+  // Log flash: 16 sectors unless resized. tearNextLogWrite() makes the next
+  // write stop after that many bytes, as if power failed during it.
+  // interruptNextLogErase() makes the next erase fail part done: each bit
+  // the seed picks has reached 1, the rest keep what was programmed.
+  void setLogFlashSize(size_t size) { logFlash.assign(size, 0xFF); }
+  void tearNextLogWrite(size_t bytes) { tearAfter = bytes; }
+  void interruptNextLogErase(uint32_t seed) { eraseSeed = seed; }
+
+private:
+  struct SimTimer {
+    HalTimerCallback callback;
+    void* arg;
+    bool armed;
+    uint64_t deadlineUs;
+    uint64_t periodUs;  // 0 for one-shot
+  };
+
+  uint64_t timeUs;
+  bool advancing;
+  bool signaled;
+  std::vector<SimTimer*> timers;
+  bool outputs[NUM_PINS];
+  bool levels[NUM_PINS];
+  uint32_t duties[NUM_PWM_CHANNELS];
+  int attachedPins[NUM_PWM_CHANNELS];
+  uint32_t counts[NUM_COUNTERS];
+  int counterPins[NUM_COUNTERS];  // -1 until set up
+  uint32_t analogMv[NUM_PINS];
+  HalTimer adcTimer;  // NULL until the stream starts
+  uint8_t adcPin;
+  uint64_t adcBlockUs;
+  HalAdcCallback adcCallback;
+  void* adcArg;
+  static void onAdcBlock(void* arg);
+  std::vector<Event> eventLog;
+  uint32_t writeCount;
+  std::map<std::string, std::vector<uint8_t> > storage;
+  std::vector<uint8_t> logFlash;
+  long tearAfter;  // -1 when no tear is pending
+  uint32_t eraseSeed;  // 0 when no interrupted erase is pending
+
+  void record(EventKind kind, uint8_t index, uint32_t value);
+  void applyLevel(uint8_t pin, bool high);
+};
+
+#endif // HAL_SIM_H
@@ -0,0 +1,72 @@
+#ifndef HTTP_REQUEST_H
+#define HTTP_REQUEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum HttpMethod {
+  HTTP_METHOD_ANY,    // Route matching only
+  HTTP_METHOD_GET,
+  HTTP_METHOD_POST,
+  HTTP_METHOD_OTHER
+};
+
+// Incremental HTTP/1.x request parser over a fixed per-connection buffer.
+// Bytes are appended as they arrive; once a request is complete its parts
+// are available as slices into the buffer. Bytes that arrive after the end
+// of a request (a pipelined request) are kept and parsed after reset(). A
+// request that does not fit the buffer is rejected with the matching
+// status code rather than grown on the heap.
+class HttpRequest {
+public:
+  static const size_t BUFFER_SIZE = 2560;  // Head plus body
+  static const size_t MAX_HEAD_SIZE = 1024;
+
+  enum State {
+    STATE_INCOMPLETE,
+    STATE_COMPLETE,
+    STATE_ERROR
+  };
+
+private:
+  char buffer[BUFFER_SIZE + 1];  // +1 so the head can be terminated in place
+  size_t used;
+  size_t bodyStart;
+  size_t contentLength;
+  State state;
+  int errorStatus;
+
+  HttpMethod requestMethod;
+  const char* requestPath;
+  const char* requestQuery;
+  bool keepAlive;
+
+  State fail(int status);
+  State parseHead(size_t headEnd);
+
+public:
+  HttpRequest();
+
+  // Append received bytes and parse as far as possible
+  State feed(const char* data, size_t len);
+
+  // Drop the completed request, keeping any bytes that followed it
+  State reset();
+
+  // Forget everything, for a new connection
+  void clear() { used = 0; state = STATE_INCOMPLETE; reset(); }
+
+  State getState() const { return state; }
+  int getErrorStatus() const { return errorStatus; }  // 400, 413, 431 or 501
+
+  HttpMethod method() const { return requestMethod; }
+  const char* path() const { return requestPath; }
+  const char* body() const { return buffer + bodyStart; }
+  size_t bodyLength() const { return contentLength; }
+  bool isKeepAlive() const { return keepAlive; }
+
+  // Copy a query parameter into out, URL-decoded; false if absent
+  bool queryParam(const char* name, char* out, size_t outSize) const;
+};
+
+#endif // HTTP_REQUEST_H
@@ -0,0 +1,153 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <functional>
+#include "http_request.h"
+
+class HttpServer;
+struct HttpConnection;
+
+// Identifies an event-stream connection across its lifetime; a slot that
+// is reused by a later client gets a new id
+typedef int32_t HttpStreamId;
+static const HttpStreamId HTTP_NO_STREAM = -1;
+
+// Produces the next piece of a streamed response body into out (at most
+// max bytes) and returns its length; 0 ends the response
+typedef std::function<size_t(char* out, size_t max)> HttpBodyWriter;
+
+// What a route handler sees: the parsed request and the ways to answer it.
+// Exactly one send*() or beginEventStream() call per request.
+class HttpExchange {
+private:
+  HttpServer& server;
+  HttpConnection& connection;
+  bool responded;
+
+  friend class HttpServer;
+  HttpExchange(HttpServer& serverInstance, HttpConnection& connectionInstance);
+
+public:
+  const HttpRequest& request() const;
+  HttpMethod method() const { return request().method(); }
+  const char* body() const { return request().body(); }
+  size_t bodyLength() const { return request().bodyLength(); }
+  bool queryParam(const char* name, char* out, size_t outSize) const {
+    return request().queryParam(name, out, outSize);
+  }
+
+  // Small response copied into the connection's send buffer
+  void send(int code, const char* contentType, const char* body, size_t length);
+
+  // Response whose body stays in flash and is sent as the window allows.
+  // extraHeaders, if given, is inserted verbatim ("Name: value\r\n"...).
+  void sendStatic(int code, const char* contentType, const uint8_t* body, size_t length,
+                  const char* extraHeaders = NULL);
+
+  // Response generated piece by piece as the window drains, for bodies too
+  // large to hold. Its length isn't known up front, so the connection
+  // closes after it.
+  void sendStream(int code, const char* contentType, HttpBodyWriter writer, const char* extraHeaders = NULL);
+
+  // Switch the connection to a text/event-stream and hand back its id
+  HttpStreamId beginEventStream();
+
+  bool hasResponded() const { return responded; }
+};
+
+typedef std::function<void(HttpExchange&)> HttpHandler;
+
+// Per-connection state, all in fixed buffers allocated with the server
+struct HttpConnection {
+  static const size_t TX_BUFFER_SIZE = 1024;
+
+  AsyncClient* client;
+  uint32_t generation;
+  HttpRequest request;
+  char tx[TX_BUFFER_SIZE];
+  size_t txLen;
+  size_t txSent;
+  const uint8_t* staticBody;  // Streamed after tx, straight from flash
+  size_t staticLen;
+  size_t staticSent;
+  HttpBodyWriter bodyWriter;  // Refills tx once it has been sent
+  bool closeWhenSent;
+  bool eventStream;
+  uint32_t lastActivityMs;
+};
+
+// Event-driven HTTP/1.1 server on AsyncTCP. Connections are served
+// concurrently from the AsyncTCP task with keep-alive, each in a fixed
+// slot, so memory use does not depend on the traffic. A mutex serializes
+// the AsyncTCP callbacks with service(), which loop() calls to expire idle
+// connections and by the event streams to push data.
+class HttpServer {
+public:
+  static const uint8_t MAX_CONNECTIONS = 6;
+  static const uint8_t MAX_ROUTES = 24;
+  static const uint32_t IDLE_TIMEOUT_MS = 5000;
+
+private:
+  struct Route {
+    const char* path;
+    HttpMethod method;
+    HttpHandler handler;
+    uint32_t requests;  // Dispatched to this route, counted under the lock
+  };
+
+  AsyncServer server;
+  SemaphoreHandle_t mutex;
+  Route routes[MAX_ROUTES];
+  uint8_t routeCount;
+  uint32_t unroutedRequests;  // 404 and 405
+  HttpConnection connections[MAX_CONNECTIONS];
+
+  HttpConnection* slotFor(AsyncClient* client);
+  HttpConnection* streamConnection(HttpStreamId id);
+  void accept(AsyncClient* client);
+  void onData(HttpConnection& connection, const char* data, size_t len);
+  void onAck(HttpConnection& connection);
+  void release(HttpConnection& connection);
+  void processRequests(HttpConnection& connection);
+  void dispatch(HttpConnection& connection);
+  void pump(HttpConnection& connection);
+  bool idle(const HttpConnection& connection) const;
+  void sendError(HttpConnection& connection, int code, const char* message);
+
+  friend class HttpExchange;
+  void writeHead(HttpConnection& connection, int code, const char* contentType,
+                 size_t contentLength, const char* extraHeaders);
+
+public:
+  explicit HttpServer(uint16_t port);
+
+  // Routes are tried in the order they were added. A path ending in "/*"
+  // matches everything below it, e.g. "/api/pumps/*" takes "/api/pumps/3".
+  void on(const char* path, HttpHandler handler) { on(path, HTTP_METHOD_ANY, handler); }
+  void on(const char* path, HttpMethod method, HttpHandler handler);
+  void begin();
+
+  // Call from loop(): closes idle keep-alive connections
+  void service();
+
+  // Event streams: write is all-or-nothing and never blocks; false means
+  // the connection has no room right now (or is gone - see streamOpen)
+  bool streamOpen(HttpStreamId id);
+  bool streamWrite(HttpStreamId id, const char* data, size_t len);
+
+  // Requests per route, for /metrics; read from a handler or under lock()
+  uint8_t getRouteCount() const { return routeCount; }
+  const char* getRoutePath(uint8_t index) const { return routes[index].path; }
+  HttpMethod getRouteMethod(uint8_t index) const { return routes[index].method; }
+  uint32_t getRouteRequests(uint8_t index) const { return routes[index].requests; }
+  uint32_t getUnroutedRequests() const { return unroutedRequests; }
+
+  void lock() { xSemaphoreTakeRecursive(mutex, portMAX_DELAY); }
+  void unlock() { xSemaphoreGiveRecursive(mutex); }
+};
+
+const char* httpStatusText(int code);
+
+#endif // HTTP_SERVER_H
@@ -0,0 +1,64 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal pull-style JSON tokenizer working in place over a request body.
+// It never allocates: strings are returned as (pointer, length) slices into
+// the original text, with escape sequences left undecoded. Only what the
+// control API needs is supported - objects, arrays, strings, unsigned
+// integers, booleans and skipping of any other value.
+enum JsonError {
+  JSON_OK = 0,
+  JSON_ERR_SYNTAX,     // Malformed document
+  JSON_ERR_TYPE,       // Value has a different type than requested
+  JSON_ERR_RANGE,      // Number is negative, fractional or does not fit
+  JSON_ERR_DEPTH       // Nesting too deep to skip
+};
+
+class JsonReader {
+private:
+  const char* text;
+  size_t length;
+  size_t pos;
+  JsonError err;
+
+  static const int MAX_SKIP_DEPTH = 8;
+
+  void skipWhitespace();
+  bool consume(char c);
+  bool fail(JsonError error);
+  bool scanString(const char*& value, size_t& valueLen);
+  bool skipNumber();
+  bool skipLiteral(const char* literal);
+  bool skipValueAtDepth(int depth);
+
+public:
+  JsonReader(const char* jsonText, size_t jsonLength);
+
+  // Containers. next*() return false at the closing bracket (which is then
+  // consumed) or on error - check ok() to tell the two apart.
+  bool beginObject();
+  bool nextKey(const char*& key, size_t& keyLen);
+  bool beginArray();
+  bool nextElement();
+
+  // Values
+  bool readString(const char*& value, size_t& valueLen);
+  bool readUInt(uint32_t& value);
+  bool readBool(bool& value);
+  bool skipValue();
+
+  // True if only whitespace remains
+  bool atEnd();
+
+  bool ok() const { return err == JSON_OK; }
+  JsonError error() const { return err; }
+  size_t position() const { return pos; }
+
+  // Compare a slice returned by nextKey()/readString() with a C string
+  static bool equals(const char* slice, size_t sliceLen, const char* literal);
+};
+
+#endif // JSON_READER_H
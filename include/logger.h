@@ -0,0 +1,60 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile-time log levels. Set LOG_LEVEL with a build flag; statements above
+// the configured level compile to nothing, including their arguments.
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Keeps the format string type-checked while generating no code
+#define LOG_DISABLED(...) do { if (0) logPrintf(__VA_ARGS__); } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) logPrintf(fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) logPrintf(fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) logPrintf(fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) logPrintf(fmt "\n", ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+// Formats a message into a lock-free ring buffer and returns immediately.
+// Safe to call from any task; if the ring is full the message is dropped
+// (and counted) rather than blocking the caller.
+void logPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Start the low-priority task that drains the ring to Serial (ESP32 only)
+void logBegin();
+
+// Write out everything queued so far from the calling context. Only for
+// builds without the drain task (the host), as the ring has one consumer.
+void logFlush();
+
+uint32_t logDroppedCount();
+
+#endif // LOGGER_H
@@ -0,0 +1,64 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-bucket histogram of durations in microseconds. observe() is a
+// bucket search and two relaxed atomic adds - no lock, no allocation - so it
+// can be called from any task or timer callback and left on in production.
+// Buckets are not cumulative in memory; the exposition adds them up.
+class Histogram {
+public:
+  static const uint8_t MAX_BOUNDS = 12;
+
+  struct Snapshot {
+    uint32_t buckets[MAX_BOUNDS + 1];  // Last one is +Inf
+    uint64_t sumUs;
+  };
+
+private:
+  const char* name;
+  const char* help;
+  const uint32_t* bounds;  // Upper bounds in us, ascending
+  uint8_t boundCount;
+  std::atomic<uint32_t> buckets[MAX_BOUNDS + 1];
+
+  // 64-bit sum as two words: 32-bit atomics are lock-free on the ESP32,
+  // 64-bit ones are not. The writer that wraps the low word carries.
+  std::atomic<uint32_t> sumLow;
+  std::atomic<uint32_t> sumHigh;
+
+public:
+  Histogram(const char* metricName, const char* metricHelp, const uint32_t* boundsUs, uint8_t count);
+
+  void observe(uint32_t us);
+
+  // Copy of the counters, consistent enough for one scrape
+  void snapshot(Snapshot& out) const;
+
+  // Prometheus text format, one line at a time so a scrape can be streamed
+  // through a small buffer: HELP, TYPE, one line per bucket, +Inf, sum and
+  // count. Returns the line length, or 0 past the last line.
+  size_t formatLine(const Snapshot& snap, uint8_t line, char* out, size_t max) const;
+};
+
+// What the firmware measures about itself, served at /metrics
+struct RuntimeMetrics {
+  Histogram httpHandler;        // Route handler run time
+  Histogram commandLatency;     // Command queued -> applied to the PWM outputs
+  Histogram schedulerLateness;  // Main loop job run, past its deadline
+  Histogram timedStopError;     // Timed stop, past its deadline
+  Histogram speedLoopRun;       // Closed-loop speed step run time
+  Histogram speedLoopJitter;    // Closed-loop speed step, off its fixed period
+
+  static const uint8_t HISTOGRAM_COUNT = 6;
+  Histogram* histogram(uint8_t index);
+
+  RuntimeMetrics();
+};
+
+extern RuntimeMetrics metrics;
+
+#endif // METRICS_H
@@ -0,0 +1,53 @@
+#ifndef PI_CONTROLLER_H
+#define PI_CONTROLLER_H
+
+#include <stdint.h>
+
+// Proportional-integral step shared by the closed loops (head speed and
+// vacuum). The caller normalises the error to its full scale; the output is
+// a duty fraction, feedforward included, clamped to [minimum, maximum].
+//
+// Anti-windup by conditional integration: while the output is pinned at a
+// limit, error that would push it further is not integrated, so the loop
+// comes off the limit as soon as the error turns.
+class PiController {
+private:
+  float kp;
+  float ki;
+  float minimum;
+  float maximum;
+  float integral;  // Duty fraction
+
+public:
+  PiController() : kp(0.0f), ki(0.0f), minimum(0.0f), maximum(1.0f), integral(0.0f) {}
+
+  void configure(float proportionalGain, float integralGain, float minOutput, float maxOutput) {
+    kp = proportionalGain;
+    ki = integralGain;
+    minimum = minOutput;
+    maximum = maxOutput;
+    integral = 0.0f;
+  }
+
+  // Start the integral over at value; the duty already applied, for a
+  // bumpless switch from open loop
+  void reset(float value = 0.0f) { integral = value; }
+
+  // One step on error, dtUs after the previous one
+  float update(float error, float feedforward, uint32_t dtUs) {
+    float proportional = kp * error;
+    float candidate = integral + ki * error * (dtUs * 1e-6f);
+
+    float out = feedforward + proportional + candidate;
+    if ((out > maximum && error > 0.0f) || (out < minimum && error < 0.0f)) {
+      out = feedforward + proportional + integral;
+    } else {
+      integral = candidate;
+    }
+    if (out > maximum) out = maximum;
+    if (out < minimum) out = minimum;
+    return out;
+  }
+};
+
+#endif // PI_CONTROLLER_H
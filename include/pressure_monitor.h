@@ -0,0 +1,95 @@
+#ifndef PRESSURE_MONITOR_H
+#define PRESSURE_MONITOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include "board_config.h"
+#include "hal.h"
+
+// What the vacuum gauge says about running the vacuum pump. Anything but
+// PRESSURE_OK stops it.
+enum PressureState {
+  PRESSURE_NO_DATA,       // No reading yet
+  PRESSURE_OK,
+  PRESSURE_OVER_VACUUM,   // Reached the cutoff, and not yet back below it by the hysteresis
+  PRESSURE_SENSOR_FAULT,  // Reading outside what the gauge can output: open or shorted wiring
+  PRESSURE_STALE          // Readings stopped arriving
+};
+
+const char* pressureStateName(PressureState state);
+
+// Vacuum gauge on the ADC, sampled continuously in the background. Every
+// BLOCK_SAMPLES samples become one reading, converted to pascals of vacuum
+// and judged against the cutoff right there in the sampling task; the
+// listener then gets it in that same task, which is where the vacuum pump
+// cuts its motor, without waiting on the control task or the main loop.
+//
+// Readers on other tasks see the latest reading and a trace of recent ones
+// through atomics, without a lock.
+class PressureMonitor {
+public:
+  static const uint32_t SAMPLE_HZ = 20000;
+  static const uint16_t BLOCK_SAMPLES = 200;
+  static const uint32_t READING_US = (uint32_t)BLOCK_SAMPLES * 1000000 / SAMPLE_HZ;  // 10 ms
+  static const uint16_t FAULT_MARGIN_MV = 100;  // Past the gauge's range before it counts as a fault
+  static const uint32_t STALE_MS = 100;         // Ten readings missed
+
+  // One trace point per TRACE_DECIMATION readings: 100 ms apart, the last
+  // minute kept
+  static const uint8_t TRACE_DECIMATION = 10;
+  static const uint16_t TRACE_POINTS = 600;
+  static const uint32_t TRACE_PERIOD_MS = READING_US * TRACE_DECIMATION / 1000;
+
+  // Called from the sampling task for every reading
+  typedef void (*Listener)(void* arg, int32_t pressurePa, PressureState state);
+
+private:
+  Hal& hal;
+  const PressureSensorConfig config;
+  Listener listener;
+  void* listenerArg;
+
+  // Sampling task only
+  bool overVacuum;  // Latched at the cutoff until below it by the hysteresis
+  uint8_t decimation;
+
+  std::atomic<int32_t> latestPa;
+  std::atomic<uint8_t> latestState;  // PressureState of the latest reading
+  std::atomic<uint32_t> latestMs;
+  std::atomic<uint32_t> readings;
+  std::atomic<int32_t> trace[TRACE_POINTS];
+  std::atomic<uint32_t> traceEndIndex;  // Points ever written; point i is at trace[i % TRACE_POINTS]
+
+  static void onBlock(void* arg, uint32_t millivolts);
+  void onReading(uint32_t millivolts);
+
+public:
+  PressureMonitor(Hal& halInstance, const PressureSensorConfig& sensorConfig);
+
+  // Before begin()
+  void setListener(Listener listenerFunction, void* arg);
+  // Start sampling. Until the first reading the state is PRESSURE_NO_DATA,
+  // so a failure here keeps the vacuum pump stopped.
+  bool begin();
+  // Wait, up to timeoutMs, for the first reading; the boot does, so the
+  // vacuum pump can run as soon as commands arrive
+  bool awaitFirstReading(uint32_t timeoutMs);
+
+  // Vacuum in Pa: 0 open to air, negative above atmospheric
+  int32_t toPascal(uint32_t millivolts) const;
+
+  int32_t pressurePa() const { return latestPa.load(); }
+  // The latest reading's state, or PRESSURE_STALE once they stop
+  PressureState state() const;
+  uint32_t readingCount() const { return readings.load(); }
+  const PressureSensorConfig& getConfig() const { return config; }
+
+  // Trace points are numbered from the first one ever taken; the ones from
+  // traceBegin() to traceEnd() are still held, oldest first. tracePoint()
+  // fails for one overwritten in the meantime.
+  uint32_t traceEnd() const { return traceEndIndex.load(); }
+  uint32_t traceBegin() const;
+  bool tracePoint(uint32_t index, int32_t& pressurePa) const;
+};
+
+#endif // PRESSURE_MONITOR_H
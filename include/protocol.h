@@ -0,0 +1,44 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pump_command.h"
+
+// A named sequence of pump and vacuum steps run on the device, e.g.
+//
+//   {"name": "prime", "steps": [
+//     {"target": "vacuum", "action": "start", "speed": 80, "durationMs": 3000},
+//     {"action": "forward", "speed": 600, "durationMs": 2500},
+//     {"action": "wait", "durationMs": 1000},
+//     {"action": "reverse", "speed": 1023, "duration": 4}]}
+//
+// "target" defaults to the peristaltic pump. A step with a duration is a
+// timed run and the next step starts when it ends; "async": true starts
+// the next step at once while this one keeps running on its own timer.
+// Speeds are duty (100-1023) for the pump and percent (10-80) for the
+// vacuum pump. Steps are checked in full before anything runs.
+struct ProtocolStep {
+  uint8_t target;       // CommandTarget
+  uint8_t action;       // CommandAction
+  bool async;
+  uint16_t speed;
+  uint32_t durationMs;  // 0 for continuous runs and stops
+};
+
+struct Protocol {
+  static const uint8_t MAX_STEPS = 16;
+  static const size_t MAX_NAME_LEN = 12;  // Fits an NVS key with a prefix
+  static const uint32_t MAX_STEP_MS = 300000;
+
+  char name[MAX_NAME_LEN + 1];
+  uint8_t stepCount;
+  ProtocolStep steps[MAX_STEPS];
+};
+
+// Parse and validate a protocol. A body with only a name parses with
+// stepCount == 0 (a reference to a stored protocol). On error badStep is
+// the index of the offending step, or -1 if the error is not in a step.
+CommandParseError parseProtocol(const char* body, size_t length, Protocol& protocol, int& badStep);
+
+#endif // PROTOCOL_H
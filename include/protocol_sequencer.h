@@ -0,0 +1,56 @@
+#ifndef PROTOCOL_SEQUENCER_H
+#define PROTOCOL_SEQUENCER_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "protocol.h"
+#include "pump_controller.h"
+#include "seqlock.h"
+
+// Progress of the current or most recent protocol run
+struct ProtocolProgress {
+  bool active;
+  bool aborted;             // Last run was stopped before its final step
+  uint8_t step;             // Index of the step running now
+  uint8_t stepCount;
+  char name[Protocol::MAX_NAME_LEN + 1];
+  uint64_t stepDeadlineUs;  // When the running step hands over to the next
+};
+
+// Runs a protocol against the PumpController from a one-shot HAL timer.
+// Each step's deadline is derived from the previous deadline rather than
+// from when the callback ran, so timer latency never accumulates over a
+// protocol. start() and stop() may be called from any task.
+class ProtocolSequencer {
+private:
+  PumpController& controller;
+  Hal& hal;
+  HalTimer stepTimer;
+
+  Protocol protocol;
+  uint8_t stepIndex;
+  bool active;
+  bool aborted;
+  uint64_t stepDeadlineUs;
+  SeqLock<ProtocolProgress> published;
+
+  void runSteps();
+  void executeStep(const ProtocolStep& step);
+  void publishProgress();
+  void stepTimerFired();
+  static void onStepTimer(void* arg);
+
+public:
+  ProtocolSequencer(PumpController& controllerInstance, Hal& halInstance);
+  void begin();
+
+  // Start a validated protocol, replacing any protocol already running
+  bool start(const Protocol& newProtocol);
+
+  // Abort the running protocol and stop both pumps
+  void stop();
+
+  ProtocolProgress progress() const { return published.load(); }
+};
+
+#endif // PROTOCOL_SEQUENCER_H
@@ -0,0 +1,48 @@
+#ifndef PROTOCOL_STORE_H
+#define PROTOCOL_STORE_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "protocol.h"
+
+// Named protocols kept in the Hal settings store, one blob per protocol
+// plus an index of the names in use
+class ProtocolStore {
+public:
+  static const uint8_t MAX_PROTOCOLS = 8;
+
+private:
+  static const uint8_t STORAGE_VERSION = 1;
+
+  struct Index {
+    uint8_t version;
+    uint8_t count;
+    char names[MAX_PROTOCOLS][Protocol::MAX_NAME_LEN + 1];
+  };
+
+  struct Stored {
+    uint8_t version;
+    Protocol protocol;
+  };
+
+  Hal& hal;
+  Index index;
+
+  int find(const char* name) const;
+  bool saveIndex();
+
+public:
+  explicit ProtocolStore(Hal& halInstance);
+
+  void begin();
+
+  // Store or replace a protocol; fails when all slots are taken
+  bool save(const Protocol& protocol);
+  bool load(const char* name, Protocol& protocol);
+  bool remove(const char* name);
+
+  uint8_t count() const { return index.count; }
+  const char* name(uint8_t i) const { return index.names[i]; }
+};
+
+#endif // PROTOCOL_STORE_H
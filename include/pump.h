@@ -1,7 +1,12 @@
 #ifndef PUMP_H
 #define PUMP_H
 
-#include <Arduino.h>
+#include <stdint.h>
+#include "board_config.h"
+#include "hal.h"
+#include "ramp.h"
+#include "speed_loop.h"
+#include "tb6612.h"
 
 // Peristaltic Pump States
 enum PumpState {
@@ -10,47 +15,110 @@ enum PumpState {
   PUMP_REVERSE   // Reverse rotation - Liquid extraction
 };
 
+// How a channel's speed setting is applied
+enum SpeedControl {
+  SPEED_OPEN_LOOP,     // No encoder: the setting is the duty
+  SPEED_CLOSED_LOOP,   // Encoder: the setting is a head speed, held by SpeedLoop
+  SPEED_ENCODER_FAULT  // Encoder silent while driving; open loop until the motor next stops
+};
+
 class PeristalticPump {
 private:
-  // Pin definitions
-  const int PIN_PWMA = 13;  // PWM-capable
-  const int PIN_STBY = 10;
-  const int PIN_AIN1 = 11;
-  const int PIN_AIN2 = 12;
-  
-  // PWM settings
-  const int PWM_CH = 2;  // Use different channel from vacuum pump
-  const int PWM_FREQ = 20000;
-  const int PWM_RES = 10;  // Match vacuum pump resolution
+  Hal& hal;
+  Tb6612Driver& driver;  // STBY is shared with the other channel
+  const ChannelConfig config;  // Pins, LEDC channel and PWM settings
+  const uint8_t id;  // Channel id, for the log
   
   // State variables
   PumpState currentState;
   uint16_t currentSpeed;  // 0-1023 for 10-bit PWM
-  uint32_t runDuration;
-  unsigned long pumpStartTime;
+  uint32_t runDurationMs;
+  uint32_t pumpStartTime;
+  uint64_t stopDeadlineUs;
   bool isTimedRun;
   uint32_t lastDuty;
   
+  // Timed runs end from a one-shot timer; update() is only a safety net
+  static const uint32_t TIMER_GRACE_US = 2000;
+  HalTimer stopTimer;
+  void (*stopListener)(void* arg);
+  void* stopListenerArg;
+  
+  // Optional duty ramps, stepped from a periodic timer while one is running.
+  // A reversal ramps down to zero on the old direction before the new
+  // direction is engaged.
+  static const uint32_t RAMP_TICK_US = 1000;
+  RampGenerator ramp;
+  HalTimer rampTimer;
+  PumpState driveDirection;  // Direction currently applied to AIN1/AIN2
+  PumpState pendingDirection;
+  uint16_t pendingDuty;
+  
+  // Closed-loop speed, on a channel with an encoder. The PI step runs from
+  // its own fixed-rate timer; lastDuty stays the commanded duty and the
+  // loop's trim is added where the duty is written.
+  static const uint32_t SPEED_TICK_US = 10000;
+  static const uint32_t ENCODER_TIMEOUT_US = 500000;
+  SpeedLoop speedLoop;
+  HalTimer speedTimer;
+  SpeedControl speedControl;
+  uint32_t lastPulseCount;
+  uint64_t lastSpeedTickUs;
+  uint64_t lastPulseUs;
+  
   // Private methods
   void logPinStates(const char* prefix);
   void motorCoast();
   void motorBrake();
+  void motorDrive(PumpState direction, uint16_t speed);
   void motorForward(uint16_t speed);
   void motorReverse(uint16_t speed);
+  uint32_t maxDuty() const { return (1UL << config.pwmRes) - 1; }
+  Tb6612Driver::Channel driverChannel() const { return (Tb6612Driver::Channel)config.driverChannel; }
+  void applyDuty(uint32_t duty);
+  void speedTick();
+  static void onSpeedTimer(void* arg);
+  void setDirection(PumpState direction);
+  void driveTo(PumpState state, uint16_t duty);
+  void rampTo(uint16_t duty);
+  void rampTick();
+  static void onRampTimer(void* arg);
+  void startTimedRun(uint32_t durationMs);
+  void timedStop();
+  static void onStopTimer(void* arg);
   
 public:
-  PeristalticPump();
+  PeristalticPump(Hal& halInstance, Tb6612Driver& driverInstance, const ChannelConfig& channelConfig,
+                  uint8_t channelId);
+  // Drive the channel's outputs low (coast). Touches only GPIO, so it can
+  // be the first thing setup() does, along with the driver's makeSafe().
+  void makeSafe();
   void begin();
-  void controlPump(PumpState state, uint16_t speed = 512, uint32_t duration = 0);
-  void update(); // Call in main loop to handle timed runs
+  void controlPump(PumpState state, uint16_t speed = 512, uint32_t durationMs = 0);
+  void update(); // Backup for timed runs in case the stop timer is late
+  
+  // Called (with the HAL lock held) when a timed run stops on its own
+  void setStopListener(void (*listener)(void* arg), void* arg);
+  
+  // Ramp profile for later speed and direction changes
+  void setRampConfig(const RampConfig& config);
+  RampConfig getRampConfig() const { return ramp.getConfig(); }
   
   // Getters
+  uint8_t getId() const { return id; }
   PumpState getCurrentState() const { return currentState; }
   uint16_t getCurrentSpeed() const { return currentSpeed; }
-  uint32_t getRunDuration() const { return runDuration; }
+  uint32_t getCurrentDuty() const { return lastDuty; }
+  SpeedControl getSpeedControl() const { return speedControl; }
+  uint16_t getMeasuredRpm() const;
+  uint32_t getRunDurationMs() const { return runDurationMs; }
   bool getIsTimedRun() const { return isTimedRun; }
-  unsigned long getPumpStartTime() const { return pumpStartTime; }
-  uint32_t getRemainingTime() const;
+  uint32_t getPumpStartTime() const { return pumpStartTime; }
+  uint64_t getStopDeadlineUs() const { return stopDeadlineUs; }
+  uint32_t getRemainingTimeMs() const;
+  // Whole seconds, rounded up: for whole-second runs the same value as the
+  // original "duration less whole seconds elapsed"
+  uint32_t getRemainingTime() const { return (getRemainingTimeMs() + 999) / 1000; }
 };
 
 #endif // PUMP_H
@@ -0,0 +1,104 @@
+#ifndef PUMP_COMMAND_H
+#define PUMP_COMMAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "board_config.h"
+#include "ramp.h"
+
+// Which motor a command is addressed to
+enum CommandTarget {
+  TARGET_PUMP,    // Peristaltic pump (/api/control)
+  TARGET_VACUUM,      // Vacuum pump (/api/vacuum)
+  TARGET_CALIBRATION  // Flow calibration routine (/api/calibrate)
+};
+
+enum CommandAction {
+  ACTION_NONE,
+  ACTION_STOP,
+  ACTION_FORWARD,    // Peristaltic only
+  ACTION_REVERSE,    // Peristaltic only
+  ACTION_START,      // Vacuum only
+  ACTION_EMERGENCY,  // Vacuum only
+  ACTION_SET_RAMP,   // Peristaltic only, from /api/ramp
+  ACTION_WAIT,       // Protocol steps only
+  ACTION_CAL_RUN,    // Calibration only
+  ACTION_CAL_RECORD, // Calibration only
+  ACTION_CAL_CLEAR   // Calibration only
+};
+
+// Who asked for a command, as recorded in the event log
+enum CommandSource {
+  SOURCE_UNKNOWN,
+  SOURCE_WEB,       // HTTP API
+  SOURCE_UDP,       // Binary UDP protocol
+  SOURCE_PROTOCOL,  // Protocol sequencer
+  SOURCE_TIMER,     // A timed run ending on its own
+  SOURCE_SYSTEM,    // Boot and other firmware-initiated changes
+  SOURCE_SERIAL,    // Line commands on the serial console
+  SOURCE_BUTTON,    // Front-panel buttons
+  SOURCE_INTERLOCK  // The vacuum gauge stopping the vacuum pump
+};
+
+enum CommandParseError {
+  CMD_OK = 0,
+  CMD_ERR_SYNTAX,           // Body is not a well-formed JSON object
+  CMD_ERR_MISSING_ACTION,   // No "action" field
+  CMD_ERR_UNKNOWN_ACTION,   // "action" not valid for this target
+  CMD_ERR_BAD_FIELD,        // Field has the wrong type or is out of range
+  CMD_ERR_DUPLICATE_FIELD,  // Same field given twice
+  CMD_ERR_MISSING_FIELD     // A field the request needs is absent
+};
+
+// A decoded control request. Numeric fields hold the raw value as sent;
+// range limits and defaults for missing fields are applied by the caller.
+struct PumpCommand {
+  CommandTarget target;
+  uint8_t channel;    // Peristaltic channel for TARGET_PUMP; 0 unless addressed
+  CommandAction action;
+  bool hasSpeed;
+  uint32_t speed;
+  bool hasDuration;
+  uint32_t duration;  // Milliseconds; "duration" (seconds) or "durationMs"
+  bool hasVolume;
+  uint32_t volume;    // uL
+  bool hasFlowRate;
+  uint32_t flowRate;  // uL/min
+  bool hasPressure;
+  uint32_t pressure;  // Pa of vacuum to hold ("targetPa"); vacuum starts only, and speed is then ignored
+  RampConfig ramp;    // ACTION_SET_RAMP only
+  CommandSource source;
+};
+
+// Commands applied together in one control tick, from /api/batch. Room for
+// one per motor, and never fewer than four.
+struct CommandBatch {
+  static const uint8_t MAX_COMMANDS = PUMP_CHANNEL_COUNT + 1 > 4 ? PUMP_CHANNEL_COUNT + 1 : 4;
+
+  uint8_t count;
+  PumpCommand commands[MAX_COMMANDS];
+};
+
+// Parse a request body in a single pass. Unknown fields are ignored. The run
+// length may be given as "duration" in whole seconds or "durationMs", but not
+// both, and a calibration run must give one.
+CommandParseError parsePumpCommand(const char* body, size_t length, CommandTarget target, PumpCommand& command);
+const char* commandParseErrorMessage(CommandParseError error);
+
+// Parse a batch body: a JSON array of command objects, each shaped like a
+// /api/control or /api/vacuum body plus "target": "pump" (the default) or
+// "vacuum", and for pumps "channel" (0 by default). The channel is not
+// range checked here. On error badCommand is the index of the offending command, or
+// -1 if the error is not in one.
+CommandParseError parseCommandBatch(const char* body, size_t length, CommandBatch& batch, int& badCommand);
+
+// Action named by an "action" string for a target, or ACTION_NONE
+CommandAction commandActionFromName(CommandTarget target, const char* name, size_t length);
+
+// Parse a ramp settings body ({"shape": "off|linear|scurve", "rampMs": n}).
+// Fields that are left out keep their value in config.
+CommandParseError parseRampConfig(const char* body, size_t length, RampConfig& config);
+const char* rampShapeName(RampShape shape);
+const char* commandSourceName(CommandSource source);
+
+#endif // PUMP_COMMAND_H
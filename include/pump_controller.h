@@ -0,0 +1,126 @@
+#ifndef PUMP_CONTROLLER_H
+#define PUMP_CONTROLLER_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "pump.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_command.h"
+#include "seqlock.h"
+
+class EventLog;
+
+// One peristaltic channel as seen by readers outside the control task
+struct ChannelStatus {
+  PumpState state;
+  uint16_t speed;
+  bool timedRun;
+  uint32_t runDurationMs;
+  uint64_t stopDeadlineUs;
+  RampConfig ramp;
+  SpeedControl speedControl;
+  uint16_t rpm;  // Measured head speed; 0 without an encoder
+};
+
+// Snapshot of the pumps as seen by readers outside the control task. The
+// pump* fields are channel 0, the pump of the single-pump interfaces.
+struct PumpStatus {
+  PumpState pumpState;
+  uint16_t pumpSpeed;
+  bool pumpTimedRun;
+  uint32_t pumpRunDurationMs;
+  uint64_t pumpStopDeadlineUs;
+  RampConfig pumpRamp;
+
+  VacuumPumpState vacuumState;
+  uint8_t vacuumSpeed;          // Percent
+  bool vacuumTimedRun;
+  uint32_t vacuumRunDurationMs;
+  uint64_t vacuumStopDeadlineUs;
+  uint32_t vacuumTargetPa;      // 0 unless regulating
+  int32_t vacuumPressurePa;     // Gauge reading when the snapshot was taken
+  PressureState vacuumInterlock;
+  PressureState vacuumLastTrip;  // What the gauge last stopped the pump for, PRESSURE_OK if it didn't
+
+  // Most recent volumetric dose on the peristaltic pump
+  bool doseActive;
+  uint32_t doseTargetUl;
+  uint32_t doseFlowRate;        // uL/min
+  uint32_t doseDeliveredUl;     // Final volume once the dose has ended
+
+  ChannelStatus channels[PUMP_CHANNEL_COUNT];
+};
+
+// Milliseconds left on a timed run (rounded up), as the pump classes report it
+uint32_t remainingMs(bool timedRun, uint64_t stopDeadlineUs, uint64_t nowUs);
+
+// Names used for the states in the JSON API
+const char* pumpStateName(PumpState state);
+const char* vacuumStateName(VacuumPumpState state);
+const char* speedControlName(SpeedControl control);
+
+// Volume delivered by the current or most recent dose
+uint32_t doseDeliveredUl(const PumpStatus& status, uint64_t nowUs);
+
+// Owns the pumps on behalf of a single control context. Pump commands go to
+// the channel they name; doses and the pump* status fields are channel 0. Commands are applied
+// with execute(); timed runs end from the pumps' own stop timers, with
+// service() as a backstop. Every change is published as a PumpStatus that
+// other tasks can read without locking.
+// Hardware independent, so the same logic runs in the ESP32 control task
+// and in host builds.
+class PumpController {
+private:
+  PumpManager& pumps;
+  PeristalticPump& pump;  // Channel 0
+  VacuumPump& vacuumPump;
+  Hal& hal;
+  SeqLock<PumpStatus> published;
+
+  bool doseActive;
+  uint32_t doseTargetUl;
+  uint32_t doseFlowRate;
+  uint32_t doseDeliveredUl;
+
+  // Last state written to the event log, so stops that happen on their own
+  // (timers, the ramp finishing) are logged once
+  EventLog* eventLog;
+  void (*commandListener)(void* arg);
+  void* commandListenerArg;
+  PumpState loggedPumpStates[PUMP_CHANNEL_COUNT];
+  VacuumPumpState loggedVacuumState;
+
+  void publishStatus();
+  void finishDose();
+  void logPump(PeristalticPump& channel, CommandSource source);
+  void logVacuum(CommandSource source);
+  static void onPumpStopped(void* arg);
+
+public:
+  PumpController(PumpManager& pumpsInstance, VacuumPump& vacuumPumpInstance, Hal& halInstance);
+
+  // Record every command applied and every timed stop in this log
+  void setEventLog(EventLog* log) { eventLog = log; }
+
+  // Called, in the caller's context, after each command has been applied
+  void setCommandListener(void (*listener)(void* arg), void* arg) {
+    commandListener = listener;
+    commandListenerArg = arg;
+  }
+
+  // Apply a command whose speed/duration have already been resolved. A pump
+  // command carrying a volume and flow rate is tracked as a dose.
+  void execute(const PumpCommand& command);
+
+  // Apply several commands back to back under one lock, so no timer,
+  // service pass or other command lands between them
+  void executeBatch(const CommandBatch& batch);
+
+  // Catch timed runs whose stop timer is overdue and republish the status
+  void service();
+
+  PumpStatus status() const { return published.load(); }
+};
+
+#endif // PUMP_CONTROLLER_H
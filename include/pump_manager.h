@@ -0,0 +1,100 @@
+#ifndef PUMP_MANAGER_H
+#define PUMP_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "board_config.h"
+#include "hal.h"
+#include "pump.h"
+#include "tb6612.h"
+
+// Objects ID..END-1 of Element<ID>, built in place one after the other with
+// the same constructor arguments, and looked up as Base pointers.
+// Lets a table of constexpr configs become a fixed array of objects whose
+// types know their entry, without the heap or default constructors.
+template <template <uint8_t> class Element, typename Base, uint8_t ID, uint8_t END>
+class StaticList {
+private:
+  Element<ID> head;
+  StaticList<Element, Base, ID + 1, END> tail;
+
+public:
+  template <typename... Args>
+  explicit StaticList(Args&... args) : head(args...), tail(args...) {}
+
+  Base* at(uint8_t i) { return i == ID ? &head : tail.at(i); }
+
+  void index(Base** table) {
+    table[ID] = &head;
+    tail.index(table);
+  }
+};
+
+template <template <uint8_t> class Element, typename Base, uint8_t END>
+class StaticList<Element, Base, END, END> {
+public:
+  template <typename... Args>
+  explicit StaticList(Args&...) {}
+
+  Base* at(uint8_t) { return NULL; }
+  void index(Base**) {}
+};
+
+// Driver ID of MOTOR_DRIVERS
+template <uint8_t ID>
+class MotorDriver : public Tb6612Driver {
+  static_assert(ID < MOTOR_DRIVER_COUNT, "No such entry in MOTOR_DRIVERS");
+
+public:
+  explicit MotorDriver(Hal& hal) : Tb6612Driver(hal, MOTOR_DRIVERS[ID]) {}
+};
+
+typedef StaticList<MotorDriver, Tb6612Driver, 0, MOTOR_DRIVER_COUNT> MotorDriverList;
+
+// Peristaltic channel ID of PUMP_CHANNELS, on the driver its entry names.
+// The behaviour is all in PeristalticPump, so each extra channel costs its
+// state and not another copy of the code.
+template <uint8_t ID>
+class PumpChannel : public PeristalticPump {
+  static_assert(ID < PUMP_CHANNEL_COUNT, "No such entry in PUMP_CHANNELS");
+
+public:
+  PumpChannel(Hal& hal, MotorDriverList& drivers)
+    : PeristalticPump(hal, *drivers.at(PUMP_CHANNELS[ID].driver), PUMP_CHANNELS[ID], ID) {}
+};
+
+// Owns the motor drivers and every peristaltic channel of the board, so
+// the rest of the firmware addresses pumps by channel id. Fixed size, set
+// by board_config.h. The vacuum pump stays separate but gets its driver
+// from here.
+class PumpManager {
+public:
+  static const uint8_t CHANNEL_COUNT = PUMP_CHANNEL_COUNT;
+
+private:
+  MotorDriverList driverList;  // Before the channels, which refer to it
+  Tb6612Driver* drivers[MOTOR_DRIVER_COUNT];
+  StaticList<PumpChannel, PeristalticPump, 0, PUMP_CHANNEL_COUNT> channelList;
+  PeristalticPump* channels[PUMP_CHANNEL_COUNT];
+
+public:
+  explicit PumpManager(Hal& hal);
+
+  // Every driver in standby, then every channel's outputs low. GPIO only,
+  // for the start of setup(); the vacuum pump's makeSafe() follows.
+  void makeSafe();
+  void begin();
+
+  // Backup for timed runs, on every channel
+  void update();
+
+  // Called (with the HAL lock held) when any channel's timed run ends
+  void setStopListener(void (*listener)(void* arg), void* arg);
+
+  static bool valid(uint8_t id) { return id < CHANNEL_COUNT; }
+  PeristalticPump& channel(uint8_t id) { return *channels[id]; }
+  const PeristalticPump& channel(uint8_t id) const { return *channels[id]; }
+  Tb6612Driver& driver(uint8_t index) { return *drivers[index]; }
+};
+
+#endif // PUMP_MANAGER_H
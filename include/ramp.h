@@ -0,0 +1,50 @@
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <stdint.h>
+
+enum RampShape {
+  RAMP_OFF,      // Duty changes in one step (original behaviour)
+  RAMP_LINEAR,   // Constant acceleration
+  RAMP_SCURVE    // Smoothstep: gentle start and finish
+};
+
+struct RampConfig {
+  RampShape shape;
+  uint16_t rampMs;  // Time for a full-scale 0 -> max duty change
+};
+
+// Duty trajectory between two set points. The ramp shape is precomputed
+// into a lookup table when configured, so each tick is a table lookup and
+// one interpolation - cheap enough to run from a 1 kHz timer. A segment's
+// length scales with the size of the duty change, so every ramp has the
+// same slope profile.
+class RampGenerator {
+public:
+  static const uint8_t TABLE_STEPS = 64;
+
+private:
+  uint16_t table[TABLE_STEPS + 1];  // Progress 0..32768 at each step
+  RampConfig config;
+  uint32_t fromDuty;
+  uint32_t toDuty;
+  uint32_t tick;
+  uint32_t totalTicks;
+
+public:
+  RampGenerator();
+
+  void configure(const RampConfig& rampConfig);
+  const RampConfig& getConfig() const { return config; }
+  bool enabled() const { return config.shape != RAMP_OFF && config.rampMs > 0; }
+
+  // Begin a segment; tickUs is the period at which next() will be called
+  void start(uint32_t from, uint32_t to, uint32_t maxDuty, uint32_t tickUs);
+  bool active() const { return tick < totalTicks; }
+  uint32_t target() const { return toDuty; }
+
+  // Advance one tick and return the duty to apply
+  uint32_t next();
+};
+
+#endif // RAMP_H
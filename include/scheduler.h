@@ -0,0 +1,61 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <stdint.h>
+#include "hal.h"
+
+// Returned by a job (or a service function) that has no deadline and only
+// needs to run again when woken
+static const uint32_t SCHEDULE_NEVER = 0xFFFFFFFF;
+
+// A job does its work and returns the number of ms until it next needs to
+// run, or SCHEDULE_NEVER
+typedef uint32_t (*SchedulerJob)(void* arg);
+
+// Cooperative scheduler for the work loop() used to poll for every 10 ms.
+// Each job has a deadline; run() calls the jobs that are due and then
+// blocks in hal.waitForEvent() until the earliest remaining deadline, so an
+// idle device doesn't wake at all. Other tasks, timer callbacks and ISRs
+// call wake() to have a job run straight away.
+class Scheduler {
+public:
+  static const uint8_t MAX_JOBS = 8;
+  typedef int8_t JobId;
+
+private:
+  struct Entry {
+    const char* name;
+    SchedulerJob job;
+    void* arg;
+    bool scheduled;
+    uint64_t deadlineUs;
+  };
+
+  Hal& hal;
+  Entry jobs[MAX_JOBS];
+  uint8_t jobCount;
+  std::atomic<uint32_t> woken;  // One bit per job
+  uint32_t wakeups;
+
+public:
+  explicit Scheduler(Hal& halInstance);
+
+  // Register a job that first runs after firstDelayMs (SCHEDULE_NEVER: when
+  // woken). Returns its id, or -1 when the table is full.
+  JobId add(const char* name, SchedulerJob job, void* arg, uint32_t firstDelayMs);
+
+  // From any context: run the job on the next pass and end the wait
+  void wake(JobId id);
+
+  // Run every job that is due or woken, once. Returns the ms until the
+  // next deadline, or SCHEDULE_NEVER.
+  uint32_t runDue();
+
+  // runDue(), then sleep until there is something to do. Call from loop().
+  void run();
+
+  uint32_t wakeupCount() const { return wakeups; }
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,48 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Single-writer, multi-reader value published without locks: writes may
+// come from several tasks but never overlap. The writer bumps the
+// sequence to odd, copies the value and bumps it back to even;
+// readers retry until they see the same even sequence before and after
+// their copy. Readers never block the writer, which matters when the
+// writer is the pump control task. T must be trivially copyable.
+template <typename T>
+class SeqLock {
+private:
+  std::atomic<uint32_t> sequence;
+  T value;
+
+public:
+  SeqLock() : sequence(0) {
+    memset(&value, 0, sizeof(value));
+  }
+
+  // Writers must be serialized (HalLock, or a single writing task): two
+  // at once can leave the sequence even over a torn value
+  void store(const T& newValue) {
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&value, &newValue, sizeof(T));
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    T copy;
+    uint32_t before, after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      memcpy(&copy, &value, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return copy;
+  }
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,36 @@
+#ifndef SERIAL_CONSOLE_H
+#define SERIAL_CONSOLE_H
+
+#include <Arduino.h>
+#include "command_console.h"
+#include "scheduler.h"
+
+// The command console on the USB serial port. The port's receive event
+// wakes the main loop job, which reads what has arrived and feeds it to
+// the console; replies go out through the logger so they don't interleave
+// with log lines.
+class SerialConsole {
+private:
+  CommandConsole& console;
+  void (*wakeListener)(void* arg);
+  void* wakeListenerArg;
+
+  static SerialConsole* instance;  // For the USB CDC event handler, which takes no argument of ours
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+  static void onUsbEvent(void* arg, esp_event_base_t base, int32_t id, void* data);
+#endif
+
+public:
+  explicit SerialConsole(CommandConsole& consoleInstance);
+
+  // Start listening; listener is called from the serial driver's task
+  // whenever bytes arrive
+  void begin(void (*listener)(void* arg), void* arg);
+
+  // Main loop job: feeds everything buffered to the console
+  uint32_t service();
+
+  static void writeLine(void* arg, const char* line);
+};
+
+#endif // SERIAL_CONSOLE_H
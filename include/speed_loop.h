@@ -0,0 +1,54 @@
+#ifndef SPEED_LOOP_H
+#define SPEED_LOOP_H
+
+#include <stdint.h>
+#include "board_config.h"
+#include "pi_controller.h"
+
+// Head speed regulation for a channel with an encoder. Called at a fixed
+// rate with the edges counted since the last call: the speed is the edge
+// rate over the last WINDOW calls, and a PI term trims the commanded duty
+// (the feedforward) so the head turns at the speed that duty stands for,
+// whatever the tube stiffness or supply voltage. No derivative term: on a
+// speed quantized to whole edges it would only add noise.
+class SpeedLoop {
+public:
+  static const uint8_t WINDOW = 5;
+
+private:
+  EncoderConfig config;
+  uint16_t windowPulses[WINDOW];
+  uint32_t windowUs[WINDOW];
+  uint8_t slot;
+  uint32_t pulseSum;
+  uint32_t usSum;
+  float rpm;
+  PiController pi;
+  float trim;      // Output minus feedforward, duty fraction
+
+public:
+  SpeedLoop();
+
+  void configure(const EncoderConfig& encoder);
+
+  // Forget the integral and the trim, for a motor coming to rest. The
+  // speed window carries on.
+  void reset();
+
+  // Edges seen over the last intervalUs
+  void measure(uint32_t pulses, uint32_t intervalUs);
+  float measuredRpm() const { return rpm; }
+
+  // One control step toward setpointRpm from the feedforward duty
+  // fraction, dtUs after the previous one
+  void update(float setpointRpm, float feedforward, uint32_t dtUs);
+
+  // Head speed that duty asks for
+  float setpointRpm(uint32_t duty, uint32_t maxDuty) const;
+
+  // Duty to write for a commanded duty: the duty plus the current trim,
+  // within 0..maxDuty. A commanded 0 is always 0.
+  uint32_t output(uint32_t duty, uint32_t maxDuty) const;
+};
+
+#endif // SPEED_LOOP_H
@@ -0,0 +1,45 @@
+#ifndef STATUS_DELTA_H
+#define STATUS_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+
+// The part of the status that is pushed to live observers. Remaining times
+// are kept at REMAINING_RESOLUTION_MS and the vacuum at PRESSURE_RESOLUTION_PA
+// so a running timer or a noisy gauge does not count as a change on every
+// reading.
+struct StatusView {
+  PumpState pumpState;
+  uint16_t pumpSpeed;
+  bool pumpTimedRun;
+  uint32_t pumpRemainingMs;
+
+  VacuumPumpState vacuumState;
+  uint8_t vacuumSpeed;
+  bool vacuumTimedRun;
+  uint32_t vacuumRemainingMs;
+  uint32_t vacuumTargetPa;
+  uint32_t vacuumPressurePa;  // Rounded, and 0 above atmospheric
+  PressureState vacuumInterlock;
+
+  bool doseActive;
+  uint32_t doseDeliveredUl;
+
+  bool protocolActive;
+  uint8_t protocolStep;
+};
+
+static const uint32_t REMAINING_RESOLUTION_MS = 100;
+static const uint32_t PRESSURE_RESOLUTION_PA = 1000;
+
+StatusView makeStatusView(const PumpStatus& status, const ProtocolProgress& progress, uint64_t nowUs);
+
+// Write the fields of current that differ from previous as a JSON object
+// using the /api/status field names, e.g. {"pump":{"remainingMs":1200}}.
+// With previous == NULL every field is written. Returns the length, or 0
+// when nothing changed or the buffer is too small.
+size_t writeStatusDelta(const StatusView* previous, const StatusView& current, char* buffer, size_t size);
+
+#endif // STATUS_DELTA_H
@@ -0,0 +1,18 @@
+#ifndef STATUS_JSON_H
+#define STATUS_JSON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "boot_profile.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+#include "wifi_stats.h"
+
+// Write the /api/status body into buffer with snprintf, never the heap.
+// nowUs is the clock of the status deadlines (esp_timer), nowMs that of the
+// Wi-Fi times (millis()). Returns the length written; output that does not
+// fit is cut short, still terminated, and the length is then size - 1.
+size_t writeStatusJson(const PumpStatus& status, const ProtocolProgress& progress, const WiFiStats& link,
+                       const BootProfile& boot, uint64_t nowUs, uint32_t nowMs, char* buffer, size_t size);
+
+#endif // STATUS_JSON_H
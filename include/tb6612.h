@@ -0,0 +1,48 @@
+#ifndef TB6612_H
+#define TB6612_H
+
+#include <stdint.h>
+#include "board_config.h"
+#include "hal.h"
+
+// A TB6612FNG dual H-bridge. Its two channels (on the stock board: A the
+// peristaltic pump, B the vacuum pump) share one STBY input, which is
+// owned here so neither channel can put the chip in standby under the
+// other. A channel acquires the driver before it drives and
+// releases it when it coasts; STBY only goes low once neither holds it.
+// Stopping a single channel is done with its own inputs (coast or brake).
+class Tb6612Driver {
+public:
+  enum Channel {
+    CHANNEL_A = 0,
+    CHANNEL_B = 1
+  };
+
+private:
+  Hal& hal;
+  const uint8_t stbyPin;  // Shared by both channels
+  uint8_t users;  // One bit per channel holding the driver out of standby
+
+public:
+  Tb6612Driver(Hal& halInstance, const DriverConfig& config);
+
+  // Standby. Call once at boot, before either pump's makeSafe() or begin().
+  void makeSafe();
+
+  // Idempotent per channel, so a channel that drives twice in a row (a
+  // speed change) still counts once. Safe from any task or timer callback.
+  void acquire(Channel channel);
+  void release(Channel channel);
+
+  // Set a channel's IN1/IN2 pair with one write, so going from one
+  // direction to the other passes through coast (both low) and never
+  // through brake (both high): (1,0) forward, (0,1) reverse, (0,0) coast,
+  // (1,1) short brake
+  static void setInputs(Hal& hal, const ChannelConfig& channel, bool in1, bool in2);
+
+  bool inStandby() const { return users == 0; }
+  uint8_t userCount() const { return (users & 1) + ((users >> 1) & 1); }
+  uint8_t getStbyPin() const { return stbyPin; }
+};
+
+#endif // TB6612_H
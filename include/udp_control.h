@@ -0,0 +1,25 @@
+#ifndef UDP_CONTROL_H
+#define UDP_CONTROL_H
+
+#include <AsyncUDP.h>
+#include "command_dispatcher.h"
+#include "udp_dispatcher.h"
+
+// Binary control protocol (see udp_protocol.h) on a UDP port. Packets are
+// decoded and acknowledged in the AsyncUDP task and the commands go through
+// the shared dispatcher to the control task's queue, so neither loop() nor
+// the web server is involved.
+class UdpControlServer {
+public:
+  static const uint16_t DEFAULT_PORT = 5005;
+
+private:
+  AsyncUDP udp;
+  UdpCommandDispatcher dispatcher;
+
+public:
+  explicit UdpControlServer(CommandDispatcher& commands);
+  bool begin(uint16_t port = DEFAULT_PORT);
+};
+
+#endif // UDP_CONTROL_H
@@ -0,0 +1,55 @@
+#ifndef UDP_DISPATCHER_H
+#define UDP_DISPATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "udp_protocol.h"
+#include "pump_command.h"
+#include "command_dispatcher.h"
+
+// Turns binary requests into pump commands and answers each with an ack.
+// Retries are idempotent: the last sequence number and ack of each sender
+// are remembered, and a request that repeats them gets the same ack back
+// (flagged as replayed) without running the command again. A sender should
+// start from a random sequence number so a restart isn't taken for a retry.
+// Commands go through the shared CommandDispatcher, so an emergency stop
+// here is the same one the web and console send. Transport independent, so the same logic runs behind AsyncUDP on the
+// device and behind a socket in host builds.
+class UdpCommandDispatcher {
+public:
+  static const uint8_t MAX_PEERS = 4;
+
+private:
+  struct Peer {
+    bool used;
+    bool hasAck;
+    uint32_t address;
+    uint16_t port;
+    uint16_t lastSeq;
+    uint32_t lastSeenMs;
+    uint8_t ack[UDP_ACK_SIZE];
+  };
+
+  CommandDispatcher& commands;
+  Peer peers[MAX_PEERS];
+  uint32_t droppedPackets;
+  uint32_t replayedAcks;
+
+  Peer& peerFor(uint32_t address, uint16_t port, uint32_t nowMs);
+  bool toCommand(const UdpRequest& request, PumpCommand& command) const;
+  uint8_t apply(const UdpRequest& request);
+
+public:
+  explicit UdpCommandDispatcher(CommandDispatcher& commandsInstance);
+
+  // Handle one datagram from address:port. Writes the ack to reply (at
+  // least UDP_ACK_SIZE bytes) and returns its length, or 0 when the packet
+  // is malformed and gets no answer.
+  size_t handle(uint32_t address, uint16_t port, const uint8_t* packet, size_t length,
+                uint8_t* reply, uint64_t nowUs);
+
+  uint32_t droppedCount() const { return droppedPackets; }
+  uint32_t replayedCount() const { return replayedAcks; }
+};
+
+#endif // UDP_DISPATCHER_H
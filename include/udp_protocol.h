@@ -0,0 +1,90 @@
+#ifndef UDP_PROTOCOL_H
+#define UDP_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed-layout binary control protocol carried over UDP, for automation
+// hosts that send many commands and can't afford HTTP and JSON on each.
+// All fields are little-endian; the CRC is CRC-16/CCITT-FALSE over every
+// byte before it.
+//
+// Request, 16 bytes:
+//   0  magic 'P'            1  version
+//   2  sequence (u16)       4  target           5  action
+//   6  speed (u16)          8  duration ms (u32), 0 for the default
+//   12 reserved (u16, 0)    14 CRC
+//
+// Ack, 22 bytes:
+//   0  magic 'A'            1  version
+//   2  sequence (echoed)    4  result           5  flags
+//   6  pump state           7  vacuum state
+//   8  pump speed (u16)     10 vacuum speed (%) 11 reserved
+//   12 pump remaining ms (u32)
+//   16 vacuum remaining ms (u32)
+//   20 CRC
+//
+// Speeds are duty for the pump and percent for the vacuum pump. Commands
+// get the same limits and defaults as the web API (CommandDispatcher::
+// resolve): pump speed held to 100-1023, vacuum to 10-100 %, runs to 1 ms
+// up to five minutes, and a duration of 0 takes the channel's configured
+// run length. Nothing runs until stopped.
+
+static const uint8_t UDP_REQUEST_MAGIC = 'P';
+static const uint8_t UDP_ACK_MAGIC = 'A';
+static const uint8_t UDP_PROTOCOL_VERSION = 1;
+static const size_t UDP_REQUEST_SIZE = 16;
+static const size_t UDP_ACK_SIZE = 22;
+
+enum UdpTarget {
+  UDP_TARGET_PUMP = 0,
+  UDP_TARGET_VACUUM = 1
+};
+
+enum UdpAction {
+  UDP_ACTION_STATUS = 0,     // No change, just the ack with the current state
+  UDP_ACTION_STOP = 1,
+  UDP_ACTION_FORWARD = 2,    // Pump only
+  UDP_ACTION_REVERSE = 3,    // Pump only
+  UDP_ACTION_START = 4,      // Vacuum only
+  UDP_ACTION_EMERGENCY = 5   // Either target; stops everything
+};
+
+enum UdpResult {
+  UDP_RESULT_OK = 0,
+  UDP_RESULT_BUSY = 1,         // Not applied; retry with the same sequence
+  UDP_RESULT_BAD_COMMAND = 2   // Not applied; retrying won't help
+};
+
+static const uint8_t UDP_FLAG_REPLAYED = 0x01;  // Ack resent for a duplicate request
+
+struct UdpRequest {
+  uint16_t seq;
+  uint8_t target;      // UdpTarget
+  uint8_t action;      // UdpAction
+  uint16_t speed;
+  uint32_t durationMs;
+};
+
+struct UdpAck {
+  uint16_t seq;
+  uint8_t result;      // UdpResult
+  uint8_t flags;
+  uint8_t pumpState;   // PumpState
+  uint8_t vacuumState; // VacuumPumpState
+  uint16_t pumpSpeed;
+  uint8_t vacuumSpeed;
+  uint32_t pumpRemainingMs;
+  uint32_t vacuumRemainingMs;
+};
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t len);
+
+// Encoders write exactly UDP_REQUEST_SIZE / UDP_ACK_SIZE bytes. Decoders
+// reject a packet with the wrong size, magic, version or CRC.
+size_t encodeUdpRequest(const UdpRequest& request, uint8_t* out);
+bool decodeUdpRequest(const uint8_t* data, size_t len, UdpRequest& request);
+size_t encodeUdpAck(const UdpAck& ack, uint8_t* out);
+bool decodeUdpAck(const uint8_t* data, size_t len, UdpAck& ack);
+
+#endif // UDP_PROTOCOL_H
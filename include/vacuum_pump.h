@@ -1,40 +1,52 @@
 #ifndef VACUUM_PUMP_H
 #define VACUUM_PUMP_H
 
-#include <Arduino.h>
+#include <stdint.h>
+#include "board_config.h"
+#include "hal.h"
+#include "pi_controller.h"
+#include "pressure_monitor.h"
+#include "tb6612.h"
 
 // Vacuum Pump States
 enum VacuumPumpState {
   VACUUM_STOPPED,
-  VACUUM_RUNNING   // Only forward direction allowed
+  VACUUM_RUNNING,    // Only forward direction allowed
+  VACUUM_REGULATING  // Forward, duty set by the gauge to hold a target vacuum
 };
 
 class VacuumPump {
 private:
-  // Pin definitions for 6612FNG - Vacuum Pump (Channel B)
-  const int PIN_PWMB = 14;  // PWM-capable for vacuum pump
-  const int PIN_STBY = 10;  // Shared standby pin
-  const int PIN_BIN1 = 15;  // BIN1 for vacuum pump
-  const int PIN_BIN2 = 16;  // BIN2 for vacuum pump
-  // BO1 and BO2 are 6612FNG output pins, directly connected to vacuum pump
-  // BO1 -> Vacuum pump positive terminal
-  // BO2 -> Vacuum pump negative terminal
-  
-  // PWM settings
-  const int PWM_CH = 1;  // Use different channel from peristaltic pump
-  const int PWM_FREQ = 20000;  // 20kHz to avoid audible noise
-  const int PWM_RES = 10;  // 10-bit resolution for better control
+  Hal& hal;
+  Tb6612Driver& driver;  // STBY is shared with the other channel
+  const ChannelConfig config;  // Pins, LEDC channel and PWM settings
   
   // State variables
   VacuumPumpState currentState;
   uint8_t currentSpeedPercent;  // Speed as percentage (0-100)
-  uint32_t runDuration;
-  unsigned long pumpStartTime;
+  uint32_t runDurationMs;
+  uint32_t pumpStartTime;
+  uint64_t stopDeadlineUs;
   bool isTimedRun;
   uint32_t lastDuty;
+
+  // Gauge and regulation. The monitor's sampling task drives both the
+  // regulator and the cutoff.
+  PressureMonitor* pressure;
+  PiController regulator;
+  uint32_t targetPa;        // While regulating
+  PressureState lastTrip;   // What the gauge stopped the last run for; PRESSURE_OK if it didn't
+  
+  // Timed runs end from a one-shot timer; update() is only a safety net
+  static const uint32_t TIMER_GRACE_US = 2000;
+  HalTimer stopTimer;
+  void (*stopListener)(void* arg);
+  void* stopListenerArg;
   
   // PWM constants
-  uint32_t getMaxDuty() const { return (1 << PWM_RES) - 1; }
+  static const uint8_t MAX_SPEED_PERCENT = 80;  // Limit for vacuum pump safety
+  uint32_t getMaxDuty() const { return (1 << config.pwmRes) - 1; }
+  Tb6612Driver::Channel driverChannel() const { return (Tb6612Driver::Channel)config.driverChannel; }
   uint32_t percentToDuty(uint8_t percent) const;
   uint8_t dutyToPercent(uint32_t duty) const;
   
@@ -45,23 +57,54 @@ private:
   void motorForward(uint8_t speedPercent);
   void disableDriver();
   void enableDriver();
+  void startTimedRun(uint32_t durationMs);
+  void timedStop();
+  static void onStopTimer(void* arg);
+  static void onPressure(void* arg, int32_t pressurePa, PressureState state);
+  void pressureReading(int32_t pressurePa, PressureState state);
+  void regulate(int32_t pressurePa);
+  void trip(PressureState state, int32_t pressurePa);
   
 public:
-  VacuumPump();
+  VacuumPump(Hal& halInstance, Tb6612Driver& driverInstance, const ChannelConfig& channelConfig);
+  // Drive the channel's outputs low (coast). Touches only GPIO, so it can
+  // be the first thing setup() does, along with the driver's makeSafe().
+  void makeSafe();
   void begin();
-  void controlVacuumPump(VacuumPumpState state, uint8_t speed = 100, uint32_t duration = 0);
-  void update(); // Call in main loop to handle timed runs
+  // Attach the gauge before begin(). Without one the pump runs open loop
+  // only, unguarded.
+  void setPressureMonitor(PressureMonitor& monitor);
+  void controlVacuumPump(VacuumPumpState state, uint8_t speed = 100, uint32_t durationMs = 0);
+  // Hold targetPa of vacuum, for durationMs or until stopped (0)
+  void regulateVacuum(uint32_t targetPa, uint32_t durationMs = 0);
+  // Backup for timed runs in case the stop timer is late, and the stop for
+  // a gauge that has gone quiet, which the sampling path can't see
+  void update();
+  
+  // Called (with the HAL lock held) when a timed run ends or the gauge
+  // stops the pump
+  void setStopListener(void (*listener)(void* arg), void* arg);
   
   // Getters
   VacuumPumpState getCurrentState() const { return currentState; }
   uint8_t getCurrentSpeed() const { return currentSpeedPercent; }
-  uint32_t getRunDuration() const { return runDuration; }
+  uint32_t getRunDurationMs() const { return runDurationMs; }
   bool getIsTimedRun() const { return isTimedRun; }
-  unsigned long getPumpStartTime() const { return pumpStartTime; }
-  uint32_t getRemainingTime() const;
+  uint32_t getPumpStartTime() const { return pumpStartTime; }
+  uint64_t getStopDeadlineUs() const { return stopDeadlineUs; }
+  uint32_t getTargetPa() const { return currentState == VACUUM_REGULATING ? targetPa : 0; }
+  PressureState getLastTrip() const { return lastTrip; }
+  // The gauge's view, PRESSURE_OK and 0 Pa without one
+  PressureState getPressureState() const { return pressure != NULL ? pressure->state() : PRESSURE_OK; }
+  int32_t getPressurePa() const { return pressure != NULL ? pressure->pressurePa() : 0; }
+  uint32_t getRemainingTimeMs() const;
+  // Whole seconds, rounded up: for whole-second runs the same value as the
+  // original "duration less whole seconds elapsed"
+  uint32_t getRemainingTime() const { return (getRemainingTimeMs() + 999) / 1000; }
   
   // Safety methods
   void emergencyStop();
+  // The gauge, if any, reads OK: not over the cutoff, wired and sampling
   bool isSafeToRun() const;
 };
 
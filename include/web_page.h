@@ -0,0 +1,19 @@
+#ifndef WEB_PAGE_H
+#define WEB_PAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#define PROGMEM
+#endif
+
+// Gzip-compressed control page (web/index.html), generated by tools/embed_web.py.
+// Stored in flash and streamed as-is with Content-Encoding: gzip; live values
+// are filled in by the page itself from /api/status.
+extern const uint8_t INDEX_HTML_GZ[] PROGMEM;
+extern const size_t INDEX_HTML_GZ_LEN;
+
+#endif // WEB_PAGE_H
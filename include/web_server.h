@@ -1,38 +1,97 @@
 #ifndef WEB_SERVER_H
 #define WEB_SERVER_H
 
-#include <WebServer.h>
-#include "pump.h"
-#include "vacuum_pump.h"
+#include <WiFi.h>
+#include "boot_profile.h"
+#include "command_dispatcher.h"
+#include "event_log.h"
+#include "event_stream.h"
+#include "flow_calibration.h"
+#include "http_server.h"
+#include "metrics.h"
+#include "pressure_monitor.h"
+#include "protocol_sequencer.h"
+#include "protocol_store.h"
+#include "pump_command.h"
+#include "wifi_manager.h"
 
 class WebServerManager {
 private:
-  WebServer server;
-  PeristalticPump* pump;
-  VacuumPump* vacuumPump;
+  HttpServer server;
+  CommandDispatcher* commands;
+  FlowCalibration* calibration;
+  ProtocolSequencer* sequencer;
+  ProtocolStore* protocols;
+  EventLog* eventLog;
+  WiFiManager* wifi;
+  BootProfile* boot;
+  PressureMonitor* pressure;
+  StatusEventStream events;
+  void (*observerListener)(void* arg);
+  void* observerListenerArg;
+
+  // Calibration run awaiting its measured volume
+  bool calibrationPending;
+  uint16_t calibrationDuty;
+  uint32_t calibrationDurationMs;
+  
+  // Status is serialized into a fixed buffer; never touches the heap.
+  // Only the AsyncTCP task uses it.
+  static const size_t STATUS_JSON_SIZE = 1280;
+  char statusBuffer[STATUS_JSON_SIZE];
+  size_t generateStatusJSON(char* buffer, size_t size);
+
+  // /metrics families: the histograms, then request counts and heap gauges
+  static const uint8_t METRIC_FAMILIES = RuntimeMetrics::HISTOGRAM_COUNT + 5;
+  size_t formatMetricsLine(uint8_t family, uint8_t line, Histogram::Snapshot& snap, char* out, size_t max);
   
-  // Web page generation
-  String generateHTML();
-  String generateStatusJSON();
+  static const uint16_t MAX_RAMP_MS = 10000;
   
   // Request handlers
-  void handleRoot();
-  void handleTest();
-  void handleControl();
-  void handleVacuumControl();
-  void handleStatus();
+  void handleRoot(HttpExchange& ex);
+  void handleTest(HttpExchange& ex);
+  void handleControl(HttpExchange& ex);
+  void handleVacuumControl(HttpExchange& ex);
+  void handleStatus(HttpExchange& ex);
+  void handlePressure(HttpExchange& ex);
+  void handleEvents(HttpExchange& ex);
+  void handleBatch(HttpExchange& ex);
+  void handleLog(HttpExchange& ex);
+  void handleMetrics(HttpExchange& ex);
+  void handleDose(HttpExchange& ex);
+  void handleCalibrate(HttpExchange& ex);
+  void handleRamp(HttpExchange& ex);
+  void handlePumps(HttpExchange& ex);
+  void handlePumpChannel(HttpExchange& ex);
+  void controlChannel(HttpExchange& ex, uint8_t channel);
+  void rampChannel(HttpExchange& ex, uint8_t channel);
+  void handleProtocol(HttpExchange& ex);
+  void handleProtocolRun(HttpExchange& ex);
+  void handleProtocolStop(HttpExchange& ex);
+  void handleProtocolDelete(HttpExchange& ex);
+  bool readProtocol(HttpExchange& ex, Protocol& protocol);
+  void sendCalibration(HttpExchange& ex);
   
-  // JSON parsing helpers
-  String parseAction(const String& body);
-  String parseVacuumAction(const String& body);
-  uint16_t parseSpeed(const String& body);
-  uint8_t parseVacuumSpeed(const String& body);
-  uint32_t parseDuration(const String& body);
+  // Command helpers: parse the request body, then limits, defaults and
+  // the hand-over to the control task through the shared dispatcher
+  bool readCommand(HttpExchange& ex, CommandTarget target, PumpCommand& command, uint8_t channel = 0);
+  bool submitCommand(HttpExchange& ex, const PumpCommand& command);
+  void sendResult(HttpExchange& ex, int code, bool success, const char* message);
   
 public:
-  WebServerManager(PeristalticPump* pumpInstance, VacuumPump* vacuumPumpInstance);
+  WebServerManager(CommandDispatcher* dispatcherInstance, FlowCalibration* calibrationInstance,
+                   ProtocolSequencer* sequencerInstance, ProtocolStore* protocolsInstance,
+                   EventLog* eventLogInstance, WiFiManager* wifiInstance,
+                   BootProfile* bootInstance, PressureMonitor* pressureInstance);
   void begin();
-  void handleClient();
+
+  // Main loop jobs; each returns the ms until it needs to run again
+  uint32_t serviceConnections();
+  uint32_t pollEvents();
+
+  // Called when a live status observer connects, so pollEvents() runs for it
+  void setObserverListener(void (*listener)(void* arg), void* arg);
+
   void printServerInfo() const;
 };
 
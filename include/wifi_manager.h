@@ -2,18 +2,66 @@
 #define WIFI_MANAGER_H
 
 #include <WiFi.h>
+#include <atomic>
+#include "scheduler.h"
+#include "seqlock.h"
+#include "wifi_stats.h"
 
+// Station connection as a state machine. The Wi-Fi driver's events only
+// set flags (they arrive on the driver's event task); service() runs as a
+// main loop job, applies them and starts the next attempt when its backoff
+// runs out. Nothing here ever waits for the access point, so the pumps and
+// the control task are up regardless of the network.
 class WiFiManager {
 private:
+  // Flags posted by the event handler
+  static const uint32_t EVENT_GOT_IP = 1;
+  static const uint32_t EVENT_DISCONNECTED = 2;
+
+  // An attempt that hasn't produced an IP by then is abandoned
+  static const uint32_t CONNECT_TIMEOUT_MS = 15000;
+  static const uint32_t BACKOFF_MIN_MS = 1000;
+  static const uint32_t BACKOFF_MAX_MS = 60000;
+
   const char* ssid;
   const char* password;
-  int connectionAttempts;
-  bool isConnected;
-  
+
+  // Owned by service()
+  WiFiState state;
+  uint32_t attemptStartMs;
+  uint32_t backoffStartMs;
+  uint32_t backoffMs;
+  uint32_t downSinceMs;  // Since the last drop, or boot
+  WiFiStats stats;
+
+  std::atomic<uint32_t> pendingEvents;
+  std::atomic<uint8_t> disconnectReason;
+  std::atomic<bool> isConnected;
+  SeqLock<WiFiStats> published;
+
+  void (*wakeListener)(void* arg);
+  void* wakeListenerArg;
+
+  void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+  void startAttempt(uint32_t now);
+  void startBackoff(uint32_t now);
+  void publish();
+
 public:
   WiFiManager(const char* wifi_ssid, const char* wifi_password);
-  bool connect();
-  bool isWiFiConnected() const { return isConnected; }
+
+  // Registers for driver events and starts the first attempt; returns at once
+  void begin();
+
+  // Main loop job: returns the ms until it next needs to run, or
+  // SCHEDULE_NEVER while connected
+  uint32_t service();
+
+  // Called from the driver's event task when there is something for service()
+  void setWakeListener(void (*listener)(void* arg), void* arg);
+
+  bool isWiFiConnected() const { return isConnected.load(std::memory_order_relaxed); }
+  WiFiStats getStats() const { return published.load(); }
   String getLocalIP() const;
   void disconnect();
   void printStatus() const;
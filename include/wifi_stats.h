@@ -0,0 +1,26 @@
+#ifndef WIFI_STATS_H
+#define WIFI_STATS_H
+
+#include <stdint.h>
+
+enum WiFiState {
+  WIFI_STATE_IDLE,        // begin() not called yet
+  WIFI_STATE_CONNECTING,  // Association and DHCP in progress
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_BACKOFF      // Waiting out the delay before the next attempt
+};
+
+// Published for /api/status; times are millis()
+struct WiFiStats {
+  uint8_t state;              // WiFiState
+  uint32_t drops;             // Connection lost after having had an IP
+  uint32_t failedAttempts;    // Attempts that timed out or were refused
+  uint32_t lastReconnectMs;   // Drop (or boot) to IP, for the last connection
+  uint32_t connectedSinceMs;  // When the current connection got its IP
+  uint32_t backoffMs;         // Current delay between attempts
+  uint8_t lastReason;         // Last disconnect reason from the driver
+};
+
+const char* wifiStateName(uint8_t state);
+
+#endif // WIFI_STATS_H
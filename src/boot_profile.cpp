@@ -0,0 +1,60 @@
+#include "boot_profile.h"
+#include "logger.h"
+#include <stdio.h>
+
+BootProfile::BootProfile(Hal& halInstance)
+  : hal(halInstance), startUs(0), stageCount(0), networkUs(0), finished(false) {
+  json[0] = '\0';
+}
+
+void BootProfile::begin() {
+  startUs = (uint32_t)hal.nowUs();
+  stageCount = 0;
+}
+
+void BootProfile::mark(const char* name) {
+  if (stageCount >= MAX_STAGES) return;
+  stages[stageCount].name = name;
+  stages[stageCount].endUs = (uint32_t)hal.nowUs();
+  stageCount++;
+}
+
+uint32_t BootProfile::readyUs() const {
+  return stageCount > 0 ? stages[stageCount - 1].endUs : startUs;
+}
+
+void BootProfile::finish() {
+  LOG_INFO("[Boot] %-14s %8lu us", "pre-setup", (unsigned long)startUs);
+
+  size_t used = snprintf(json, sizeof(json), "{\"setupStartUs\":%lu,\"stages\":{", (unsigned long)startUs);
+  uint32_t previous = startUs;
+  for (uint8_t i = 0; i < stageCount; i++) {
+    uint32_t us = stages[i].endUs - previous;
+    previous = stages[i].endUs;
+    LOG_INFO("[Boot] %-14s %8lu us", stages[i].name, (unsigned long)us);
+    if (used < sizeof(json)) {
+      used += snprintf(json + used, sizeof(json) - used, "%s\"%s\":%lu",
+                       i > 0 ? "," : "", stages[i].name, (unsigned long)us);
+    }
+  }
+  if (used < sizeof(json)) {
+    used += snprintf(json + used, sizeof(json) - used, "},\"readyUs\":%lu}", (unsigned long)readyUs());
+  }
+  if (used >= sizeof(json)) {
+    snprintf(json, sizeof(json), "{\"readyUs\":%lu}", (unsigned long)readyUs());
+  }
+  LOG_INFO("[Boot] Ready %lu us after boot", (unsigned long)readyUs());
+  finished.store(true, std::memory_order_release);
+}
+
+void BootProfile::markNetworkUp() {
+  uint32_t expected = 0;
+  uint32_t now = (uint32_t)hal.nowUs();
+  if (networkUs.compare_exchange_strong(expected, now ? now : 1, std::memory_order_relaxed)) {
+    LOG_INFO("[Boot] Network up %lu us after boot", (unsigned long)now);
+  }
+}
+
+const char* BootProfile::stagesJson() const {
+  return finished.load(std::memory_order_acquire) ? json : "null";
+}
@@ -0,0 +1,59 @@
+#include "button_input.h"
+#include <string.h>
+#include "logger.h"
+
+ButtonInput::ButtonInput(CommandConsole& consoleInstance) : console(consoleInstance) {
+  buttonCount = 0;
+  wakeListener = NULL;
+  wakeListenerArg = NULL;
+}
+
+void ButtonInput::begin(const ButtonBinding* bindings, uint8_t count, void (*listener)(void* arg), void* arg) {
+  wakeListener = listener;
+  wakeListenerArg = arg;
+  buttonCount = count < MAX_BUTTONS ? count : MAX_BUTTONS;
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < buttonCount; i++) {
+    Button& button = buttons[i];
+    button.binding = bindings[i];
+    pinMode(button.binding.pin, INPUT_PULLUP);
+    button.stablePressed = digitalRead(button.binding.pin) == LOW;  // Held at boot: not a press
+    button.lastPressed = button.stablePressed;
+    button.changedMs = now;
+    attachInterruptArg(button.binding.pin, onEdge, this, CHANGE);
+    LOG_INFO("[Button] GPIO %u runs \"%s\"", button.binding.pin, button.binding.line);
+  }
+}
+
+void IRAM_ATTR ButtonInput::onEdge(void* arg) {
+  ButtonInput* self = static_cast<ButtonInput*>(arg);
+  if (self->wakeListener) self->wakeListener(self->wakeListenerArg);
+}
+
+// A level counts once it has held for DEBOUNCE_MS; contact bounce inside
+// that window only restarts the wait
+uint32_t ButtonInput::service() {
+  uint32_t now = millis();
+  uint32_t nextMs = SCHEDULE_NEVER;
+  for (uint8_t i = 0; i < buttonCount; i++) {
+    Button& button = buttons[i];
+    bool pressed = digitalRead(button.binding.pin) == LOW;
+    if (pressed != button.lastPressed) {
+      button.lastPressed = pressed;
+      button.changedMs = now;
+    }
+    if (pressed == button.stablePressed) continue;
+
+    uint32_t heldMs = now - button.changedMs;
+    if (heldMs < DEBOUNCE_MS) {
+      uint32_t waitMs = DEBOUNCE_MS - heldMs;
+      if (waitMs < nextMs) nextMs = waitMs;
+      continue;
+    }
+    button.stablePressed = pressed;
+    if (pressed) {
+      console.execute(button.binding.line, strlen(button.binding.line), SOURCE_BUTTON);
+    }
+  }
+  return nextMs;
+}
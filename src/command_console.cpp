@@ -0,0 +1,204 @@
+#include "command_console.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "json_reader.h"
+
+// Next space-separated word from [pos, end), or false at the end
+static bool nextWord(const char* text, size_t end, size_t& pos, const char*& word, size_t& wordLen) {
+  while (pos < end && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+  if (pos >= end) return false;
+  word = text + pos;
+  while (pos < end && text[pos] != ' ' && text[pos] != '\t') pos++;
+  wordLen = (text + pos) - word;
+  return true;
+}
+
+static bool parseUInt(const char* text, size_t length, uint32_t& value) {
+  if (length == 0) return false;
+  uint32_t result = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    uint32_t digit = text[i] - '0';
+    if (result > (UINT32_MAX - digit) / 10) return false;
+    result = result * 10 + digit;
+  }
+  value = result;
+  return true;
+}
+
+// key=value fields after the action, same names and meaning as the JSON body
+static CommandParseError parseFields(const char* line, size_t length, size_t pos, PumpCommand& command) {
+  const char* word;
+  size_t wordLen;
+  while (nextWord(line, length, pos, word, wordLen)) {
+    const char* equals = (const char*)memchr(word, '=', wordLen);
+    if (equals == NULL) return CMD_ERR_SYNTAX;
+    size_t keyLen = equals - word;
+    const char* value = equals + 1;
+    size_t valueLen = wordLen - keyLen - 1;
+    uint32_t number;
+    if (!parseUInt(value, valueLen, number)) return CMD_ERR_BAD_FIELD;
+
+    if (JsonReader::equals(word, keyLen, "speed")) {
+      if (command.hasSpeed) return CMD_ERR_DUPLICATE_FIELD;
+      command.speed = number;
+      command.hasSpeed = true;
+    } else if (JsonReader::equals(word, keyLen, "duration")) {
+      if (command.hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      if (number > UINT32_MAX / 1000) return CMD_ERR_BAD_FIELD;
+      command.duration = number * 1000;
+      command.hasDuration = true;
+    } else if (JsonReader::equals(word, keyLen, "durationMs")) {
+      if (command.hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      command.duration = number;
+      command.hasDuration = true;
+    } else if (JsonReader::equals(word, keyLen, "targetPa") && command.target == TARGET_VACUUM) {
+      if (command.hasPressure) return CMD_ERR_DUPLICATE_FIELD;
+      command.pressure = number;
+      command.hasPressure = true;
+    } else {
+      return CMD_ERR_BAD_FIELD;
+    }
+  }
+  return CMD_OK;
+}
+
+CommandParseError parseConsoleLine(const char* line, size_t length, ConsoleRequest& request) {
+  memset(&request, 0, sizeof(request));
+  PumpCommand& command = request.command;
+  size_t pos = 0;
+  const char* word;
+  size_t wordLen;
+  if (!nextWord(line, length, pos, word, wordLen)) return CMD_ERR_MISSING_ACTION;
+
+  if (JsonReader::equals(word, wordLen, "status")) {
+    request.verb = CONSOLE_STATUS;
+  } else if (JsonReader::equals(word, wordLen, "help")) {
+    request.verb = CONSOLE_HELP;
+  } else if (JsonReader::equals(word, wordLen, "estop")) {
+    request.verb = CONSOLE_ESTOP;
+  } else {
+    request.verb = CONSOLE_COMMAND;
+    if (JsonReader::equals(word, wordLen, "pump")) command.target = TARGET_PUMP;
+    else if (JsonReader::equals(word, wordLen, "vacuum")) command.target = TARGET_VACUUM;
+    else return CMD_ERR_UNKNOWN_ACTION;
+
+    if (!nextWord(line, length, pos, word, wordLen)) return CMD_ERR_MISSING_ACTION;
+    command.action = commandActionFromName(command.target, word, wordLen);
+    // Emergency stops have a word of their own
+    if (command.action == ACTION_NONE || command.action == ACTION_EMERGENCY) return CMD_ERR_UNKNOWN_ACTION;
+    return parseFields(line, length, pos, command);
+  }
+
+  // The single-word commands take nothing after them
+  return nextWord(line, length, pos, word, wordLen) ? CMD_ERR_SYNTAX : CMD_OK;
+}
+
+CommandConsole::CommandConsole(CommandDispatcher& dispatcherInstance, Hal& halInstance,
+                               ConsoleWriter writerFunction, void* writerArgument)
+  : dispatcher(dispatcherInstance), hal(halInstance) {
+  writer = writerFunction;
+  writerArg = writerArgument;
+  lineLength = 0;
+  overflowed = false;
+}
+
+void CommandConsole::reply(const char* format, ...) {
+  char text[LINE_SIZE];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  writer(writerArg, text);
+}
+
+void CommandConsole::feed(const char* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    char c = data[i];
+    if (c == '\r' || c == '\n') {
+      // The LF of a CRLF arrives as an empty line, which is ignored
+      if (overflowed) {
+        reply("error: line too long");
+      } else if (lineLength > 0) {
+        execute(line, lineLength, SOURCE_SERIAL);
+      }
+      lineLength = 0;
+      overflowed = false;
+    } else if (c == '\b' || c == 0x7F) {
+      if (lineLength > 0) lineLength--;
+    } else if (lineLength < LINE_SIZE) {
+      line[lineLength++] = c;
+    } else {
+      overflowed = true;
+    }
+  }
+}
+
+void CommandConsole::replyStatus() {
+  PumpStatus status = dispatcher.status();
+  uint64_t now = hal.nowUs();
+  reply("pump %s speed=%u remainingMs=%lu", pumpStateName(status.pumpState), (unsigned)status.pumpSpeed,
+        (unsigned long)remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, now));
+  reply("vacuum %s speed=%u%% remainingMs=%lu", vacuumStateName(status.vacuumState), (unsigned)status.vacuumSpeed,
+        (unsigned long)remainingMs(status.vacuumTimedRun, status.vacuumStopDeadlineUs, now));
+  reply("gauge %s pressurePa=%ld targetPa=%lu", pressureStateName(status.vacuumInterlock),
+        (long)status.vacuumPressurePa, (unsigned long)status.vacuumTargetPa);
+}
+
+void CommandConsole::execute(const char* text, size_t length, CommandSource source) {
+  ConsoleRequest request;
+  CommandParseError error = parseConsoleLine(text, length, request);
+  if (error != CMD_OK) {
+    // The shared messages talk about JSON, which a console line isn't
+    reply("error: %s", error == CMD_ERR_SYNTAX ? "Expected key=value fields" : commandParseErrorMessage(error));
+    return;
+  }
+
+  switch (request.verb) {
+    case CONSOLE_STATUS:
+      replyStatus();
+      return;
+    case CONSOLE_ESTOP:
+      if (dispatcher.emergencyStop(source)) {
+        reply("ok emergency stop");
+      } else {
+        reply("error: controller busy");
+      }
+      return;
+    case CONSOLE_HELP:
+      reply("pump forward|reverse [speed=100-1023] [duration=S | durationMs=MS]");
+      reply("pump stop");
+      reply("vacuum start [speed=0-1023 | targetPa=PA] [duration=S | durationMs=MS]");
+      reply("vacuum stop");
+      reply("estop | status | help");
+      return;
+    case CONSOLE_COMMAND:
+      break;
+  }
+
+  PumpCommand& command = request.command;
+  dispatcher.resolve(command, dispatcher.status(), source);
+  if (!dispatcher.submit(command)) {
+    reply("error: controller busy");
+    return;
+  }
+
+  const char* target = command.target == TARGET_PUMP ? "pump" : "vacuum";
+  switch (command.action) {
+    case ACTION_STOP:
+      reply("ok %s stop", target);
+      break;
+    default:
+      if (command.hasPressure) {
+        reply("ok vacuum regulate targetPa=%lu durationMs=%lu", (unsigned long)command.pressure,
+              (unsigned long)command.duration);
+        break;
+      }
+      reply("ok %s %s speed=%lu%s durationMs=%lu", target, command.action == ACTION_START ? "start"
+            : (command.action == ACTION_FORWARD ? "forward" : "reverse"),
+            (unsigned long)command.speed, command.target == TARGET_VACUUM ? "%" : "",
+            (unsigned long)command.duration);
+      break;
+  }
+}
@@ -0,0 +1,96 @@
+#include "command_dispatcher.h"
+
+CommandDispatcher::CommandDispatcher(PumpController& controllerInstance, ProtocolSequencer& sequencerInstance,
+                                     CommandSink sinkFunction, void* sinkArgument)
+  : controller(controllerInstance), sequencer(sequencerInstance) {
+  sink = sinkFunction;
+  sinkArg = sinkArgument;
+}
+
+// The vacuum pump takes its default run length from channel 0, and so does
+// a pump command for a channel the controller will reject anyway
+const ChannelStatus& CommandDispatcher::channelOf(const PumpCommand& command, const PumpStatus& status) {
+  bool addressed = command.target == TARGET_PUMP && PumpManager::valid(command.channel);
+  return status.channels[addressed ? command.channel : 0];
+}
+
+// Resolve limits and defaults here so the control task gets final values
+void CommandDispatcher::resolve(PumpCommand& command, const PumpStatus& status, CommandSource source) const {
+  command.speed = command.target == TARGET_VACUUM ? vacuumSpeedFrom(command, status) : pumpSpeedFrom(command, status);
+  command.duration = command.action == ACTION_STOP ? 0 : durationFrom(command, status);
+  command.pressure = command.hasPressure ? vacuumTargetFrom(command) : 0;
+  command.hasSpeed = true;
+  command.hasDuration = true;
+  command.source = source;
+}
+
+// The stored speed a start falls back to is held to the same limits as a
+// given one, so it can't start a motor at (near) zero duty
+uint16_t CommandDispatcher::pumpSpeedFrom(const PumpCommand& command, const PumpStatus& status) const {
+  uint32_t speed = command.hasSpeed ? command.speed : channelOf(command, status).speed;
+  if (speed < 100) return 100;    // Minimum 10% of 1023
+  if (speed > 1023) return 1023;  // Maximum 100% of 1023
+  return speed;
+}
+
+uint8_t CommandDispatcher::vacuumSpeedFrom(const PumpCommand& command, const PumpStatus& status) const {
+  uint8_t speedPercent = status.vacuumSpeed;
+  if (command.hasSpeed) {
+    // Convert from 0-1023 range to 0-100 percentage
+    uint32_t rawSpeed = command.speed > 1023 ? 1023 : command.speed;
+    speedPercent = (rawSpeed * 100) / 1023;
+  }
+  if (speedPercent < 10) speedPercent = 10;    // Minimum 10%
+  if (speedPercent > 100) speedPercent = 100;
+  return speedPercent;
+}
+
+// Headroom under the cutoff for the regulator's overshoot, which would
+// otherwise trip the pump it is regulating
+uint32_t CommandDispatcher::vacuumTargetFrom(const PumpCommand& command) const {
+  uint32_t maxTarget = VACUUM_SENSOR.cutoffPa - VACUUM_SENSOR.hysteresisPa;
+  if (command.pressure < MIN_TARGET_PA) return MIN_TARGET_PA;
+  if (command.pressure > maxTarget) return maxTarget;
+  return command.pressure;
+}
+
+uint32_t CommandDispatcher::durationFrom(const PumpCommand& command, const PumpStatus& status) const {
+  if (!command.hasDuration) return channelOf(command, status).runDurationMs;
+  if (command.duration < 1) return 1;
+  if (command.duration > MAX_RUN_MS) return MAX_RUN_MS;
+  return command.duration;
+}
+
+bool CommandDispatcher::submit(const PumpCommand& command) {
+  CommandBatch batch;
+  batch.count = 1;
+  batch.commands[0] = command;
+  return submitBatch(batch);
+}
+
+bool CommandDispatcher::emergencyStop(CommandSource source) {
+  PumpStatus current = status();
+  CommandBatch batch = {};
+  batch.count = PUMP_CHANNEL_COUNT + 1;
+  batch.commands[0].target = TARGET_VACUUM;
+  batch.commands[0].action = ACTION_EMERGENCY;
+  batch.commands[0].source = source;
+  for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) {
+    PumpCommand& stop = batch.commands[i + 1];
+    stop.target = TARGET_PUMP;
+    stop.channel = i;
+    stop.action = ACTION_STOP;
+    resolve(stop, current, source);
+  }
+  return submitBatch(batch);
+}
+
+bool CommandDispatcher::submitBatch(const CommandBatch& batch) {
+  for (uint8_t i = 0; i < batch.count; i++) {
+    if (batch.commands[i].action == ACTION_EMERGENCY) {
+      sequencer.stop();  // A running protocol must not restart the pumps
+      break;
+    }
+  }
+  return sink(sinkArg, batch);
+}
@@ -0,0 +1,69 @@
+#include "control_task.h"
+#include "logger.h"
+#include "metrics.h"
+#include <esp_timer.h>
+
+ControlTask::ControlTask(PumpController& controllerInstance) : controller(controllerInstance) {
+  commandQueue = NULL;
+  taskHandle = NULL;
+}
+
+bool ControlTask::begin() {
+  commandQueue = xQueueCreate(QUEUE_LENGTH, sizeof(QueuedBatch));
+  if (commandQueue == NULL) {
+    LOG_ERROR("[Control] Failed to create command queue");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(taskEntry, "pump_ctrl", TASK_STACK_SIZE, this,
+                              TASK_PRIORITY, &taskHandle, TASK_CORE) != pdPASS) {
+    LOG_ERROR("[Control] Failed to start control task");
+    return false;
+  }
+  LOG_INFO("[Control] Control task running on core %d (priority %u)", TASK_CORE, (unsigned)TASK_PRIORITY);
+  return true;
+}
+
+bool ControlTask::submit(const PumpCommand& command) {
+  CommandBatch batch;
+  batch.count = 1;
+  batch.commands[0] = command;
+  return submitBatch(batch);
+}
+
+bool ControlTask::submitBatch(const CommandBatch& batch) {
+  if (commandQueue == NULL) return false;
+  // Emergency stops jump the queue
+  bool emergency = false;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    if (batch.commands[i].action == ACTION_EMERGENCY) emergency = true;
+  }
+  QueuedBatch entry;
+  entry.batch = batch;
+  entry.queuedUs = esp_timer_get_time();
+  BaseType_t queued = emergency
+    ? xQueueSendToFront(commandQueue, &entry, 0)
+    : xQueueSendToBack(commandQueue, &entry, 0);
+  if (queued != pdTRUE) {
+    LOG_WARN("[Control] Command queue full, dropping command");
+    return false;
+  }
+  return true;
+}
+
+void ControlTask::taskEntry(void* param) {
+  static_cast<ControlTask*>(param)->run();
+}
+
+void ControlTask::run() {
+  for (;;) {
+    // Timed stops fire from esp_timer; waking periodically only backs
+    // them up should a timer ever be late
+    QueuedBatch entry;
+    if (xQueueReceive(commandQueue, &entry, pdMS_TO_TICKS(SERVICE_PERIOD_MS)) == pdTRUE) {
+      controller.executeBatch(entry.batch);
+      // execute() writes the outputs before returning, ramps aside
+      metrics.commandLatency.observe((uint32_t)(esp_timer_get_time() - entry.queuedUs));
+    }
+    controller.service();
+  }
+}
@@ -0,0 +1,368 @@
+#include "event_log.h"
+#include <string.h>
+#include "logger.h"
+
+static const uint32_t MAX_RECORD_DURATION_MS = 0xFFFFFF;  // 24-bit field, about 4.6 hours
+
+// On-flash layout, little-endian:
+//   0 seq (u32)   4 timeMs (u32)   8 durationMs (u24)   11 kind | source << 4
+//   12 duty (u16)   14 state | channel << 4   15 CRC-8 of bytes 0-14
+static uint8_t crc8(const uint8_t* data, size_t len) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool erased(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+void encodeEventRecord(const EventRecord& record, uint8_t* out) {
+  uint32_t duration = record.durationMs > MAX_RECORD_DURATION_MS ? MAX_RECORD_DURATION_MS : record.durationMs;
+  put32(out, record.seq);
+  put32(out + 4, record.timeMs);
+  out[8] = (uint8_t)duration;
+  out[9] = (uint8_t)(duration >> 8);
+  out[10] = (uint8_t)(duration >> 16);
+  out[11] = (uint8_t)((record.kind & 0x0F) | (record.source << 4));
+  out[12] = (uint8_t)record.duty;
+  out[13] = (uint8_t)(record.duty >> 8);
+  out[14] = (uint8_t)((record.state & 0x0F) | (record.channel << 4));
+  out[15] = crc8(out, 15);
+}
+
+bool decodeEventRecord(const uint8_t* data, EventRecord& record) {
+  if (erased(data, EventLog::RECORD_SIZE) || crc8(data, 15) != data[15]) return false;
+  record.seq = get32(data);
+  record.timeMs = get32(data + 4);
+  record.durationMs = data[8] | ((uint32_t)data[9] << 8) | ((uint32_t)data[10] << 16);
+  record.kind = data[11] & 0x0F;
+  record.source = data[11] >> 4;
+  record.duty = (uint16_t)(data[12] | (data[13] << 8));
+  // Records from before there were channels have zero there
+  record.state = data[14] & 0x0F;
+  record.channel = data[14] >> 4;
+  return record.kind != 0;
+}
+
+const char* eventKindName(uint8_t kind) {
+  switch (kind) {
+    case EVENT_BOOT:      return "boot";
+    case EVENT_PUMP:      return "pump";
+    case EVENT_VACUUM:    return "vacuum";
+    case EVENT_EMERGENCY: return "emergency";
+    default:              return "unknown";
+  }
+}
+
+EventLog::EventLog(Hal& halInstance) : hal(halInstance) {
+  ready = false;
+  sectorCount = 0;
+  headSector = 0;
+  headSlot = 0;
+  oldestSector = 0;
+  writtenSeq = 1;
+  queueHead = 0;
+  queueCount = 0;
+  queuedSinceMs = 0;
+  nextSeq = 1;
+  droppedRecords = 0;
+  wakeListener = NULL;
+  wakeListenerArg = NULL;
+}
+
+void EventLog::setWakeListener(void (*listener)(void* arg), void* arg) {
+  wakeListener = listener;
+  wakeListenerArg = arg;
+}
+
+bool EventLog::readSlot(size_t sector, size_t slot, EventRecord& record, bool& empty) {
+  uint8_t data[RECORD_SIZE];
+  if (!hal.logFlashRead(sector * LOG_FLASH_SECTOR_SIZE + slot * RECORD_SIZE, data, sizeof(data))) {
+    empty = true;
+    return false;
+  }
+  empty = erased(data, sizeof(data));
+  return decodeEventRecord(data, record);
+}
+
+// Slots are filled in order, so the first erased slot ends a sector's data
+bool EventLog::firstSeqIn(size_t sector, uint32_t& seq) {
+  for (size_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+    EventRecord record;
+    bool empty;
+    if (readSlot(sector, slot, record, empty)) {
+      seq = record.seq;
+      return true;
+    }
+    if (empty) return false;
+  }
+  return false;
+}
+
+// A good sector has at most a torn slot per power cut among its records.
+// One whose erase was interrupted is noise throughout, in which a slot now
+// and then passes the CRC by chance with a meaningless sequence number.
+bool EventLog::trustedSector(size_t sector) {
+  size_t garbled = 0;
+  for (size_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+    EventRecord record;
+    bool empty;
+    if (!readSlot(sector, slot, record, empty) && !empty) garbled++;
+  }
+  return garbled <= RECORDS_PER_SECTOR / 2;
+}
+
+bool EventLog::begin() {
+  sectorCount = hal.logFlashSize() / LOG_FLASH_SECTOR_SIZE;
+  if (sectorCount < 2) {
+    LOG_WARN("[EventLog] No log partition, events are not recorded");
+    return false;
+  }
+
+  // The newest sector is the one whose first record has the highest
+  // sequence number, the oldest the one with the lowest. A half-erased
+  // sector's chance record would most likely be taken for one of the two,
+  // so those are checked in full and passed over if they are noise.
+  static const uint8_t MAX_SKIPPED = 4;
+  size_t skipped[MAX_SKIPPED];
+  uint8_t skippedCount = 0;
+  bool found;
+  uint32_t newestSeq = 0, oldestSeq = 0;
+  for (;;) {
+    found = false;
+    for (size_t sector = 0; sector < sectorCount; sector++) {
+      bool skip = false;
+      for (uint8_t i = 0; i < skippedCount; i++) skip = skip || skipped[i] == sector;
+      uint32_t seq;
+      if (skip || !firstSeqIn(sector, seq)) continue;
+      if (!found || seq > newestSeq) {
+        newestSeq = seq;
+        headSector = sector;
+      }
+      if (!found || seq < oldestSeq) {
+        oldestSeq = seq;
+        oldestSector = sector;
+      }
+      found = true;
+    }
+    if (!found || skippedCount == MAX_SKIPPED) break;
+    size_t noise = sectorCount;
+    if (!trustedSector(headSector)) noise = headSector;
+    else if (!trustedSector(oldestSector)) noise = oldestSector;
+    if (noise == sectorCount) break;
+    LOG_WARN("[EventLog] Sector %u is half erased, skipping it", (unsigned)noise);
+    skipped[skippedCount++] = noise;
+  }
+
+  if (!found) {
+    headSector = 0;
+    oldestSector = 0;
+    headSlot = 0;
+    nextSeq = 1;
+    if (!hal.logFlashErase(0, LOG_FLASH_SECTOR_SIZE)) {
+      LOG_ERROR("[EventLog] Failed to erase log flash");
+      return false;
+    }
+  } else {
+    // Continue after the last programmed slot, torn or not: flash can't be
+    // rewritten without an erase
+    uint32_t lastSeq = newestSeq;
+    headSlot = 0;
+    for (size_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+      EventRecord record;
+      bool empty;
+      bool valid = readSlot(headSector, slot, record, empty);
+      if (empty) break;
+      if (valid && record.seq > lastSeq) lastSeq = record.seq;
+      headSlot = slot + 1;
+    }
+    nextSeq = lastSeq + 1;
+  }
+  writtenSeq = nextSeq;
+  ready = true;
+
+  LOG_INFO("[EventLog] %u sectors, oldest %u, writing at %u:%u, next record %lu", (unsigned)sectorCount,
+           (unsigned)oldestSector, (unsigned)headSector, (unsigned)headSlot, (unsigned long)nextSeq);
+  record(EVENT_BOOT, SOURCE_SYSTEM, 0, 0, 0);
+  return true;
+}
+
+void EventLog::record(EventKind kind, CommandSource source, uint8_t state, uint16_t duty, uint32_t durationMs,
+                      uint8_t channel) {
+  if (!ready) return;
+  HalLock guard(hal);
+  if (queueCount >= QUEUE_SIZE) {
+    droppedRecords++;
+    return;
+  }
+  EventRecord& record = queue[(queueHead + queueCount) % QUEUE_SIZE];
+  record.seq = nextSeq++;
+  record.timeMs = hal.nowMs();
+  record.durationMs = durationMs;
+  record.kind = (uint8_t)kind;
+  record.source = (uint8_t)source;
+  record.state = state;
+  record.channel = channel;
+  record.duty = duty;
+  if (queueCount == 0) queuedSinceMs = record.timeMs;
+  queueCount++;
+  if ((queueCount == 1 || queueCount == FLUSH_RECORDS) && wakeListener != NULL) wakeListener(wakeListenerArg);
+}
+
+uint32_t EventLog::service() {
+  if (!ready) return SCHEDULE_NEVER;
+  bool due;
+  {
+    HalLock guard(hal);
+    due = queueCount >= FLUSH_RECORDS ||
+          (queueCount > 0 && hal.nowMs() - queuedSinceMs >= FLUSH_INTERVAL_MS);
+  }
+  if (due) flush();
+
+  // flush() may have raced with new records; the next deadline is theirs
+  HalLock guard(hal);
+  if (queueCount == 0) return SCHEDULE_NEVER;
+  if (queueCount >= FLUSH_RECORDS) return 0;
+  uint32_t age = hal.nowMs() - queuedSinceMs;
+  return age >= FLUSH_INTERVAL_MS ? 0 : FLUSH_INTERVAL_MS - age;
+}
+
+void EventLog::flush() {
+  if (!ready) return;
+  for (;;) {
+    // Take a page worth off the queue, then program it without holding
+    // the lock, so a slow erase never stalls the control task
+    EventRecord batch[FLUSH_RECORDS];
+    uint8_t count;
+    {
+      HalLock guard(hal);
+      count = queueCount < FLUSH_RECORDS ? queueCount : FLUSH_RECORDS;
+      for (uint8_t i = 0; i < count; i++) {
+        batch[i] = queue[(queueHead + i) % QUEUE_SIZE];
+      }
+      queueHead = (queueHead + count) % QUEUE_SIZE;
+      queueCount -= count;
+      queuedSinceMs = hal.nowMs();
+    }
+    if (count == 0) return;
+    writeRecords(batch, count);
+  }
+}
+
+bool EventLog::writeRecords(const EventRecord* records, uint8_t count) {
+  uint8_t data[FLUSH_RECORDS * RECORD_SIZE];
+  uint8_t done = 0;
+  while (done < count) {
+    if (headSlot >= RECORDS_PER_SECTOR) {
+      // Reclaim the next sector. Readers stop looking at it first.
+      size_t next = (headSector + 1) % sectorCount;
+      {
+        HalLock guard(hal);
+        if (next == oldestSector) oldestSector = (oldestSector + 1) % sectorCount;
+      }
+      if (!hal.logFlashErase(next * LOG_FLASH_SECTOR_SIZE, LOG_FLASH_SECTOR_SIZE)) {
+        LOG_ERROR("[EventLog] Failed to erase sector %u", (unsigned)next);
+        return false;
+      }
+      HalLock guard(hal);
+      headSector = next;
+      headSlot = 0;
+    }
+
+    size_t left = count - done;
+    size_t room = RECORDS_PER_SECTOR - headSlot;
+    uint8_t n = (uint8_t)(left < room ? left : room);
+    for (uint8_t i = 0; i < n; i++) {
+      encodeEventRecord(records[done + i], data + i * RECORD_SIZE);
+    }
+    bool written = hal.logFlashWrite(headSector * LOG_FLASH_SECTOR_SIZE + headSlot * RECORD_SIZE,
+                                     data, n * RECORD_SIZE);
+    if (!written) LOG_ERROR("[EventLog] Failed to write %u records", n);
+
+    // A failed write may have programmed part of the slots; never reuse them
+    HalLock guard(hal);
+    headSlot += n;
+    writtenSeq = records[done + n - 1].seq + 1;
+    done += n;
+  }
+  return true;
+}
+
+EventLog::Position EventLog::position() {
+  HalLock guard(hal);
+  Position pos = { headSector, headSlot, oldestSector };
+  return pos;
+}
+
+uint32_t EventLog::endSeq() {
+  HalLock guard(hal);
+  return writtenSeq;
+}
+
+uint32_t EventLog::firstSeq() {
+  EventRecord record;
+  uint32_t resumeSeq;
+  return read(0, &record, 1, resumeSeq) == 1 ? record.seq : endSeq();
+}
+
+size_t EventLog::read(uint32_t fromSeq, EventRecord* out, size_t maxRecords, uint32_t& resumeSeq) {
+  resumeSeq = fromSeq;
+  if (!ready || maxRecords == 0) return 0;
+  Position pos = position();
+  int used = (int)((pos.headSector + sectorCount - pos.oldestSector) % sectorCount) + 1;
+
+  // Last sector, in ring order from the oldest, starting at or before
+  // fromSeq. A sector with no readable record doesn't bound the search.
+  int start = 0, lo = 0, hi = used - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    uint32_t seq;
+    if (!firstSeqIn((pos.oldestSector + mid) % sectorCount, seq) || seq <= fromSeq) {
+      start = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  size_t count = 0;
+  uint8_t data[FLUSH_RECORDS * RECORD_SIZE];
+  for (int k = start; k < used; k++) {
+    size_t sector = (pos.oldestSector + k) % sectorCount;
+    size_t slots = (k == used - 1) ? pos.headSlot : RECORDS_PER_SECTOR;
+    for (size_t slot = 0; slot < slots; slot += FLUSH_RECORDS) {
+      size_t chunk = slots - slot < FLUSH_RECORDS ? slots - slot : FLUSH_RECORDS;
+      if (!hal.logFlashRead(sector * LOG_FLASH_SECTOR_SIZE + slot * RECORD_SIZE, data, chunk * RECORD_SIZE)) {
+        return count;
+      }
+      for (size_t i = 0; i < chunk; i++) {
+        EventRecord record;
+        if (!decodeEventRecord(data + i * RECORD_SIZE, record) || record.seq < fromSeq) continue;
+        out[count++] = record;
+        resumeSeq = record.seq + 1;
+        if (count == maxRecords) return count;
+      }
+    }
+  }
+  return count;
+}
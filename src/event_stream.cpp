@@ -0,0 +1,74 @@
+#include "event_stream.h"
+#include <string.h>
+#include "logger.h"
+
+StatusEventStream::StatusEventStream(HttpServer& serverInstance) : server(serverInstance) {
+  for (uint8_t i = 0; i < MAX_OBSERVERS; i++) {
+    observers[i].open = false;
+    observers[i].hasLast = false;
+  }
+}
+
+uint8_t StatusEventStream::count() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < MAX_OBSERVERS; i++) {
+    if (observers[i].open) n++;
+  }
+  return n;
+}
+
+bool StatusEventStream::add(HttpExchange& exchange, uint32_t intervalMs) {
+  Observer* slot = NULL;
+  for (uint8_t i = 0; i < MAX_OBSERVERS && slot == NULL; i++) {
+    if (!observers[i].open) slot = &observers[i];
+  }
+  if (slot == NULL) return false;
+
+  slot->stream = exchange.beginEventStream();
+  slot->open = slot->stream != HTTP_NO_STREAM;
+  slot->hasLast = false;
+  slot->intervalMs = intervalMs;
+  slot->lastWriteMs = 0;
+  if (!slot->open) return false;
+  server.streamWrite(slot->stream, "retry: 2000\n\n", 13);
+
+  LOG_INFO("[Events] Observer connected (%u ms interval, %u open)", (unsigned)intervalMs, count());
+  return true;
+}
+
+uint32_t StatusEventStream::poll(const StatusView& current, uint32_t nowMs) {
+  uint32_t nextMs = SCHEDULE_NEVER;
+  for (uint8_t i = 0; i < MAX_OBSERVERS; i++) {
+    Observer& observer = observers[i];
+    if (!observer.open) continue;
+    if (!server.streamOpen(observer.stream)) {
+      observer.open = false;
+      LOG_INFO("[Events] Observer disconnected (%u open)", count());
+      continue;
+    }
+    if (!observer.hasLast || nowMs - observer.lastWriteMs >= observer.intervalMs) {
+      // "data: " prefix and blank-line terminator around the JSON delta
+      size_t len = writeStatusDelta(observer.hasLast ? &observer.last : NULL, current,
+                                    event + 6, sizeof(event) - 8);
+      if (len > 0) {
+        memcpy(event, "data: ", 6);
+        event[6 + len] = '\n';
+        event[7 + len] = '\n';
+        if (server.streamWrite(observer.stream, event, len + 8)) {
+          observer.last = current;
+          observer.hasLast = true;
+          observer.lastWriteMs = nowMs;
+        }
+      } else if (nowMs - observer.lastWriteMs >= KEEPALIVE_MS) {
+        if (server.streamWrite(observer.stream, ": ping\n\n", 8)) observer.lastWriteMs = nowMs;
+      }
+    }
+
+    // Changes are looked for once per interval; an event that found no
+    // room in the connection is retried after the same wait
+    uint32_t sinceMs = nowMs - observer.lastWriteMs;
+    uint32_t waitMs = sinceMs < observer.intervalMs ? observer.intervalMs - sinceMs : observer.intervalMs;
+    if (waitMs < nextMs) nextMs = waitMs;
+  }
+  return nextMs;
+}
@@ -0,0 +1,111 @@
+#include "flow_calibration.h"
+#include <string.h>
+#include "logger.h"
+
+static const char* STORAGE_KEY = "flowcal";
+
+uint32_t volumeDelivered(uint32_t flowRate, uint32_t elapsedMs) {
+  return (uint32_t)(((uint64_t)flowRate * elapsedMs + 30000) / 60000);
+}
+
+uint32_t flowRateFor(uint32_t volumeUl, uint32_t elapsedMs) {
+  if (elapsedMs == 0) return 0;
+  uint64_t flowRate = ((uint64_t)volumeUl * 60000 + elapsedMs / 2) / elapsedMs;
+  return flowRate > UINT32_MAX ? UINT32_MAX : (uint32_t)flowRate;
+}
+
+FlowCalibration::FlowCalibration(Hal& halInstance) : hal(halInstance) {
+  pointCount = 0;
+}
+
+bool FlowCalibration::load() {
+  Stored stored;
+  if (!hal.loadBlob(STORAGE_KEY, &stored, sizeof(stored))) {
+    LOG_INFO("[Calib] No stored flow calibration");
+    return false;
+  }
+  if (stored.version != STORAGE_VERSION || stored.count > MAX_POINTS) {
+    LOG_WARN("[Calib] Ignoring stored calibration (version %u, %u points)", stored.version, stored.count);
+    return false;
+  }
+
+  clear();
+  for (uint8_t i = 0; i < stored.count; i++) {
+    if (!addPoint(stored.points[i].duty, stored.points[i].flowRate)) {
+      LOG_WARN("[Calib] Stored calibration is inconsistent, discarding it");
+      clear();
+      return false;
+    }
+  }
+  LOG_INFO("[Calib] Loaded %u calibration points", pointCount);
+  return true;
+}
+
+bool FlowCalibration::save() const {
+  Stored stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.version = STORAGE_VERSION;
+  stored.count = pointCount;
+  memcpy(stored.points, points, pointCount * sizeof(Point));
+  return hal.saveBlob(STORAGE_KEY, &stored, sizeof(stored));
+}
+
+bool FlowCalibration::addPoint(uint16_t duty, uint32_t flowRate) {
+  if (flowRate == 0) return false;
+
+  // Find the insertion slot, replacing an existing point for the same duty
+  uint8_t index = 0;
+  while (index < pointCount && points[index].duty < duty) index++;
+  bool replace = index < pointCount && points[index].duty == duty;
+  if (!replace && pointCount >= MAX_POINTS) return false;
+
+  // Flow must stay strictly increasing with duty
+  if (index > 0 && points[index - 1].flowRate >= flowRate) return false;
+  uint8_t next = replace ? index + 1 : index;
+  if (next < pointCount && points[next].flowRate <= flowRate) return false;
+
+  if (!replace) {
+    memmove(&points[index + 1], &points[index], (pointCount - index) * sizeof(Point));
+    pointCount++;
+  }
+  points[index].duty = duty;
+  points[index].flowRate = flowRate;
+  return true;
+}
+
+uint32_t FlowCalibration::flowAt(uint16_t duty) const {
+  if (pointCount == 0) return 0;
+  if (duty <= points[0].duty) return points[0].flowRate;
+  if (duty >= points[pointCount - 1].duty) return points[pointCount - 1].flowRate;
+
+  uint8_t i = 1;
+  while (points[i].duty < duty) i++;
+  const Point& lo = points[i - 1];
+  const Point& hi = points[i];
+  uint32_t span = hi.duty - lo.duty;
+  return lo.flowRate + (uint32_t)(((uint64_t)(hi.flowRate - lo.flowRate) * (duty - lo.duty) + span / 2) / span);
+}
+
+uint16_t FlowCalibration::dutyFor(uint32_t flowRate) const {
+  if (flowRate <= points[0].flowRate) return points[0].duty;
+  if (flowRate >= points[pointCount - 1].flowRate) return points[pointCount - 1].duty;
+
+  uint8_t i = 1;
+  while (points[i].flowRate < flowRate) i++;
+  const Point& lo = points[i - 1];
+  const Point& hi = points[i];
+  uint32_t span = hi.flowRate - lo.flowRate;
+  return lo.duty + (uint16_t)(((uint64_t)(hi.duty - lo.duty) * (flowRate - lo.flowRate) + span / 2) / span);
+}
+
+bool FlowCalibration::planDose(uint32_t volumeUl, uint32_t flowRate, DosePlan& plan) const {
+  if (!isCalibrated() || volumeUl == 0) return false;
+  if (flowRate < minFlowRate() || flowRate > maxFlowRate()) return false;
+
+  plan.duty = dutyFor(flowRate);
+  plan.flowRate = flowAt(plan.duty);
+  uint64_t durationMs = ((uint64_t)volumeUl * 60000 + plan.flowRate / 2) / plan.flowRate;
+  if (durationMs == 0 || durationMs > UINT32_MAX) return false;
+  plan.durationMs = (uint32_t)durationMs;
+  return true;
+}
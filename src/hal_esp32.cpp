@@ -0,0 +1,305 @@
+#include "hal_esp32.h"
+#include <esp_timer.h>
+#include <driver/adc.h>
+#include <driver/pcnt.h>
+#include <Preferences.h>
+#include <esp_pm.h>
+#include <soc/gpio_struct.h>
+#include "logger.h"
+
+// Must match partitions.csv
+static const char* LOG_PARTITION_LABEL = "evlog";
+static const uint8_t LOG_PARTITION_SUBTYPE = 0x40;
+
+Esp32Hal::Esp32Hal() {
+  mutex = xSemaphoreCreateRecursiveMutex();
+  wakeSemaphore = xSemaphoreCreateBinary();
+  logPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)LOG_PARTITION_SUBTYPE,
+                                          LOG_PARTITION_LABEL);
+  for (uint8_t i = 0; i < COUNTER_UNITS; i++) {
+    counterLast[i] = 0;
+    counterTotal[i] = 0;
+  }
+  adcTask = NULL;
+  adcChannel = 0;
+  adcBlockSamples = 0;
+  adcCallback = NULL;
+  adcArg = NULL;
+}
+
+void Esp32Hal::pinModeOutput(uint8_t pin) {
+  pinMode(pin, OUTPUT);
+}
+
+// Straight to the write-1-to-set/clear registers: no pin lookup, and no
+// read-modify-write that could race a writer on another core
+void Esp32Hal::writePin(uint8_t pin, bool high) {
+  uint64_t mask = 1ULL << pin;
+  writePins(high ? mask : 0, high ? 0 : mask);
+}
+
+void Esp32Hal::writePins(uint64_t setMask, uint64_t clearMask) {
+  if ((uint32_t)clearMask) GPIO.out_w1tc = (uint32_t)clearMask;
+  if (clearMask >> 32) GPIO.out1_w1tc.val = (uint32_t)(clearMask >> 32);
+  if ((uint32_t)setMask) GPIO.out_w1ts = (uint32_t)setMask;
+  if (setMask >> 32) GPIO.out1_w1ts.val = (uint32_t)(setMask >> 32);
+}
+
+bool Esp32Hal::readPin(uint8_t pin) {
+  return digitalRead(pin) == HIGH;
+}
+
+bool Esp32Hal::counterSetup(uint8_t unit, uint8_t pin) {
+  if (unit >= COUNTER_UNITS) return false;
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = pin;  // The driver enables its pull-up
+  config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  config.unit = (pcnt_unit_t)unit;
+  config.channel = PCNT_CHANNEL_0;
+  config.pos_mode = PCNT_COUNT_INC;
+  config.neg_mode = PCNT_COUNT_DIS;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.counter_h_lim = COUNTER_LIMIT;
+  config.counter_l_lim = -COUNTER_LIMIT;  // Only counts up
+  if (pcnt_unit_config(&config) != ESP_OK) {
+    LOG_ERROR("[HAL] Failed to set up pulse counter %u on GPIO %u", unit, pin);
+    return false;
+  }
+  // Ignore pulses shorter than 1000 APB cycles (12.5 us), far below any
+  // real encoder period, as motor noise
+  pcnt_set_filter_value((pcnt_unit_t)unit, 1000);
+  pcnt_filter_enable((pcnt_unit_t)unit);
+  pcnt_counter_pause((pcnt_unit_t)unit);
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  pcnt_counter_resume((pcnt_unit_t)unit);
+  counterLast[unit] = 0;
+  counterTotal[unit] = 0;
+  return true;
+}
+
+uint32_t Esp32Hal::counterRead(uint8_t unit) {
+  if (unit >= COUNTER_UNITS) return 0;
+  int16_t raw = 0;
+  if (pcnt_get_counter_value((pcnt_unit_t)unit, &raw) != ESP_OK) return counterTotal[unit];
+  // The count runs 0..COUNTER_LIMIT-1 and starts over
+  int32_t delta = (int32_t)raw - counterLast[unit];
+  if (delta < 0) delta += COUNTER_LIMIT;
+  counterLast[unit] = raw;
+  counterTotal[unit] += delta;
+  return counterTotal[unit];
+}
+
+bool Esp32Hal::adcStartContinuous(uint8_t pin, uint32_t sampleHz, uint16_t blockSamples,
+                                  HalAdcCallback callback, void* arg) {
+  if (adcTask != NULL || pin < ADC1_FIRST_PIN || pin > ADC1_LAST_PIN || blockSamples == 0) return false;
+  adcChannel = pin - ADC1_FIRST_PIN;
+  adcBlockSamples = blockSamples;
+  adcCallback = callback;
+  adcArg = arg;
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = ADC_FRAME_BYTES * 8;  // Slack for the task being held off
+  init.conv_num_each_intr = ADC_FRAME_BYTES;
+  init.adc1_chan_mask = BIT(adcChannel);
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    LOG_ERROR("[HAL] Failed to set up continuous ADC on GPIO %u", pin);
+    return false;
+  }
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_11;
+  pattern.channel = adcChannel;
+  pattern.unit = 0;  // ADC1
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_digi_configuration_t digi = {};
+  digi.conv_limit_en = false;
+  digi.conv_limit_num = 250;
+  digi.pattern_num = 1;
+  digi.adc_pattern = &pattern;
+  digi.sample_freq_hz = sampleHz;
+  digi.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digi.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&digi) != ESP_OK) {
+    LOG_ERROR("[HAL] ADC rejected %lu Hz sampling", (unsigned long)sampleHz);
+    adc_digi_deinitialize();
+    return false;
+  }
+  // eFuse two-point or reference calibration, whichever this chip has
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 0, &adcCalibration);
+
+  // On the control task's core, so it preempts it rather than racing it
+  if (xTaskCreatePinnedToCore(adcTaskEntry, "adc", 3072, this, ADC_TASK_PRIORITY, &adcTask, 1) != pdPASS) {
+    LOG_ERROR("[HAL] Failed to start the ADC task");
+    adc_digi_deinitialize();
+    adcTask = NULL;
+    return false;
+  }
+  adc_digi_start();
+  return true;
+}
+
+void Esp32Hal::adcTaskEntry(void* param) {
+  static_cast<Esp32Hal*>(param)->adcRun();
+}
+
+void Esp32Hal::adcRun() {
+  uint8_t frame[ADC_FRAME_BYTES];
+  uint32_t sum = 0;
+  uint16_t count = 0;
+  for (;;) {
+    uint32_t length = 0;
+    // Times out only if the DMA stops; the readings stopping is how the
+    // consumer finds out. An overflowed ring (ESP_ERR_INVALID_STATE) has
+    // lost old samples but what it returns is still good.
+    if (adc_digi_read_bytes(frame, sizeof(frame), &length, 100) == ESP_ERR_TIMEOUT) continue;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* sample = reinterpret_cast<const adc_digi_output_data_t*>(frame + i);
+      if (sample->type2.unit != 0 || sample->type2.channel != adcChannel) continue;
+      sum += sample->type2.data;
+      if (++count < adcBlockSamples) continue;
+      adcCallback(adcArg, esp_adc_cal_raw_to_voltage((sum + count / 2) / count, &adcCalibration));
+      sum = 0;
+      count = 0;
+    }
+  }
+}
+
+uint32_t Esp32Hal::pwmSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+  return ledcSetup(channel, freq, resolutionBits);
+}
+
+void Esp32Hal::pwmAttachPin(uint8_t pin, uint8_t channel) {
+  ledcAttachPin(pin, channel);
+}
+
+void Esp32Hal::pwmWrite(uint8_t channel, uint32_t duty) {
+  ledcWrite(channel, duty);
+}
+
+uint32_t Esp32Hal::nowMs() {
+  return millis();
+}
+
+uint64_t Esp32Hal::nowUs() {
+  return esp_timer_get_time();
+}
+
+void Esp32Hal::delayMs(uint32_t ms) {
+  delay(ms);
+}
+
+void Esp32Hal::delayUs(uint32_t us) {
+  delayMicroseconds(us);
+}
+
+HalTimer Esp32Hal::createTimer(HalTimerCallback callback, void* arg, const char* name) {
+  esp_timer_create_args_t args = {};
+  args.callback = callback;
+  args.arg = arg;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = name;
+
+  esp_timer_handle_t handle = NULL;
+  if (esp_timer_create(&args, &handle) != ESP_OK) {
+    LOG_ERROR("[HAL] Failed to create timer %s", name);
+    return NULL;
+  }
+  return handle;
+}
+
+void Esp32Hal::startTimerOnce(HalTimer timer, uint64_t delayUs) {
+  if (timer == NULL) return;
+  esp_timer_handle_t handle = static_cast<esp_timer_handle_t>(timer);
+  esp_timer_stop(handle);  // Fails harmlessly if not armed
+  esp_timer_start_once(handle, delayUs);
+}
+
+void Esp32Hal::startTimerPeriodic(HalTimer timer, uint64_t periodUs) {
+  if (timer == NULL) return;
+  esp_timer_handle_t handle = static_cast<esp_timer_handle_t>(timer);
+  esp_timer_stop(handle);
+  esp_timer_start_periodic(handle, periodUs);
+}
+
+void Esp32Hal::stopTimer(HalTimer timer) {
+  if (timer == NULL) return;
+  esp_timer_stop(static_cast<esp_timer_handle_t>(timer));
+}
+
+static const char* SETTINGS_NAMESPACE = "pump";
+
+bool Esp32Hal::loadBlob(const char* key, void* data, size_t len) {
+  Preferences prefs;
+  if (!prefs.begin(SETTINGS_NAMESPACE, true)) return false;
+  bool found = prefs.getBytesLength(key) == len && prefs.getBytes(key, data, len) == len;
+  prefs.end();
+  return found;
+}
+
+bool Esp32Hal::saveBlob(const char* key, const void* data, size_t len) {
+  Preferences prefs;
+  if (!prefs.begin(SETTINGS_NAMESPACE, false)) {
+    LOG_ERROR("[HAL] Failed to open settings namespace");
+    return false;
+  }
+  bool saved = prefs.putBytes(key, data, len) == len;
+  prefs.end();
+  if (!saved) LOG_ERROR("[HAL] Failed to save setting %s", key);
+  return saved;
+}
+
+size_t Esp32Hal::logFlashSize() {
+  return logPartition ? logPartition->size : 0;
+}
+
+bool Esp32Hal::logFlashErase(size_t offset, size_t len) {
+  return logPartition && esp_partition_erase_range(logPartition, offset, len) == ESP_OK;
+}
+
+bool Esp32Hal::logFlashWrite(size_t offset, const void* data, size_t len) {
+  return logPartition && esp_partition_write(logPartition, offset, data, len) == ESP_OK;
+}
+
+bool Esp32Hal::logFlashRead(size_t offset, void* data, size_t len) {
+  return logPartition && esp_partition_read(logPartition, offset, data, len) == ESP_OK;
+}
+
+void Esp32Hal::lock() {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+void Esp32Hal::unlock() {
+  xSemaphoreGiveRecursive(mutex);
+}
+
+void Esp32Hal::waitForEvent(uint32_t timeoutMs) {
+  TickType_t ticks = timeoutMs == 0xFFFFFFFF ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  if (ticks == 0 && timeoutMs > 0) ticks = 1;
+  xSemaphoreTake(wakeSemaphore, ticks);
+}
+
+void Esp32Hal::signalEvent() {
+  if (xPortInIsrContext()) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(wakeSemaphore, &woken);
+    if (woken == pdTRUE) portYIELD_FROM_ISR();
+  } else {
+    xSemaphoreGive(wakeSemaphore);
+  }
+}
+
+// Dynamic frequency scaling only. Automatic light sleep would also stop
+// the LEDC clock, and with it the pump PWM, so it stays off.
+void Esp32Hal::enablePowerSaving() {
+  esp_pm_config_esp32s3_t config = {};
+  config.max_freq_mhz = 240;
+  config.min_freq_mhz = 80;
+  config.light_sleep_enable = false;
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK) {
+    LOG_WARN("[HAL] Power management unavailable (%d), CPU stays at full clock", err);
+  }
+}
@@ -0,0 +1,306 @@
+#include "hal_sim.h"
+#include <string.h>
+
+SimHal::SimHal() {
+  timeUs = 0;
+  advancing = false;
+  signaled = false;
+  logFlash.assign(16 * LOG_FLASH_SECTOR_SIZE, 0xFF);
+  tearAfter = -1;
+  eraseSeed = 0;
+  writeCount = 0;
+  for (int i = 0; i < NUM_PINS; i++) {
+    outputs[i] = false;
+    levels[i] = false;
+    analogMv[i] = 0;
+  }
+  for (int i = 0; i < NUM_PWM_CHANNELS; i++) {
+    duties[i] = 0;
+    attachedPins[i] = -1;
+  }
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    counts[i] = 0;
+    counterPins[i] = -1;
+  }
+  adcTimer = NULL;
+  adcPin = 0;
+  adcBlockUs = 0;
+  adcCallback = NULL;
+  adcArg = NULL;
+}
+
+SimHal::~SimHal() {
+  for (size_t i = 0; i < timers.size(); i++) delete timers[i];
+}
+
+void SimHal::record(EventKind kind, uint8_t index, uint32_t value) {
+  Event event = { timeUs, kind, index, value, writeCount };
+  eventLog.push_back(event);
+}
+
+void SimHal::pinModeOutput(uint8_t pin) {
+  if (pin < NUM_PINS) outputs[pin] = true;
+}
+
+// Only transitions are recorded, like a logic analyzer would see them
+void SimHal::applyLevel(uint8_t pin, bool high) {
+  if (levels[pin] != high) {
+    levels[pin] = high;
+    record(EVENT_PIN, pin, high ? 1 : 0);
+  }
+}
+
+void SimHal::writePin(uint8_t pin, bool high) {
+  if (pin >= NUM_PINS) return;
+  writeCount++;
+  applyLevel(pin, high);
+}
+
+void SimHal::writePins(uint64_t setMask, uint64_t clearMask) {
+  // One write per register and bank, as on the chip
+  const uint64_t banks[] = { 0xFFFFFFFFULL, ~0xFFFFFFFFULL };
+  for (uint8_t b = 0; b < 2; b++) {
+    if (!(clearMask & banks[b])) continue;
+    writeCount++;
+    for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+      if ((clearMask & banks[b]) >> pin & 1) applyLevel(pin, false);
+    }
+  }
+  for (uint8_t b = 0; b < 2; b++) {
+    if (!(setMask & banks[b])) continue;
+    writeCount++;
+    for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+      if ((setMask & banks[b]) >> pin & 1) applyLevel(pin, true);
+    }
+  }
+}
+
+bool SimHal::readPin(uint8_t pin) {
+  return pin < NUM_PINS ? levels[pin] : false;
+}
+
+bool SimHal::counterSetup(uint8_t unit, uint8_t pin) {
+  if (unit >= NUM_COUNTERS || pin >= NUM_PINS) return false;
+  counterPins[unit] = pin;
+  counts[unit] = 0;
+  return true;
+}
+
+uint32_t SimHal::counterRead(uint8_t unit) {
+  return unit < NUM_COUNTERS ? counts[unit] : 0;
+}
+
+bool SimHal::adcStartContinuous(uint8_t pin, uint32_t sampleHz, uint16_t blockSamples,
+                                HalAdcCallback callback, void* arg) {
+  if (adcTimer != NULL || pin >= NUM_PINS || sampleHz == 0 || blockSamples == 0) return false;
+  adcPin = pin;
+  adcCallback = callback;
+  adcArg = arg;
+  adcBlockUs = (uint64_t)blockSamples * 1000000 / sampleHz;
+  adcTimer = createTimer(onAdcBlock, this, "adc");
+  startTimerPeriodic(adcTimer, adcBlockUs);
+  return true;
+}
+
+void SimHal::onAdcBlock(void* arg) {
+  SimHal* hal = static_cast<SimHal*>(arg);
+  hal->adcCallback(hal->adcArg, hal->analogMv[hal->adcPin]);
+}
+
+uint32_t SimHal::pwmSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+  (void)resolutionBits;
+  if (channel >= NUM_PWM_CHANNELS) return 0;
+  return freq;
+}
+
+void SimHal::pwmAttachPin(uint8_t pin, uint8_t channel) {
+  if (channel < NUM_PWM_CHANNELS) attachedPins[channel] = pin;
+}
+
+void SimHal::pwmWrite(uint8_t channel, uint32_t duty) {
+  if (channel >= NUM_PWM_CHANNELS) return;
+  writeCount++;
+  if (duties[channel] != duty) {
+    duties[channel] = duty;
+    record(EVENT_PWM, channel, duty);
+  }
+}
+
+uint32_t SimHal::nowMs() {
+  return (uint32_t)(timeUs / 1000);
+}
+
+uint64_t SimHal::nowUs() {
+  return timeUs;
+}
+
+void SimHal::advanceUs(uint64_t us) {
+  uint64_t target = timeUs + us;
+  if (advancing) {
+    // Delay from inside a timer callback: time passes, nothing else runs
+    timeUs = target;
+    return;
+  }
+
+  advancing = true;
+  for (;;) {
+    SimTimer* next = NULL;
+    for (size_t i = 0; i < timers.size(); i++) {
+      SimTimer* timer = timers[i];
+      if (timer->armed && timer->deadlineUs <= target &&
+          (next == NULL || timer->deadlineUs < next->deadlineUs)) {
+        next = timer;
+      }
+    }
+    if (next == NULL) break;
+
+    if (next->deadlineUs > timeUs) timeUs = next->deadlineUs;
+    if (next->periodUs > 0) {
+      next->deadlineUs += next->periodUs;
+    } else {
+      next->armed = false;
+    }
+    next->callback(next->arg);
+  }
+  if (target > timeUs) timeUs = target;
+  advancing = false;
+}
+
+HalTimer SimHal::createTimer(HalTimerCallback callback, void* arg, const char* name) {
+  (void)name;
+  SimTimer* timer = new SimTimer();
+  timer->callback = callback;
+  timer->arg = arg;
+  timer->armed = false;
+  timer->deadlineUs = 0;
+  timer->periodUs = 0;
+  timers.push_back(timer);
+  return timer;
+}
+
+void SimHal::startTimerOnce(HalTimer timer, uint64_t delayUs) {
+  SimTimer* simTimer = static_cast<SimTimer*>(timer);
+  if (simTimer == NULL) return;
+  simTimer->armed = true;
+  simTimer->deadlineUs = timeUs + delayUs;
+  simTimer->periodUs = 0;
+}
+
+void SimHal::startTimerPeriodic(HalTimer timer, uint64_t periodUs) {
+  SimTimer* simTimer = static_cast<SimTimer*>(timer);
+  if (simTimer == NULL) return;
+  simTimer->armed = periodUs > 0;
+  simTimer->deadlineUs = timeUs + periodUs;
+  simTimer->periodUs = periodUs;
+}
+
+void SimHal::stopTimer(HalTimer timer) {
+  if (timer != NULL) static_cast<SimTimer*>(timer)->armed = false;
+}
+
+bool SimHal::loadBlob(const char* key, void* data, size_t len) {
+  std::map<std::string, std::vector<uint8_t> >::const_iterator it = storage.find(key);
+  if (it == storage.end() || it->second.size() != len) return false;
+  if (len > 0) memcpy(data, &it->second[0], len);
+  return true;
+}
+
+bool SimHal::saveBlob(const char* key, const void* data, size_t len) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  storage[key].assign(bytes, bytes + len);
+  return true;
+}
+
+bool SimHal::logFlashErase(size_t offset, size_t len) {
+  if (offset % LOG_FLASH_SECTOR_SIZE || len % LOG_FLASH_SECTOR_SIZE || offset + len > logFlash.size()) return false;
+  if (eraseSeed != 0) {
+    uint32_t state = eraseSeed;
+    eraseSeed = 0;
+    for (size_t i = 0; i < len; i++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      logFlash[offset + i] |= (uint8_t)state;  // Power lost part way through
+    }
+    return false;
+  }
+  memset(&logFlash[offset], 0xFF, len);
+  return true;
+}
+
+bool SimHal::logFlashWrite(size_t offset, const void* data, size_t len) {
+  if (offset + len > logFlash.size()) return false;
+  if (tearAfter >= 0 && (size_t)tearAfter < len) {
+    len = tearAfter;  // Power lost part way through
+  }
+  tearAfter = -1;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < len; i++) {
+    logFlash[offset + i] &= bytes[i];  // Programming only clears bits
+  }
+  return true;
+}
+
+bool SimHal::logFlashRead(size_t offset, void* data, size_t len) {
+  if (offset + len > logFlash.size()) return false;
+  memcpy(data, &logFlash[offset], len);
+  return true;
+}
+
+void SimHal::delayMs(uint32_t ms) {
+  advanceMs(ms);
+}
+
+void SimHal::delayUs(uint32_t us) {
+  advanceUs(us);
+}
+
+void SimHal::waitForEvent(uint32_t timeoutMs) {
+  uint64_t target = timeoutMs == 0xFFFFFFFF ? UINT64_MAX : timeUs + (uint64_t)timeoutMs * 1000;
+  while (!signaled && timeUs < target) {
+    uint64_t next = target;
+    for (size_t i = 0; i < timers.size(); i++) {
+      if (timers[i]->armed && timers[i]->deadlineUs < next) next = timers[i]->deadlineUs;
+    }
+    if (next == UINT64_MAX) break;  // Nothing will ever signal
+    advanceUs(next > timeUs ? next - timeUs : 0);
+  }
+  signaled = false;
+}
+
+bool SimHal::isOutput(uint8_t pin) const {
+  return pin < NUM_PINS && outputs[pin];
+}
+
+bool SimHal::pinLevel(uint8_t pin) const {
+  return pin < NUM_PINS && levels[pin];
+}
+
+uint32_t SimHal::pwmDuty(uint8_t channel) const {
+  return channel < NUM_PWM_CHANNELS ? duties[channel] : 0;
+}
+
+int SimHal::pwmPin(uint8_t channel) const {
+  return channel < NUM_PWM_CHANNELS ? attachedPins[channel] : -1;
+}
+
+void SimHal::addPulses(uint8_t unit, uint32_t count) {
+  if (unit < NUM_COUNTERS && counterPins[unit] >= 0) counts[unit] += count;
+}
+
+int SimHal::counterPin(uint8_t unit) const {
+  return unit < NUM_COUNTERS ? counterPins[unit] : -1;
+}
+
+void SimHal::setAnalogInput(uint8_t pin, uint32_t millivolts) {
+  if (pin < NUM_PINS) analogMv[pin] = millivolts;
+}
+
+void SimHal::setAdcStalled(bool stalled) {
+  if (adcTimer == NULL) return;
+  if (stalled) {
+    stopTimer(adcTimer);
+  } else {
+    startTimerPeriodic(adcTimer, adcBlockUs);
+  }
+}
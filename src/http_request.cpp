@@ -0,0 +1,178 @@
+#include "http_request.h"
+#include <string.h>
+
+static bool equalsIgnoreCase(const char* a, size_t aLen, const char* literal) {
+  if (strlen(literal) != aLen) return false;
+  for (size_t i = 0; i < aLen; i++) {
+    char c = a[i];
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    if (c != literal[i]) return false;
+  }
+  return true;
+}
+
+static bool containsIgnoreCase(const char* text, size_t len, const char* literal) {
+  size_t litLen = strlen(literal);
+  for (size_t i = 0; i + litLen <= len; i++) {
+    if (equalsIgnoreCase(text + i, litLen, literal)) return true;
+  }
+  return false;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+HttpRequest::HttpRequest() {
+  used = 0;
+  state = STATE_INCOMPLETE;
+  reset();
+}
+
+HttpRequest::State HttpRequest::fail(int status) {
+  state = STATE_ERROR;
+  errorStatus = status;
+  keepAlive = false;
+  return state;
+}
+
+HttpRequest::State HttpRequest::feed(const char* data, size_t len) {
+  if (state == STATE_ERROR) return state;
+  if (len > BUFFER_SIZE - used) return fail(bodyStart == 0 ? 431 : 413);
+  memcpy(buffer + used, data, len);
+  used += len;
+  if (state == STATE_COMPLETE) return state;  // Pipelined bytes wait for reset()
+
+  if (bodyStart == 0) {
+    const char* end = NULL;
+    for (size_t i = 0; i + 4 <= used; i++) {
+      if (memcmp(buffer + i, "\r\n\r\n", 4) == 0) {
+        end = buffer + i;
+        break;
+      }
+    }
+    if (end == NULL) return used > MAX_HEAD_SIZE ? fail(431) : state;
+    if (parseHead(end - buffer) == STATE_ERROR) return state;
+  }
+  if (used >= bodyStart + contentLength) state = STATE_COMPLETE;
+  return state;
+}
+
+HttpRequest::State HttpRequest::parseHead(size_t headEnd) {
+  if (headEnd > MAX_HEAD_SIZE) return fail(431);
+  buffer[headEnd] = '\0';
+  bodyStart = headEnd + 4;
+
+  // Request line: METHOD SP target SP version
+  char* line = buffer;
+  char* lineEnd = strstr(line, "\r\n");
+  if (lineEnd == NULL) lineEnd = buffer + headEnd;
+  *lineEnd = '\0';
+
+  char* target = strchr(line, ' ');
+  if (target == NULL) return fail(400);
+  *target++ = '\0';
+  char* version = strchr(target, ' ');
+  if (version == NULL || *target != '/') return fail(400);
+  *version++ = '\0';
+
+  if (strcmp(line, "GET") == 0) requestMethod = HTTP_METHOD_GET;
+  else if (strcmp(line, "POST") == 0) requestMethod = HTTP_METHOD_POST;
+  else requestMethod = HTTP_METHOD_OTHER;
+
+  if (strcmp(version, "HTTP/1.1") == 0) keepAlive = true;
+  else if (strcmp(version, "HTTP/1.0") == 0) keepAlive = false;
+  else return fail(400);
+
+  requestPath = target;
+  char* query = strchr(target, '?');
+  if (query != NULL) {
+    *query++ = '\0';
+    requestQuery = query;
+  }
+
+  // Headers - only the few that change how the request is read
+  char* header = lineEnd + 2;
+  while (header < buffer + headEnd) {
+    char* end = strstr(header, "\r\n");
+    if (end == NULL) end = buffer + headEnd;
+    char* colon = (char*)memchr(header, ':', end - header);
+    if (colon == NULL) return fail(400);
+
+    size_t nameLen = colon - header;
+    char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    size_t valueLen = end - value;
+
+    if (equalsIgnoreCase(header, nameLen, "content-length")) {
+      size_t length = 0;
+      if (valueLen == 0) return fail(400);
+      for (size_t i = 0; i < valueLen; i++) {
+        if (value[i] < '0' || value[i] > '9') return fail(400);
+        length = length * 10 + (value[i] - '0');
+        if (length > BUFFER_SIZE) return fail(413);
+      }
+      contentLength = length;
+    } else if (equalsIgnoreCase(header, nameLen, "connection")) {
+      if (containsIgnoreCase(value, valueLen, "close")) keepAlive = false;
+      else if (containsIgnoreCase(value, valueLen, "keep-alive")) keepAlive = true;
+    } else if (equalsIgnoreCase(header, nameLen, "transfer-encoding")) {
+      return fail(501);  // Chunked request bodies are not supported
+    }
+    header = end + 2;
+  }
+
+  if (bodyStart + contentLength > BUFFER_SIZE) return fail(413);
+  return state;
+}
+
+HttpRequest::State HttpRequest::reset() {
+  size_t consumed = (state == STATE_COMPLETE) ? bodyStart + contentLength : 0;
+  if (state == STATE_ERROR) consumed = used;
+  memmove(buffer, buffer + consumed, used - consumed);
+  used -= consumed;
+
+  bodyStart = 0;
+  contentLength = 0;
+  state = STATE_INCOMPLETE;
+  errorStatus = 0;
+  requestMethod = HTTP_METHOD_OTHER;
+  requestPath = "";
+  requestQuery = NULL;
+  keepAlive = false;
+
+  // Parse whatever of the next request is already here
+  return used > 0 ? feed(buffer, 0) : state;
+}
+
+bool HttpRequest::queryParam(const char* name, char* out, size_t outSize) const {
+  if (requestQuery == NULL || outSize == 0) return false;
+  size_t nameLen = strlen(name);
+  const char* p = requestQuery;
+  while (*p) {
+    const char* end = strchr(p, '&');
+    if (end == NULL) end = p + strlen(p);
+    const char* eq = (const char*)memchr(p, '=', end - p);
+    const char* keyEnd = eq ? eq : end;
+    if ((size_t)(keyEnd - p) == nameLen && memcmp(p, name, nameLen) == 0) {
+      size_t n = 0;
+      for (const char* v = eq ? eq + 1 : end; v < end && n + 1 < outSize; v++) {
+        if (*v == '+') {
+          out[n++] = ' ';
+        } else if (*v == '%' && end - v > 2 && hexValue(v[1]) >= 0 && hexValue(v[2]) >= 0) {
+          out[n++] = (char)(hexValue(v[1]) * 16 + hexValue(v[2]));
+          v += 2;
+        } else {
+          out[n++] = *v;
+        }
+      }
+      out[n] = '\0';
+      return true;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return false;
+}
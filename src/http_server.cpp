@@ -0,0 +1,377 @@
+#include "http_server.h"
+#include "logger.h"
+#include "metrics.h"
+#include <esp_timer.h>
+
+// writeHead() length for streamed bodies: no Content-Length header
+static const size_t HTTP_UNKNOWN_LENGTH = (size_t)-1;
+
+const char* httpStatusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default:  return "Unknown";
+  }
+}
+
+// ---------------------------------------------------------------------------
+// HttpExchange
+
+HttpExchange::HttpExchange(HttpServer& serverInstance, HttpConnection& connectionInstance)
+  : server(serverInstance), connection(connectionInstance), responded(false) {}
+
+const HttpRequest& HttpExchange::request() const {
+  return connection.request;
+}
+
+void HttpExchange::send(int code, const char* contentType, const char* body, size_t length) {
+  if (responded) return;
+  responded = true;
+  server.writeHead(connection, code, contentType, length, NULL);
+  if (connection.txLen + length > HttpConnection::TX_BUFFER_SIZE) {
+    LOG_ERROR("[HTTP] Response for %s too large (%u bytes)", connection.request.path(), (unsigned)length);
+    server.sendError(connection, 500, "Response too large");
+    return;
+  }
+  memcpy(connection.tx + connection.txLen, body, length);
+  connection.txLen += length;
+  server.pump(connection);
+}
+
+void HttpExchange::sendStatic(int code, const char* contentType, const uint8_t* body, size_t length,
+                              const char* extraHeaders) {
+  if (responded) return;
+  responded = true;
+  server.writeHead(connection, code, contentType, length, extraHeaders);
+  connection.staticBody = body;
+  connection.staticLen = length;
+  connection.staticSent = 0;
+  server.pump(connection);
+}
+
+void HttpExchange::sendStream(int code, const char* contentType, HttpBodyWriter writer,
+                              const char* extraHeaders) {
+  if (responded) return;
+  responded = true;
+  connection.closeWhenSent = true;
+  server.writeHead(connection, code, contentType, HTTP_UNKNOWN_LENGTH, extraHeaders);
+  connection.bodyWriter = writer;
+  server.pump(connection);
+}
+
+HttpStreamId HttpExchange::beginEventStream() {
+  if (responded) return HTTP_NO_STREAM;
+  responded = true;
+  static const char HEAD[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+  memcpy(connection.tx, HEAD, sizeof(HEAD) - 1);
+  connection.txLen = sizeof(HEAD) - 1;
+  connection.txSent = 0;
+  connection.eventStream = true;
+  connection.closeWhenSent = false;
+  server.pump(connection);
+
+  int slot = &connection - server.connections;
+  return (HttpStreamId)(((connection.generation & 0x7FFFFF) << 8) | slot);
+}
+
+// ---------------------------------------------------------------------------
+// HttpServer
+
+HttpServer::HttpServer(uint16_t port) : server(port) {
+  mutex = xSemaphoreCreateRecursiveMutex();
+  routeCount = 0;
+  unroutedRequests = 0;
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    connections[i].client = NULL;
+    connections[i].generation = 0;
+  }
+}
+
+void HttpServer::on(const char* path, HttpMethod method, HttpHandler handler) {
+  if (routeCount >= MAX_ROUTES) {
+    LOG_ERROR("[HTTP] Route table full, dropping %s", path);
+    return;
+  }
+  routes[routeCount].path = path;
+  routes[routeCount].method = method;
+  routes[routeCount].handler = handler;
+  routes[routeCount].requests = 0;
+  routeCount++;
+}
+
+void HttpServer::begin() {
+  server.onClient([](void* arg, AsyncClient* client) {
+    static_cast<HttpServer*>(arg)->accept(client);
+  }, this);
+  server.setNoDelay(true);
+  server.begin();
+}
+
+HttpConnection* HttpServer::slotFor(AsyncClient* client) {
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    if (connections[i].client == client) return &connections[i];
+  }
+  return NULL;
+}
+
+void HttpServer::accept(AsyncClient* client) {
+  lock();
+  HttpConnection* connection = slotFor(NULL);
+  if (connection == NULL) {
+    unlock();
+    // Out of slots: refuse rather than queue
+    client->onDisconnect([](void*, AsyncClient* c) { delete c; }, NULL);
+    client->close(true);
+    LOG_WARN("[HTTP] Connection refused, all %u slots busy", MAX_CONNECTIONS);
+    return;
+  }
+
+  connection->client = client;
+  connection->request.clear();
+  connection->txLen = 0;
+  connection->txSent = 0;
+  connection->staticBody = NULL;
+  connection->staticLen = 0;
+  connection->staticSent = 0;
+  connection->bodyWriter = nullptr;
+  connection->closeWhenSent = false;
+  connection->eventStream = false;
+  connection->lastActivityMs = millis();
+  unlock();
+
+  client->setNoDelay(true);
+  client->onData([](void* arg, AsyncClient* c, void* data, size_t len) {
+    HttpServer* self = static_cast<HttpServer*>(arg);
+    self->lock();
+    HttpConnection* conn = self->slotFor(c);
+    if (conn != NULL) self->onData(*conn, static_cast<const char*>(data), len);
+    self->unlock();
+  }, this);
+  client->onAck([](void* arg, AsyncClient* c, size_t, uint32_t) {
+    HttpServer* self = static_cast<HttpServer*>(arg);
+    self->lock();
+    HttpConnection* conn = self->slotFor(c);
+    if (conn != NULL) self->onAck(*conn);
+    self->unlock();
+  }, this);
+  client->onTimeout([](void*, AsyncClient* c, uint32_t) { c->close(true); }, NULL);
+  client->onDisconnect([](void* arg, AsyncClient* c) {
+    HttpServer* self = static_cast<HttpServer*>(arg);
+    self->lock();
+    HttpConnection* conn = self->slotFor(c);
+    if (conn != NULL) self->release(*conn);
+    self->unlock();
+    delete c;
+  }, this);
+}
+
+void HttpServer::release(HttpConnection& connection) {
+  connection.client = NULL;
+  connection.generation++;
+  connection.eventStream = false;
+  connection.staticBody = NULL;
+  connection.bodyWriter = nullptr;
+  connection.request.clear();
+}
+
+bool HttpServer::idle(const HttpConnection& connection) const {
+  return connection.txSent >= connection.txLen && !connection.bodyWriter &&
+         (connection.staticBody == NULL || connection.staticSent >= connection.staticLen);
+}
+
+void HttpServer::onData(HttpConnection& connection, const char* data, size_t len) {
+  connection.lastActivityMs = millis();
+  if (connection.eventStream) return;  // Nothing more is read from a stream
+  connection.request.feed(data, len);
+  processRequests(connection);
+}
+
+void HttpServer::onAck(HttpConnection& connection) {
+  connection.lastActivityMs = millis();
+  pump(connection);
+  if (idle(connection) && !connection.eventStream && !connection.closeWhenSent) processRequests(connection);
+}
+
+// Answers complete requests one at a time; a pipelined request waits until
+// the response before it has been handed to the stack
+void HttpServer::processRequests(HttpConnection& connection) {
+  while (connection.client != NULL && idle(connection) && !connection.closeWhenSent) {
+    HttpRequest& request = connection.request;
+    if (request.getState() == HttpRequest::STATE_ERROR) {
+      connection.closeWhenSent = true;  // The stream can't be resynchronized
+      sendError(connection, request.getErrorStatus(), httpStatusText(request.getErrorStatus()));
+      return;
+    }
+    if (request.getState() != HttpRequest::STATE_COMPLETE) return;
+
+    dispatch(connection);
+    if (connection.eventStream) return;
+    request.reset();
+  }
+}
+
+static bool routeMatches(const char* route, const char* path) {
+  size_t length = strlen(route);
+  if (length >= 2 && route[length - 2] == '/' && route[length - 1] == '*') {
+    return strncmp(route, path, length - 1) == 0 && path[length - 1] != '\0';
+  }
+  return strcmp(route, path) == 0;
+}
+
+void HttpServer::dispatch(HttpConnection& connection) {
+  const HttpRequest& request = connection.request;
+  connection.closeWhenSent = !request.isKeepAlive();
+
+  bool pathFound = false;
+  for (uint8_t i = 0; i < routeCount; i++) {
+    if (!routeMatches(routes[i].path, request.path())) continue;
+    pathFound = true;
+    if (routes[i].method != HTTP_METHOD_ANY && routes[i].method != request.method()) continue;
+
+    HttpExchange exchange(*this, connection);
+    routes[i].requests++;
+    int64_t startUs = esp_timer_get_time();
+    routes[i].handler(exchange);
+    metrics.httpHandler.observe((uint32_t)(esp_timer_get_time() - startUs));
+    if (!exchange.hasResponded()) sendError(connection, 500, "No response");
+    return;
+  }
+  unroutedRequests++;
+  if (pathFound) {
+    sendError(connection, 405, "Method not allowed");
+  } else {
+    LOG_DEBUG("[HTTP] 404 %s", request.path());
+    sendError(connection, 404, "Not found");
+  }
+}
+
+void HttpServer::writeHead(HttpConnection& connection, int code, const char* contentType,
+                           size_t contentLength, const char* extraHeaders) {
+  char lengthHeader[32] = "";
+  if (contentLength != HTTP_UNKNOWN_LENGTH) {
+    snprintf(lengthHeader, sizeof(lengthHeader), "Content-Length: %u\r\n", (unsigned)contentLength);
+  }
+  int len = snprintf(connection.tx, HttpConnection::TX_BUFFER_SIZE,
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n%sConnection: %s\r\n%s\r\n",
+                     code, httpStatusText(code), contentType, lengthHeader,
+                     connection.closeWhenSent ? "close" : "keep-alive", extraHeaders ? extraHeaders : "");
+  connection.txLen = (len > 0 && (size_t)len < HttpConnection::TX_BUFFER_SIZE) ? len : 0;
+  connection.txSent = 0;
+}
+
+void HttpServer::sendError(HttpConnection& connection, int code, const char* message) {
+  connection.staticBody = NULL;
+  connection.bodyWriter = nullptr;
+
+  char body[96];
+  int bodyLen = snprintf(body, sizeof(body), "{\"success\": false, \"message\": \"%s\"}", message);
+  if (bodyLen < 0 || (size_t)bodyLen >= sizeof(body)) bodyLen = 0;
+  writeHead(connection, code, "application/json", bodyLen, NULL);
+  memcpy(connection.tx + connection.txLen, body, bodyLen);
+  connection.txLen += bodyLen;
+  pump(connection);
+}
+
+// Hands as much pending output to the TCP stack as its window takes; the
+// rest follows from onAck()
+void HttpServer::pump(HttpConnection& connection) {
+  AsyncClient* client = connection.client;
+  if (client == NULL) return;
+
+  bool added = false;
+  for (;;) {
+    size_t space = client->space();
+    if (space == 0) break;
+    if (connection.txSent >= connection.txLen && connection.bodyWriter) {
+      connection.txLen = connection.bodyWriter(connection.tx, HttpConnection::TX_BUFFER_SIZE);
+      connection.txSent = 0;
+      if (connection.txLen == 0) connection.bodyWriter = nullptr;
+    }
+    const char* data;
+    size_t remaining;
+    size_t* sent;
+    if (connection.txSent < connection.txLen) {
+      data = connection.tx + connection.txSent;
+      remaining = connection.txLen - connection.txSent;
+      sent = &connection.txSent;
+    } else if (connection.staticBody != NULL && connection.staticSent < connection.staticLen) {
+      data = reinterpret_cast<const char*>(connection.staticBody) + connection.staticSent;
+      remaining = connection.staticLen - connection.staticSent;
+      sent = &connection.staticSent;
+    } else {
+      break;
+    }
+    size_t n = client->add(data, remaining < space ? remaining : space);
+    if (n == 0) break;
+    *sent += n;
+    added = true;
+  }
+  if (added) client->send();
+
+  if (idle(connection)) {
+    connection.txLen = 0;
+    connection.txSent = 0;
+    connection.staticBody = NULL;
+    if (connection.closeWhenSent) client->close();
+  }
+}
+
+void HttpServer::service() {
+  lock();
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < MAX_CONNECTIONS; i++) {
+    HttpConnection& connection = connections[i];
+    if (connection.client == NULL || connection.eventStream) continue;
+    if (idle(connection) && now - connection.lastActivityMs > IDLE_TIMEOUT_MS) {
+      connection.client->close();
+      connection.lastActivityMs = now;  // Don't close twice while the FIN goes out
+    }
+  }
+  unlock();
+}
+
+HttpConnection* HttpServer::streamConnection(HttpStreamId id) {
+  if (id < 0) return NULL;
+  uint32_t slot = id & 0xFF;
+  uint32_t generation = (uint32_t)id >> 8;
+  if (slot >= MAX_CONNECTIONS) return NULL;
+  HttpConnection& connection = connections[slot];
+  if (connection.client == NULL || !connection.eventStream) return NULL;
+  if ((connection.generation & 0x7FFFFF) != generation) return NULL;
+  return &connection;
+}
+
+bool HttpServer::streamOpen(HttpStreamId id) {
+  lock();
+  bool open = streamConnection(id) != NULL;
+  unlock();
+  return open;
+}
+
+bool HttpServer::streamWrite(HttpStreamId id, const char* data, size_t len) {
+  lock();
+  HttpConnection* connection = streamConnection(id);
+  bool written = false;
+  if (connection != NULL && idle(*connection) && connection->client->space() >= len) {
+    written = connection->client->add(data, len) == len;
+    if (written) {
+      connection->client->send();
+      connection->lastActivityMs = millis();
+    }
+  }
+  unlock();
+  return written;
+}
@@ -0,0 +1,236 @@
+#include "json_reader.h"
+#include <string.h>
+
+JsonReader::JsonReader(const char* jsonText, size_t jsonLength) {
+  text = jsonText;
+  length = jsonLength;
+  pos = 0;
+  err = JSON_OK;
+}
+
+bool JsonReader::fail(JsonError error) {
+  if (err == JSON_OK) err = error;
+  return false;
+}
+
+void JsonReader::skipWhitespace() {
+  while (pos < length) {
+    char c = text[pos];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+    pos++;
+  }
+}
+
+bool JsonReader::consume(char c) {
+  skipWhitespace();
+  if (pos < length && text[pos] == c) {
+    pos++;
+    return true;
+  }
+  return false;
+}
+
+bool JsonReader::equals(const char* slice, size_t sliceLen, const char* literal) {
+  return strlen(literal) == sliceLen && memcmp(slice, literal, sliceLen) == 0;
+}
+
+bool JsonReader::beginObject() {
+  if (err) return false;
+  return consume('{') || fail(JSON_ERR_TYPE);
+}
+
+bool JsonReader::beginArray() {
+  if (err) return false;
+  return consume('[') || fail(JSON_ERR_TYPE);
+}
+
+// Shared by nextKey()/nextElement(): handles the separator between members
+// and detects the closing bracket. Whether a comma is required is derived
+// from the previous significant character, so nested containers need no
+// extra bookkeeping.
+static bool isContainerStart(const char* text, size_t pos) {
+  while (pos > 0) {
+    char c = text[--pos];
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+    return c == '{' || c == '[';
+  }
+  return false;
+}
+
+bool JsonReader::nextElement() {
+  if (err) return false;
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+  bool first = isContainerStart(text, pos);
+  if (text[pos] == ']') {
+    pos++;
+    return false;
+  }
+  if (!first) {
+    if (!consume(',')) return fail(JSON_ERR_SYNTAX);
+    if (consume(']')) return fail(JSON_ERR_SYNTAX);  // Trailing comma
+  }
+  return true;
+}
+
+bool JsonReader::nextKey(const char*& key, size_t& keyLen) {
+  if (err) return false;
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+  bool first = isContainerStart(text, pos);
+  if (text[pos] == '}') {
+    pos++;
+    return false;
+  }
+  if (!first && !consume(',')) return fail(JSON_ERR_SYNTAX);
+  skipWhitespace();
+  if (pos >= length || text[pos] != '"') return fail(JSON_ERR_SYNTAX);
+  if (!scanString(key, keyLen)) return false;
+  if (!consume(':')) return fail(JSON_ERR_SYNTAX);
+  return true;
+}
+
+bool JsonReader::scanString(const char*& value, size_t& valueLen) {
+  pos++;  // Opening quote
+  size_t start = pos;
+  while (pos < length) {
+    char c = text[pos];
+    if (c == '"') {
+      value = text + start;
+      valueLen = pos - start;
+      pos++;
+      return true;
+    }
+    if ((unsigned char)c < 0x20) return fail(JSON_ERR_SYNTAX);
+    if (c == '\\') {
+      pos++;
+      if (pos >= length) break;
+    }
+    pos++;
+  }
+  return fail(JSON_ERR_SYNTAX);
+}
+
+bool JsonReader::readString(const char*& value, size_t& valueLen) {
+  if (err) return false;
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+  if (text[pos] != '"') return fail(JSON_ERR_TYPE);
+  return scanString(value, valueLen);
+}
+
+bool JsonReader::readUInt(uint32_t& value) {
+  if (err) return false;
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+
+  char c = text[pos];
+  if (c == '-') {
+    // Valid JSON, but never a valid value for us
+    return skipNumber() && fail(JSON_ERR_RANGE);
+  }
+  if (c < '0' || c > '9') return fail(JSON_ERR_TYPE);
+
+  size_t start = pos;
+  uint32_t result = 0;
+  bool overflow = false;
+  while (pos < length && text[pos] >= '0' && text[pos] <= '9') {
+    uint32_t digit = text[pos] - '0';
+    if (result > (UINT32_MAX - digit) / 10) overflow = true;
+    result = result * 10 + digit;
+    pos++;
+  }
+  if (text[start] == '0' && pos - start > 1) return fail(JSON_ERR_SYNTAX);  // Leading zero
+  if (pos < length && (text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')) {
+    pos = start;
+    return skipNumber() && fail(JSON_ERR_RANGE);
+  }
+  if (overflow) return fail(JSON_ERR_RANGE);
+
+  value = result;
+  return true;
+}
+
+bool JsonReader::readBool(bool& value) {
+  if (err) return false;
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+  if (text[pos] == 't') {
+    if (!skipLiteral("true")) return false;
+    value = true;
+    return true;
+  }
+  if (text[pos] == 'f') {
+    if (!skipLiteral("false")) return false;
+    value = false;
+    return true;
+  }
+  return fail(JSON_ERR_TYPE);
+}
+
+bool JsonReader::skipNumber() {
+  if (pos < length && text[pos] == '-') pos++;
+  size_t digits = 0;
+  while (pos < length && text[pos] >= '0' && text[pos] <= '9') { pos++; digits++; }
+  if (digits == 0) return fail(JSON_ERR_SYNTAX);
+  if (pos < length && text[pos] == '.') {
+    pos++;
+    digits = 0;
+    while (pos < length && text[pos] >= '0' && text[pos] <= '9') { pos++; digits++; }
+    if (digits == 0) return fail(JSON_ERR_SYNTAX);
+  }
+  if (pos < length && (text[pos] == 'e' || text[pos] == 'E')) {
+    pos++;
+    if (pos < length && (text[pos] == '+' || text[pos] == '-')) pos++;
+    digits = 0;
+    while (pos < length && text[pos] >= '0' && text[pos] <= '9') { pos++; digits++; }
+    if (digits == 0) return fail(JSON_ERR_SYNTAX);
+  }
+  return true;
+}
+
+bool JsonReader::skipLiteral(const char* literal) {
+  size_t len = strlen(literal);
+  if (length - pos < len || memcmp(text + pos, literal, len) != 0) return fail(JSON_ERR_SYNTAX);
+  pos += len;
+  return true;
+}
+
+bool JsonReader::skipValue() {
+  if (err) return false;
+  return skipValueAtDepth(0);
+}
+
+bool JsonReader::skipValueAtDepth(int depth) {
+  if (depth > MAX_SKIP_DEPTH) return fail(JSON_ERR_DEPTH);
+  skipWhitespace();
+  if (pos >= length) return fail(JSON_ERR_SYNTAX);
+
+  const char* slice;
+  size_t sliceLen;
+  switch (text[pos]) {
+    case '"':
+      return scanString(slice, sliceLen);
+    case '{':
+      pos++;
+      while (nextKey(slice, sliceLen)) {
+        if (!skipValueAtDepth(depth + 1)) return false;
+      }
+      return ok();
+    case '[':
+      pos++;
+      while (nextElement()) {
+        if (!skipValueAtDepth(depth + 1)) return false;
+      }
+      return ok();
+    case 't': return skipLiteral("true");
+    case 'f': return skipLiteral("false");
+    case 'n': return skipLiteral("null");
+    default:  return skipNumber();
+  }
+}
+
+bool JsonReader::atEnd() {
+  skipWhitespace();
+  return pos == length;
+}
@@ -0,0 +1,124 @@
+#include "logger.h"
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Bounded multi-producer / single-consumer ring. Each slot carries a
+// sequence number: producers claim a slot by advancing enqueuePos with a CAS
+// and publish it by bumping the slot sequence, the drain task consumes slots
+// in order. No locks, no allocation, and a producer never waits.
+static const size_t LOG_SLOTS = 64;  // Must be a power of two
+static const size_t LOG_LINE_SIZE = 128;
+
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  uint16_t length;
+  char text[LOG_LINE_SIZE];
+};
+
+class LogRing {
+public:
+  LogSlot slots[LOG_SLOTS];
+  std::atomic<uint32_t> enqueuePos;
+  uint32_t dequeuePos;  // Only touched by the consumer
+  std::atomic<uint32_t> dropped;
+
+  LogRing() : enqueuePos(0), dequeuePos(0), dropped(0) {
+    for (size_t i = 0; i < LOG_SLOTS; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+      slots[i].length = 0;
+    }
+  }
+};
+
+static LogRing ring;
+
+void logPrintf(const char* format, ...) {
+  uint32_t pos = ring.enqueuePos.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  for (;;) {
+    slot = &ring.slots[pos & (LOG_SLOTS - 1)];
+    uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int32_t diff = (int32_t)(sequence - pos);
+    if (diff == 0) {
+      if (ring.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);  // Ring full
+      return;
+    } else {
+      pos = ring.enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(slot->text, LOG_LINE_SIZE, format, args);
+  va_end(args);
+  if (len < 0) len = 0;
+  if ((size_t)len >= LOG_LINE_SIZE) {
+    // Keep the line break of truncated lines
+    len = LOG_LINE_SIZE - 1;
+    slot->text[len - 1] = '\n';
+  }
+  slot->length = len;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+static void logWrite(const char* text, size_t length) {
+#ifdef ARDUINO
+  Serial.write(reinterpret_cast<const uint8_t*>(text), length);
+#else
+  fwrite(text, 1, length, stdout);
+#endif
+}
+
+// Consumer side; only ever called from one context at a time
+static bool logDrainOne() {
+  static uint32_t reportedDrops = 0;
+  uint32_t drops = ring.dropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    char notice[48];
+    int len = snprintf(notice, sizeof(notice), "[Log] %lu message(s) dropped\n",
+                       (unsigned long)(drops - reportedDrops));
+    logWrite(notice, len);
+    reportedDrops = drops;
+  }
+
+  LogSlot& slot = ring.slots[ring.dequeuePos & (LOG_SLOTS - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != ring.dequeuePos + 1) return false;
+  logWrite(slot.text, slot.length);
+  slot.sequence.store(ring.dequeuePos + LOG_SLOTS, std::memory_order_release);
+  ring.dequeuePos++;
+  return true;
+}
+
+void logFlush() {
+  while (logDrainOne()) {
+  }
+}
+
+uint32_t logDroppedCount() {
+  return ring.dropped.load(std::memory_order_relaxed);
+}
+
+#ifdef ARDUINO
+static void logDrainTask(void* param) {
+  (void)param;
+  for (;;) {
+    if (!logDrainOne()) vTaskDelay(pdMS_TO_TICKS(5));
+  }
+}
+
+void logBegin() {
+  // Lowest application priority: Serial output only runs when nothing
+  // else has work, and a slow UART can never hold up motor control.
+  xTaskCreate(logDrainTask, "log", 3072, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+#else
+void logBegin() {
+}
+#endif
@@ -1,8 +1,24 @@
 #include <Arduino.h>
-#include "pump.h"
+#include "hal_esp32.h"
+#include "logger.h"
+#include "boot_profile.h"
+#include "pump_manager.h"
 #include "vacuum_pump.h"
+#include "pressure_monitor.h"
+#include "pump_controller.h"
+#include "event_log.h"
+#include "scheduler.h"
+#include "flow_calibration.h"
+#include "protocol_sequencer.h"
+#include "protocol_store.h"
+#include "control_task.h"
+#include "command_dispatcher.h"
+#include "command_console.h"
+#include "serial_console.h"
+#include "button_input.h"
 #include "wifi_manager.h"
 #include "web_server.h"
+#include "udp_control.h"
 
 // with 6612FNG
 
@@ -10,47 +26,136 @@
 const char* ssid = "ssid";        // Change to your WiFi name
 const char* password = "pwd"; // Change to your WiFi password
 
+// Front-panel buttons, active low, and the console line each one runs.
+// GPIO 0 is the devkit's BOOT button.
+static const ButtonBinding BUTTONS[] = {
+  { 0, "estop" },
+};
+
+static bool submitToControlTask(void*, const CommandBatch& batch);
+
 // Global objects
-PeristalticPump pump;
-VacuumPump vacuumPump;
+Esp32Hal hardware;
+BootProfile bootProfile(hardware);
+PumpManager pumps(hardware);
+VacuumPump vacuumPump(hardware, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL);
+PressureMonitor vacuumGauge(hardware, VACUUM_SENSOR);
 WiFiManager wifiManager(ssid, password);
-WebServerManager webServer(&pump, &vacuumPump);
+PumpController controller(pumps, vacuumPump, hardware);
+EventLog eventLog(hardware);
+ControlTask controlTask(controller);
+FlowCalibration flowCalibration(hardware);
+ProtocolSequencer sequencer(controller, hardware);
+ProtocolStore protocolStore(hardware);
+CommandDispatcher commands(controller, sequencer, submitToControlTask, NULL);
+CommandConsole console(commands, hardware, SerialConsole::writeLine, NULL);
+SerialConsole serialConsole(console);
+ButtonInput buttons(console);
+WebServerManager webServer(&commands, &flowCalibration, &sequencer, &protocolStore, &eventLog, &wifiManager,
+                           &bootProfile, &vacuumGauge);
+UdpControlServer udpControl(commands);
+Scheduler scheduler(hardware);
+
+// Main loop jobs
+static Scheduler::JobId eventsJob = -1;
+static Scheduler::JobId logJob = -1;
+static Scheduler::JobId wifiJob = -1;
+static Scheduler::JobId serialJob = -1;
+static Scheduler::JobId buttonJob = -1;
+
+// Every front end's commands reach the control task through here
+static bool submitToControlTask(void*, const CommandBatch& batch) { return controlTask.submitBatch(batch); }
 
+static uint32_t runConnections(void*) { return webServer.serviceConnections(); }
+static uint32_t runEvents(void*) { return webServer.pollEvents(); }
+static uint32_t runEventLog(void*) { return eventLog.service(); }  // Flash writes stay off the control task
+static uint32_t runWiFi(void*) {
+  static bool wasConnected = false;
+  uint32_t nextMs = wifiManager.service();
+  bool connected = wifiManager.isWiFiConnected();
+  if (connected && !wasConnected) {
+    bootProfile.markNetworkUp();
+    webServer.printServerInfo();
+  }
+  wasConnected = connected;
+  return nextMs;
+}
+static void wakeEvents(void*) { scheduler.wake(eventsJob); }
+static void wakeEventLog(void*) { scheduler.wake(logJob); }
+static void wakeWiFi(void*) { scheduler.wake(wifiJob); }
+static uint32_t runSerial(void*) { return serialConsole.service(); }
+static uint32_t runButtons(void*) { return buttons.service(); }
+static void wakeSerial(void*) { scheduler.wake(serialJob); }
+static void wakeButtons(void*) { scheduler.wake(buttonJob); }
 
 
 void setup() {
+  // Motor outputs first: until now every pin has been a floating input
+  bootProfile.begin();
+  pumps.makeSafe();
+  vacuumPump.makeSafe();
+  bootProfile.mark("outputs_safe");
+
+  // Log lines queue until the drain task sends them, so nothing waits for
+  // the USB host to attach
   Serial.begin(115200);
-  delay(300);
-  Serial.println();
-  Serial.println("=== ESP32-S3 Pump Controller (Peristaltic + Vacuum) ===");
+  logBegin();
+  LOG_INFO("");
+  LOG_INFO("=== ESP32-S3 Pump Controller (Peristaltic + Vacuum) ===");
+  bootProfile.mark("serial");
 
   // Initialize pumps
-  pump.begin();
+  pumps.begin();
+  vacuumPump.setPressureMonitor(vacuumGauge);
   vacuumPump.begin();
+  // The vacuum pump stays locked out until the gauge's first reading
+  if (vacuumGauge.begin()) vacuumGauge.awaitFirstReading(PressureMonitor::STALE_MS);
+  bootProfile.mark("drivers");
 
-  // Connect to WiFi
-  wifiManager.connect();
+  eventLog.begin();
+  controller.setEventLog(&eventLog);
+  flowCalibration.load();
+  sequencer.begin();
+  protocolStore.begin();
+  bootProfile.mark("storage");
+
+  // From here on only the control task touches the pumps
+  controlTask.begin();
+  bootProfile.mark("control_task");
+
+  // Local control works from here on, network or not
+  serialJob = scheduler.add("serial", runSerial, NULL, SCHEDULE_NEVER);
+  buttonJob = scheduler.add("buttons", runButtons, NULL, SCHEDULE_NEVER);
+  serialConsole.begin(wakeSerial, NULL);
+  buttons.begin(BUTTONS, sizeof(BUTTONS) / sizeof(BUTTONS[0]), wakeButtons, NULL);
+  bootProfile.mark("local_control");
+
+  // Connect to WiFi in the background; the pumps don't wait for it
+  wifiJob = scheduler.add("wifi", runWiFi, NULL, 0);
+  wifiManager.setWakeListener(wakeWiFi, NULL);
+  wifiManager.begin();
+  bootProfile.mark("wifi_start");
 
   // Setup and start web server
   webServer.begin();
-  
-  if (wifiManager.isWiFiConnected()) {
-    webServer.printServerInfo();
-  } else {
-    Serial.println("[Main] WiFi not connected. Web server may not be accessible.");
-  }
-  
-  Serial.println("[Main] Setup complete. System ready.");
+  udpControl.begin();
+  bootProfile.mark("servers");
+
+  scheduler.add("connections", runConnections, NULL, 1000);
+  eventsJob = scheduler.add("events", runEvents, NULL, SCHEDULE_NEVER);
+  logJob = scheduler.add("event_log", runEventLog, NULL, 0);
+  webServer.setObserverListener(wakeEvents, NULL);
+  controller.setCommandListener(wakeEvents, NULL);  // Observers see commands without waiting a poll
+  eventLog.setWakeListener(wakeEventLog, NULL);
+  hardware.enablePowerSaving();
+  bootProfile.mark("scheduler");
+
+  bootProfile.finish();
+  LOG_INFO("[Main] Setup complete. System ready.");
 }
 
 void loop() {
-  // Handle Web Server Requests
-  webServer.handleClient();
-  
-  // Update pumps (handles timed runs)
-  pump.update();
-  vacuumPump.update();
-  
-  // Can add other background tasks here
-  delay(10);
-}
\ No newline at end of file
+  // Sleeps until the next job deadline or wake(); commands don't pass
+  // through here, they go straight to the control task
+  scheduler.run();
+}
@@ -0,0 +1,102 @@
+#include "metrics.h"
+#include <stdio.h>
+
+// Sub-millisecond detail for the control path, up to the 25 ms where a
+// command would visibly lag
+static const uint32_t LATENCY_BOUNDS_US[] = {
+  10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000
+};
+
+RuntimeMetrics metrics;
+
+RuntimeMetrics::RuntimeMetrics()
+  : httpHandler("pump_http_handler_seconds", "Time spent in an HTTP route handler",
+                LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])),
+    commandLatency("pump_command_latency_seconds", "Time from a command being queued to its PWM update",
+                   LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])),
+    schedulerLateness("pump_scheduler_lateness_seconds", "How late main loop jobs ran after their deadline",
+                      LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])),
+    timedStopError("pump_timed_stop_error_seconds", "How late timed runs stopped after their deadline",
+                   LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])),
+    speedLoopRun("pump_speed_loop_run_seconds", "Time spent in a closed-loop speed step",
+                 LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])),
+    speedLoopJitter("pump_speed_loop_jitter_seconds", "How far closed-loop speed steps ran from their fixed period",
+                    LATENCY_BOUNDS_US, sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0])) {}
+
+Histogram* RuntimeMetrics::histogram(uint8_t index) {
+  switch (index) {
+    case 0:  return &httpHandler;
+    case 1:  return &commandLatency;
+    case 2:  return &schedulerLateness;
+    case 3:  return &timedStopError;
+    case 4:  return &speedLoopRun;
+    case 5:  return &speedLoopJitter;
+    default: return NULL;
+  }
+}
+
+Histogram::Histogram(const char* metricName, const char* metricHelp, const uint32_t* boundsUs, uint8_t count)
+  : name(metricName), help(metricHelp), bounds(boundsUs),
+    boundCount(count < MAX_BOUNDS ? count : MAX_BOUNDS), sumLow(0), sumHigh(0) {
+  for (uint8_t i = 0; i <= MAX_BOUNDS; i++) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(uint32_t us) {
+  uint8_t bucket = 0;
+  while (bucket < boundCount && us > bounds[bucket]) bucket++;
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  uint32_t before = sumLow.fetch_add(us, std::memory_order_relaxed);
+  if (before + us < before) sumHigh.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::snapshot(Snapshot& out) const {
+  for (uint8_t i = 0; i <= boundCount; i++) {
+    out.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+  }
+  // Retry if a carry lands between the two reads
+  uint32_t high, low;
+  do {
+    high = sumHigh.load(std::memory_order_relaxed);
+    low = sumLow.load(std::memory_order_relaxed);
+  } while (high != sumHigh.load(std::memory_order_relaxed));
+  out.sumUs = ((uint64_t)high << 32) | low;
+}
+
+// Microseconds as decimal seconds, the unit Prometheus expects
+static void formatSeconds(uint64_t us, char* out, size_t max) {
+  snprintf(out, max, "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+size_t Histogram::formatLine(const Snapshot& snap, uint8_t line, char* out, size_t max) const {
+  char value[24];
+  int len;
+  if (line == 0) {
+    len = snprintf(out, max, "# HELP %s %s\n", name, help);
+  } else if (line == 1) {
+    len = snprintf(out, max, "# TYPE %s histogram\n", name);
+  } else if (line < 3 + boundCount) {
+    // Buckets, then +Inf; counts are cumulative in the exposition
+    uint8_t bucket = line - 2;
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i <= bucket; i++) cumulative += snap.buckets[i];
+    if (bucket < boundCount) {
+      formatSeconds(bounds[bucket], value, sizeof(value));
+    } else {
+      snprintf(value, sizeof(value), "+Inf");
+    }
+    len = snprintf(out, max, "%s_bucket{le=\"%s\"} %lu\n", name, value, (unsigned long)cumulative);
+  } else if (line == 3 + boundCount) {
+    formatSeconds(snap.sumUs, value, sizeof(value));
+    len = snprintf(out, max, "%s_sum %s\n", name, value);
+  } else if (line == 4 + boundCount) {
+    uint32_t count = 0;
+    for (uint8_t i = 0; i <= boundCount; i++) count += snap.buckets[i];
+    len = snprintf(out, max, "%s_count %lu\n", name, (unsigned long)count);
+  } else {
+    return 0;
+  }
+  if (len < 0 || (size_t)len >= max) return 0;
+  return len;
+}
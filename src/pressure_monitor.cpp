@@ -0,0 +1,113 @@
+#include "pressure_monitor.h"
+#include "logger.h"
+
+const char* pressureStateName(PressureState state) {
+  switch (state) {
+    case PRESSURE_OK:           return "ok";
+    case PRESSURE_OVER_VACUUM:  return "over-vacuum";
+    case PRESSURE_SENSOR_FAULT: return "sensor-fault";
+    case PRESSURE_STALE:        return "stale";
+    case PRESSURE_NO_DATA:
+    default:                    return "no-data";
+  }
+}
+
+PressureMonitor::PressureMonitor(Hal& halInstance, const PressureSensorConfig& sensorConfig)
+  : hal(halInstance), config(sensorConfig) {
+  listener = NULL;
+  listenerArg = NULL;
+  overVacuum = false;
+  decimation = 0;
+  latestPa.store(0);
+  latestState.store(PRESSURE_NO_DATA);
+  latestMs.store(0);
+  readings.store(0);
+  for (uint16_t i = 0; i < TRACE_POINTS; i++) trace[i].store(0);
+  traceEndIndex.store(0);
+}
+
+void PressureMonitor::setListener(Listener listenerFunction, void* arg) {
+  listener = listenerFunction;
+  listenerArg = arg;
+}
+
+bool PressureMonitor::begin() {
+  if (!hal.adcStartContinuous(config.adcPin, SAMPLE_HZ, BLOCK_SAMPLES, onBlock, this)) {
+    LOG_ERROR("[Pressure] Failed to start sampling GPIO %u; the vacuum pump stays locked out", config.adcPin);
+    return false;
+  }
+  LOG_INFO("[Pressure] Sampling GPIO %u at %lu Hz, cutoff %lu Pa", config.adcPin, (unsigned long)SAMPLE_HZ,
+           (unsigned long)config.cutoffPa);
+  return true;
+}
+
+bool PressureMonitor::awaitFirstReading(uint32_t timeoutMs) {
+  uint32_t startMs = hal.nowMs();
+  while (readings.load() == 0) {
+    if (hal.nowMs() - startMs >= timeoutMs) {
+      LOG_ERROR("[Pressure] No reading from the gauge after %lu ms", (unsigned long)timeoutMs);
+      return false;
+    }
+    hal.delayMs(1);
+  }
+  return true;
+}
+
+int32_t PressureMonitor::toPascal(uint32_t millivolts) const {
+  int64_t span = (int64_t)config.zeroMv - config.fullScaleMv;
+  return (int32_t)(((int64_t)config.zeroMv - millivolts) * config.fullScalePa / span);
+}
+
+void PressureMonitor::onBlock(void* arg, uint32_t millivolts) {
+  static_cast<PressureMonitor*>(arg)->onReading(millivolts);
+}
+
+void PressureMonitor::onReading(uint32_t millivolts) {
+  uint32_t low = config.zeroMv < config.fullScaleMv ? config.zeroMv : config.fullScaleMv;
+  uint32_t high = config.zeroMv < config.fullScaleMv ? config.fullScaleMv : config.zeroMv;
+  bool fault = millivolts + FAULT_MARGIN_MV < low || millivolts > high + FAULT_MARGIN_MV;
+
+  int32_t pa = toPascal(millivolts);
+  if (!fault) {
+    if (pa >= (int32_t)config.cutoffPa) {
+      overVacuum = true;
+    } else if (pa < (int32_t)(config.cutoffPa - config.hysteresisPa)) {
+      overVacuum = false;
+    }
+  }
+  PressureState state = fault ? PRESSURE_SENSOR_FAULT : overVacuum ? PRESSURE_OVER_VACUUM : PRESSURE_OK;
+
+  latestPa.store(pa);
+  latestState.store(state);
+  latestMs.store(hal.nowMs());
+  readings.fetch_add(1);
+
+  if (++decimation >= TRACE_DECIMATION) {
+    decimation = 0;
+    uint32_t index = traceEndIndex.load();
+    trace[index % TRACE_POINTS].store(pa);
+    traceEndIndex.store(index + 1);
+  }
+
+  if (listener != NULL) listener(listenerArg, pa, state);
+}
+
+PressureState PressureMonitor::state() const {
+  if (readings.load() == 0) return PRESSURE_NO_DATA;
+  if (hal.nowMs() - latestMs.load() > STALE_MS) return PRESSURE_STALE;
+  return (PressureState)latestState.load();
+}
+
+// The slot of the oldest point is the one the sampling task writes next,
+// so that one never counts as held
+uint32_t PressureMonitor::traceBegin() const {
+  uint32_t end = traceEndIndex.load();
+  return end >= TRACE_POINTS ? end - (TRACE_POINTS - 1) : 0;
+}
+
+bool PressureMonitor::tracePoint(uint32_t index, int32_t& pressurePa) const {
+  if (index >= traceEndIndex.load()) return false;
+  pressurePa = trace[index % TRACE_POINTS].load();
+  // Checked again after the read: a newer point may have taken the slot
+  return traceEndIndex.load() - index < TRACE_POINTS;
+}
@@ -0,0 +1,154 @@
+#include "protocol.h"
+#include <string.h>
+#include "json_reader.h"
+
+static CommandParseError readerError(const JsonReader& reader) {
+  return reader.error() == JSON_ERR_SYNTAX || reader.error() == JSON_ERR_DEPTH
+    ? CMD_ERR_SYNTAX : CMD_ERR_BAD_FIELD;
+}
+
+static bool validName(const char* name, size_t len) {
+  if (len == 0 || len > Protocol::MAX_NAME_LEN) return false;
+  for (size_t i = 0; i < len; i++) {
+    char c = name[i];
+    bool alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    if (!alnum && c != '_' && c != '-') return false;
+  }
+  return true;
+}
+
+static CommandParseError parseStep(JsonReader& reader, ProtocolStep& step) {
+  if (!reader.beginObject()) return readerError(reader);
+
+  CommandTarget target = TARGET_PUMP;
+  const char* actionName = NULL;
+  size_t actionLen = 0;
+  bool hasTarget = false, hasSpeed = false, hasDuration = false, hasAsync = false;
+  uint32_t speed = 0;
+  uint32_t durationMs = 0;
+  bool async = false;
+
+  const char* key;
+  size_t keyLen;
+  while (reader.nextKey(key, keyLen)) {
+    if (JsonReader::equals(key, keyLen, "target")) {
+      if (hasTarget) return CMD_ERR_DUPLICATE_FIELD;
+      const char* value;
+      size_t valueLen;
+      if (!reader.readString(value, valueLen)) return readerError(reader);
+      if (JsonReader::equals(value, valueLen, "pump")) target = TARGET_PUMP;
+      else if (JsonReader::equals(value, valueLen, "vacuum")) target = TARGET_VACUUM;
+      else return CMD_ERR_BAD_FIELD;
+      hasTarget = true;
+    } else if (JsonReader::equals(key, keyLen, "action")) {
+      if (actionName != NULL) return CMD_ERR_DUPLICATE_FIELD;
+      // Resolved once the target is known, which may come later
+      if (!reader.readString(actionName, actionLen)) return readerError(reader);
+    } else if (JsonReader::equals(key, keyLen, "speed")) {
+      if (hasSpeed) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(speed)) return readerError(reader);
+      hasSpeed = true;
+    } else if (JsonReader::equals(key, keyLen, "duration")) {
+      if (hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      uint32_t seconds;
+      if (!reader.readUInt(seconds)) return readerError(reader);
+      if (seconds > Protocol::MAX_STEP_MS / 1000) return CMD_ERR_BAD_FIELD;
+      durationMs = seconds * 1000;
+      hasDuration = true;
+    } else if (JsonReader::equals(key, keyLen, "durationMs")) {
+      if (hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(durationMs)) return readerError(reader);
+      hasDuration = true;
+    } else if (JsonReader::equals(key, keyLen, "async")) {
+      if (hasAsync) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readBool(async)) return readerError(reader);
+      hasAsync = true;
+    } else if (!reader.skipValue()) {
+      return CMD_ERR_SYNTAX;
+    }
+  }
+  if (!reader.ok()) return CMD_ERR_SYNTAX;
+  if (actionName == NULL) return CMD_ERR_MISSING_ACTION;
+  if (durationMs > Protocol::MAX_STEP_MS) return CMD_ERR_BAD_FIELD;
+
+  CommandAction action = JsonReader::equals(actionName, actionLen, "wait")
+    ? ACTION_WAIT : commandActionFromName(target, actionName, actionLen);
+
+  switch (action) {
+    case ACTION_WAIT:
+      if (durationMs == 0) return hasDuration ? CMD_ERR_BAD_FIELD : CMD_ERR_MISSING_FIELD;
+      speed = 0;
+      async = false;
+      break;
+    case ACTION_STOP:
+      if (durationMs != 0) return CMD_ERR_BAD_FIELD;
+      speed = 0;
+      break;
+    case ACTION_FORWARD:
+    case ACTION_REVERSE:
+      if (!hasSpeed) return CMD_ERR_MISSING_FIELD;
+      if (speed < 100 || speed > 1023) return CMD_ERR_BAD_FIELD;
+      break;
+    case ACTION_START:
+      if (!hasSpeed) return CMD_ERR_MISSING_FIELD;
+      if (speed < 10 || speed > 80) return CMD_ERR_BAD_FIELD;  // Vacuum safety limit
+      break;
+    default:
+      return CMD_ERR_UNKNOWN_ACTION;  // Including emergency stops
+  }
+
+  step.target = target;
+  step.action = action;
+  step.async = async;
+  step.speed = (uint16_t)speed;
+  step.durationMs = durationMs;
+  return CMD_OK;
+}
+
+CommandParseError parseProtocol(const char* body, size_t length, Protocol& protocol, int& badStep) {
+  memset(&protocol, 0, sizeof(protocol));
+  badStep = -1;
+
+  JsonReader reader(body, length);
+  if (!reader.beginObject()) return CMD_ERR_SYNTAX;
+
+  bool hasName = false, hasSteps = false;
+  const char* key;
+  size_t keyLen;
+  while (reader.nextKey(key, keyLen)) {
+    if (JsonReader::equals(key, keyLen, "name")) {
+      if (hasName) return CMD_ERR_DUPLICATE_FIELD;
+      const char* value;
+      size_t valueLen;
+      if (!reader.readString(value, valueLen)) return readerError(reader);
+      if (!validName(value, valueLen)) return CMD_ERR_BAD_FIELD;
+      memcpy(protocol.name, value, valueLen);
+      protocol.name[valueLen] = '\0';
+      hasName = true;
+    } else if (JsonReader::equals(key, keyLen, "steps")) {
+      if (hasSteps) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.beginArray()) return readerError(reader);
+      while (reader.nextElement()) {
+        if (protocol.stepCount >= Protocol::MAX_STEPS) {
+          badStep = protocol.stepCount;
+          return CMD_ERR_BAD_FIELD;
+        }
+        CommandParseError error = parseStep(reader, protocol.steps[protocol.stepCount]);
+        if (error != CMD_OK) {
+          badStep = protocol.stepCount;
+          return error;
+        }
+        protocol.stepCount++;
+      }
+      if (!reader.ok()) return CMD_ERR_SYNTAX;
+      if (protocol.stepCount == 0) return CMD_ERR_BAD_FIELD;
+      hasSteps = true;
+    } else if (!reader.skipValue()) {
+      return CMD_ERR_SYNTAX;
+    }
+  }
+  if (!reader.ok() || !reader.atEnd()) return CMD_ERR_SYNTAX;
+
+  if (!hasName && !hasSteps) return CMD_ERR_MISSING_FIELD;
+  return CMD_OK;
+}
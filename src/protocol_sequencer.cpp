@@ -0,0 +1,113 @@
+#include "protocol_sequencer.h"
+#include <string.h>
+#include "logger.h"
+
+ProtocolSequencer::ProtocolSequencer(PumpController& controllerInstance, Hal& halInstance)
+  : controller(controllerInstance), hal(halInstance) {
+  stepTimer = NULL;
+  memset(&protocol, 0, sizeof(protocol));
+  stepIndex = 0;
+  active = false;
+  aborted = false;
+  stepDeadlineUs = 0;
+  publishProgress();
+}
+
+void ProtocolSequencer::begin() {
+  stepTimer = hal.createTimer(onStepTimer, this, "protocol_step");
+}
+
+void ProtocolSequencer::publishProgress() {
+  ProtocolProgress progress;
+  progress.active = active;
+  progress.aborted = aborted;
+  progress.step = stepIndex;
+  progress.stepCount = protocol.stepCount;
+  memcpy(progress.name, protocol.name, sizeof(progress.name));
+  progress.stepDeadlineUs = stepDeadlineUs;
+  published.store(progress);
+}
+
+bool ProtocolSequencer::start(const Protocol& newProtocol) {
+  if (newProtocol.stepCount == 0 || newProtocol.stepCount > Protocol::MAX_STEPS) return false;
+
+  HalLock guard(hal);
+  hal.stopTimer(stepTimer);
+  protocol = newProtocol;
+  stepIndex = 0;
+  active = true;
+  aborted = false;
+  stepDeadlineUs = hal.nowUs();
+  LOG_INFO("[Protocol] Starting %s (%u steps)", protocol.name[0] ? protocol.name : "(inline)", protocol.stepCount);
+  runSteps();
+  return true;
+}
+
+void ProtocolSequencer::stop() {
+  HalLock guard(hal);
+  if (!active) return;
+
+  hal.stopTimer(stepTimer);
+  active = false;
+  aborted = true;
+
+  PumpCommand command = {};
+  command.action = ACTION_STOP;
+  command.source = SOURCE_PROTOCOL;
+  command.target = TARGET_PUMP;
+  controller.execute(command);
+  command.target = TARGET_VACUUM;
+  controller.execute(command);
+
+  LOG_WARN("[Protocol] Aborted at step %u of %u", stepIndex + 1, protocol.stepCount);
+  publishProgress();
+}
+
+void ProtocolSequencer::executeStep(const ProtocolStep& step) {
+  if (step.action == ACTION_WAIT) return;
+
+  PumpCommand command = {};
+  command.target = (CommandTarget)step.target;
+  command.action = (CommandAction)step.action;
+  command.hasSpeed = true;
+  command.speed = step.speed;
+  command.hasDuration = true;
+  command.duration = step.durationMs;
+  command.source = SOURCE_PROTOCOL;
+  controller.execute(command);
+}
+
+// Runs steps from stepIndex until one has to be waited for. Called with the
+// HAL lock held.
+void ProtocolSequencer::runSteps() {
+  while (stepIndex < protocol.stepCount) {
+    const ProtocolStep& step = protocol.steps[stepIndex];
+    LOG_DEBUG("[Protocol] Step %u/%u", stepIndex + 1, protocol.stepCount);
+    executeStep(step);
+
+    if (step.durationMs > 0 && !step.async) {
+      stepDeadlineUs += (uint64_t)step.durationMs * 1000;
+      uint64_t now = hal.nowUs();
+      hal.startTimerOnce(stepTimer, stepDeadlineUs > now ? stepDeadlineUs - now : 1);
+      publishProgress();
+      return;
+    }
+    stepIndex++;
+  }
+
+  active = false;
+  LOG_INFO("[Protocol] Completed %s", protocol.name[0] ? protocol.name : "(inline)");
+  publishProgress();
+}
+
+void ProtocolSequencer::onStepTimer(void* arg) {
+  static_cast<ProtocolSequencer*>(arg)->stepTimerFired();
+}
+
+void ProtocolSequencer::stepTimerFired() {
+  HalLock guard(hal);
+  // Ignore a callback that was already dispatched when the run was replaced
+  if (!active || hal.nowUs() < stepDeadlineUs) return;
+  stepIndex++;
+  runSteps();
+}
@@ -0,0 +1,84 @@
+#include "protocol_store.h"
+#include <stdio.h>
+#include <string.h>
+#include "logger.h"
+
+static const char* INDEX_KEY = "protocols";
+
+static void protocolKey(const char* name, char* key, size_t size) {
+  snprintf(key, size, "p_%s", name);
+}
+
+ProtocolStore::ProtocolStore(Hal& halInstance) : hal(halInstance) {
+  memset(&index, 0, sizeof(index));
+  index.version = STORAGE_VERSION;
+}
+
+void ProtocolStore::begin() {
+  if (!hal.loadBlob(INDEX_KEY, &index, sizeof(index)) ||
+      index.version != STORAGE_VERSION || index.count > MAX_PROTOCOLS) {
+    memset(&index, 0, sizeof(index));
+    index.version = STORAGE_VERSION;
+  }
+  LOG_INFO("[Protocol] %u stored protocols", index.count);
+}
+
+int ProtocolStore::find(const char* name) const {
+  for (uint8_t i = 0; i < index.count; i++) {
+    if (strcmp(index.names[i], name) == 0) return i;
+  }
+  return -1;
+}
+
+bool ProtocolStore::saveIndex() {
+  return hal.saveBlob(INDEX_KEY, &index, sizeof(index));
+}
+
+bool ProtocolStore::save(const Protocol& protocol) {
+  int slot = find(protocol.name);
+  if (slot < 0 && index.count >= MAX_PROTOCOLS) return false;
+
+  Stored stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.version = STORAGE_VERSION;
+  stored.protocol = protocol;
+  char key[16];
+  protocolKey(protocol.name, key, sizeof(key));
+  if (!hal.saveBlob(key, &stored, sizeof(stored))) return false;
+
+  if (slot < 0) {
+    strcpy(index.names[index.count], protocol.name);
+    index.count++;
+    if (!saveIndex()) {
+      index.count--;
+      return false;
+    }
+  }
+  LOG_INFO("[Protocol] Saved %s (%u steps)", protocol.name, protocol.stepCount);
+  return true;
+}
+
+bool ProtocolStore::load(const char* name, Protocol& protocol) {
+  if (find(name) < 0) return false;
+
+  Stored stored;
+  char key[16];
+  protocolKey(name, key, sizeof(key));
+  if (!hal.loadBlob(key, &stored, sizeof(stored)) || stored.version != STORAGE_VERSION ||
+      stored.protocol.stepCount == 0 || stored.protocol.stepCount > Protocol::MAX_STEPS) {
+    LOG_WARN("[Protocol] Stored protocol %s is unreadable", name);
+    return false;
+  }
+  protocol = stored.protocol;
+  return true;
+}
+
+bool ProtocolStore::remove(const char* name) {
+  int slot = find(name);
+  if (slot < 0) return false;
+  // The blob itself is left behind and reused if the name is saved again
+  memmove(index.names[slot], index.names[slot + 1], (index.count - slot - 1) * sizeof(index.names[0]));
+  index.count--;
+  memset(index.names[index.count], 0, sizeof(index.names[0]));
+  return saveIndex();
+}
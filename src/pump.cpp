@@ -1,180 +1,341 @@
 #include "pump.h"
+#include "logger.h"
+#include "metrics.h"
 
-PeristalticPump::PeristalticPump() {
+PeristalticPump::PeristalticPump(Hal& halInstance, Tb6612Driver& driverInstance, const ChannelConfig& channelConfig,
+                                 uint8_t channelId)
+  : hal(halInstance), driver(driverInstance), config(channelConfig), id(channelId) {
   currentState = PUMP_STOPPED;
   currentSpeed = 512;  // 50% of 1023
-  runDuration = 5;
+  runDurationMs = 5000;
   pumpStartTime = 0;
+  stopDeadlineUs = 0;
   isTimedRun = false;
   lastDuty = 0;
+  stopTimer = NULL;
+  stopListener = NULL;
+  stopListenerArg = NULL;
+  rampTimer = NULL;
+  driveDirection = PUMP_STOPPED;
+  pendingDirection = PUMP_STOPPED;
+  pendingDuty = 0;
+  speedLoop.configure(config.encoder);
+  speedTimer = NULL;
+  speedControl = SPEED_OPEN_LOOP;
+  lastPulseCount = 0;
+  lastSpeedTickUs = 0;
+  lastPulseUs = 0;
+}
+
+void PeristalticPump::setStopListener(void (*listener)(void* arg), void* arg) {
+  stopListener = listener;
+  stopListenerArg = arg;
+}
+
+// The level is set before the pin becomes an output, so it never drives
+// high, even for an instant
+void PeristalticPump::makeSafe() {
+  const uint8_t pins[] = { config.in1Pin, config.in2Pin, config.pwmPin };
+  for (uint8_t i = 0; i < sizeof(pins); i++) {
+    hal.writePin(pins[i], false);
+    hal.pinModeOutput(pins[i]);
+  }
 }
 
 void PeristalticPump::begin() {
-  // Initialize GPIO
-  pinMode(PIN_AIN1, OUTPUT);
-  pinMode(PIN_AIN2, OUTPUT);
-  pinMode(PIN_STBY, OUTPUT);
+  // A no-op when setup() has already made the outputs safe
+  makeSafe();
 
   // Initialize PWM
-  uint32_t actualFreq = ledcSetup(PWM_CH, PWM_FREQ, PWM_RES);
-  Serial.print("[Pump] LEDC channel=");
-  Serial.print(PWM_CH);
-  Serial.print(" freq=");
-  Serial.print(PWM_FREQ);
-  Serial.print("Hz (actual=");
-  Serial.print(actualFreq);
-  Serial.print("Hz) res=");
-  Serial.print(PWM_RES);
-  Serial.println("-bit");
-
-  ledcAttachPin(PIN_PWMA, PWM_CH);
-  Serial.print("[Pump] Attached PWM channel ");
-  Serial.print(PWM_CH);
-  Serial.print(" to pin ");
-  Serial.println(PIN_PWMA);
-
-  // Initialize Motor Driver
-  Serial.println("[Pump] Initializing motor driver...");
-  digitalWrite(PIN_STBY, LOW);  // Start with driver disabled
-  digitalWrite(PIN_AIN1, LOW);
-  digitalWrite(PIN_AIN2, LOW);
-  ledcWrite(PWM_CH, 0);  // Set PWM to 0
-  delay(10);
-  digitalWrite(PIN_STBY, HIGH);  // Enable driver
+  uint32_t actualFreq = hal.pwmSetup(config.ledcChannel, config.pwmFreq, config.pwmRes);
+  LOG_DEBUG("[Pump %u] LEDC channel=%u freq=%luHz (actual=%luHz) res=%u-bit", id,
+            config.ledcChannel, (unsigned long)config.pwmFreq, (unsigned long)actualFreq, config.pwmRes);
+
+  hal.pwmAttachPin(config.pwmPin, config.ledcChannel);
+  hal.pwmWrite(config.ledcChannel, 0);
+
+  // The driver leaves standby when a channel first runs
   logPinStates("        ");
+
+  stopTimer = hal.createTimer(onStopTimer, this, "pump_stop");
+  rampTimer = hal.createTimer(onRampTimer, this, "pump_ramp");
+
+  if (config.encoder.pin == NO_ENCODER_PIN) return;
+  if (!hal.counterSetup(config.encoder.pcntUnit, config.encoder.pin)) {
+    LOG_ERROR("[Pump %u] Encoder counter setup failed, running open loop", id);
+    return;
+  }
+  speedControl = SPEED_CLOSED_LOOP;
+  lastPulseCount = hal.counterRead(config.encoder.pcntUnit);
+  lastSpeedTickUs = hal.nowUs();
+  speedTimer = hal.createTimer(onSpeedTimer, this, "pump_speed");
+  hal.startTimerPeriodic(speedTimer, SPEED_TICK_US);
+  LOG_INFO("[Pump %u] Encoder on GPIO %u, %u pulses/rev, %u rpm full scale", id, config.encoder.pin,
+           config.encoder.pulsesPerRev, config.encoder.maxRpm);
+}
+
+void PeristalticPump::setRampConfig(const RampConfig& config) {
+  HalLock guard(hal);
+  // Finish any ramp in flight at its target before the profile changes
+  if (ramp.active()) {
+    uint32_t target = ramp.target();
+    ramp.start(target, target, maxDuty(), RAMP_TICK_US);
+    rampTick();
+  }
+  ramp.configure(config);
+  LOG_INFO("[Pump %u] Ramp %s, %u ms full scale", id,
+           config.shape == RAMP_SCURVE ? "s-curve" : (config.shape == RAMP_LINEAR ? "linear" : "off"),
+           config.rampMs);
 }
 
 void PeristalticPump::logPinStates(const char* prefix) {
-  int ain1 = digitalRead(PIN_AIN1);
-  int ain2 = digitalRead(PIN_AIN2);
-  int stby = digitalRead(PIN_STBY);
-
-  Serial.print(prefix);
-  Serial.print(" AIN1=");
-  Serial.print(ain1);
-  Serial.print(" AIN2=");
-  Serial.print(ain2);
-  Serial.print(" STBY=");
-  Serial.print(stby);
-  Serial.print(" PWM(duty)=");
-  Serial.print(lastDuty);
-  Serial.print("/");
-  Serial.print((1 << PWM_RES) - 1);
-  Serial.print(" (");
-  Serial.print((lastDuty * 100) / ((1 << PWM_RES) - 1));
-  Serial.println("%)");
+  uint32_t maxDuty = (1 << config.pwmRes) - 1;
+  LOG_DEBUG("%s AIN1=%d AIN2=%d STBY=%d PWM(duty)=%lu/%lu (%lu%%)",
+            prefix, hal.readPin(config.in1Pin), hal.readPin(config.in2Pin), hal.readPin(driver.getStbyPin()),
+            (unsigned long)lastDuty, (unsigned long)maxDuty, (unsigned long)((lastDuty * 100) / maxDuty));
 }
 
 void PeristalticPump::motorCoast() {
-  digitalWrite(PIN_AIN1, LOW);
-  digitalWrite(PIN_AIN2, LOW);
-  ledcWrite(PWM_CH, 0);
-  lastDuty = 0;
+  hal.stopTimer(rampTimer);
+  pendingDirection = PUMP_STOPPED;
+  driveDirection = PUMP_STOPPED;
+  // Inputs first: both low is off whatever the PWM is doing
+  Tb6612Driver::setInputs(hal, config, false, false);
+  if (speedControl == SPEED_ENCODER_FAULT) speedControl = SPEED_CLOSED_LOOP;  // Try again next run
+  applyDuty(0);
+  driver.release(driverChannel());  // Standby only if the other channel is idle too
 
-  Serial.println("[Motor] Coast (freewheel)");
+  LOG_DEBUG("[Motor %u] Coast (freewheel)", id);
   logPinStates("        ");
 }
 
 void PeristalticPump::motorBrake() {
-  digitalWrite(PIN_AIN1, HIGH);
-  digitalWrite(PIN_AIN2, HIGH);
-  ledcWrite(PWM_CH, 0);
-  lastDuty = 0;
+  driver.acquire(driverChannel());  // Braking needs the bridge powered
+  applyDuty(0);
+  Tb6612Driver::setInputs(hal, config, true, true);
+  driveDirection = PUMP_STOPPED;
 
-  Serial.println("[Motor] Brake (short brake)");
+  LOG_DEBUG("[Motor %u] Brake (short brake)", id);
   logPinStates("        ");
 }
 
+// STBY, then the inputs, then the duty. A reversal drops the duty to zero
+// before the inputs change, so the new direction never sees the old duty.
+void PeristalticPump::motorDrive(PumpState direction, uint16_t speed) {
+  driver.acquire(driverChannel());
+  if (driveDirection != direction) {
+    if (lastDuty > 0) applyDuty(0);
+    Tb6612Driver::setInputs(hal, config, direction == PUMP_FORWARD, direction == PUMP_REVERSE);
+  }
+  applyDuty(speed);
+  driveDirection = direction;
+}
+
 void PeristalticPump::motorForward(uint16_t speed) {
-  digitalWrite(PIN_STBY, HIGH);  // Enable driver
-  digitalWrite(PIN_AIN1, HIGH);
-  digitalWrite(PIN_AIN2, LOW);
-  ledcWrite(PWM_CH, speed);
-  lastDuty = speed;
-
-  Serial.print("[Motor] Forward | speed=");
-  Serial.print(speed);
-  Serial.print(" (");
-  Serial.print((speed * 100) / ((1 << PWM_RES) - 1));
-  Serial.println("%)");
+  motorDrive(PUMP_FORWARD, speed);
+
+  LOG_DEBUG("[Motor %u] Forward | speed=%u (%lu%%)", id, speed, (unsigned long)((speed * 100) / ((1 << config.pwmRes) - 1)));
   logPinStates("        ");
 }
 
 void PeristalticPump::motorReverse(uint16_t speed) {
-  digitalWrite(PIN_STBY, HIGH);  // Enable driver
-  digitalWrite(PIN_AIN1, LOW);
-  digitalWrite(PIN_AIN2, HIGH);
-  ledcWrite(PWM_CH, speed);
-  lastDuty = speed;
-
-  Serial.print("[Motor] Reverse | speed=");
-  Serial.print(speed);
-  Serial.print(" (");
-  Serial.print((speed * 100) / ((1 << PWM_RES) - 1));
-  Serial.println("%)");
+  motorDrive(PUMP_REVERSE, speed);
+
+  LOG_DEBUG("[Motor %u] Reverse | speed=%u (%lu%%)", id, speed, (unsigned long)((speed * 100) / ((1 << config.pwmRes) - 1)));
   logPinStates("        ");
 }
 
-void PeristalticPump::controlPump(PumpState state, uint16_t speed, uint32_t duration) {
-  Serial.println("[Pump] controlPump called - State: " + String(state) + ", Speed: " + String(speed) + ", Duration: " + String(duration));
-  
+// lastDuty is the duty asked for; closed loop writes it with the trim
+void PeristalticPump::applyDuty(uint32_t duty) {
+  lastDuty = duty;
+  if (speedControl != SPEED_CLOSED_LOOP) {
+    hal.pwmWrite(config.ledcChannel, duty);
+    return;
+  }
+  if (duty == 0) speedLoop.reset();
+  hal.pwmWrite(config.ledcChannel, speedLoop.output(duty, maxDuty()));
+}
+
+void PeristalticPump::onSpeedTimer(void* arg) {
+  static_cast<PeristalticPump*>(arg)->speedTick();
+}
+
+void PeristalticPump::speedTick() {
+  HalLock guard(hal);
+  uint64_t now = hal.nowUs();
+  uint32_t intervalUs = (uint32_t)(now - lastSpeedTickUs);
+  lastSpeedTickUs = now;
+  metrics.speedLoopJitter.observe(intervalUs > SPEED_TICK_US ? intervalUs - SPEED_TICK_US : SPEED_TICK_US - intervalUs);
+
+  uint32_t count = hal.counterRead(config.encoder.pcntUnit);
+  uint32_t pulses = count - lastPulseCount;
+  lastPulseCount = count;
+  speedLoop.measure(pulses, intervalUs);
+
+  bool driving = driveDirection != PUMP_STOPPED && lastDuty > 0;
+  if (pulses > 0 || !driving) lastPulseUs = now;
+  if (speedControl != SPEED_CLOSED_LOOP || !driving) return;
+
+  if (now - lastPulseUs > ENCODER_TIMEOUT_US) {
+    // A loose encoder would otherwise wind the motor up to full duty
+    speedControl = SPEED_ENCODER_FAULT;
+    speedLoop.reset();
+    LOG_ERROR("[Pump %u] No encoder pulses for %lu ms at duty %lu, open loop until stopped", id,
+              (unsigned long)((now - lastPulseUs) / 1000), (unsigned long)lastDuty);
+  } else {
+    speedLoop.update(speedLoop.setpointRpm(lastDuty, maxDuty()), (float)lastDuty / maxDuty(), intervalUs);
+  }
+  applyDuty(lastDuty);
+  metrics.speedLoopRun.observe((uint32_t)(hal.nowUs() - now));
+}
+
+void PeristalticPump::setDirection(PumpState direction) {
+  driver.acquire(driverChannel());
+  if (lastDuty > 0) applyDuty(0);
+  Tb6612Driver::setInputs(hal, config, direction == PUMP_FORWARD, direction == PUMP_REVERSE);
+  driveDirection = direction;
+  LOG_DEBUG("[Motor %u] Direction %s", id, direction == PUMP_FORWARD ? "forward" : "reverse");
+}
+
+void PeristalticPump::rampTo(uint16_t duty) {
+  ramp.start(lastDuty, duty, maxDuty(), RAMP_TICK_US);
+  if (ramp.active()) {
+    hal.startTimerPeriodic(rampTimer, RAMP_TICK_US);
+  } else {
+    hal.stopTimer(rampTimer);
+    applyDuty(duty);
+  }
+}
+
+// Moves the motor to a new state and duty, ramping when a profile is set
+void PeristalticPump::driveTo(PumpState state, uint16_t duty) {
+  if (!ramp.enabled()) {
+    if (state == PUMP_FORWARD) motorForward(duty);
+    else if (state == PUMP_REVERSE) motorReverse(duty);
+    else motorCoast();
+    return;
+  }
+
+  pendingDirection = PUMP_STOPPED;
+  if (state == PUMP_STOPPED) {
+    if (lastDuty == 0) motorCoast();
+    else rampTo(0);  // rampTick() coasts once the duty reaches zero
+  } else if (driveDirection == state || lastDuty == 0) {
+    if (driveDirection != state) setDirection(state);
+    rampTo(duty);
+  } else {
+    // Reversal: bring the rotor to rest on the current direction first
+    pendingDirection = state;
+    pendingDuty = duty;
+    rampTo(0);
+  }
+  LOG_DEBUG("[Motor %u] Ramping to duty %u", id, duty);
+}
+
+void PeristalticPump::onRampTimer(void* arg) {
+  static_cast<PeristalticPump*>(arg)->rampTick();
+}
+
+void PeristalticPump::rampTick() {
+  HalLock guard(hal);
+  applyDuty(ramp.next());
+  if (ramp.active()) return;
+
+  hal.stopTimer(rampTimer);
+  if (pendingDirection != PUMP_STOPPED) {
+    setDirection(pendingDirection);
+    pendingDirection = PUMP_STOPPED;
+    rampTo(pendingDuty);
+  } else if (currentState == PUMP_STOPPED && lastDuty == 0) {
+    motorCoast();
+  }
+}
+
+void PeristalticPump::startTimedRun(uint32_t durationMs) {
+  if (durationMs > 0) {
+    isTimedRun = true;
+    pumpStartTime = hal.nowMs();
+    stopDeadlineUs = hal.nowUs() + (uint64_t)durationMs * 1000;
+    hal.startTimerOnce(stopTimer, (uint64_t)durationMs * 1000);
+    LOG_INFO("[Pump %u] Timed run started for %lu ms", id, (unsigned long)durationMs);
+  } else {
+    isTimedRun = false;
+    LOG_INFO("[Pump %u] Continuous run started", id);
+  }
+}
+
+void PeristalticPump::controlPump(PumpState state, uint16_t speed, uint32_t durationMs) {
+  HalLock guard(hal);
+  LOG_DEBUG("[Pump %u] controlPump called - State: %d, Speed: %u, Duration: %lu ms", id,
+            state, speed, (unsigned long)durationMs);
+
+  // Any new command supersedes a pending timed stop
+  hal.stopTimer(stopTimer);
   currentState = state;
-  currentSpeed = speed;
-  runDuration = duration;
-  
+  // A stop keeps the speed, which the next start without one reuses
+  if (state != PUMP_STOPPED) currentSpeed = speed;
+  runDurationMs = durationMs;
+
   switch (state) {
     case PUMP_STOPPED:
-      Serial.println("[Pump] Executing STOP");
-      motorCoast();
+      LOG_INFO("[Pump %u] Executing STOP", id);
+      driveTo(PUMP_STOPPED, 0);
       isTimedRun = false;
       break;
     case PUMP_FORWARD:
-      Serial.println("[Pump] Executing FORWARD");
-      motorForward(speed);
-      if (duration > 0) {
-        isTimedRun = true;
-        pumpStartTime = millis();
-        Serial.println("[Pump] Timed run started for " + String(duration) + " seconds");
-      } else {
-        isTimedRun = false;
-        Serial.println("[Pump] Continuous run started");
-      }
+      LOG_INFO("[Pump %u] Executing FORWARD", id);
+      driveTo(PUMP_FORWARD, speed);
+      startTimedRun(durationMs);
       break;
     case PUMP_REVERSE:
-      Serial.println("[Pump] Executing REVERSE");
-      motorReverse(speed);
-      if (duration > 0) {
-        isTimedRun = true;
-        pumpStartTime = millis();
-        Serial.println("[Pump] Timed run started for " + String(duration) + " seconds");
-      } else {
-        isTimedRun = false;
-        Serial.println("[Pump] Continuous run started");
-      }
+      LOG_INFO("[Pump %u] Executing REVERSE", id);
+      driveTo(PUMP_REVERSE, speed);
+      startTimedRun(durationMs);
       break;
   }
-  
-  Serial.println("[Pump] controlPump completed");
+
+  LOG_DEBUG("[Pump %u] controlPump completed", id);
+}
+
+void PeristalticPump::onStopTimer(void* arg) {
+  static_cast<PeristalticPump*>(arg)->timedStop();
+}
+
+void PeristalticPump::timedStop() {
+  HalLock guard(hal);
+  if (!isTimedRun || currentState == PUMP_STOPPED) return;
+
+  // A callback that was already dispatched when a newer run re-armed the
+  // timer sees the new, later deadline and leaves that run alone
+  uint64_t now = hal.nowUs();
+  if (now < stopDeadlineUs) return;
+
+  currentState = PUMP_STOPPED;
+  driveTo(PUMP_STOPPED, 0);
+  isTimedRun = false;
+  metrics.timedStopError.observe((uint32_t)(now - stopDeadlineUs));
+  LOG_INFO("[Pump %u] Timed run completed (%lu us after deadline). Pump stopped.", id,
+           (unsigned long)(now - stopDeadlineUs));
+
+  if (stopListener != NULL) stopListener(stopListenerArg);
 }
 
 void PeristalticPump::update() {
-  // Check if timed run should stop
-  if (isTimedRun && currentState != PUMP_STOPPED) {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = (currentTime - pumpStartTime) / 1000; // Convert to seconds
-    
-    if (elapsedTime >= runDuration) {
-      Serial.println("[Pump] Timed run completed. Stopping pump.");
-      controlPump(PUMP_STOPPED, currentSpeed, 0);
-    }
+  if (isTimedRun && currentState != PUMP_STOPPED && hal.nowUs() >= stopDeadlineUs + TIMER_GRACE_US) {
+    LOG_WARN("[Pump %u] Stop timer late, stopping from update()", id);
+    timedStop();
   }
 }
 
-uint32_t PeristalticPump::getRemainingTime() const {
+uint16_t PeristalticPump::getMeasuredRpm() const {
+  if (config.encoder.pin == NO_ENCODER_PIN) return 0;
+  return (uint16_t)(speedLoop.measuredRpm() + 0.5f);
+}
+
+uint32_t PeristalticPump::getRemainingTimeMs() const {
   if (isTimedRun && currentState != PUMP_STOPPED) {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = (currentTime - pumpStartTime) / 1000;
-    return (runDuration > elapsedTime) ? (runDuration - elapsedTime) : 0;
+    uint64_t now = hal.nowUs();
+    return (stopDeadlineUs > now) ? (uint32_t)((stopDeadlineUs - now + 999) / 1000) : 0;
   }
   return 0;
 }
@@ -0,0 +1,217 @@
+#include "pump_command.h"
+#include "json_reader.h"
+
+CommandAction commandActionFromName(CommandTarget target, const char* name, size_t len) {
+  if (JsonReader::equals(name, len, "stop")) return ACTION_STOP;
+  if (target == TARGET_PUMP) {
+    if (JsonReader::equals(name, len, "forward")) return ACTION_FORWARD;
+    if (JsonReader::equals(name, len, "reverse")) return ACTION_REVERSE;
+  } else if (target == TARGET_VACUUM) {
+    if (JsonReader::equals(name, len, "start")) return ACTION_START;
+    if (JsonReader::equals(name, len, "emergency")) return ACTION_EMERGENCY;
+  } else {
+    if (JsonReader::equals(name, len, "run")) return ACTION_CAL_RUN;
+    if (JsonReader::equals(name, len, "record")) return ACTION_CAL_RECORD;
+    if (JsonReader::equals(name, len, "clear")) return ACTION_CAL_CLEAR;
+  }
+  return ACTION_NONE;
+}
+
+static CommandParseError readerError(const JsonReader& reader) {
+  return reader.error() == JSON_ERR_SYNTAX || reader.error() == JSON_ERR_DEPTH
+    ? CMD_ERR_SYNTAX : CMD_ERR_BAD_FIELD;
+}
+
+// Reads one command object. With targetField set, the object may name its
+// motor in "target" ("pump" or "vacuum"); otherwise that key is ignored like
+// any other unknown field.
+static CommandParseError readCommandObject(JsonReader& reader, CommandTarget target, bool targetField,
+                                           PumpCommand& command) {
+  command.target = target;
+  command.channel = 0;
+  command.action = ACTION_NONE;
+  command.hasSpeed = false;
+  command.speed = 0;
+  command.hasDuration = false;
+  command.duration = 0;
+  command.hasVolume = false;
+  command.volume = 0;
+  command.hasFlowRate = false;
+  command.flowRate = 0;
+  command.hasPressure = false;
+  command.pressure = 0;
+  command.source = SOURCE_UNKNOWN;
+
+  if (!reader.beginObject()) return CMD_ERR_SYNTAX;
+
+  bool hasAction = false, hasTarget = false, hasChannel = false;
+  const char* actionName = NULL;
+  size_t actionLen = 0;
+  const char* key;
+  size_t keyLen;
+  while (reader.nextKey(key, keyLen)) {
+    if (JsonReader::equals(key, keyLen, "action")) {
+      if (hasAction) return CMD_ERR_DUPLICATE_FIELD;
+      // Resolved once the target is known, which may come later
+      if (!reader.readString(actionName, actionLen)) return readerError(reader);
+      hasAction = true;
+    } else if (targetField && JsonReader::equals(key, keyLen, "target")) {
+      if (hasTarget) return CMD_ERR_DUPLICATE_FIELD;
+      const char* value;
+      size_t valueLen;
+      if (!reader.readString(value, valueLen)) return readerError(reader);
+      if (JsonReader::equals(value, valueLen, "pump")) command.target = TARGET_PUMP;
+      else if (JsonReader::equals(value, valueLen, "vacuum")) command.target = TARGET_VACUUM;
+      else return CMD_ERR_BAD_FIELD;
+      hasTarget = true;
+    } else if (targetField && JsonReader::equals(key, keyLen, "channel")) {
+      if (hasChannel) return CMD_ERR_DUPLICATE_FIELD;
+      uint32_t channel;
+      if (!reader.readUInt(channel)) return readerError(reader);
+      if (channel > UINT8_MAX) return CMD_ERR_BAD_FIELD;
+      command.channel = (uint8_t)channel;
+      hasChannel = true;
+    } else if (JsonReader::equals(key, keyLen, "speed")) {
+      if (command.hasSpeed) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(command.speed)) return readerError(reader);
+      command.hasSpeed = true;
+    } else if (JsonReader::equals(key, keyLen, "duration")) {
+      if (command.hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      uint32_t seconds;
+      if (!reader.readUInt(seconds)) return readerError(reader);
+      if (seconds > UINT32_MAX / 1000) return CMD_ERR_BAD_FIELD;
+      command.duration = seconds * 1000;
+      command.hasDuration = true;
+    } else if (JsonReader::equals(key, keyLen, "durationMs")) {
+      if (command.hasDuration) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(command.duration)) return readerError(reader);
+      command.hasDuration = true;
+    } else if (JsonReader::equals(key, keyLen, "volume")) {
+      if (command.hasVolume) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(command.volume)) return readerError(reader);
+      command.hasVolume = true;
+    } else if (JsonReader::equals(key, keyLen, "flowRate")) {
+      if (command.hasFlowRate) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(command.flowRate)) return readerError(reader);
+      command.hasFlowRate = true;
+    } else if (JsonReader::equals(key, keyLen, "targetPa")) {
+      if (command.hasPressure) return CMD_ERR_DUPLICATE_FIELD;
+      if (!reader.readUInt(command.pressure)) return readerError(reader);
+      command.hasPressure = true;
+    } else if (!reader.skipValue()) {
+      return CMD_ERR_SYNTAX;
+    }
+  }
+  if (!reader.ok()) return CMD_ERR_SYNTAX;
+
+  if (!hasAction) return CMD_ERR_MISSING_ACTION;
+  command.action = commandActionFromName(command.target, actionName, actionLen);
+  if (command.action == ACTION_NONE) return CMD_ERR_UNKNOWN_ACTION;
+  if (hasChannel && command.target != TARGET_PUMP) return CMD_ERR_BAD_FIELD;  // The vacuum pump has none
+  if (command.hasPressure && command.target != TARGET_VACUUM) return CMD_ERR_BAD_FIELD;  // Nor do the pumps a gauge
+  // The volume collected is divided by the run's length, so that can't be
+  // left to a default that resolve() would fill in
+  if (command.action == ACTION_CAL_RUN && !command.hasDuration) return CMD_ERR_MISSING_FIELD;
+  return CMD_OK;
+}
+
+CommandParseError parsePumpCommand(const char* body, size_t length, CommandTarget target, PumpCommand& command) {
+  JsonReader reader(body, length);
+  CommandParseError error = readCommandObject(reader, target, false, command);
+  if (error != CMD_OK) return error;
+  return reader.atEnd() ? CMD_OK : CMD_ERR_SYNTAX;
+}
+
+CommandParseError parseCommandBatch(const char* body, size_t length, CommandBatch& batch, int& badCommand) {
+  batch.count = 0;
+  badCommand = -1;
+
+  JsonReader reader(body, length);
+  if (!reader.beginArray()) return CMD_ERR_SYNTAX;
+  while (reader.nextElement()) {
+    if (batch.count >= CommandBatch::MAX_COMMANDS) {
+      badCommand = batch.count;
+      return CMD_ERR_BAD_FIELD;
+    }
+    CommandParseError error = readCommandObject(reader, TARGET_PUMP, true, batch.commands[batch.count]);
+    if (error != CMD_OK) {
+      badCommand = batch.count;
+      return error;
+    }
+    batch.count++;
+  }
+  if (!reader.ok() || !reader.atEnd()) return CMD_ERR_SYNTAX;
+  if (batch.count == 0) return CMD_ERR_MISSING_FIELD;
+  return CMD_OK;
+}
+
+CommandParseError parseRampConfig(const char* body, size_t length, RampConfig& config) {
+  JsonReader reader(body, length);
+  if (!reader.beginObject()) return CMD_ERR_SYNTAX;
+
+  bool hasShape = false;
+  bool hasRampMs = false;
+  const char* key;
+  size_t keyLen;
+  while (reader.nextKey(key, keyLen)) {
+    if (JsonReader::equals(key, keyLen, "shape")) {
+      if (hasShape) return CMD_ERR_DUPLICATE_FIELD;
+      const char* value;
+      size_t valueLen;
+      if (!reader.readString(value, valueLen)) return readerError(reader);
+      if (JsonReader::equals(value, valueLen, "off")) config.shape = RAMP_OFF;
+      else if (JsonReader::equals(value, valueLen, "linear")) config.shape = RAMP_LINEAR;
+      else if (JsonReader::equals(value, valueLen, "scurve")) config.shape = RAMP_SCURVE;
+      else return CMD_ERR_BAD_FIELD;
+      hasShape = true;
+    } else if (JsonReader::equals(key, keyLen, "rampMs")) {
+      if (hasRampMs) return CMD_ERR_DUPLICATE_FIELD;
+      uint32_t rampMs;
+      if (!reader.readUInt(rampMs)) return readerError(reader);
+      if (rampMs > UINT16_MAX) return CMD_ERR_BAD_FIELD;
+      config.rampMs = (uint16_t)rampMs;
+      hasRampMs = true;
+    } else if (!reader.skipValue()) {
+      return CMD_ERR_SYNTAX;
+    }
+  }
+  if (!reader.ok() || !reader.atEnd()) return CMD_ERR_SYNTAX;
+  return CMD_OK;
+}
+
+const char* rampShapeName(RampShape shape) {
+  switch (shape) {
+    case RAMP_LINEAR: return "linear";
+    case RAMP_SCURVE: return "scurve";
+    case RAMP_OFF:
+    default:          return "off";
+  }
+}
+
+const char* commandSourceName(CommandSource source) {
+  switch (source) {
+    case SOURCE_WEB:       return "web";
+    case SOURCE_UDP:       return "udp";
+    case SOURCE_PROTOCOL:  return "protocol";
+    case SOURCE_TIMER:     return "timer";
+    case SOURCE_SYSTEM:    return "system";
+    case SOURCE_SERIAL:    return "serial";
+    case SOURCE_BUTTON:    return "button";
+    case SOURCE_INTERLOCK: return "interlock";
+    case SOURCE_UNKNOWN:
+    default:               return "unknown";
+  }
+}
+
+const char* commandParseErrorMessage(CommandParseError error) {
+  switch (error) {
+    case CMD_OK:                  return "OK";
+    case CMD_ERR_SYNTAX:          return "Malformed JSON";
+    case CMD_ERR_MISSING_ACTION:  return "Missing action";
+    case CMD_ERR_UNKNOWN_ACTION:  return "Invalid operation";
+    case CMD_ERR_BAD_FIELD:       return "Invalid field value";
+    case CMD_ERR_DUPLICATE_FIELD: return "Duplicate field";
+    case CMD_ERR_MISSING_FIELD:   return "Missing required field";
+  }
+  return "Unknown error";
+}
@@ -0,0 +1,220 @@
+#include "pump_controller.h"
+#include "flow_calibration.h"
+#include "event_log.h"
+#include "logger.h"
+
+uint32_t remainingMs(bool timedRun, uint64_t stopDeadlineUs, uint64_t nowUs) {
+  if (!timedRun || stopDeadlineUs <= nowUs) return 0;
+  return (uint32_t)((stopDeadlineUs - nowUs + 999) / 1000);
+}
+
+const char* pumpStateName(PumpState state) {
+  switch (state) {
+    case PUMP_FORWARD: return "forward";
+    case PUMP_REVERSE: return "reverse";
+    case PUMP_STOPPED:
+    default:           return "stopped";
+  }
+}
+
+const char* vacuumStateName(VacuumPumpState state) {
+  switch (state) {
+    case VACUUM_RUNNING:    return "running";
+    case VACUUM_REGULATING: return "regulating";
+    case VACUUM_STOPPED:
+    default:                return "stopped";
+  }
+}
+
+const char* speedControlName(SpeedControl control) {
+  switch (control) {
+    case SPEED_CLOSED_LOOP:   return "closed";
+    case SPEED_ENCODER_FAULT: return "fault";
+    case SPEED_OPEN_LOOP:
+    default:                  return "open";
+  }
+}
+
+uint32_t doseDeliveredUl(const PumpStatus& status, uint64_t nowUs) {
+  if (!status.doseActive) return status.doseDeliveredUl;
+  uint32_t left = remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, nowUs);
+  uint32_t elapsedMs = status.pumpRunDurationMs > left ? status.pumpRunDurationMs - left : 0;
+  return volumeDelivered(status.doseFlowRate, elapsedMs);
+}
+
+PumpController::PumpController(PumpManager& pumpsInstance, VacuumPump& vacuumPumpInstance, Hal& halInstance)
+  : pumps(pumpsInstance), pump(pumpsInstance.channel(0)), vacuumPump(vacuumPumpInstance), hal(halInstance) {
+  doseActive = false;
+  doseTargetUl = 0;
+  doseFlowRate = 0;
+  doseDeliveredUl = 0;
+  eventLog = NULL;
+  commandListener = NULL;
+  commandListenerArg = NULL;
+  for (uint8_t i = 0; i < PumpManager::CHANNEL_COUNT; i++) loggedPumpStates[i] = PUMP_STOPPED;
+  loggedVacuumState = VACUUM_STOPPED;
+  pumps.setStopListener(onPumpStopped, this);
+  vacuumPump.setStopListener(onPumpStopped, this);
+  publishStatus();
+}
+
+void PumpController::onPumpStopped(void* arg) {
+  // Runs in the stop timer's context; the lock keeps this publisher and the
+  // control task from writing the snapshot at the same time
+  static_cast<PumpController*>(arg)->publishStatus();
+}
+
+void PumpController::finishDose() {
+  uint32_t elapsedMs = pump.getRunDurationMs() - pump.getRemainingTimeMs();
+  doseDeliveredUl = volumeDelivered(doseFlowRate, elapsedMs);
+  doseActive = false;
+  LOG_INFO("[Dose] Delivered %lu of %lu uL", (unsigned long)doseDeliveredUl, (unsigned long)doseTargetUl);
+}
+
+void PumpController::logPump(PeristalticPump& channel, CommandSource source) {
+  PumpState state = channel.getCurrentState();
+  loggedPumpStates[channel.getId()] = state;
+  if (eventLog == NULL) return;
+  bool running = state != PUMP_STOPPED;
+  eventLog->record(EVENT_PUMP, source, (uint8_t)state, running ? channel.getCurrentSpeed() : 0,
+                   running && channel.getIsTimedRun() ? channel.getRunDurationMs() : 0, channel.getId());
+}
+
+void PumpController::logVacuum(CommandSource source) {
+  loggedVacuumState = vacuumPump.getCurrentState();
+  if (eventLog == NULL) return;
+  bool running = loggedVacuumState != VACUUM_STOPPED;
+  uint16_t duty = loggedVacuumState == VACUUM_REGULATING ? (uint16_t)(vacuumPump.getTargetPa() / 1000)
+                : running ? vacuumPump.getCurrentSpeed() : 0;
+  eventLog->record(EVENT_VACUUM, source, (uint8_t)loggedVacuumState, duty,
+                   running && vacuumPump.getIsTimedRun() ? vacuumPump.getRunDurationMs() : 0);
+}
+
+void PumpController::publishStatus() {
+  HalLock guard(hal);
+  // A dose ends when its timed run does, whatever stopped it
+  if (doseActive && !(pump.getIsTimedRun() && pump.getCurrentState() != PUMP_STOPPED)) finishDose();
+
+  PumpStatus status;
+  for (uint8_t i = 0; i < PumpManager::CHANNEL_COUNT; i++) {
+    PeristalticPump& channel = pumps.channel(i);
+    // Commands are logged by execute(), so a change seen here ended by itself
+    if (channel.getCurrentState() != loggedPumpStates[i]) logPump(channel, SOURCE_TIMER);
+
+    ChannelStatus& out = status.channels[i];
+    out.state = channel.getCurrentState();
+    out.speed = channel.getCurrentSpeed();
+    out.timedRun = channel.getIsTimedRun() && channel.getCurrentState() != PUMP_STOPPED;
+    out.runDurationMs = channel.getRunDurationMs();
+    out.stopDeadlineUs = channel.getStopDeadlineUs();
+    out.ramp = channel.getRampConfig();
+    out.speedControl = channel.getSpeedControl();
+    out.rpm = channel.getMeasuredRpm();
+  }
+  if (vacuumPump.getCurrentState() != loggedVacuumState) {
+    logVacuum(vacuumPump.getLastTrip() != PRESSURE_OK ? SOURCE_INTERLOCK : SOURCE_TIMER);
+  }
+
+  const ChannelStatus& first = status.channels[0];
+  status.pumpState = first.state;
+  status.pumpSpeed = first.speed;
+  status.pumpTimedRun = first.timedRun;
+  status.pumpRunDurationMs = first.runDurationMs;
+  status.pumpStopDeadlineUs = first.stopDeadlineUs;
+  status.pumpRamp = first.ramp;
+
+  status.vacuumState = vacuumPump.getCurrentState();
+  status.vacuumSpeed = vacuumPump.getCurrentSpeed();
+  status.vacuumTimedRun = vacuumPump.getIsTimedRun() && vacuumPump.getCurrentState() != VACUUM_STOPPED;
+  status.vacuumRunDurationMs = vacuumPump.getRunDurationMs();
+  status.vacuumStopDeadlineUs = vacuumPump.getStopDeadlineUs();
+  status.vacuumTargetPa = vacuumPump.getTargetPa();
+  status.vacuumPressurePa = vacuumPump.getPressurePa();
+  status.vacuumInterlock = vacuumPump.getPressureState();
+  status.vacuumLastTrip = vacuumPump.getLastTrip();
+
+  status.doseActive = doseActive;
+  status.doseTargetUl = doseTargetUl;
+  status.doseFlowRate = doseFlowRate;
+  status.doseDeliveredUl = doseDeliveredUl;
+
+  published.store(status);
+}
+
+void PumpController::execute(const PumpCommand& command) {
+  HalLock guard(hal);
+  if (command.target == TARGET_PUMP) {
+    if (!PumpManager::valid(command.channel)) {
+      LOG_WARN("[Control] Ignoring command for pump channel %u", command.channel);
+      return;
+    }
+    PeristalticPump& channel = pumps.channel(command.channel);
+    // Any motion command on the dosing channel ends the dose in progress
+    if (doseActive && command.channel == 0 && command.action != ACTION_SET_RAMP) finishDose();
+    bool dose = command.channel == 0 && command.hasVolume && command.hasFlowRate && command.flowRate > 0;
+
+    switch (command.action) {
+      case ACTION_FORWARD:
+        channel.controlPump(PUMP_FORWARD, command.speed, command.duration);
+        break;
+      case ACTION_REVERSE:
+        channel.controlPump(PUMP_REVERSE, command.speed, command.duration);
+        break;
+      case ACTION_STOP:
+        channel.controlPump(PUMP_STOPPED, command.speed, 0);
+        break;
+      case ACTION_SET_RAMP:
+        channel.setRampConfig(command.ramp);
+        break;
+      default:
+        LOG_WARN("[Control] Ignoring invalid pump action %d", command.action);
+        return;
+    }
+    if (command.action != ACTION_SET_RAMP) logPump(channel, command.source);
+
+    if (dose && command.action != ACTION_STOP && command.duration > 0) {
+      doseActive = true;
+      doseTargetUl = command.volume;
+      doseFlowRate = command.flowRate;
+      doseDeliveredUl = 0;
+      LOG_INFO("[Dose] %lu uL at %lu uL/min (duty %lu, %lu ms)", (unsigned long)command.volume,
+               (unsigned long)command.flowRate, (unsigned long)command.speed, (unsigned long)command.duration);
+    }
+  } else {
+    switch (command.action) {
+      case ACTION_START:
+        if (command.hasPressure) {
+          vacuumPump.regulateVacuum(command.pressure, command.duration);
+        } else {
+          vacuumPump.controlVacuumPump(VACUUM_RUNNING, command.speed, command.duration);
+        }
+        break;
+      case ACTION_STOP:
+        vacuumPump.controlVacuumPump(VACUUM_STOPPED, command.speed, 0);
+        break;
+      case ACTION_EMERGENCY:
+        vacuumPump.emergencyStop();
+        if (eventLog != NULL) eventLog->record(EVENT_EMERGENCY, command.source, 0, 0, 0);
+        break;
+      default:
+        LOG_WARN("[Control] Ignoring invalid vacuum action %d", command.action);
+        return;
+    }
+    logVacuum(command.source);
+  }
+  publishStatus();
+  if (commandListener != NULL) commandListener(commandListenerArg);
+}
+
+void PumpController::executeBatch(const CommandBatch& batch) {
+  HalLock guard(hal);
+  for (uint8_t i = 0; i < batch.count; i++) {
+    execute(batch.commands[i]);
+  }
+}
+
+void PumpController::service() {
+  pumps.update();
+  vacuumPump.update();
+  publishStatus();
+}
@@ -0,0 +1,23 @@
+#include "pump_manager.h"
+
+PumpManager::PumpManager(Hal& hal) : driverList(hal), channelList(hal, driverList) {
+  driverList.index(drivers);
+  channelList.index(channels);
+}
+
+void PumpManager::makeSafe() {
+  for (uint8_t i = 0; i < MOTOR_DRIVER_COUNT; i++) drivers[i]->makeSafe();
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) channels[i]->makeSafe();
+}
+
+void PumpManager::begin() {
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) channels[i]->begin();
+}
+
+void PumpManager::update() {
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) channels[i]->update();
+}
+
+void PumpManager::setStopListener(void (*listener)(void* arg), void* arg) {
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) channels[i]->setStopListener(listener, arg);
+}
@@ -0,0 +1,58 @@
+#include "ramp.h"
+
+static const uint32_t PROGRESS_ONE = 32768;
+
+RampGenerator::RampGenerator() {
+  fromDuty = 0;
+  toDuty = 0;
+  tick = 0;
+  totalTicks = 0;
+  RampConfig off = { RAMP_OFF, 0 };
+  configure(off);
+}
+
+void RampGenerator::configure(const RampConfig& rampConfig) {
+  config = rampConfig;
+  const uint32_t n = TABLE_STEPS;
+  for (uint32_t i = 0; i <= n; i++) {
+    if (config.shape == RAMP_SCURVE) {
+      // 3x^2 - 2x^3 with x = i/n, in integer arithmetic
+      table[i] = (uint16_t)(((uint64_t)(3 * n - 2 * i) * i * i * PROGRESS_ONE) / (n * n * n));
+    } else {
+      table[i] = (uint16_t)((i * PROGRESS_ONE) / n);
+    }
+  }
+  totalTicks = 0;
+  tick = 0;
+}
+
+void RampGenerator::start(uint32_t from, uint32_t to, uint32_t maxDuty, uint32_t tickUs) {
+  fromDuty = from;
+  toDuty = to;
+  tick = 0;
+  uint32_t delta = from > to ? from - to : to - from;
+  if (!enabled() || delta == 0 || maxDuty == 0 || tickUs == 0) {
+    totalTicks = 0;
+    return;
+  }
+  uint64_t segmentUs = (uint64_t)delta * config.rampMs * 1000 / maxDuty;
+  totalTicks = (uint32_t)(segmentUs / tickUs);
+  if (totalTicks == 0) totalTicks = 1;
+}
+
+uint32_t RampGenerator::next() {
+  if (!active()) return toDuty;
+  tick++;
+  if (tick >= totalTicks) return toDuty;
+
+  // Position along the table in 1/1024 steps, then interpolate
+  uint32_t position = (uint32_t)(((uint64_t)tick * TABLE_STEPS * 1024) / totalTicks);
+  uint32_t index = position >> 10;
+  uint32_t fraction = position & 1023;
+  uint32_t progress = table[index] + (((uint32_t)(table[index + 1] - table[index]) * fraction) >> 10);
+
+  if (toDuty >= fromDuty) {
+    return fromDuty + (uint32_t)(((uint64_t)(toDuty - fromDuty) * progress) / PROGRESS_ONE);
+  }
+  return fromDuty - (uint32_t)(((uint64_t)(fromDuty - toDuty) * progress) / PROGRESS_ONE);
+}
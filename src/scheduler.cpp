@@ -0,0 +1,62 @@
+#include "scheduler.h"
+#include "logger.h"
+#include "metrics.h"
+
+Scheduler::Scheduler(Hal& halInstance) : hal(halInstance), jobCount(0), woken(0), wakeups(0) {}
+
+Scheduler::JobId Scheduler::add(const char* name, SchedulerJob job, void* arg, uint32_t firstDelayMs) {
+  if (jobCount >= MAX_JOBS) {
+    LOG_ERROR("[Scheduler] Job table full, dropping %s", name);
+    return -1;
+  }
+  Entry& entry = jobs[jobCount];
+  entry.name = name;
+  entry.job = job;
+  entry.arg = arg;
+  entry.scheduled = firstDelayMs != SCHEDULE_NEVER;
+  entry.deadlineUs = hal.nowUs() + (uint64_t)firstDelayMs * 1000;
+  return (JobId)jobCount++;
+}
+
+void Scheduler::wake(JobId id) {
+  if (id < 0 || id >= (JobId)jobCount) return;
+  woken.fetch_or(1UL << id, std::memory_order_release);
+  hal.signalEvent();
+}
+
+uint32_t Scheduler::runDue() {
+  uint32_t wokenNow = woken.exchange(0, std::memory_order_acquire);
+  uint64_t now = hal.nowUs();
+
+  for (uint8_t i = 0; i < jobCount; i++) {
+    Entry& entry = jobs[i];
+    bool due = entry.scheduled && entry.deadlineUs <= now;
+    if (!due && !(wokenNow & (1UL << i))) continue;
+    if (due) metrics.schedulerLateness.observe((uint32_t)(now - entry.deadlineUs));
+
+    uint32_t nextMs = entry.job(entry.arg);
+    now = hal.nowUs();
+    entry.scheduled = nextMs != SCHEDULE_NEVER;
+    entry.deadlineUs = now + (uint64_t)nextMs * 1000;
+  }
+
+  // Round up, so the wait never ends just before a deadline
+  uint64_t earliest = 0;
+  bool any = false;
+  for (uint8_t i = 0; i < jobCount; i++) {
+    if (!jobs[i].scheduled) continue;
+    if (!any || jobs[i].deadlineUs < earliest) earliest = jobs[i].deadlineUs;
+    any = true;
+  }
+  if (!any) return SCHEDULE_NEVER;
+  if (earliest <= now) return 0;
+  uint64_t waitMs = (earliest - now + 999) / 1000;
+  return waitMs < SCHEDULE_NEVER ? (uint32_t)waitMs : SCHEDULE_NEVER - 1;
+}
+
+void Scheduler::run() {
+  uint32_t waitMs = runDue();
+  if (waitMs == 0) return;
+  hal.waitForEvent(waitMs);
+  wakeups++;
+}
@@ -0,0 +1,43 @@
+#include "serial_console.h"
+#include "logger.h"
+
+SerialConsole* SerialConsole::instance = NULL;
+
+SerialConsole::SerialConsole(CommandConsole& consoleInstance) : console(consoleInstance) {
+  wakeListener = NULL;
+  wakeListenerArg = NULL;
+}
+
+void SerialConsole::begin(void (*listener)(void* arg), void* arg) {
+  wakeListener = listener;
+  wakeListenerArg = arg;
+  instance = this;
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+  Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, onUsbEvent);
+#else
+  Serial.onReceive([this]() {
+    if (wakeListener) wakeListener(wakeListenerArg);
+  });
+#endif
+  LOG_INFO("[Console] Serial commands enabled; type help");
+}
+
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+void SerialConsole::onUsbEvent(void*, esp_event_base_t, int32_t, void*) {
+  if (instance && instance->wakeListener) instance->wakeListener(instance->wakeListenerArg);
+}
+#endif
+
+uint32_t SerialConsole::service() {
+  char buffer[64];
+  int available;
+  while ((available = Serial.available()) > 0) {
+    size_t count = Serial.readBytes(buffer, (size_t)available < sizeof(buffer) ? available : sizeof(buffer));
+    console.feed(buffer, count);
+  }
+  return SCHEDULE_NEVER;
+}
+
+void SerialConsole::writeLine(void*, const char* line) {
+  logPrintf("%s\n", line);
+}
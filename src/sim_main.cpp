@@ -0,0 +1,365 @@
+// Host entry point for the [env:native] build. Runs a scripted session
+// against SimHal - the same sequence an operator would click through on the
+// web page - and prints every recorded pin/PWM transition as CSV, so control
+// timing can be inspected without a board on the bench.
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pressure_monitor.h"
+#include "pump_controller.h"
+#include "flow_calibration.h"
+#include "protocol.h"
+#include "protocol_sequencer.h"
+#include "protocol_store.h"
+#include "udp_dispatcher.h"
+#include "command_dispatcher.h"
+#include "command_console.h"
+#include "event_log.h"
+#include "boot_profile.h"
+#include "metrics.h"
+#include <string.h>
+
+// Advances simulated time in the control task's service period. Timed stops
+// fire from SimHal's timers at their exact deadline within each step.
+static void runFor(SimHal& hal, PumpController& controller, uint32_t ms) {
+  const uint32_t SERVICE_PERIOD_MS = 20;
+  while (ms > 0) {
+    uint32_t step = ms < SERVICE_PERIOD_MS ? ms : SERVICE_PERIOD_MS;
+    hal.advanceMs(step);
+    ms -= step;
+    controller.service();
+    logFlush();
+  }
+}
+
+// Every record from fromSeq on, as /api/log?format=csv lists them
+static uint32_t printLog(EventLog& log, uint32_t fromSeq) {
+  EventRecord records[16];
+  uint32_t resumeSeq = fromSeq;
+  size_t n;
+  while ((n = log.read(fromSeq, records, 16, resumeSeq)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      printf("log %lu,%lu,%s,%s,%u,%u,%lu,%u\n", (unsigned long)records[i].seq, (unsigned long)records[i].timeMs,
+             eventKindName(records[i].kind), commandSourceName((CommandSource)records[i].source),
+             records[i].state, records[i].duty, (unsigned long)records[i].durationMs, records[i].channel);
+    }
+    fromSeq = resumeSeq;
+  }
+  return fromSeq;
+}
+
+// Sink standing in for the control task's queue
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  logFlush();
+  return true;
+}
+
+// Times a pin went low in the trace since event index from
+static unsigned countFalls(const SimHal& hal, size_t from, uint8_t pin) {
+  unsigned falls = 0;
+  for (size_t i = from; i < hal.events().size(); i++) {
+    const SimHal::Event& event = hal.events()[i];
+    if (event.kind == SimHal::EVENT_PIN && event.index == pin && event.value == 0) falls++;
+  }
+  return falls;
+}
+
+// Replays a motor's inputs, duty and STBY from event index from, one output
+// write at a time (a register write can move several pins at once), and
+// counts the instants where the bridge was in a state nobody asked for:
+// brake (both inputs high), a drive direction taking over from the other
+// with the duty still up, or a duty applied while the chip is in standby
+struct BridgeCheck {
+  unsigned writes;
+  unsigned glitches;
+};
+
+static BridgeCheck checkBridge(const SimHal& hal, size_t from, const ChannelConfig& channel, uint8_t stbyPin,
+                               bool in1, bool in2, uint32_t duty, bool stby) {
+  BridgeCheck check = { 0, 0 };
+  int lastDirection = in1 != in2 ? (in1 ? 1 : -1) : 0;
+  const std::vector<SimHal::Event>& events = hal.events();
+  for (size_t i = from; i < events.size(); i++) {
+    const SimHal::Event& event = events[i];
+    if (event.kind == SimHal::EVENT_PIN) {
+      if (event.index == channel.in1Pin) in1 = event.value;
+      else if (event.index == channel.in2Pin) in2 = event.value;
+      else if (event.index == stbyPin) stby = event.value;
+      else continue;
+    } else if (event.index == channel.ledcChannel) {
+      duty = event.value;
+    } else {
+      continue;
+    }
+    if (i + 1 < events.size() && events[i + 1].write == event.write) continue;  // Same instant
+
+    check.writes++;
+    int direction = in1 != in2 ? (in1 ? 1 : -1) : 0;
+    bool glitch = (in1 && in2) || (direction != 0 && duty > 0 && !stby);
+    if (direction != 0 && lastDirection != 0 && direction != lastDirection && duty > 0) glitch = true;
+    if (glitch) check.glitches++;
+    if (direction != 0) lastDirection = direction;
+  }
+  return check;
+}
+
+static void printConsoleLine(void*, const char* line) {
+  printf("console> %s\n", line);
+}
+
+static void submit(PumpController& controller, CommandTarget target, CommandAction action,
+                   uint32_t speed, uint32_t durationMs) {
+  PumpCommand command = {};
+  command.target = target;
+  command.action = action;
+  command.hasSpeed = true;
+  command.speed = speed;
+  command.hasDuration = true;
+  command.duration = durationMs;
+  command.source = SOURCE_WEB;
+  controller.execute(command);
+  logFlush();
+}
+
+int main() {
+  SimHal hal;
+  PumpManager pumps(hal);
+  PeristalticPump& pump = pumps.channel(0);
+  Tb6612Driver& motorDriver = pumps.driver(VACUUM_CHANNEL.driver);
+  VacuumPump vacuumPump(hal, motorDriver, VACUUM_CHANNEL);
+  PressureMonitor gauge(hal, VACUUM_SENSOR);
+  PumpController controller(pumps, vacuumPump, hal);
+
+  EventLog eventLog(hal);
+
+  // Boot in the firmware's order, on simulated time; only waits show up
+  BootProfile boot(hal);
+  boot.begin();
+  pumps.makeSafe();
+  vacuumPump.makeSafe();
+  boot.mark("outputs_safe");
+  pumps.begin();
+  vacuumPump.setPressureMonitor(gauge);
+  vacuumPump.begin();
+  // Line open to air throughout; tools/vacuum_sim.cpp models the chamber
+  hal.setAnalogInput(VACUUM_SENSOR.adcPin, VACUUM_SENSOR.zeroMv);
+  if (gauge.begin()) gauge.awaitFirstReading(PressureMonitor::STALE_MS);
+  boot.mark("drivers");
+  eventLog.begin();
+  controller.setEventLog(&eventLog);
+  boot.mark("storage");
+  boot.finish();
+  logFlush();
+  hal.clearEvents();
+
+  submit(controller, TARGET_VACUUM, ACTION_START, 80, 3000);
+  runFor(hal, controller, 3500);
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 600, 2250);
+  runFor(hal, controller, 2500);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 1023, 0);
+  runFor(hal, controller, 1000);
+  submit(controller, TARGET_PUMP, ACTION_STOP, 0, 0);
+
+  // Volumetric dose against a two-point calibration, planned the way
+  // /api/dose does it
+  FlowCalibration calibration(hal);
+  calibration.addPoint(200, 150);
+  calibration.addPoint(1000, 900);
+  DosePlan plan;
+  if (calibration.planDose(500, 300, plan)) {
+    PumpCommand dose = {};
+    dose.target = TARGET_PUMP;
+    dose.action = ACTION_FORWARD;
+    dose.speed = plan.duty;
+    dose.duration = plan.durationMs;
+    dose.hasVolume = true;
+    dose.volume = 500;
+    dose.hasFlowRate = true;
+    dose.flowRate = plan.flowRate;
+    controller.execute(dose);
+    logFlush();
+    runFor(hal, controller, plan.durationMs + 100);
+    printf("dose: duty=%u flow=%lu uL/min delivered=%lu uL\n", plan.duty,
+           (unsigned long)plan.flowRate, (unsigned long)doseDeliveredUl(controller.status(), hal.nowUs()));
+  }
+
+  // S-curve ramps: spin up, reverse through zero, ramp down to a stop
+  PumpCommand rampSettings = {};
+  rampSettings.target = TARGET_PUMP;
+  rampSettings.action = ACTION_SET_RAMP;
+  rampSettings.ramp.shape = RAMP_SCURVE;
+  rampSettings.ramp.rampMs = 50;
+  controller.execute(rampSettings);
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 800, 0);
+  runFor(hal, controller, 100);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 800, 0);
+  runFor(hal, controller, 150);
+  submit(controller, TARGET_PUMP, ACTION_STOP, 0, 0);
+  runFor(hal, controller, 100);
+
+  // The example workflow, stored by name and started with a single request
+  static const char PRIME[] =
+    "{\"name\": \"prime\", \"steps\": ["
+    "{\"target\": \"vacuum\", \"action\": \"start\", \"speed\": 80, \"durationMs\": 3000},"
+    "{\"action\": \"forward\", \"speed\": 600, \"durationMs\": 2500},"
+    "{\"action\": \"wait\", \"durationMs\": 1000},"
+    "{\"action\": \"reverse\", \"speed\": 1023, \"duration\": 4}]}";
+  ProtocolSequencer sequencer(controller, hal);
+  ProtocolStore store(hal);
+  sequencer.begin();
+  store.begin();
+  Protocol protocol;
+  int badStep;
+  if (parseProtocol(PRIME, strlen(PRIME), protocol, badStep) == CMD_OK && store.save(protocol)) {
+    Protocol stored;
+    store.load("prime", stored);
+    sequencer.start(stored);
+    logFlush();
+    runFor(hal, controller, 11000);
+    ProtocolProgress progress = sequencer.progress();
+    printf("protocol %s: active=%d steps=%u\n", progress.name, progress.active, progress.stepCount);
+  }
+
+  // Binary UDP command, its retry (acked again, not rerun) and a stop
+  CommandDispatcher commands(controller, sequencer, executeNow, &controller);
+  UdpCommandDispatcher udp(commands);
+  UdpRequest request = {};
+  request.seq = 7;
+  request.target = UDP_TARGET_PUMP;
+  request.action = UDP_ACTION_FORWARD;
+  request.speed = 500;
+  request.durationMs = 300;
+  uint8_t packet[UDP_REQUEST_SIZE];
+  uint8_t reply[UDP_ACK_SIZE];
+  UdpAck ack;
+  encodeUdpRequest(request, packet);
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (udp.handle(0x0100007F, 40000, packet, sizeof(packet), reply, hal.nowUs()) && decodeUdpAck(reply, sizeof(reply), ack)) {
+      printf("udp seq %u: result=%u flags=%u pump=%s remaining=%lu ms\n", ack.seq, ack.result, ack.flags,
+             pumpStateName((PumpState)ack.pumpState), (unsigned long)ack.pumpRemainingMs);
+    }
+    runFor(hal, controller, 100);
+  }
+  runFor(hal, controller, 300);
+
+  // Serial console, fed a scripted session the way the port delivers it:
+  // reads split mid-line, CR, LF and CRLF endings, a typo, a backspace and
+  // a line too long for the buffer
+  char longLine[CommandConsole::LINE_SIZE + 20];
+  memset(longLine, 'x', sizeof(longLine) - 1);
+  longLine[sizeof(longLine) - 2] = '\n';
+  longLine[sizeof(longLine) - 1] = '\0';
+  const char* const session[] = {
+    "help\r\n",
+    "pump forward speed=700 duration=1\r",
+    "\n",
+    "status\n",
+    "vacuum start spe",
+    "ed=2000 durationMs=400\r\n",
+    "pump reverse sped=300\n",
+    "pump forwardX\b speed=50 durationMs=200\n",
+    "pump stop now\n",
+    longLine,
+    "estop\n",
+    "status\n",
+  };
+  CommandConsole console(commands, hal, printConsoleLine, NULL);
+  for (size_t i = 0; i < sizeof(session) / sizeof(session[0]); i++) {
+    console.feed(session[i], strlen(session[i]));
+    runFor(hal, controller, 100);
+  }
+
+  // Both motors from one /api/batch body, applied in the same tick
+  static const char BATCH[] =
+    "[{\"target\": \"vacuum\", \"action\": \"start\", \"speed\": 60, \"durationMs\": 500},"
+    "{\"action\": \"forward\", \"speed\": 700, \"durationMs\": 500}]";
+  CommandBatch batch;
+  int badCommand;
+  if (parseCommandBatch(BATCH, strlen(BATCH), batch, badCommand) == CMD_OK) {
+    uint64_t appliedUs = hal.nowUs();
+    controller.executeBatch(batch);
+    logFlush();
+    runFor(hal, controller, 600);
+    printf("batch of %u applied at %llu us\n", batch.count, (unsigned long long)appliedUs);
+  }
+
+  // The shared standby line: each motor stops on its own inputs while the
+  // other runs on, and the chip only goes to standby once both are idle
+  uint8_t stby = motorDriver.getStbyPin();
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 500, 0);
+  size_t traceFrom = hal.events().size();
+  submit(controller, TARGET_VACUUM, ACTION_START, 50, 200);
+  runFor(hal, controller, 300);
+  submit(controller, TARGET_VACUUM, ACTION_STOP, 0, 0);
+  bool pumpKept = countFalls(hal, traceFrom, stby) == 0 && pump.getCurrentDuty() > 0;
+  submit(controller, TARGET_VACUUM, ACTION_START, 50, 0);
+  traceFrom = hal.events().size();
+  submit(controller, TARGET_PUMP, ACTION_STOP, 0, 0);
+  runFor(hal, controller, 200);  // Past the ramp down
+  bool vacuumKept = countFalls(hal, traceFrom, stby) == 0 && vacuumPump.getCurrentState() == VACUUM_RUNNING;
+  submit(controller, TARGET_VACUUM, ACTION_STOP, 0, 0);
+  printf("stby: pump kept through vacuum stops %s, vacuum kept through pump stop %s, standby when idle %s\n",
+         pumpKept ? "yes" : "NO", vacuumKept ? "yes" : "NO",
+         !hal.readPin(stby) && motorDriver.inStandby() ? "yes" : "NO");
+
+  // Direction changes, with and without ramps, with the other motor running
+  // alongside: every intermediate state of both bridges is one a command
+  // could have asked for
+  const ChannelConfig& pumpPins = PUMP_CHANNELS[0];
+  bool pumpIn1 = hal.pinLevel(pumpPins.in1Pin), pumpIn2 = hal.pinLevel(pumpPins.in2Pin);
+  bool vacuumIn1 = hal.pinLevel(VACUUM_CHANNEL.in1Pin), vacuumIn2 = hal.pinLevel(VACUUM_CHANNEL.in2Pin);
+  uint32_t pumpDuty = hal.pwmDuty(pumpPins.ledcChannel), vacuumDuty = hal.pwmDuty(VACUUM_CHANNEL.ledcChannel);
+  bool stbyLevel = hal.pinLevel(stby);
+  traceFrom = hal.events().size();
+  rampSettings.ramp.shape = RAMP_OFF;
+  controller.execute(rampSettings);
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 800, 0);
+  submit(controller, TARGET_VACUUM, ACTION_START, 60, 0);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 600, 0);
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 300, 0);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 1023, 0);
+  submit(controller, TARGET_PUMP, ACTION_STOP, 0, 0);
+  submit(controller, TARGET_VACUUM, ACTION_STOP, 0, 0);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 500, 0);
+  rampSettings.ramp.shape = RAMP_SCURVE;
+  controller.execute(rampSettings);
+  submit(controller, TARGET_PUMP, ACTION_FORWARD, 700, 0);
+  runFor(hal, controller, 100);
+  submit(controller, TARGET_VACUUM, ACTION_START, 40, 50);
+  submit(controller, TARGET_PUMP, ACTION_REVERSE, 700, 0);
+  runFor(hal, controller, 150);
+  submit(controller, TARGET_PUMP, ACTION_STOP, 0, 0);
+  runFor(hal, controller, 100);
+  BridgeCheck pumpCheck = checkBridge(hal, traceFrom, pumpPins, stby, pumpIn1, pumpIn2, pumpDuty, stbyLevel);
+  BridgeCheck vacuumCheck = checkBridge(hal, traceFrom, VACUUM_CHANNEL, stby, vacuumIn1, vacuumIn2, vacuumDuty,
+                                        stbyLevel);
+  printf("bridge: pump %u writes %u glitches, vacuum %u writes %u glitches\n", pumpCheck.writes,
+         pumpCheck.glitches, vacuumCheck.writes, vacuumCheck.glitches);
+
+  // The session as the event log recorded it
+  eventLog.flush();
+  printLog(eventLog, eventLog.firstSeq());
+
+  // How late the simulated stop timers fired, as /metrics reports it
+  Histogram::Snapshot snap;
+  char line[160];
+  metrics.timedStopError.snapshot(snap);
+  for (uint8_t i = 0; metrics.timedStopError.formatLine(snap, i, line, sizeof(line)) > 0; i++) {
+    printf("%s", line);
+  }
+
+  printf("\ntime_us,kind,index,value\n");
+  for (size_t i = 0; i < hal.events().size(); i++) {
+    const SimHal::Event& event = hal.events()[i];
+    printf("%llu,%s,%u,%lu\n", (unsigned long long)event.timeUs,
+           event.kind == SimHal::EVENT_PIN ? "pin" : "pwm", event.index, (unsigned long)event.value);
+  }
+  return 0;
+}
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,53 @@
+#include "speed_loop.h"
+
+SpeedLoop::SpeedLoop() {
+  configure(NO_ENCODER);
+}
+
+void SpeedLoop::configure(const EncoderConfig& encoder) {
+  config = encoder;
+  pi.configure(encoder.kp, encoder.ki, 0.0f, 1.0f);
+  for (uint8_t i = 0; i < WINDOW; i++) {
+    windowPulses[i] = 0;
+    windowUs[i] = 0;
+  }
+  slot = 0;
+  pulseSum = 0;
+  usSum = 0;
+  rpm = 0.0f;
+  reset();
+}
+
+void SpeedLoop::reset() {
+  pi.reset();
+  trim = 0.0f;
+}
+
+void SpeedLoop::measure(uint32_t pulses, uint32_t intervalUs) {
+  if (pulses > 0xFFFF) pulses = 0xFFFF;
+  pulseSum = pulseSum - windowPulses[slot] + pulses;
+  usSum = usSum - windowUs[slot] + intervalUs;
+  windowPulses[slot] = (uint16_t)pulses;
+  windowUs[slot] = intervalUs;
+  slot = (slot + 1) % WINDOW;
+  rpm = (usSum == 0 || config.pulsesPerRev == 0)
+      ? 0.0f : (float)pulseSum * 60e6f / ((float)config.pulsesPerRev * (float)usSum);
+}
+
+void SpeedLoop::update(float setpointRpm, float feedforward, uint32_t dtUs) {
+  if (config.maxRpm == 0) return;
+  float out = pi.update((setpointRpm - rpm) / config.maxRpm, feedforward, dtUs);
+  trim = out - feedforward;
+}
+
+float SpeedLoop::setpointRpm(uint32_t duty, uint32_t maxDuty) const {
+  return maxDuty == 0 ? 0.0f : (float)duty * config.maxRpm / maxDuty;
+}
+
+uint32_t SpeedLoop::output(uint32_t duty, uint32_t maxDuty) const {
+  if (duty == 0) return 0;
+  float out = (float)duty + trim * maxDuty + 0.5f;
+  if (out <= 0.0f) return 0;
+  if (out >= (float)maxDuty) return maxDuty;
+  return (uint32_t)out;
+}
@@ -0,0 +1,114 @@
+#include "status_delta.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+static uint32_t quantize(uint32_t ms) {
+  return (ms + REMAINING_RESOLUTION_MS - 1) / REMAINING_RESOLUTION_MS * REMAINING_RESOLUTION_MS;
+}
+
+StatusView makeStatusView(const PumpStatus& status, const ProtocolProgress& progress, uint64_t nowUs) {
+  StatusView view;
+  view.pumpState = status.pumpState;
+  view.pumpSpeed = status.pumpSpeed;
+  view.pumpTimedRun = status.pumpTimedRun;
+  view.pumpRemainingMs = quantize(remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, nowUs));
+  view.vacuumState = status.vacuumState;
+  view.vacuumSpeed = status.vacuumSpeed;
+  view.vacuumTimedRun = status.vacuumTimedRun;
+  view.vacuumRemainingMs = quantize(remainingMs(status.vacuumTimedRun, status.vacuumStopDeadlineUs, nowUs));
+  view.vacuumTargetPa = status.vacuumTargetPa;
+  view.vacuumPressurePa = status.vacuumPressurePa > 0
+    ? ((uint32_t)status.vacuumPressurePa + PRESSURE_RESOLUTION_PA / 2) / PRESSURE_RESOLUTION_PA * PRESSURE_RESOLUTION_PA
+    : 0;
+  view.vacuumInterlock = status.vacuumInterlock;
+  view.doseActive = status.doseActive;
+  view.doseDeliveredUl = doseDeliveredUl(status, nowUs);
+  view.protocolActive = progress.active;
+  view.protocolStep = progress.active ? progress.step + 1 : 0;
+  return view;
+}
+
+// Appends to a JSON object under construction, opening the group object
+// on its first field and separating fields with commas
+class DeltaWriter {
+private:
+  char* buffer;
+  size_t size;
+  size_t len;
+  bool overflow;
+  bool anyGroup;
+  bool inGroup;
+  const char* group;
+
+  void append(const char* fmt, ...) {
+    if (overflow) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buffer + len, size - len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - len) overflow = true;
+    else len += n;
+  }
+
+  void field(const char* name) {
+    if (!inGroup) {
+      append("%s\"%s\":{", anyGroup ? "," : "", group);
+      anyGroup = inGroup = true;
+    } else {
+      append(",");
+    }
+    append("\"%s\":", name);
+  }
+
+public:
+  DeltaWriter(char* out, size_t outSize)
+    : buffer(out), size(outSize), len(0), overflow(outSize == 0), anyGroup(false), inGroup(false), group("") {
+    append("{");
+  }
+
+  void beginGroup(const char* name) { group = name; inGroup = false; }
+  void endGroup() { if (inGroup) append("}"); inGroup = false; }
+
+  void text(const char* name, const char* value) { field(name); append("\"%s\"", value); }
+  void number(const char* name, unsigned long value) { field(name); append("%lu", value); }
+  void boolean(const char* name, bool value) { field(name); append(value ? "true" : "false"); }
+
+  size_t finish() {
+    append("}");
+    return (overflow || !anyGroup) ? 0 : len;
+  }
+};
+
+size_t writeStatusDelta(const StatusView* previous, const StatusView& current, char* buffer, size_t size) {
+  const StatusView* p = previous;
+  DeltaWriter out(buffer, size);
+
+  out.beginGroup("pump");
+  if (!p || p->pumpState != current.pumpState) out.text("state", pumpStateName(current.pumpState));
+  if (!p || p->pumpSpeed != current.pumpSpeed) out.number("speed", current.pumpSpeed);
+  if (!p || p->pumpTimedRun != current.pumpTimedRun) out.boolean("isTimedRun", current.pumpTimedRun);
+  if (!p || p->pumpRemainingMs != current.pumpRemainingMs) out.number("remainingMs", current.pumpRemainingMs);
+  out.endGroup();
+
+  out.beginGroup("vacuum");
+  if (!p || p->vacuumState != current.vacuumState) out.text("state", vacuumStateName(current.vacuumState));
+  if (!p || p->vacuumSpeed != current.vacuumSpeed) out.number("speed", current.vacuumSpeed);
+  if (!p || p->vacuumTimedRun != current.vacuumTimedRun) out.boolean("isTimedRun", current.vacuumTimedRun);
+  if (!p || p->vacuumRemainingMs != current.vacuumRemainingMs) out.number("remainingMs", current.vacuumRemainingMs);
+  if (!p || p->vacuumTargetPa != current.vacuumTargetPa) out.number("targetPa", current.vacuumTargetPa);
+  if (!p || p->vacuumPressurePa != current.vacuumPressurePa) out.number("pressurePa", current.vacuumPressurePa);
+  if (!p || p->vacuumInterlock != current.vacuumInterlock) out.text("interlock", pressureStateName(current.vacuumInterlock));
+  out.endGroup();
+
+  out.beginGroup("dose");
+  if (!p || p->doseActive != current.doseActive) out.boolean("active", current.doseActive);
+  if (!p || p->doseDeliveredUl != current.doseDeliveredUl) out.number("delivered", current.doseDeliveredUl);
+  out.endGroup();
+
+  out.beginGroup("protocol");
+  if (!p || p->protocolActive != current.protocolActive) out.boolean("active", current.protocolActive);
+  if (!p || p->protocolStep != current.protocolStep) out.number("step", current.protocolStep);
+  out.endGroup();
+
+  return out.finish();
+}
@@ -0,0 +1,67 @@
+#include "status_json.h"
+#include <stdio.h>
+
+size_t writeStatusJson(const PumpStatus& status, const ProtocolProgress& progress, const WiFiStats& link,
+                       const BootProfile& boot, uint64_t nowUs, uint32_t nowMs, char* buffer, size_t size) {
+  // Remaining time is only reported while running on a timer.
+  // remainingTime stays in whole seconds for existing clients, rounded up
+  // as it always was (a 5 s run reads 5 until a full second has passed);
+  // the page counts down from remainingMs.
+  unsigned long pumpRemainingMs = remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, nowUs);
+  unsigned long vacuumRemainingMs = remainingMs(status.vacuumTimedRun, status.vacuumStopDeadlineUs, nowUs);
+
+  int len = snprintf(buffer, size,
+    "{\"success\": true,"
+    "\"pump\": {\"state\": \"%s\",\"speed\": %u,\"speedPercent\": %d"
+    ",\"remainingTime\": %lu,\"remainingMs\": %lu,\"durationMs\": %lu,\"isTimedRun\": %s},"
+    "\"vacuum\": {\"state\": \"%s\",\"speed\": %u,\"speedPercent\": %d"
+    ",\"remainingTime\": %lu,\"remainingMs\": %lu,\"durationMs\": %lu,\"isTimedRun\": %s"
+    ",\"targetPa\": %lu,\"pressurePa\": %ld,\"interlock\": \"%s\",\"lastTrip\": \"%s\"},"
+    "\"dose\": {\"active\": %s,\"volume\": %lu,\"flowRate\": %lu,\"delivered\": %lu},"
+    "\"protocol\": {\"active\": %s,\"aborted\": %s,\"name\": \"%s\",\"step\": %u,\"steps\": %u"
+    ",\"stepRemainingMs\": %lu},"
+    "\"wifi\": {\"state\": \"%s\",\"drops\": %lu,\"failedAttempts\": %lu,\"lastReconnectMs\": %lu"
+    ",\"connectedMs\": %lu,\"backoffMs\": %lu,\"lastReason\": %u},"
+    "\"boot\": {\"setup\": %s,\"networkUpUs\": %lu}"
+    "}",
+    pumpStateName(status.pumpState),
+    (unsigned)status.pumpSpeed,
+    (status.pumpSpeed * 100) / 255,
+    (pumpRemainingMs + 999) / 1000,
+    pumpRemainingMs,
+    (unsigned long)status.pumpRunDurationMs,
+    status.pumpTimedRun ? "true" : "false",
+    vacuumStateName(status.vacuumState),
+    (unsigned)status.vacuumSpeed,
+    (status.vacuumSpeed * 100) / 255,
+    (vacuumRemainingMs + 999) / 1000,
+    vacuumRemainingMs,
+    (unsigned long)status.vacuumRunDurationMs,
+    status.vacuumTimedRun ? "true" : "false",
+    (unsigned long)status.vacuumTargetPa,
+    (long)status.vacuumPressurePa,
+    pressureStateName(status.vacuumInterlock),
+    pressureStateName(status.vacuumLastTrip),
+    status.doseActive ? "true" : "false",
+    (unsigned long)status.doseTargetUl,
+    (unsigned long)status.doseFlowRate,
+    (unsigned long)doseDeliveredUl(status, nowUs),
+    progress.active ? "true" : "false",
+    progress.aborted ? "true" : "false",
+    progress.name,
+    (unsigned)(progress.active ? progress.step + 1 : 0),
+    (unsigned)progress.stepCount,
+    (unsigned long)remainingMs(progress.active, progress.stepDeadlineUs, nowUs),
+    wifiStateName(link.state),
+    (unsigned long)link.drops,
+    (unsigned long)link.failedAttempts,
+    (unsigned long)link.lastReconnectMs,
+    (unsigned long)(link.state == WIFI_STATE_CONNECTED ? nowMs - link.connectedSinceMs : 0),
+    (unsigned long)link.backoffMs,
+    (unsigned)link.lastReason,
+    boot.stagesJson(),
+    (unsigned long)boot.networkUpUs());
+
+  if (len < 0 || size == 0) return 0;
+  return ((size_t)len < size) ? (size_t)len : size - 1;
+}
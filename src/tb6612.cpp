@@ -0,0 +1,40 @@
+#include "tb6612.h"
+#include "logger.h"
+
+Tb6612Driver::Tb6612Driver(Hal& halInstance, const DriverConfig& config)
+  : hal(halInstance), stbyPin(config.stbyPin), users(0) {}
+
+void Tb6612Driver::makeSafe() {
+  HalLock guard(hal);
+  users = 0;
+  hal.writePin(stbyPin, false);
+  hal.pinModeOutput(stbyPin);
+}
+
+void Tb6612Driver::acquire(Channel channel) {
+  HalLock guard(hal);
+  uint8_t bit = 1 << channel;
+  if (users & bit) return;
+  if (users == 0) {
+    hal.writePin(stbyPin, true);
+    LOG_DEBUG("[TB6612] STBY %u high for channel %c", stbyPin, 'A' + channel);
+  }
+  users |= bit;
+}
+
+void Tb6612Driver::release(Channel channel) {
+  HalLock guard(hal);
+  uint8_t bit = 1 << channel;
+  if (!(users & bit)) return;
+  users &= ~bit;
+  if (users == 0) {
+    hal.writePin(stbyPin, false);
+    LOG_DEBUG("[TB6612] STBY %u low, both channels idle", stbyPin);
+  }
+}
+
+void Tb6612Driver::setInputs(Hal& hal, const ChannelConfig& channel, bool in1, bool in2) {
+  uint64_t pin1 = 1ULL << channel.in1Pin;
+  uint64_t pin2 = 1ULL << channel.in2Pin;
+  hal.writePins((in1 ? pin1 : 0) | (in2 ? pin2 : 0), (in1 ? 0 : pin1) | (in2 ? 0 : pin2));
+}
@@ -0,0 +1,20 @@
+#include "udp_control.h"
+#include <esp_timer.h>
+#include "logger.h"
+
+UdpControlServer::UdpControlServer(CommandDispatcher& commands) : dispatcher(commands) {}
+
+bool UdpControlServer::begin(uint16_t port) {
+  if (!udp.listen(port)) {
+    LOG_ERROR("[UDP] Failed to listen on port %u", port);
+    return false;
+  }
+  udp.onPacket([this](AsyncUDPPacket& packet) {
+    uint8_t reply[UDP_ACK_SIZE];
+    size_t len = dispatcher.handle((uint32_t)packet.remoteIP(), packet.remotePort(),
+                                   packet.data(), packet.length(), reply, esp_timer_get_time());
+    if (len > 0) packet.write(reply, len);
+  });
+  LOG_INFO("[UDP] Binary control protocol on port %u", port);
+  return true;
+}
@@ -0,0 +1,142 @@
+#include "udp_dispatcher.h"
+#include <string.h>
+#include "logger.h"
+
+UdpCommandDispatcher::UdpCommandDispatcher(CommandDispatcher& commandsInstance) : commands(commandsInstance) {
+  droppedPackets = 0;
+  replayedAcks = 0;
+  for (uint8_t i = 0; i < MAX_PEERS; i++) {
+    peers[i].used = false;
+    peers[i].hasAck = false;
+  }
+}
+
+// The sender's entry, or the least recently heard one taken over for it
+UdpCommandDispatcher::Peer& UdpCommandDispatcher::peerFor(uint32_t address, uint16_t port, uint32_t nowMs) {
+  Peer* oldest = &peers[0];
+  for (uint8_t i = 0; i < MAX_PEERS; i++) {
+    Peer& peer = peers[i];
+    if (peer.used && peer.address == address && peer.port == port) {
+      peer.lastSeenMs = nowMs;
+      return peer;
+    }
+    if (!peer.used) {
+      oldest = &peer;
+    } else if (oldest->used && nowMs - peer.lastSeenMs > nowMs - oldest->lastSeenMs) {
+      oldest = &peer;
+    }
+  }
+  oldest->used = true;
+  oldest->hasAck = false;
+  oldest->address = address;
+  oldest->port = port;
+  oldest->lastSeenMs = nowMs;
+  return *oldest;
+}
+
+// Wire fields to a parsed command, then the same limits and defaults as
+// every other front end. A duration of 0 is the field left out.
+bool UdpCommandDispatcher::toCommand(const UdpRequest& request, PumpCommand& command) const {
+  memset(&command, 0, sizeof(command));
+  command.duration = request.durationMs;
+  command.hasDuration = request.durationMs > 0;
+
+  if (request.target == UDP_TARGET_PUMP) {
+    command.target = TARGET_PUMP;
+    switch (request.action) {
+      case UDP_ACTION_FORWARD:
+      case UDP_ACTION_REVERSE:
+        command.action = request.action == UDP_ACTION_FORWARD ? ACTION_FORWARD : ACTION_REVERSE;
+        command.speed = request.speed;
+        command.hasSpeed = true;
+        break;
+      case UDP_ACTION_STOP:
+        command.action = ACTION_STOP;
+        break;
+      default:
+        return false;
+    }
+  } else if (request.target == UDP_TARGET_VACUUM) {
+    command.target = TARGET_VACUUM;
+    switch (request.action) {
+      case UDP_ACTION_START: {
+        // Percent on the wire, the 0-1023 scale resolve() converts back
+        uint32_t percent = request.speed > 100 ? 100 : request.speed;
+        command.action = ACTION_START;
+        command.speed = (percent * 1023 + 99) / 100;
+        command.hasSpeed = true;
+        break;
+      }
+      case UDP_ACTION_STOP:
+        command.action = ACTION_STOP;
+        break;
+      default:
+        return false;
+    }
+  } else {
+    return false;
+  }
+
+  commands.resolve(command, commands.status(), SOURCE_UDP);
+  return true;
+}
+
+uint8_t UdpCommandDispatcher::apply(const UdpRequest& request) {
+  if (request.action == UDP_ACTION_EMERGENCY) {
+    // Vacuum and every pump channel, whichever target the sender named
+    return commands.emergencyStop(SOURCE_UDP) ? UDP_RESULT_OK : UDP_RESULT_BUSY;
+  }
+
+  PumpCommand command;
+  if (!toCommand(request, command)) return UDP_RESULT_BAD_COMMAND;
+  return commands.submit(command) ? UDP_RESULT_OK : UDP_RESULT_BUSY;
+}
+
+size_t UdpCommandDispatcher::handle(uint32_t address, uint16_t port, const uint8_t* packet, size_t length,
+                                    uint8_t* reply, uint64_t nowUs) {
+  UdpRequest request;
+  if (!decodeUdpRequest(packet, length, request)) {
+    droppedPackets++;
+    LOG_DEBUG("[UDP] Dropped malformed packet (%u bytes)", (unsigned)length);
+    return 0;
+  }
+
+  Peer& peer = peerFor(address, port, (uint32_t)(nowUs / 1000));
+  if (request.action != UDP_ACTION_STATUS && peer.hasAck && peer.lastSeq == request.seq) {
+    // A retry of a request that was already decided: same answer, no rerun
+    memcpy(reply, peer.ack, UDP_ACK_SIZE);
+    reply[5] |= UDP_FLAG_REPLAYED;
+    uint16_t crc = crc16Ccitt(reply, UDP_ACK_SIZE - 2);
+    reply[UDP_ACK_SIZE - 2] = (uint8_t)crc;
+    reply[UDP_ACK_SIZE - 1] = (uint8_t)(crc >> 8);
+    replayedAcks++;
+    return UDP_ACK_SIZE;
+  }
+
+  UdpAck ack;
+  ack.seq = request.seq;
+  ack.flags = 0;
+  ack.result = request.action == UDP_ACTION_STATUS ? (uint8_t)UDP_RESULT_OK : apply(request);
+  if (ack.result == UDP_RESULT_BAD_COMMAND) {
+    LOG_WARN("[UDP] Rejected seq %u: target %u action %u speed %u duration %lu", request.seq,
+             request.target, request.action, request.speed, (unsigned long)request.durationMs);
+  }
+
+  // State as of receipt; on the device the command itself is still queued
+  PumpStatus status = commands.status();
+  ack.pumpState = (uint8_t)status.pumpState;
+  ack.vacuumState = (uint8_t)status.vacuumState;
+  ack.pumpSpeed = status.pumpSpeed;
+  ack.vacuumSpeed = status.vacuumSpeed;
+  ack.pumpRemainingMs = remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, nowUs);
+  ack.vacuumRemainingMs = remainingMs(status.vacuumTimedRun, status.vacuumStopDeadlineUs, nowUs);
+  encodeUdpAck(ack, reply);
+
+  // Busy requests weren't applied, so their retry must be tried again
+  if (request.action != UDP_ACTION_STATUS && ack.result != UDP_RESULT_BUSY) {
+    peer.lastSeq = request.seq;
+    peer.hasAck = true;
+    memcpy(peer.ack, reply, UDP_ACK_SIZE);
+  }
+  return UDP_ACK_SIZE;
+}
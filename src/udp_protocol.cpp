@@ -0,0 +1,89 @@
+#include "udp_protocol.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  put16(p, (uint16_t)v);
+  put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static bool checkFrame(const uint8_t* data, size_t len, size_t size, uint8_t magic) {
+  if (len != size || data[0] != magic || data[1] != UDP_PROTOCOL_VERSION) return false;
+  return get16(data + size - 2) == crc16Ccitt(data, size - 2);
+}
+
+size_t encodeUdpRequest(const UdpRequest& request, uint8_t* out) {
+  out[0] = UDP_REQUEST_MAGIC;
+  out[1] = UDP_PROTOCOL_VERSION;
+  put16(out + 2, request.seq);
+  out[4] = request.target;
+  out[5] = request.action;
+  put16(out + 6, request.speed);
+  put32(out + 8, request.durationMs);
+  put16(out + 12, 0);
+  put16(out + 14, crc16Ccitt(out, 14));
+  return UDP_REQUEST_SIZE;
+}
+
+bool decodeUdpRequest(const uint8_t* data, size_t len, UdpRequest& request) {
+  if (!checkFrame(data, len, UDP_REQUEST_SIZE, UDP_REQUEST_MAGIC)) return false;
+  request.seq = get16(data + 2);
+  request.target = data[4];
+  request.action = data[5];
+  request.speed = get16(data + 6);
+  request.durationMs = get32(data + 8);
+  return true;
+}
+
+size_t encodeUdpAck(const UdpAck& ack, uint8_t* out) {
+  out[0] = UDP_ACK_MAGIC;
+  out[1] = UDP_PROTOCOL_VERSION;
+  put16(out + 2, ack.seq);
+  out[4] = ack.result;
+  out[5] = ack.flags;
+  out[6] = ack.pumpState;
+  out[7] = ack.vacuumState;
+  put16(out + 8, ack.pumpSpeed);
+  out[10] = ack.vacuumSpeed;
+  out[11] = 0;
+  put32(out + 12, ack.pumpRemainingMs);
+  put32(out + 16, ack.vacuumRemainingMs);
+  put16(out + 20, crc16Ccitt(out, 20));
+  return UDP_ACK_SIZE;
+}
+
+bool decodeUdpAck(const uint8_t* data, size_t len, UdpAck& ack) {
+  if (!checkFrame(data, len, UDP_ACK_SIZE, UDP_ACK_MAGIC)) return false;
+  ack.seq = get16(data + 2);
+  ack.result = data[4];
+  ack.flags = data[5];
+  ack.pumpState = data[6];
+  ack.vacuumState = data[7];
+  ack.pumpSpeed = get16(data + 8);
+  ack.vacuumSpeed = data[10];
+  ack.pumpRemainingMs = get32(data + 12);
+  ack.vacuumRemainingMs = get32(data + 16);
+  return true;
+}
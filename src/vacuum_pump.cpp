@@ -1,12 +1,34 @@
 #include "vacuum_pump.h"
+#include "logger.h"
+#include "metrics.h"
 
-VacuumPump::VacuumPump() {
+VacuumPump::VacuumPump(Hal& halInstance, Tb6612Driver& driverInstance, const ChannelConfig& channelConfig)
+  : hal(halInstance), driver(driverInstance), config(channelConfig) {
   currentState = VACUUM_STOPPED;
   currentSpeedPercent = 100;
-  runDuration = 5;
+  runDurationMs = 5000;
   pumpStartTime = 0;
+  stopDeadlineUs = 0;
   isTimedRun = false;
   lastDuty = 0;
+  pressure = NULL;
+  targetPa = 0;
+  lastTrip = PRESSURE_OK;
+  stopTimer = NULL;
+  stopListener = NULL;
+  stopListenerArg = NULL;
+}
+
+void VacuumPump::setStopListener(void (*listener)(void* arg), void* arg) {
+  stopListener = listener;
+  stopListenerArg = arg;
+}
+
+void VacuumPump::setPressureMonitor(PressureMonitor& monitor) {
+  pressure = &monitor;
+  const PressureSensorConfig& sensor = monitor.getConfig();
+  regulator.configure(sensor.kp, sensor.ki, 0.0f, MAX_SPEED_PERCENT / 100.0f);
+  monitor.setListener(onPressure, this);
 }
 
 uint32_t VacuumPump::percentToDuty(uint8_t percent) const {
@@ -19,88 +41,59 @@ uint8_t VacuumPump::dutyToPercent(uint32_t duty) const {
   return (duty * 100) / getMaxDuty();
 }
 
-void VacuumPump::begin() {
-  // Initialize GPIO for vacuum pump (Channel B)
-  pinMode(PIN_BIN1, OUTPUT);
-  pinMode(PIN_BIN2, OUTPUT);
-  pinMode(PIN_STBY, OUTPUT);
+// Same as PeristalticPump::makeSafe()
+void VacuumPump::makeSafe() {
+  const uint8_t pins[] = { config.in1Pin, config.in2Pin, config.pwmPin };
+  for (uint8_t i = 0; i < sizeof(pins); i++) {
+    hal.writePin(pins[i], false);
+    hal.pinModeOutput(pins[i]);
+  }
+}
 
+void VacuumPump::begin() {
   // BO1 and BO2 are 6612FNG output pins, directly connected to vacuum pump
   // No GPIO control needed for BO1/BO2
-  Serial.println("[Vacuum] BO1/BO2 are 6612FNG outputs, directly connected to vacuum pump");
+  makeSafe();
 
   // Initialize PWM
-  uint32_t actualFreq = ledcSetup(PWM_CH, PWM_FREQ, PWM_RES);
-  Serial.print("[Vacuum] LEDC channel=");
-  Serial.print(PWM_CH);
-  Serial.print(" freq=");
-  Serial.print(PWM_FREQ);
-  Serial.print("Hz (actual=");
-  Serial.print(actualFreq);
-  Serial.print("Hz) res=");
-  Serial.print(PWM_RES);
-  Serial.println("-bit");
-
-  ledcAttachPin(PIN_PWMB, PWM_CH);
-  Serial.print("[Vacuum] Attached PWM channel ");
-  Serial.print(PWM_CH);
-  Serial.print(" to pin ");
-  Serial.println(PIN_PWMB);
-
-  // Initialize Motor Driver
+  uint32_t actualFreq = hal.pwmSetup(config.ledcChannel, config.pwmFreq, config.pwmRes);
+  LOG_DEBUG("[Vacuum] LEDC channel=%u freq=%luHz (actual=%luHz) res=%u-bit",
+            config.ledcChannel, (unsigned long)config.pwmFreq, (unsigned long)actualFreq, config.pwmRes);
+
+  hal.pwmAttachPin(config.pwmPin, config.ledcChannel);
+
+  // Initialize Motor Driver; it leaves standby when a channel first runs
   motorCoast();
-  Serial.println("[Vacuum] Bringing driver out of standby...");
-  digitalWrite(PIN_STBY, LOW);
-  delay(10);
-  digitalWrite(PIN_STBY, HIGH);
-  logPinStates("        ");
 
-  Serial.println("[Vacuum] Vacuum pump initialized successfully");
+  stopTimer = hal.createTimer(onStopTimer, this, "vacuum_stop");
 }
 
+// STBY is shared: this only lets the chip go to standby, which happens
+// once its other channel is idle as well
 void VacuumPump::disableDriver() {
-  ledcWrite(PWM_CH, 0);
-  digitalWrite(PIN_STBY, LOW);
+  hal.pwmWrite(config.ledcChannel, 0);
   lastDuty = 0;
-  Serial.println("[Vacuum] Driver disabled (STBY=LOW)");
+  driver.release(driverChannel());
 }
 
 void VacuumPump::enableDriver() {
-  digitalWrite(PIN_STBY, HIGH);
-  delayMicroseconds(10);  // Small delay for driver to stabilize
-  Serial.println("[Vacuum] Driver enabled (STBY=HIGH)");
+  driver.acquire(driverChannel());
 }
 
 void VacuumPump::logPinStates(const char* prefix) {
-  int bin1 = digitalRead(PIN_BIN1);
-  int bin2 = digitalRead(PIN_BIN2);
-  int stby = digitalRead(PIN_STBY);
-
-  Serial.print(prefix);
-  Serial.print(" BIN1=");
-  Serial.print(bin1);
-  Serial.print(" BIN2=");
-  Serial.print(bin2);
-  Serial.print(" STBY=");
-  Serial.print(stby);
-  Serial.print(" PWM(duty)=");
-  Serial.print(lastDuty);
-  Serial.print("/");
-  Serial.print(getMaxDuty());
-  Serial.print(" (");
-  Serial.print(dutyToPercent(lastDuty));
-  Serial.println("%)");
+  LOG_DEBUG("%s BIN1=%d BIN2=%d STBY=%d PWM(duty)=%lu/%lu (%u%%)",
+            prefix, hal.readPin(config.in1Pin), hal.readPin(config.in2Pin), hal.readPin(driver.getStbyPin()),
+            (unsigned long)lastDuty, (unsigned long)getMaxDuty(), dutyToPercent(lastDuty));
 }
 
 void VacuumPump::motorCoast() {
-  // Proper coast: PWM=0 first, then set direction, then disable driver
-  ledcWrite(PWM_CH, 0);
-  digitalWrite(PIN_BIN1, LOW);
-  digitalWrite(PIN_BIN2, LOW);
+  // Proper coast: PWM=0 first, then set direction, then release the driver
+  hal.pwmWrite(config.ledcChannel, 0);
+  Tb6612Driver::setInputs(hal, config, false, false);
   disableDriver();
   lastDuty = 0;
 
-  Serial.println("[Vacuum] Coast (freewheel)");
+  LOG_DEBUG("[Vacuum] Coast (freewheel)");
   logPinStates("        ");
 }
 
@@ -108,109 +101,218 @@ void VacuumPump::motorBrake() {
   // True brake: IN1=IN2=HIGH + PWM=MAX for short time
   // Note: Use with caution, high current!
   enableDriver();
-  digitalWrite(PIN_BIN1, HIGH);
-  digitalWrite(PIN_BIN2, HIGH);
-  ledcWrite(PWM_CH, getMaxDuty());
+  Tb6612Driver::setInputs(hal, config, true, true);
+  hal.pwmWrite(config.ledcChannel, getMaxDuty());
   lastDuty = getMaxDuty();
 
-  Serial.println("[Vacuum] Brake (short brake) - HIGH CURRENT!");
+  LOG_WARN("[Vacuum] Brake (short brake) - HIGH CURRENT!");
   logPinStates("        ");
-  
+
   // Hold brake for short time, then coast
-  delay(50);  // Short brake duration
+  hal.delayMs(50);  // Short brake duration
   motorCoast();
 }
 
 void VacuumPump::motorForward(uint8_t speedPercent) {
   // Safety check - ensure we don't exceed safe speed limits
-  if (speedPercent > 80) {  // Limit to 80% for vacuum pump safety
-    speedPercent = 80;
-    Serial.println("[Vacuum] Speed limited to 80% for safety");
+  if (speedPercent > MAX_SPEED_PERCENT) {
+    speedPercent = MAX_SPEED_PERCENT;
+    LOG_WARN("[Vacuum] Speed limited to %u%% for safety", MAX_SPEED_PERCENT);
   }
-  
+
   // Convert percentage to duty cycle
   uint32_t duty = percentToDuty(speedPercent);
-  
+
   // Proper sequence: enable driver, set direction, then PWM
   enableDriver();
-  digitalWrite(PIN_BIN1, HIGH);
-  digitalWrite(PIN_BIN2, LOW);
-  ledcWrite(PWM_CH, duty);
+  Tb6612Driver::setInputs(hal, config, true, false);
+  hal.pwmWrite(config.ledcChannel, duty);
   lastDuty = duty;
 
-  Serial.print("[Vacuum] Forward | speed=");
-  Serial.print(speedPercent);
-  Serial.print("% (duty=");
-  Serial.print(duty);
-  Serial.print("/");
-  Serial.print(getMaxDuty());
-  Serial.println(")");
+  LOG_DEBUG("[Vacuum] Forward | speed=%u%% (duty=%lu/%lu)",
+            speedPercent, (unsigned long)duty, (unsigned long)getMaxDuty());
   logPinStates("        ");
 }
 
-void VacuumPump::controlVacuumPump(VacuumPumpState state, uint8_t speedPercent, uint32_t duration) {
+void VacuumPump::controlVacuumPump(VacuumPumpState state, uint8_t speedPercent, uint32_t durationMs) {
+  if (state == VACUUM_REGULATING) {
+    LOG_WARN("[Vacuum] Regulation needs a target - use regulateVacuum()");
+    return;
+  }
   // Safety check before any operation
   if (!isSafeToRun() && state == VACUUM_RUNNING) {
-    Serial.println("[Vacuum] Safety check failed - operation blocked");
+    LOG_WARN("[Vacuum] Safety check failed (%s) - operation blocked", pressureStateName(getPressureState()));
     return;
   }
 
+  HalLock guard(hal);
+  // Any new command supersedes a pending timed stop
+  hal.stopTimer(stopTimer);
   currentState = state;
-  currentSpeedPercent = speedPercent;
-  runDuration = duration;
-  
+  // A stop keeps the speed, which the next start without one reuses
+  if (state != VACUUM_STOPPED) currentSpeedPercent = speedPercent;
+  runDurationMs = durationMs;
+
   switch (state) {
     case VACUUM_STOPPED:
       motorCoast();
       isTimedRun = false;
-      Serial.println("[Vacuum] Vacuum pump stopped");
+      LOG_INFO("[Vacuum] Vacuum pump stopped");
       break;
     case VACUUM_RUNNING:
+      lastTrip = PRESSURE_OK;
       motorForward(speedPercent);
-      if (duration > 0) {
-        isTimedRun = true;
-        pumpStartTime = millis();
-        Serial.println("[Vacuum] Vacuum pump started for " + String(duration) + " seconds");
-      } else {
-        isTimedRun = false;
-        Serial.println("[Vacuum] Vacuum pump started (continuous)");
-      }
+      startTimedRun(durationMs);
       break;
+    case VACUUM_REGULATING:
+      break;  // Turned away above
+  }
+}
+
+void VacuumPump::regulateVacuum(uint32_t targetPressurePa, uint32_t durationMs) {
+  if (pressure == NULL) {
+    LOG_WARN("[Vacuum] No gauge fitted - cannot regulate");
+    return;
+  }
+  if (!isSafeToRun()) {
+    LOG_WARN("[Vacuum] Safety check failed (%s) - operation blocked", pressureStateName(getPressureState()));
+    return;
+  }
+
+  HalLock guard(hal);
+  hal.stopTimer(stopTimer);
+  // A new target while regulating keeps the integral; from a fixed-speed
+  // run it starts at that run's duty, so neither switch is a bump
+  if (currentState == VACUUM_STOPPED) {
+    regulator.reset();
+    enableDriver();
+    Tb6612Driver::setInputs(hal, config, true, false);
+    hal.pwmWrite(config.ledcChannel, 0);
+    lastDuty = 0;
+  } else if (currentState == VACUUM_RUNNING) {
+    regulator.reset((float)lastDuty / getMaxDuty());
+  }
+  currentState = VACUUM_REGULATING;
+  targetPa = targetPressurePa;
+  runDurationMs = durationMs;
+  lastTrip = PRESSURE_OK;
+  LOG_INFO("[Vacuum] Regulating to %lu Pa", (unsigned long)targetPa);
+  startTimedRun(durationMs);
+}
+
+void VacuumPump::startTimedRun(uint32_t durationMs) {
+  if (durationMs > 0) {
+    isTimedRun = true;
+    pumpStartTime = hal.nowMs();
+    stopDeadlineUs = hal.nowUs() + (uint64_t)durationMs * 1000;
+    hal.startTimerOnce(stopTimer, (uint64_t)durationMs * 1000);
+    LOG_INFO("[Vacuum] Vacuum pump started for %lu ms", (unsigned long)durationMs);
+  } else {
+    isTimedRun = false;
+    LOG_INFO("[Vacuum] Vacuum pump started (continuous)");
+  }
+}
+
+void VacuumPump::onPressure(void* arg, int32_t pressurePa, PressureState state) {
+  static_cast<VacuumPump*>(arg)->pressureReading(pressurePa, state);
+}
+
+// In the gauge's sampling task, for every reading
+void VacuumPump::pressureReading(int32_t pressurePa, PressureState state) {
+  if (state != PRESSURE_OK) {
+    // Inputs low before taking the lock: one GPIO write that coasts the
+    // motor whatever else is using the driver, so the cutoff never waits
+    // behind a command or a status read. Changes nothing when stopped.
+    Tb6612Driver::setInputs(hal, config, false, false);
   }
+
+  HalLock guard(hal);
+  if (currentState == VACUUM_STOPPED) return;
+  if (state != PRESSURE_OK) {
+    trip(state, pressurePa);
+  } else if (currentState == VACUUM_REGULATING) {
+    regulate(pressurePa);
+  }
+}
+
+void VacuumPump::regulate(int32_t pressurePa) {
+  float error = ((float)targetPa - pressurePa) / pressure->getConfig().fullScalePa;
+  float out = regulator.update(error, 0.0f, PressureMonitor::READING_US);
+  uint32_t duty = (uint32_t)(out * getMaxDuty() + 0.5f);
+  if (duty != lastDuty) {
+    hal.pwmWrite(config.ledcChannel, duty);
+    lastDuty = duty;
+  }
+  currentSpeedPercent = dutyToPercent(duty);
+}
+
+void VacuumPump::trip(PressureState state, int32_t pressurePa) {
+  hal.stopTimer(stopTimer);
+  motorCoast();
+  currentState = VACUUM_STOPPED;
+  isTimedRun = false;
+  lastTrip = state;
+  LOG_ERROR("[Vacuum] Interlock: %s at %ld Pa - vacuum pump stopped", pressureStateName(state), (long)pressurePa);
+
+  if (stopListener != NULL) stopListener(stopListenerArg);
+}
+
+void VacuumPump::onStopTimer(void* arg) {
+  static_cast<VacuumPump*>(arg)->timedStop();
+}
+
+void VacuumPump::timedStop() {
+  HalLock guard(hal);
+  if (!isTimedRun || currentState == VACUUM_STOPPED) return;
+
+  // Ignore a stale callback whose run has been replaced by a later one
+  uint64_t now = hal.nowUs();
+  if (now < stopDeadlineUs) return;
+
+  motorCoast();
+  currentState = VACUUM_STOPPED;
+  isTimedRun = false;
+  metrics.timedStopError.observe((uint32_t)(now - stopDeadlineUs));
+  LOG_INFO("[Vacuum] Timed run completed (%lu us after deadline). Vacuum pump stopped.",
+           (unsigned long)(now - stopDeadlineUs));
+
+  if (stopListener != NULL) stopListener(stopListenerArg);
 }
 
 void VacuumPump::update() {
-  // Check if timed run should stop
-  if (isTimedRun && currentState != VACUUM_STOPPED) {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = (currentTime - pumpStartTime) / 1000; // Convert to seconds
-    
-    if (elapsedTime >= runDuration) {
-      Serial.println("[Vacuum] Timed run completed. Stopping vacuum pump.");
-      controlVacuumPump(VACUUM_STOPPED, currentSpeedPercent, 0);
-    }
+  if (currentState != VACUUM_STOPPED && !isSafeToRun()) {
+    // Every reading is checked as it arrives; what gets here is a gauge
+    // that has stopped sending them
+    HalLock guard(hal);
+    if (currentState != VACUUM_STOPPED) trip(getPressureState(), getPressurePa());
+    return;
+  }
+  if (isTimedRun && currentState != VACUUM_STOPPED && hal.nowUs() >= stopDeadlineUs + TIMER_GRACE_US) {
+    LOG_WARN("[Vacuum] Stop timer late, stopping from update()");
+    timedStop();
   }
 }
 
-uint32_t VacuumPump::getRemainingTime() const {
+uint32_t VacuumPump::getRemainingTimeMs() const {
   if (isTimedRun && currentState != VACUUM_STOPPED) {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = (currentTime - pumpStartTime) / 1000;
-    return (runDuration > elapsedTime) ? (runDuration - elapsedTime) : 0;
+    uint64_t now = hal.nowUs();
+    return (stopDeadlineUs > now) ? (uint32_t)((stopDeadlineUs - now + 999) / 1000) : 0;
   }
   return 0;
 }
 
 void VacuumPump::emergencyStop() {
-  Serial.println("[Vacuum] EMERGENCY STOP - Vacuum pump stopped immediately");
-  disableDriver();  // PWM=0 + STBY=LOW for fastest, gentlest stop
+  HalLock guard(hal);
+  LOG_WARN("[Vacuum] EMERGENCY STOP - Vacuum pump stopped immediately");
+  hal.stopTimer(stopTimer);
+  // Inputs low (coast) and PWM=0; STBY only drops once the other channel
+  // is idle too, so the inputs are what stops this motor
+  Tb6612Driver::setInputs(hal, config, false, false);
+  disableDriver();
   currentState = VACUUM_STOPPED;
   isTimedRun = false;
 }
 
 bool VacuumPump::isSafeToRun() const {
-  // Add safety checks here
-  // For example: temperature, pressure sensors, etc.
-  // For now, always return true, but this can be expanded
-  return true;
+  return getPressureState() == PRESSURE_OK;
 }
@@ -0,0 +1,149 @@
+// Generated by tools/embed_web.py from web/index.html - do not edit.
+// Original size: 6419 bytes, gzip size: 2245 bytes
+#include "web_page.h"
+
+const uint8_t INDEX_HTML_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x9d, 0x59, 0x6d, 0x73, 0xdb, 0x36,
+  0x12, 0xfe, 0xae, 0x5f, 0xb1, 0x61, 0xd3, 0x92, 0xbc, 0xb3, 0xde, 0x2c, 0xbb, 0xcd, 0x49, 0x96,
+  0x3a, 0x39, 0xc7, 0x6e, 0x73, 0x13, 0x5f, 0x34, 0x96, 0x93, 0x99, 0x1b, 0x4f, 0xe6, 0x06, 0x26,
+  0x21, 0x09, 0x35, 0x45, 0xf2, 0x40, 0x50, 0xb2, 0x9a, 0xea, 0xbf, 0xdf, 0x2e, 0x00, 0x52, 0x94,
+  0x44, 0xb9, 0x4e, 0x93, 0xc9, 0x90, 0x04, 0x76, 0x1f, 0xec, 0xfb, 0x2e, 0x94, 0x8b, 0x57, 0xef,
+  0x3e, 0x5e, 0xde, 0xfd, 0x67, 0x7c, 0x05, 0x73, 0xb5, 0x88, 0x46, 0x8d, 0x8b, 0xe2, 0xc1, 0x59,
+  0x88, 0x8f, 0x05, 0x57, 0x0c, 0x82, 0x39, 0x93, 0x19, 0x57, 0x43, 0xe7, 0xd3, 0xdd, 0x75, 0xf3,
+  0x8d, 0x53, 0x2c, 0xc7, 0x6c, 0xc1, 0x87, 0xce, 0x52, 0xf0, 0x55, 0x9a, 0x48, 0xe5, 0x40, 0x90,
+  0xc4, 0x8a, 0xc7, 0x48, 0xb6, 0x12, 0xa1, 0x9a, 0x0f, 0x43, 0xbe, 0x14, 0x01, 0x6f, 0xea, 0x8f,
+  0x13, 0x10, 0xb1, 0x50, 0x82, 0x45, 0xcd, 0x2c, 0x60, 0x11, 0x1f, 0x76, 0x09, 0x44, 0x09, 0x15,
+  0xf1, 0xd1, 0x98, 0x4b, 0x91, 0x29, 0x16, 0x29, 0x11, 0xc0, 0x38, 0x5f, 0xa4, 0x70, 0x89, 0x30,
+  0x32, 0x89, 0x22, 0x2e, 0x2f, 0xda, 0x86, 0xa4, 0x71, 0x91, 0xa9, 0x35, 0x3d, 0x1f, 0x92, 0x70,
+  0x0d, 0x5f, 0x61, 0x8a, 0x14, 0xcd, 0x29, 0x5b, 0x88, 0x68, 0xdd, 0x87, 0xb7, 0x12, 0x61, 0x4f,
+  0x20, 0x63, 0x71, 0xd6, 0xcc, 0x10, 0x6b, 0x3a, 0x80, 0x05, 0x93, 0x33, 0x11, 0xf7, 0xe1, 0xac,
+  0x93, 0x3e, 0x0d, 0xe0, 0x81, 0x05, 0x8f, 0x33, 0x99, 0xe4, 0x71, 0xd8, 0x0c, 0x92, 0x28, 0x91,
+  0x7d, 0xf8, 0x6e, 0xda, 0xa1, 0xbf, 0x03, 0xd8, 0x34, 0x5a, 0x24, 0x34, 0x13, 0x31, 0x97, 0x88,
+  0x7b, 0x48, 0xb9, 0x9a, 0x0b, 0xc5, 0x07, 0x90, 0xb2, 0x30, 0x14, 0xf1, 0xac, 0x0f, 0x3d, 0x83,
+  0x98, 0xc8, 0x90, 0xcb, 0xa6, 0x64, 0xa1, 0xc8, 0xb3, 0x3e, 0x74, 0xed, 0xe2, 0x53, 0x33, 0x9b,
+  0xb3, 0x30, 0x59, 0xf5, 0xa1, 0x03, 0xa7, 0xe9, 0x93, 0x5e, 0x07, 0x39, 0x7b, 0x60, 0x5e, 0xe7,
+  0x44, 0xff, 0x6d, 0x75, 0x7d, 0x3a, 0x73, 0xde, 0xc5, 0xb3, 0x0a, 0x51, 0x7a, 0xbd, 0xde, 0x00,
+  0x14, 0x7f, 0x52, 0x4d, 0x16, 0x89, 0x19, 0x0a, 0x1d, 0xa0, 0x09, 0xb9, 0x2c, 0x65, 0x43, 0x4b,
+  0x34, 0x49, 0xa6, 0x14, 0x79, 0x0a, 0xbd, 0x4e, 0x09, 0xb8, 0x73, 0x8c, 0xed, 0x21, 0x57, 0x2a,
+  0x89, 0x91, 0xbc, 0x94, 0xba, 0x7b, 0x8e, 0xf4, 0x46, 0xf4, 0x02, 0xc2, 0xc8, 0xac, 0x0d, 0x99,
+  0x89, 0xdf, 0x39, 0x2e, 0xfc, 0xb8, 0xd5, 0xac, 0x0f, 0x71, 0x12, 0xf3, 0x03, 0x3d, 0xcf, 0x89,
+  0x22, 0xc8, 0x65, 0x46, 0x82, 0xa7, 0x89, 0x28, 0xe5, 0x9c, 0x26, 0x72, 0xc5, 0x64, 0x58, 0x6b,
+  0xc1, 0xef, 0xce, 0x2e, 0xdf, 0x5e, 0x9f, 0xa3, 0xb0, 0xbb, 0x16, 0x45, 0x2e, 0xc9, 0x97, 0x1c,
+  0xc3, 0xaa, 0x9e, 0x6b, 0x7a, 0x76, 0xd6, 0xeb, 0xfd, 0x58, 0xc3, 0x95, 0xa9, 0x24, 0x3d, 0xc2,
+  0x32, 0xfd, 0xc7, 0x9b, 0x4e, 0xdd, 0x41, 0x7c, 0xc1, 0xe5, 0x8c, 0xc7, 0xc1, 0xfa, 0x18, 0x5f,
+  0xa7, 0x53, 0xc7, 0x67, 0xec, 0xd8, 0x9f, 0x27, 0x4b, 0x1d, 0x1c, 0x49, 0xca, 0x02, 0xa1, 0x30,
+  0xe0, 0x3a, 0xad, 0x37, 0x56, 0x12, 0xa6, 0xf2, 0xac, 0xc6, 0x2d, 0x3b, 0x76, 0xaf, 0x8d, 0x3f,
+  0xfe, 0xd3, 0xb4, 0x37, 0x9d, 0xd6, 0x1b, 0x78, 0xd3, 0x10, 0x71, 0x9a, 0xab, 0x7b, 0xb5, 0x4e,
+  0xf9, 0xd0, 0x95, 0x2c, 0x9e, 0x71, 0xf7, 0x0b, 0x9e, 0xa2, 0xf3, 0x88, 0x0e, 0xa9, 0xf1, 0xe3,
+  0xa6, 0x71, 0xd1, 0xb6, 0x29, 0x72, 0xd1, 0xb6, 0x99, 0x4b, 0xb9, 0x82, 0x8f, 0x50, 0x2c, 0x21,
+  0x88, 0x58, 0x96, 0x0d, 0x9d, 0x32, 0xd4, 0x29, 0xf9, 0xe6, 0xdd, 0xe7, 0x33, 0x0f, 0xf7, 0x1b,
+  0x3b, 0xdc, 0x46, 0x5d, 0x07, 0x44, 0x38, 0x74, 0x52, 0xa4, 0x6e, 0xda, 0x05, 0xc2, 0xea, 0x1d,
+  0x62, 0x4d, 0xf4, 0x6e, 0x1f, 0x81, 0x7a, 0x48, 0x91, 0x8e, 0xec, 0x37, 0x5c, 0x64, 0x29, 0x8b,
+  0x4b, 0x10, 0x5a, 0xe5, 0xce, 0xa8, 0x89, 0xe2, 0xe3, 0xf2, 0xe8, 0xa2, 0x9d, 0x1a, 0xe2, 0x94,
+  0xf3, 0xf0, 0x80, 0x96, 0x16, 0x0f, 0x68, 0xcb, 0xed, 0x5b, 0xbe, 0x40, 0xe5, 0xd0, 0xee, 0xb7,
+  0xc9, 0xca, 0x81, 0xb9, 0x08, 0x43, 0x1e, 0x8f, 0xca, 0x45, 0x50, 0x62, 0xc1, 0xf7, 0x11, 0xcb,
+  0x5d, 0x67, 0xd4, 0xb1, 0xa8, 0x90, 0x71, 0x34, 0x53, 0x98, 0x19, 0xf4, 0x36, 0xea, 0xff, 0x8c,
+  0x19, 0x96, 0x2c, 0xc8, 0xf3, 0xc5, 0xae, 0x21, 0x3e, 0xeb, 0xb5, 0x97, 0xda, 0xc0, 0x20, 0xbc,
+  0xd4, 0x0a, 0x96, 0xba, 0xd6, 0x0e, 0xf6, 0xe0, 0x43, 0xf2, 0xb1, 0xe4, 0x59, 0x96, 0xcb, 0x0a,
+  0x3e, 0x3c, 0x8e, 0xd9, 0x3e, 0xd5, 0x1d, 0xc6, 0x13, 0x57, 0xce, 0x68, 0x0f, 0xf4, 0x17, 0x96,
+  0xcf, 0xf8, 0x21, 0xe6, 0x7b, 0x4a, 0xfd, 0x28, 0x09, 0x1e, 0xeb, 0xdd, 0x61, 0x88, 0xbe, 0xd1,
+  0x21, 0x7b, 0x4c, 0xdf, 0xe0, 0x92, 0x9d, 0x32, 0x79, 0x2c, 0x1e, 0x6d, 0x6c, 0x17, 0xce, 0xb0,
+  0x45, 0xd2, 0x22, 0xd8, 0x02, 0xe6, 0x40, 0x12, 0x07, 0x91, 0x08, 0x1e, 0x4b, 0x4c, 0x62, 0xf5,
+  0x5c, 0xbb, 0xed, 0xfa, 0xce, 0xe8, 0xda, 0x96, 0x3a, 0x6f, 0xc2, 0x16, 0x69, 0xc4, 0x01, 0x2d,
+  0xc1, 0x1e, 0xb9, 0x7f, 0xd1, 0x36, 0x80, 0x07, 0xc8, 0xb6, 0xc8, 0x1d, 0x43, 0xb6, 0xdb, 0x84,
+  0x7c, 0x6b, 0xcb, 0xa1, 0xf7, 0x41, 0xfc, 0x2f, 0x17, 0x21, 0x5c, 0x3d, 0x29, 0xc9, 0x02, 0x25,
+  0x92, 0xf8, 0x38, 0x3a, 0x15, 0xc3, 0x63, 0xd0, 0xb4, 0x47, 0xb8, 0x13, 0x7c, 0x56, 0x00, 0x5e,
+  0x68, 0xbf, 0x6a, 0x18, 0xff, 0x35, 0xd3, 0x19, 0x84, 0x42, 0x16, 0x26, 0x95, 0x11, 0x06, 0x5f,
+  0xc0, 0x6c, 0x1d, 0xd5, 0xea, 0x10, 0x72, 0x9e, 0x44, 0xa1, 0x61, 0xf2, 0x10, 0xe4, 0x57, 0xfc,
+  0x3a, 0xc4, 0xd0, 0x55, 0x13, 0x74, 0xd5, 0x74, 0xe2, 0x7c, 0xf1, 0x80, 0x65, 0x4e, 0xc7, 0x95,
+  0xd2, 0x91, 0xfd, 0x9e, 0x76, 0x1d, 0x58, 0x88, 0x78, 0xe8, 0x74, 0xf1, 0xc9, 0x9e, 0x86, 0xce,
+  0x4f, 0xe7, 0x0e, 0x64, 0x8a, 0xa7, 0x43, 0xa7, 0xd3, 0xc2, 0xd7, 0x25, 0x8b, 0x72, 0xe4, 0x3d,
+  0xeb, 0xd0, 0x2a, 0xd6, 0x52, 0x3b, 0xc7, 0xf4, 0xe1, 0x8d, 0xae, 0xb1, 0x65, 0x55, 0x3f, 0x3f,
+  0xa8, 0xbf, 0x64, 0xb3, 0x6d, 0x66, 0x99, 0xa8, 0x7d, 0x99, 0xab, 0x76, 0x8d, 0xb4, 0x75, 0xd8,
+  0x9f, 0x99, 0xa8, 0x6c, 0x69, 0xcf, 0x43, 0x96, 0x64, 0x84, 0x7b, 0x55, 0xb6, 0xc1, 0xbf, 0x16,
+  0x12, 0xba, 0xee, 0xec, 0x07, 0x43, 0xd5, 0xea, 0xba, 0x57, 0x19, 0xa3, 0x67, 0x44, 0x3b, 0x89,
+  0x44, 0x48, 0x5e, 0x30, 0x46, 0xef, 0x74, 0xac, 0xd9, 0xbb, 0x9d, 0xd3, 0x5e, 0x69, 0xed, 0xf3,
+  0xee, 0xa9, 0x56, 0x61, 0x4e, 0xbc, 0x43, 0x27, 0x4f, 0x43, 0x2c, 0x85, 0xfa, 0x24, 0x4f, 0xcd,
+  0x45, 0xd6, 0xd2, 0x64, 0x7e, 0x61, 0xe0, 0x2d, 0xf6, 0x67, 0x5a, 0x77, 0x46, 0xc8, 0x5e, 0xda,
+  0xfb, 0x85, 0x6a, 0xdc, 0xe6, 0x31, 0xbc, 0xcb, 0x25, 0xa3, 0xcc, 0x02, 0xcf, 0xd6, 0x16, 0xbf,
+  0x4e, 0x9f, 0x6a, 0x14, 0x85, 0x96, 0xa3, 0x1a, 0x47, 0x38, 0xcf, 0x59, 0x95, 0x7a, 0x9d, 0xce,
+  0x36, 0x94, 0xba, 0x5b, 0xe5, 0xf6, 0x23, 0xa9, 0xdb, 0x79, 0x79, 0x28, 0x95, 0x55, 0x6f, 0x47,
+  0xbd, 0x52, 0xcb, 0x2c, 0x90, 0x22, 0x55, 0xa3, 0xc6, 0x92, 0x49, 0x18, 0x7f, 0xba, 0x19, 0xff,
+  0x77, 0x72, 0xf7, 0xf6, 0xee, 0x6a, 0x02, 0x43, 0x1c, 0x15, 0x28, 0x92, 0x52, 0x6a, 0x1d, 0xee,
+  0xc4, 0xbc, 0xb9, 0x27, 0x60, 0x93, 0x0a, 0xd7, 0x8e, 0x94, 0x30, 0xa4, 0xb1, 0xd5, 0x08, 0x69,
+  0x9e, 0x29, 0x46, 0x2e, 0x6c, 0x06, 0xfa, 0xd4, 0xcf, 0x6f, 0x2f, 0x3f, 0x7d, 0xba, 0xf9, 0xb3,
+  0x73, 0x65, 0x1e, 0xc7, 0x5a, 0x57, 0xf7, 0xd6, 0xbc, 0x81, 0x67, 0x6b, 0xcb, 0x2f, 0x1c, 0x47,
+  0x11, 0x66, 0x30, 0xe9, 0xec, 0x59, 0x1e, 0xe1, 0x97, 0x26, 0xa5, 0x0c, 0x27, 0x52, 0x43, 0x59,
+  0x9e, 0x68, 0xdd, 0x99, 0xbd, 0x37, 0x77, 0x09, 0x9c, 0x5b, 0x43, 0x3c, 0x77, 0xca, 0xa2, 0x8c,
+  0x0f, 0x1a, 0x8d, 0x69, 0x1e, 0x6b, 0x09, 0xe1, 0xb5, 0x27, 0x42, 0x1f, 0xc5, 0x91, 0x5c, 0xe5,
+  0x32, 0x86, 0x30, 0x09, 0xf2, 0x05, 0x4e, 0xc7, 0x2d, 0x2c, 0x03, 0x57, 0x11, 0xa7, 0xd7, 0x7f,
+  0xae, 0xdf, 0x87, 0x44, 0x44, 0x93, 0xd3, 0x96, 0x2f, 0xe3, 0x71, 0x78, 0x99, 0x2c, 0x16, 0x2c,
+  0x0e, 0xbd, 0x5c, 0xe2, 0x9d, 0xc2, 0x68, 0x7c, 0x02, 0x11, 0x7b, 0xe0, 0xf8, 0xc9, 0xc9, 0x08,
+  0x08, 0xdc, 0x00, 0x20, 0x69, 0xf4, 0x65, 0x84, 0xd4, 0x36, 0x64, 0xfd, 0x92, 0x3c, 0x33, 0x7d,
+  0x3b, 0xa5, 0x4b, 0x13, 0x1a, 0xd7, 0x7b, 0x8d, 0xb9, 0xbd, 0xcd, 0x07, 0xd7, 0xb7, 0x41, 0x7d,
+  0x02, 0x45, 0x50, 0xdd, 0xe0, 0x4c, 0x70, 0xc3, 0xd4, 0xbc, 0xa5, 0xa7, 0x44, 0x4f, 0x33, 0x5e,
+  0x47, 0x09, 0xd3, 0xac, 0x3b, 0x91, 0x57, 0x32, 0xc3, 0xdf, 0x28, 0x98, 0x3a, 0x3e, 0x99, 0x06,
+  0xc8, 0xb9, 0xe0, 0x91, 0x4c, 0x8f, 0x7c, 0x8d, 0x37, 0xad, 0x42, 0x52, 0x92, 0xf0, 0x1e, 0x97,
+  0xbe, 0xa0, 0x98, 0x7a, 0x49, 0x7f, 0x68, 0x06, 0xae, 0x82, 0xb9, 0x51, 0x92, 0xd4, 0x01, 0xc0,
+  0x0b, 0xdd, 0x3c, 0x21, 0xcf, 0x8d, 0x3f, 0x4e, 0xee, 0xdc, 0x13, 0xbd, 0x46, 0x83, 0x24, 0x46,
+  0x41, 0x1f, 0x55, 0x74, 0x2f, 0xcd, 0xdd, 0xae, 0x79, 0x87, 0x99, 0xe1, 0x22, 0x19, 0x4b, 0x53,
+  0xac, 0x3a, 0x5a, 0xb0, 0xf6, 0x6f, 0x59, 0x12, 0xa3, 0x8f, 0x0c, 0x13, 0x9d, 0xd9, 0x87, 0x7f,
+  0x4d, 0x3e, 0xfe, 0x1b, 0x07, 0x64, 0x89, 0x4e, 0x14, 0xd3, 0xb5, 0x47, 0x8b, 0x3e, 0x6e, 0x6f,
+  0xfc, 0x96, 0x9a, 0xf3, 0xd8, 0x2b, 0x4d, 0xee, 0xe1, 0x70, 0x92, 0x26, 0x71, 0xc6, 0x2b, 0xfe,
+  0x2a, 0x96, 0x5a, 0x84, 0xeb, 0x91, 0x8f, 0x7c, 0x8d, 0xbc, 0xcf, 0x8a, 0x95, 0xc2, 0x7a, 0x83,
+  0xfe, 0xe0, 0xad, 0x52, 0x2a, 0x4f, 0x7b, 0x0a, 0xfe, 0x0e, 0x24, 0x22, 0x3e, 0x34, 0x4d, 0x2b,
+  0xcb, 0x83, 0x00, 0x67, 0x20, 0xf8, 0x19, 0xe3, 0xd2, 0xbc, 0xba, 0x40, 0x79, 0xc0, 0x44, 0x84,
+  0x21, 0xea, 0xfb, 0x03, 0x0b, 0x61, 0x8b, 0x8f, 0x1e, 0xd2, 0x3c, 0xbb, 0xba, 0xc1, 0x67, 0x35,
+  0x46, 0xaa, 0x2d, 0xd6, 0x26, 0x04, 0x05, 0x7e, 0x25, 0x72, 0xdc, 0x36, 0x4b, 0x45, 0xdb, 0xd2,
+  0xb9, 0xdb, 0x20, 0x72, 0x75, 0x2f, 0x2d, 0xd6, 0x75, 0xe8, 0xed, 0xa3, 0x56, 0x4a, 0xf7, 0x73,
+  0xd8, 0x66, 0x52, 0xaa, 0x42, 0xdb, 0x8c, 0xaa, 0x07, 0xaf, 0x36, 0x4f, 0x6d, 0xae, 0x67, 0x10,
+  0x6d, 0xa7, 0x3e, 0x84, 0xc4, 0x38, 0x01, 0xd3, 0x49, 0xc7, 0xec, 0x99, 0x60, 0xad, 0x34, 0xdb,
+  0x9a, 0x50, 0xdd, 0xb3, 0x65, 0xb5, 0xd8, 0x5b, 0xd2, 0xaf, 0x50, 0x24, 0x8b, 0x2e, 0xf0, 0x88,
+  0x41, 0x77, 0x5c, 0x1b, 0x7c, 0x18, 0xc5, 0x9a, 0x6c, 0x2f, 0x6b, 0xe7, 0xc9, 0xaa, 0x9c, 0x1a,
+  0xbd, 0x54, 0xf2, 0xa9, 0x78, 0xc2, 0x1c, 0xd4, 0x5e, 0x34, 0xfa, 0xbe, 0xb6, 0xab, 0x14, 0x17,
+  0xd5, 0xa1, 0x14, 0xd1, 0xcd, 0x54, 0x8a, 0xc0, 0xaf, 0x0c, 0x43, 0x4b, 0x64, 0x77, 0x38, 0x97,
+  0x86, 0x58, 0xab, 0x06, 0xc7, 0x38, 0x0f, 0x84, 0xf2, 0x2c, 0xaf, 0x2c, 0x28, 0x6e, 0x32, 0x68,
+  0x1b, 0x9d, 0x5b, 0x2a, 0xb9, 0x16, 0x4f, 0xa8, 0x5f, 0xd7, 0xe8, 0x4e, 0x39, 0x6a, 0xef, 0x8d,
+  0x54, 0x39, 0xe8, 0x12, 0x82, 0xe9, 0xb5, 0x39, 0x81, 0xa5, 0x9d, 0xde, 0xbf, 0x6e, 0x28, 0xa3,
+  0xb7, 0xda, 0x49, 0xf4, 0x15, 0x97, 0xde, 0xb6, 0xea, 0x10, 0x0b, 0xf2, 0xda, 0x23, 0xe9, 0xab,
+  0x60, 0xde, 0xae, 0x9a, 0x6f, 0xa3, 0x80, 0x5b, 0x5e, 0xb3, 0x0e, 0xe4, 0xae, 0xb4, 0x8d, 0x7b,
+  0xa2, 0xd2, 0x37, 0x5a, 0xfe, 0x05, 0xfe, 0xf8, 0x03, 0xb6, 0x9f, 0x55, 0x14, 0xf2, 0xcb, 0x01,
+  0x8a, 0x21, 0xd5, 0xb3, 0x01, 0x5a, 0xa9, 0x4d, 0xdd, 0x1d, 0x3c, 0x4a, 0xbe, 0x6a, 0x90, 0x6c,
+  0x69, 0x74, 0x30, 0x68, 0xf3, 0x9c, 0xf6, 0x7c, 0xe2, 0xf8, 0xde, 0x77, 0xe9, 0x8c, 0x5d, 0x37,
+  0xea, 0xf3, 0x30, 0xe8, 0xe8, 0xe1, 0x5b, 0x11, 0x2a, 0x77, 0xa5, 0x03, 0x21, 0x76, 0x7a, 0xd1,
+  0xbd, 0xa1, 0xac, 0xa8, 0x53, 0x5d, 0xd8, 0x45, 0xab, 0x55, 0xa9, 0x20, 0x2f, 0x94, 0xfa, 0xde,
+  0xdd, 0x61, 0x2a, 0x6e, 0x54, 0xc7, 0xf8, 0x52, 0xbb, 0x3f, 0x66, 0x30, 0x1c, 0x0e, 0x01, 0x0d,
+  0x80, 0x31, 0x14, 0x23, 0x14, 0x16, 0xa0, 0x26, 0x95, 0x1e, 0xef, 0x90, 0xb0, 0x2e, 0x5e, 0x2a,
+  0x47, 0x9a, 0xeb, 0xd9, 0xb1, 0x03, 0x8b, 0xc4, 0xa4, 0x03, 0xc0, 0x9b, 0xdb, 0xe6, 0xa9, 0x0b,
+  0xe0, 0x3e, 0xc5, 0xe1, 0x39, 0xa4, 0xa0, 0xaf, 0x0b, 0xe2, 0xae, 0x96, 0xe5, 0x1d, 0xef, 0xd8,
+  0xa9, 0xa2, 0x20, 0x20, 0x0b, 0xa3, 0x62, 0x35, 0x5e, 0x2c, 0xeb, 0x8a, 0x79, 0xd1, 0x3a, 0x89,
+  0x29, 0x78, 0xaf, 0xea, 0x3a, 0xf9, 0x0f, 0x3f, 0x54, 0x63, 0xe9, 0x55, 0xd5, 0x72, 0x45, 0x99,
+  0xaf, 0xef, 0xa4, 0x3b, 0x41, 0x68, 0xca, 0x76, 0xb5, 0xb4, 0x6c, 0xf7, 0x6c, 0x4d, 0xaf, 0x1f,
+  0x23, 0x94, 0xcc, 0x75, 0x6c, 0x6c, 0x28, 0x4f, 0xdb, 0x6d, 0xb8, 0xa1, 0x69, 0x19, 0x18, 0x4c,
+  0xf3, 0x28, 0x2a, 0x72, 0x16, 0xdb, 0x2c, 0x83, 0x90, 0x47, 0x0a, 0x97, 0x65, 0xb2, 0x00, 0x5d,
+  0x3c, 0x71, 0x54, 0x8a, 0x55, 0x86, 0x6d, 0x57, 0x25, 0x80, 0x2d, 0x0a, 0xd0, 0x24, 0x2c, 0xc2,
+  0x43, 0xd2, 0xf5, 0x36, 0x8d, 0xf5, 0xe8, 0xed, 0x19, 0xa9, 0x8c, 0x32, 0x65, 0xcb, 0x36, 0x3f,
+  0xee, 0x89, 0xa2, 0x1c, 0x16, 0xaa, 0x92, 0x99, 0x68, 0x0c, 0x4d, 0xa6, 0x76, 0xe3, 0x5e, 0x13,
+  0x7e, 0xd1, 0x86, 0x71, 0x93, 0x87, 0xdf, 0x78, 0x80, 0xf1, 0xa0, 0x75, 0x11, 0xb1, 0x91, 0x1c,
+  0xac, 0x98, 0x05, 0xe5, 0x70, 0xef, 0x1b, 0xdd, 0xf4, 0x75, 0x63, 0x08, 0xf7, 0x07, 0x86, 0x9d,
+  0x23, 0xfc, 0x5d, 0xbe, 0x62, 0x82, 0xd8, 0xa1, 0x29, 0x27, 0x89, 0x0d, 0xfe, 0x2b, 0x8a, 0x54,
+  0x6d, 0x79, 0xb7, 0xed, 0xd4, 0x28, 0xad, 0xc7, 0x0e, 0xd3, 0x73, 0xcc, 0x19, 0x6e, 0x7d, 0x6f,
+  0xff, 0xe6, 0xb1, 0x40, 0x1b, 0xd8, 0x08, 0x80, 0xbe, 0xfb, 0x20, 0x96, 0xdc, 0x9e, 0x9f, 0x01,
+  0x93, 0x1c, 0xe3, 0x23, 0x9b, 0xa3, 0x97, 0x1f, 0xd6, 0xda, 0x43, 0xe6, 0x97, 0xe9, 0x01, 0x4d,
+  0x8e, 0x91, 0xfe, 0x79, 0x0e, 0xd0, 0x75, 0x69, 0x12, 0x45, 0x94, 0x36, 0x2b, 0x81, 0x93, 0x10,
+  0xdd, 0x01, 0xe6, 0x7c, 0xa1, 0xeb, 0x35, 0x6d, 0x50, 0x53, 0x90, 0x68, 0x83, 0x18, 0x83, 0x61,
+  0x50, 0xe9, 0x3d, 0xd4, 0x2d, 0xc7, 0x86, 0xd1, 0xaa, 0xa8, 0xc3, 0xbb, 0x64, 0xf1, 0x77, 0xb8,
+  0x33, 0x6a, 0x8d, 0x98, 0x34, 0x18, 0xb5, 0x5e, 0xd5, 0x3a, 0x27, 0x26, 0x29, 0xb5, 0xf4, 0xc4,
+  0xbf, 0x12, 0x71, 0x98, 0xac, 0x5a, 0x57, 0x14, 0x58, 0x93, 0x24, 0x97, 0x01, 0xdf, 0xd6, 0x7f,
+  0x1b, 0x6d, 0x28, 0x0a, 0x5f, 0x41, 0x85, 0xc2, 0x5a, 0xd5, 0x6c, 0xbb, 0x3a, 0xd2, 0xcd, 0x7b,
+  0x2b, 0x89, 0x17, 0x58, 0x66, 0xd8, 0x8c, 0xf2, 0x64, 0x6b, 0x61, 0x6d, 0x5a, 0x13, 0x96, 0x7a,
+  0x58, 0xd3, 0x7d, 0xdc, 0xe3, 0x2d, 0x3d, 0x55, 0x91, 0x75, 0x77, 0x10, 0x92, 0x54, 0x77, 0xc9,
+  0x2d, 0x3b, 0x71, 0x07, 0x11, 0x67, 0xb2, 0x54, 0x68, 0xab, 0xf3, 0xe0, 0xd0, 0x64, 0x7b, 0x70,
+  0x5c, 0xca, 0x44, 0x1e, 0xe0, 0x91, 0xea, 0x96, 0x44, 0xe2, 0xe8, 0xb9, 0xd6, 0xa5, 0x5e, 0x97,
+  0xd0, 0x8a, 0x9e, 0xad, 0xcb, 0x0f, 0x1f, 0x27, 0x57, 0xef, 0xfc, 0x3d, 0xdb, 0xeb, 0x13, 0x36,
+  0xc0, 0x23, 0xfa, 0x41, 0xb9, 0x01, 0xfb, 0xbb, 0x68, 0xd9, 0xfd, 0xe9, 0x0e, 0x2f, 0x56, 0xf6,
+  0x0a, 0x85, 0x57, 0x61, 0xf3, 0x5b, 0x69, 0xdb, 0xfc, 0xdf, 0xc7, 0xff, 0x01, 0x96, 0x81, 0xf4,
+  0xa3, 0x13, 0x19, 0x00, 0x00,
+};
+
+const size_t INDEX_HTML_GZ_LEN = sizeof(INDEX_HTML_GZ);
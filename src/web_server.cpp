@@ -1,459 +1,840 @@
 #include "web_server.h"
+#include "web_page.h"
+#include "status_json.h"
+#include "logger.h"
+#include <esp_timer.h>
 
-WebServerManager::WebServerManager(PeristalticPump* pumpInstance, VacuumPump* vacuumPumpInstance) : server(80) {
-  pump = pumpInstance;
-  vacuumPump = vacuumPumpInstance;
+WebServerManager::WebServerManager(CommandDispatcher* dispatcherInstance, FlowCalibration* calibrationInstance,
+                                   ProtocolSequencer* sequencerInstance, ProtocolStore* protocolsInstance,
+                                   EventLog* eventLogInstance, WiFiManager* wifiInstance,
+                                   BootProfile* bootInstance, PressureMonitor* pressureInstance)
+  : server(80), events(server) {
+  commands = dispatcherInstance;
+  calibration = calibrationInstance;
+  sequencer = sequencerInstance;
+  protocols = protocolsInstance;
+  eventLog = eventLogInstance;
+  wifi = wifiInstance;
+  boot = bootInstance;
+  pressure = pressureInstance;
+  observerListener = NULL;
+  observerListenerArg = NULL;
+  calibrationPending = false;
+  calibrationDuty = 0;
+  calibrationDurationMs = 0;
 }
 
 void WebServerManager::begin() {
-  // Setup Web Server Routes
-  server.on("/", [this]() { handleRoot(); });
-  server.on("/test", [this]() { handleTest(); });
-  server.on("/api/control", HTTP_POST, [this]() { handleControl(); });
-  server.on("/api/vacuum", HTTP_POST, [this]() { handleVacuumControl(); });
-  server.on("/api/status", [this]() { handleStatus(); });
+  // Setup Web Server Routes. Handlers run on the AsyncTCP task, one
+  // request at a time, and must not block.
+  server.on("/", [this](HttpExchange& ex) { handleRoot(ex); });
+  server.on("/test", HTTP_METHOD_GET, [this](HttpExchange& ex) { handleTest(ex); });
+  server.on("/api/control", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleControl(ex); });
+  server.on("/api/vacuum", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleVacuumControl(ex); });
+  server.on("/api/status", [this](HttpExchange& ex) { handleStatus(ex); });
+  server.on("/api/pressure", HTTP_METHOD_GET, [this](HttpExchange& ex) { handlePressure(ex); });
+  server.on("/api/events", HTTP_METHOD_GET, [this](HttpExchange& ex) { handleEvents(ex); });
+  server.on("/api/batch", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleBatch(ex); });
+  server.on("/api/log", HTTP_METHOD_GET, [this](HttpExchange& ex) { handleLog(ex); });
+  server.on("/metrics", HTTP_METHOD_GET, [this](HttpExchange& ex) { handleMetrics(ex); });
+  server.on("/api/dose", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleDose(ex); });
+  server.on("/api/calibrate", [this](HttpExchange& ex) { handleCalibrate(ex); });
+  server.on("/api/ramp", [this](HttpExchange& ex) { handleRamp(ex); });
+  server.on("/api/pumps", HTTP_METHOD_GET, [this](HttpExchange& ex) { handlePumps(ex); });
+  server.on("/api/pumps/*", [this](HttpExchange& ex) { handlePumpChannel(ex); });
+  server.on("/api/protocol", [this](HttpExchange& ex) { handleProtocol(ex); });
+  server.on("/api/protocol/run", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleProtocolRun(ex); });
+  server.on("/api/protocol/stop", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleProtocolStop(ex); });
+  server.on("/api/protocol/delete", HTTP_METHOD_POST, [this](HttpExchange& ex) { handleProtocolDelete(ex); });
   
   // Start Web Server
   server.begin();
-  Serial.println("[Web] Web server started");
+  LOG_INFO("[Web] Web server started");
 }
 
-void WebServerManager::handleClient() {
-  server.handleClient();
+// Requests are answered on the AsyncTCP task; loop() only expires idle
+// connections and feeds the event streams
+void WebServerManager::setObserverListener(void (*listener)(void* arg), void* arg) {
+  observerListener = listener;
+  observerListenerArg = arg;
+}
+
+// Idle connections are closed within a second of their timeout
+uint32_t WebServerManager::serviceConnections() {
+  server.service();
+  return 1000;
+}
+
+uint32_t WebServerManager::pollEvents() {
+  server.lock();
+  uint32_t nextMs = SCHEDULE_NEVER;
+  if (events.count() > 0) {
+    StatusView view = makeStatusView(commands->status(), sequencer->progress(), esp_timer_get_time());
+    nextMs = events.poll(view, millis());
+  }
+  server.unlock();
+  return nextMs;
 }
 
 void WebServerManager::printServerInfo() const {
-  Serial.println("[Web] Visit http://" + WiFi.localIP().toString() + " to control the peristaltic pump");
-}
-
-String WebServerManager::generateHTML() {
-  String html = "<!DOCTYPE html><html><head><meta charset='UTF-8'>";
-  html += "<title>Peristaltic Pump Controller</title>";
-  html += "<style>";
-  html += "body { font-family: Arial, sans-serif; margin: 40px; background-color: #f0f0f0; }";
-  html += ".container { background-color: white; padding: 30px; border-radius: 10px; box-shadow: 0 2px 10px rgba(0,0,0,0.1); }";
-  html += "h1 { color: #333; text-align: center; }";
-  html += ".control-group { margin: 20px 0; text-align: center; }";
-  html += "button { padding: 15px 30px; margin: 10px; font-size: 16px; border: none; border-radius: 5px; cursor: pointer; }";
-  html += ".forward { background-color: #4CAF50; color: white; }";
-  html += ".reverse { background-color: #f44336; color: white; }";
-  html += ".stop { background-color: #ff9800; color: white; }";
-  html += "button:hover { opacity: 0.8; }";
-  html += ".status { margin: 20px 0; padding: 15px; background-color: #e7f3ff; border-radius: 5px; }";
-  html += "input[type='range'] { width: 200px; margin: 10px; }";
-  html += "</style></head><body>";
-  html += "<div class='container'>";
-  html += "<h1>Peristaltic Pump Controller</h1>";
-  
-  // Display Current Status - Peristaltic Pump
-  html += "<div class='status' id='pump-status'>";
-  html += "<h3>Peristaltic Pump Status:</h3>";
-  switch (pump->getCurrentState()) {
-    case PUMP_STOPPED:
-      html += "<p>Status: Stopped</p>";
+  LOG_INFO("[Web] Visit http://%s to control the peristaltic pump", WiFi.localIP().toString().c_str());
+}
+
+// The precompressed page goes out straight from flash as the TCP window
+// allows, so no copy of it is ever built in RAM
+void WebServerManager::handleRoot(HttpExchange& ex) {
+  ex.sendStatic(200, "text/html", INDEX_HTML_GZ, INDEX_HTML_GZ_LEN,
+                "Content-Encoding: gzip\r\nCache-Control: no-cache\r\n");
+}
+
+static const char TEST_PAGE[] =
+  "<!DOCTYPE html><html><head><title>Test Page</title></head><body>"
+  "<h1>Test Page</h1>"
+  "<button onclick='testFunction()'>Test Button</button>"
+  "<p id='result'>Click the button to test</p>"
+  "<hr>"
+  "<h2>Main Page Test</h2>"
+  "<button onclick='controlPump(\"forward\")'>Test Forward</button>"
+  "<button onclick='controlVacuumPump(\"start\")'>Test Vacuum Start</button>"
+  "<input type='range' id='speedSlider' min='50' max='255' value='100' onchange='updateSpeed(this.value)'>"
+  "<span id='speedValue'>100</span>"
+  "<script>"
+  "function testFunction() {"
+  "  document.getElementById('result').innerHTML = 'Button clicked! JavaScript is working.';"
+  "}"
+  "function controlPump(action) {"
+  "  console.log('controlPump called with action:', action);"
+  "  var speed = parseInt(document.getElementById('speedSlider').value);"
+  "  var duration = 5;"
+  "  console.log('Sending:', {action: action, speed: speed, duration: duration});"
+  "  fetch('/api/control', {"
+  "    method: 'POST',"
+  "    headers: { 'Content-Type': 'application/json' },"
+  "    body: JSON.stringify({ action: action, speed: speed, duration: duration })"
+  "  }).then(response => response.json())"
+  "    .then(data => {"
+  "      console.log('Response:', data);"
+  "      alert('Pump control: ' + (data.success ? 'Success' : 'Failed'));"
+  "    });"
+  "}"
+  "function controlVacuumPump(action) {"
+  "  console.log('controlVacuumPump called with action:', action);"
+  "  var speed = parseInt(document.getElementById('speedSlider').value);"
+  "  var duration = 5;"
+  "  console.log('Sending vacuum pump:', {action: action, speed: speed, duration: duration});"
+  "  fetch('/api/vacuum', {"
+  "    method: 'POST',"
+  "    headers: { 'Content-Type': 'application/json' },"
+  "    body: JSON.stringify({ action: action, speed: speed, duration: duration })"
+  "  }).then(response => response.json())"
+  "    .then(data => {"
+  "      console.log('Response:', data);"
+  "      alert('Vacuum control: ' + (data.success ? 'Success' : 'Failed'));"
+  "    });"
+  "}"
+  "function updateSpeed(value) {"
+  "  document.getElementById('speedValue').textContent = value;"
+  "  console.log('Speed updated to:', value);"
+  "}"
+  "</script>"
+  "</body></html>";
+
+void WebServerManager::handleTest(HttpExchange& ex) {
+  ex.sendStatic(200, "text/html", reinterpret_cast<const uint8_t*>(TEST_PAGE), sizeof(TEST_PAGE) - 1);
+}
+
+void WebServerManager::sendResult(HttpExchange& ex, int code, bool success, const char* message) {
+  char response[128];
+  int len = snprintf(response, sizeof(response), "{\"success\": %s, \"message\": \"%s\"}",
+                     success ? "true" : "false", message);
+  if (len < 0) len = 0;
+  if ((size_t)len >= sizeof(response)) len = sizeof(response) - 1;
+  ex.send(code, "application/json", response, len);
+}
+
+bool WebServerManager::readCommand(HttpExchange& ex, CommandTarget target, PumpCommand& command, uint8_t channel) {
+  if (ex.method() != HTTP_METHOD_POST) {
+    sendResult(ex, 405, false, "Method not allowed");
+    return false;
+  }
+
+  LOG_DEBUG("[Web] Received %s JSON (%u bytes): %.*s", target == TARGET_PUMP ? "pump" : "vacuum",
+            (unsigned)ex.bodyLength(), (int)ex.bodyLength(), ex.body());
+
+  CommandParseError error = parsePumpCommand(ex.body(), ex.bodyLength(), target, command);
+  if (error != CMD_OK) {
+    LOG_WARN("[Web] Rejected command: %s", commandParseErrorMessage(error));
+    sendResult(ex, 400, false, commandParseErrorMessage(error));
+    return false;
+  }
+
+  command.channel = channel;
+  commands->resolve(command, commands->status(), SOURCE_WEB);
+  LOG_DEBUG("[Web] Parsed - Action: %d, Speed: %lu, Duration: %lu",
+            command.action, (unsigned long)command.speed, (unsigned long)command.duration);
+  return true;
+}
+
+bool WebServerManager::submitCommand(HttpExchange& ex, const PumpCommand& command) {
+  if (!commands->submit(command)) {
+    sendResult(ex, 503, false, "Controller busy");
+    return false;
+  }
+  return true;
+}
+
+void WebServerManager::handleControl(HttpExchange& ex) {
+  controlChannel(ex, 0);
+}
+
+void WebServerManager::controlChannel(HttpExchange& ex, uint8_t channel) {
+  PumpCommand command;
+  if (!readCommand(ex, TARGET_PUMP, command, channel)) return;
+  command.hasVolume = false;  // Volumes are only honoured by /api/dose
+
+  char message[64];
+  switch (command.action) {
+    case ACTION_FORWARD:
+    case ACTION_REVERSE:
+      if (!submitCommand(ex, command)) return;
+      snprintf(message, sizeof(message), "%s started for %lu ms",
+               command.action == ACTION_FORWARD ? "Forward" : "Reverse", (unsigned long)command.duration);
+      sendResult(ex, 200, true, message);
       break;
-    case PUMP_FORWARD:
-      html += "<p>Status: Forward (Sample Intake)</p>";
+    case ACTION_STOP:
+      if (!submitCommand(ex, command)) return;
+      sendResult(ex, 200, true, "Stopped");
       break;
-    case PUMP_REVERSE:
-      html += "<p>Status: Reverse (Liquid Extraction)</p>";
+    default:
+      sendResult(ex, 400, false, "Invalid operation");
       break;
   }
-  html += "<p>Speed: " + String(pump->getCurrentSpeed()) + "/255 (" + String((pump->getCurrentSpeed() * 100) / 255) + "%)</p>";
-  if (pump->getIsTimedRun() && pump->getCurrentState() != PUMP_STOPPED) {
-    uint32_t remainingTime = pump->getRemainingTime();
-    html += "<p>Remaining time: " + String(remainingTime) + " seconds</p>";
+}
+
+size_t WebServerManager::generateStatusJSON(char* buffer, size_t size) {
+  return writeStatusJson(commands->status(), sequencer->progress(), wifi->getStats(), *boot, esp_timer_get_time(),
+                         millis(), buffer, size);
+}
+
+void WebServerManager::handleStatus(HttpExchange& ex) {
+  size_t len = generateStatusJSON(statusBuffer, sizeof(statusBuffer));
+  ex.send(200, "application/json", statusBuffer, len);
+}
+
+// Vacuum gauge trace, oldest first, one point every TRACE_PERIOD_MS over
+// the last minute; ?points=<n> keeps only the newest n. Streamed straight
+// from the monitor's ring as the connection drains.
+void WebServerManager::handlePressure(HttpExchange& ex) {
+  uint32_t end = pressure->traceEnd();
+  uint32_t from = pressure->traceBegin();
+  char param[12];
+  if (ex.queryParam("points", param, sizeof(param))) {
+    uint32_t points = strtoul(param, NULL, 10);
+    if (points < end - from) from = end - points;
   }
-  html += "</div>";
-  
-  // Display Current Status - Vacuum Pump
-  html += "<div class='status' id='vacuum-status'>";
-  html += "<h3>Vacuum Pump Status:</h3>";
-  switch (vacuumPump->getCurrentState()) {
-    case VACUUM_STOPPED:
-      html += "<p>Status: Stopped</p>";
-      break;
-    case VACUUM_RUNNING:
-      html += "<p>Status: Running (Vacuum Generation)</p>";
-      break;
+
+  PressureMonitor* monitor = pressure;
+  PressureState state = pressure->state();
+  int32_t latestPa = pressure->pressurePa();
+  uint32_t targetPa = commands->status().vacuumTargetPa;
+  uint32_t next = from;
+  bool header = true;
+  bool first = true;
+  bool done = false;
+  ex.sendStream(200, "application/json", [monitor, state, latestPa, targetPa, next, end, header, first, done]
+                (char* out, size_t max) mutable -> size_t {
+    static const size_t POINT_MAX = 12;  // ",-2147483648"
+    if (done) return 0;
+    size_t len = 0;
+    if (header) {
+      len = snprintf(out, max,
+                     "{\"success\": true,\"state\": \"%s\",\"pressurePa\": %ld,\"targetPa\": %lu,\"cutoffPa\": %lu"
+                     ",\"periodMs\": %lu,\"trace\": [",
+                     pressureStateName(state), (long)latestPa, (unsigned long)targetPa,
+                     (unsigned long)monitor->getConfig().cutoffPa, (unsigned long)PressureMonitor::TRACE_PERIOD_MS);
+      header = false;
+    }
+    // Points the sampling task overwrote while the response was draining
+    // are skipped
+    while (next < end && len + POINT_MAX + 2 < max) {
+      int32_t pa;
+      if (monitor->tracePoint(next++, pa)) {
+        len += snprintf(out + len, max - len, "%s%ld", first ? "" : ",", (long)pa);
+        first = false;
+      }
+    }
+    if (next >= end && len + 2 < max) {
+      len += snprintf(out + len, max - len, "]}");
+      done = true;
+    }
+    return len;
+  });
+}
+
+// Live status over Server-Sent Events. ?interval=<ms> sets the observer's
+// maximum update rate.
+void WebServerManager::handleEvents(HttpExchange& ex) {
+  uint32_t intervalMs = StatusEventStream::DEFAULT_INTERVAL_MS;
+  char interval[12];
+  if (ex.queryParam("interval", interval, sizeof(interval))) {
+    intervalMs = strtoul(interval, NULL, 10);
+    if (intervalMs < StatusEventStream::MIN_INTERVAL_MS) intervalMs = StatusEventStream::MIN_INTERVAL_MS;
+    if (intervalMs > StatusEventStream::MAX_INTERVAL_MS) intervalMs = StatusEventStream::MAX_INTERVAL_MS;
   }
-  html += "<p>Speed: " + String(vacuumPump->getCurrentSpeed()) + "/255 (" + String((vacuumPump->getCurrentSpeed() * 100) / 255) + "%)</p>";
-  if (vacuumPump->getIsTimedRun() && vacuumPump->getCurrentState() != VACUUM_STOPPED) {
-    uint32_t remainingTime = vacuumPump->getRemainingTime();
-    html += "<p>Remaining time: " + String(remainingTime) + " seconds</p>";
+
+  if (!events.add(ex, intervalMs)) {
+    sendResult(ex, 503, false, "Too many observers");
+    return;
   }
-  html += "</div>";
-  
-  // Control Buttons - Peristaltic Pump
-  html += "<div class='control-group'>";
-  html += "<h3>Peristaltic Pump Control:</h3>";
-  html += "<button class='forward' onclick=\"controlPump('forward')\">Forward (Sample Intake)</button>";
-  html += "<button class='reverse' onclick=\"controlPump('reverse')\">Reverse (Liquid Extraction)</button>";
-  html += "<button class='stop' onclick=\"controlPump('stop')\">Stop</button>";
-  html += "</div>";
-  
-  // Control Buttons - Vacuum Pump
-  html += "<div class='control-group'>";
-  html += "<h3>Vacuum Pump Control:</h3>";
-  html += "<button class='forward' onclick=\"controlVacuumPump('start')\">Start Vacuum</button>";
-  html += "<button class='stop' onclick=\"controlVacuumPump('stop')\">Stop Vacuum</button>";
-  html += "<button class='stop' onclick=\"controlVacuumPump('emergency')\" style='background-color: #ff0000;'>Emergency Stop</button>";
-  html += "</div>";
-  
-  // Speed Control
-  html += "<div class='control-group'>";
-  html += "<h3>Speed Control:</h3>";
-  html += "<input type='range' id='speedSlider' min='100' max='1023' value='" + String(pump->getCurrentSpeed()) + "' onchange=\"updateSpeed(this.value)\">";
-  html += "<span id='speedValue'>" + String(pump->getCurrentSpeed()) + "</span>";
-  html += "</div>";
-  
-  // Duration Control
-  html += "<div class='control-group'>";
-  html += "<h3>Run Duration (seconds):</h3>";
-  html += "<input type='number' id='durationInput' min='1' max='300' value='" + String(pump->getRunDuration()) + "' style='width: 100px; padding: 5px; margin: 10px;'>";
-  html += "<span> seconds</span>";
-  html += "</div>";
-  
-  html += "</div>";
-  
-  // JavaScript
-  html += "<script>";
-  html += "function controlPump(action) {";
-  html += "  console.log('controlPump called with action:', action);";
-  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
-  html += "  var duration = parseInt(document.getElementById('durationInput').value);";
-  html += "  console.log('Sending:', {action: action, speed: speed, duration: duration});";
-  html += "  fetch('/api/control', {";
-  html += "    method: 'POST',";
-  html += "    headers: { 'Content-Type': 'application/json' },";
-  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
-  html += "  }).then(response => response.json())";
-  html += "    .then(data => {";
-  html += "      console.log('Response:', data);";
-  html += "      alert('Pump control: ' + (data.success ? 'Success' : 'Failed'));";
-  html += "    });";
-  html += "}";
-  html += "function controlVacuumPump(action) {";
-  html += "  console.log('controlVacuumPump called with action:', action);";
-  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
-  html += "  var duration = parseInt(document.getElementById('durationInput').value);";
-  html += "  console.log('Sending vacuum pump:', {action: action, speed: speed, duration: duration});";
-  html += "  fetch('/api/vacuum', {";
-  html += "    method: 'POST',";
-  html += "    headers: { 'Content-Type': 'application/json' },";
-  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
-  html += "  }).then(response => response.json())";
-  html += "    .then(data => {";
-  html += "      console.log('Response:', data);";
-  html += "      alert('Vacuum control: ' + (data.success ? 'Success' : 'Failed'));";
-  html += "    });";
-  html += "}";
-  html += "function updateSpeed(value) {";
-  html += "  document.getElementById('speedValue').textContent = value;";
-  html += "  console.log('Speed updated to:', value);";
-  html += "}";
-  html += "function updateStatus() {";
-  html += "  fetch('/api/status')";
-  html += "    .then(response => response.json())";
-  html += "    .then(data => {";
-  html += "      console.log('Status response:', data);";
-  html += "    });";
-  html += "}";
-  html += "</script>";
-  
-  html += "</body></html>";
-  
-  return html;
+  if (observerListener != NULL) observerListener(observerListenerArg);
 }
 
-void WebServerManager::handleRoot() {
-  Serial.println("[Web] Handling root request");
-  String html = generateHTML();
-  Serial.println("[Web] Generated HTML length: " + String(html.length()));
-  
-  // Debug: Print first 500 characters of HTML
-  String debugHtml = html.substring(0, min(500, (int)html.length()));
-  Serial.println("[Web] HTML preview: " + debugHtml);
-  
-  server.send(200, "text/html", html);
-}
-
-void WebServerManager::handleTest() {
-  String html = "<!DOCTYPE html><html><head><title>Test Page</title></head><body>";
-  html += "<h1>Test Page</h1>";
-  html += "<button onclick='testFunction()'>Test Button</button>";
-  html += "<p id='result'>Click the button to test</p>";
-  html += "<hr>";
-  html += "<h2>Main Page Test</h2>";
-  html += "<button onclick='controlPump(\"forward\")'>Test Forward</button>";
-  html += "<button onclick='controlVacuumPump(\"start\")'>Test Vacuum Start</button>";
-  html += "<input type='range' id='speedSlider' min='50' max='255' value='100' onchange='updateSpeed(this.value)'>";
-  html += "<span id='speedValue'>100</span>";
-  html += "<script>";
-  html += "function testFunction() {";
-  html += "  document.getElementById('result').innerHTML = 'Button clicked! JavaScript is working.';";
-  html += "}";
-  html += "function controlPump(action) {";
-  html += "  console.log('controlPump called with action:', action);";
-  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
-  html += "  var duration = 5;";
-  html += "  console.log('Sending:', {action: action, speed: speed, duration: duration});";
-  html += "  fetch('/api/control', {";
-  html += "    method: 'POST',";
-  html += "    headers: { 'Content-Type': 'application/json' },";
-  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
-  html += "  }).then(response => response.json())";
-  html += "    .then(data => {";
-  html += "      console.log('Response:', data);";
-  html += "      alert('Pump control: ' + (data.success ? 'Success' : 'Failed'));";
-  html += "    });";
-  html += "}";
-  html += "function controlVacuumPump(action) {";
-  html += "  console.log('controlVacuumPump called with action:', action);";
-  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
-  html += "  var duration = 5;";
-  html += "  console.log('Sending vacuum pump:', {action: action, speed: speed, duration: duration});";
-  html += "  fetch('/api/vacuum', {";
-  html += "    method: 'POST',";
-  html += "    headers: { 'Content-Type': 'application/json' },";
-  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
-  html += "  }).then(response => response.json())";
-  html += "    .then(data => {";
-  html += "      console.log('Response:', data);";
-  html += "      alert('Vacuum control: ' + (data.success ? 'Success' : 'Failed'));";
-  html += "    });";
-  html += "}";
-  html += "function updateSpeed(value) {";
-  html += "  document.getElementById('speedValue').textContent = value;";
-  html += "  console.log('Speed updated to:', value);";
-  html += "}";
-  html += "</script>";
-  html += "</body></html>";
-  
-  server.send(200, "text/html", html);
+static const char* methodName(HttpMethod method) {
+  switch (method) {
+    case HTTP_METHOD_GET:  return "GET";
+    case HTTP_METHOD_POST: return "POST";
+    case HTTP_METHOD_ANY:
+    default:               return "any";
+  }
 }
 
-String WebServerManager::parseAction(const String& body) {
-  if (body.indexOf("\"action\":\"forward\"") >= 0) {
-    return "forward";
-  } else if (body.indexOf("\"action\":\"reverse\"") >= 0) {
-    return "reverse";
-  } else if (body.indexOf("\"action\":\"stop\"") >= 0) {
-    return "stop";
+// One line of a scalar family: HELP, TYPE, then the value
+static size_t formatScalarLine(uint8_t line, const char* name, const char* type, const char* help,
+                               uint32_t value, char* out, size_t max) {
+  int len;
+  switch (line) {
+    case 0:  len = snprintf(out, max, "# HELP %s %s\n", name, help); break;
+    case 1:  len = snprintf(out, max, "# TYPE %s %s\n", name, type); break;
+    case 2:  len = snprintf(out, max, "%s %lu\n", name, (unsigned long)value); break;
+    default: return 0;
   }
-  return "";
+  return (len > 0 && (size_t)len < max) ? len : 0;
 }
 
-String WebServerManager::parseVacuumAction(const String& body) {
-  if (body.indexOf("\"action\":\"start\"") >= 0) {
-    return "start";
-  } else if (body.indexOf("\"action\":\"stop\"") >= 0) {
-    return "stop";
-  } else if (body.indexOf("\"action\":\"emergency\"") >= 0) {
-    return "emergency";
+size_t WebServerManager::formatMetricsLine(uint8_t family, uint8_t line, Histogram::Snapshot& snap,
+                                           char* out, size_t max) {
+  if (family < RuntimeMetrics::HISTOGRAM_COUNT) {
+    Histogram* histogram = metrics.histogram(family);
+    if (line == 0) histogram->snapshot(snap);
+    return histogram->formatLine(snap, line, out, max);
+  }
+
+  int len;
+  switch (family - RuntimeMetrics::HISTOGRAM_COUNT) {
+    case 0:
+      // Requests per route; handlers run under the server lock, as does this
+      if (line == 0) {
+        len = snprintf(out, max, "# HELP pump_http_requests_total Requests dispatched to each route\n");
+      } else if (line == 1) {
+        len = snprintf(out, max, "# TYPE pump_http_requests_total counter\n");
+      } else if (line - 2 < server.getRouteCount()) {
+        uint8_t route = line - 2;
+        len = snprintf(out, max, "pump_http_requests_total{path=\"%s\",method=\"%s\"} %lu\n",
+                       server.getRoutePath(route), methodName(server.getRouteMethod(route)),
+                       (unsigned long)server.getRouteRequests(route));
+      } else {
+        return 0;
+      }
+      return (len > 0 && (size_t)len < max) ? len : 0;
+    case 1:
+      return formatScalarLine(line, "pump_http_unrouted_requests_total", "counter",
+                              "Requests answered 404 or 405", server.getUnroutedRequests(), out, max);
+    case 2:
+      return formatScalarLine(line, "pump_heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap(), out, max);
+    case 3:
+      return formatScalarLine(line, "pump_heap_min_free_bytes", "gauge", "Lowest free heap since boot",
+                              ESP.getMinFreeHeap(), out, max);
+    case 4:
+      return formatScalarLine(line, "pump_heap_largest_free_block_bytes", "gauge",
+                              "Largest block the heap can allocate", ESP.getMaxAllocHeap(), out, max);
+    default:
+      return 0;
   }
-  return "";
 }
 
-uint16_t WebServerManager::parseSpeed(const String& body) {
-  int speedStart = body.indexOf("\"speed\":");
-  if (speedStart >= 0) {
-    speedStart += 8; // Skip "speed":
-    int speedEnd = body.indexOf(",", speedStart);
-    if (speedEnd < 0) speedEnd = body.indexOf("}", speedStart);
-    if (speedEnd > speedStart) {
-      String speedStr = body.substring(speedStart, speedEnd);
-      uint16_t speed = speedStr.toInt();
-      if (speed < 100) speed = 100;  // Minimum 10% of 1023
-      if (speed > 1023) speed = 1023;  // Maximum 100% of 1023
-      Serial.println("[Web] Speed extracted: '" + speedStr + "' -> " + String(speed));
-      return speed;
+// Prometheus scrape. The text runs to a few KiB, so it is produced a line at
+// a time as the connection drains rather than in one buffer. Each histogram
+// is copied when its first line goes out, so its buckets add up.
+void WebServerManager::handleMetrics(HttpExchange& ex) {
+  uint8_t family = 0;
+  uint8_t line = 0;
+  Histogram::Snapshot snap;
+  ex.sendStream(200, "text/plain; version=0.0.4",
+                [this, family, line, snap](char* out, size_t max) mutable -> size_t {
+    static const size_t LINE_MAX = 160;
+    size_t len = 0;
+    while (family < METRIC_FAMILIES && max - len >= LINE_MAX) {
+      size_t n = formatMetricsLine(family, line, snap, out + len, max - len);
+      if (n == 0) {
+        family++;
+        line = 0;
+        continue;
+      }
+      len += n;
+      line++;
     }
+    return len;
+  });
+}
+
+static const char* eventStateName(const EventRecord& record) {
+  if (record.kind == EVENT_PUMP) return pumpStateName((PumpState)record.state);
+  if (record.kind == EVENT_VACUUM) return vacuumStateName((VacuumPumpState)record.state);
+  return "";
+}
+
+// Event log download: ?from=<seq>&count=<n>&format=csv|bin. Records are
+// read from flash as the connection drains, so the size of the log doesn't
+// matter; the response ends at the newest record written when it started.
+// X-Log-Next-Seq is where the following download should resume.
+void WebServerManager::handleLog(HttpExchange& ex) {
+  char param[12];
+  uint32_t first = eventLog->firstSeq();
+  uint32_t end = eventLog->endSeq();
+  uint32_t from = ex.queryParam("from", param, sizeof(param)) ? strtoul(param, NULL, 10) : first;
+  if (from < first) from = first;
+  if (ex.queryParam("count", param, sizeof(param))) {
+    uint32_t count = strtoul(param, NULL, 10);
+    if (from < end && count < end - from) end = from + count;
   }
-  return pump->getCurrentSpeed();
-}
-
-uint8_t WebServerManager::parseVacuumSpeed(const String& body) {
-  int speedStart = body.indexOf("\"speed\":");
-  if (speedStart >= 0) {
-    speedStart += 8; // Skip "speed":
-    int speedEnd = body.indexOf(",", speedStart);
-    if (speedEnd < 0) speedEnd = body.indexOf("}", speedStart);
-    if (speedEnd > speedStart) {
-      String speedStr = body.substring(speedStart, speedEnd);
-      uint16_t rawSpeed = speedStr.toInt();
-      // Convert from 0-1023 range to 0-100 percentage
-      uint8_t speedPercent = (rawSpeed * 100) / 1023;
-      if (speedPercent < 10) speedPercent = 10;  // Minimum 10%
-      if (speedPercent > 100) speedPercent = 100;  // Maximum 100%
-      Serial.println("[Web] Vacuum Speed extracted: '" + speedStr + "' -> " + String(speedPercent) + "%");
-      return speedPercent;
+  bool binary = ex.queryParam("format", param, sizeof(param)) && strcmp(param, "bin") == 0;
+
+  char headers[80];
+  snprintf(headers, sizeof(headers), "X-Log-First-Seq: %lu\r\nX-Log-Next-Seq: %lu\r\n",
+           (unsigned long)from, (unsigned long)(end > from ? end : from));
+
+  EventLog* log = eventLog;
+  bool header = !binary;
+  ex.sendStream(200, binary ? "application/octet-stream" : "text/csv",
+                [log, from, end, binary, header](char* out, size_t max) mutable -> size_t {
+    static const size_t CSV_LINE_MAX = 72;
+    size_t len = 0;
+    if (header) {
+      len = snprintf(out, max, "seq,time_ms,event,source,state,duty,duration_ms,channel\n");
+      header = false;
     }
-  }
-  return vacuumPump->getCurrentSpeed();
-}
-
-uint32_t WebServerManager::parseDuration(const String& body) {
-  int durationStart = body.indexOf("\"duration\":");
-  if (durationStart >= 0) {
-    durationStart += 11; // Skip "duration":
-    int durationEnd = body.indexOf(",", durationStart);
-    if (durationEnd < 0) durationEnd = body.indexOf("}", durationStart);
-    if (durationEnd > durationStart) {
-      String durationStr = body.substring(durationStart, durationEnd);
-      uint32_t duration = durationStr.toInt();
-      if (duration < 1) duration = 1;
-      if (duration > 300) duration = 300;
-      Serial.println("[Web] Duration extracted: '" + durationStr + "' -> " + String(duration));
-      return duration;
+    EventRecord records[16];
+    size_t room = (max - len) / (binary ? EventLog::RECORD_SIZE : CSV_LINE_MAX);
+    size_t wanted = room < 16 ? room : 16;
+    uint32_t resumeSeq;
+    size_t n = from < end ? log->read(from, records, wanted, resumeSeq) : 0;
+    for (size_t i = 0; i < n && records[i].seq < end; i++) {
+      const EventRecord& record = records[i];
+      if (binary) {
+        encodeEventRecord(record, reinterpret_cast<uint8_t*>(out + len));
+        len += EventLog::RECORD_SIZE;
+      } else {
+        len += snprintf(out + len, max - len, "%lu,%lu,%s,%s,%s,%u,%lu,%u\n", (unsigned long)record.seq,
+                        (unsigned long)record.timeMs, eventKindName(record.kind),
+                        commandSourceName((CommandSource)record.source), eventStateName(record),
+                        record.duty, (unsigned long)record.durationMs, record.channel);
+      }
     }
+    from = n > 0 ? resumeSeq : end;
+    return len;
+  }, headers);
+}
+
+void WebServerManager::handleVacuumControl(HttpExchange& ex) {
+  PumpCommand command;
+  if (!readCommand(ex, TARGET_VACUUM, command)) return;
+
+  char message[64];
+  switch (command.action) {
+    case ACTION_START: {
+      // The pump would refuse it anyway; this way the client hears why
+      PressureState interlock = commands->status().vacuumInterlock;
+      if (interlock != PRESSURE_OK) {
+        snprintf(message, sizeof(message), "Vacuum interlock: %s", pressureStateName(interlock));
+        sendResult(ex, 409, false, message);
+        return;
+      }
+      if (!submitCommand(ex, command)) return;
+      if (command.hasPressure) {
+        snprintf(message, sizeof(message), "Vacuum regulating to %lu Pa for %lu ms", (unsigned long)command.pressure,
+                 (unsigned long)command.duration);
+      } else {
+        snprintf(message, sizeof(message), "Vacuum pump started for %lu ms", (unsigned long)command.duration);
+      }
+      sendResult(ex, 200, true, message);
+      break;
+    }
+    case ACTION_STOP:
+      if (!submitCommand(ex, command)) return;
+      sendResult(ex, 200, true, "Vacuum pump stopped");
+      break;
+    case ACTION_EMERGENCY:
+      // Every motor, as from the console or UDP, not just the vacuum pump
+      if (!commands->emergencyStop(SOURCE_WEB)) {
+        sendResult(ex, 503, false, "Controller busy");
+        return;
+      }
+      sendResult(ex, 200, true, "Emergency stop activated");
+      break;
+    default:
+      sendResult(ex, 400, false, "Invalid vacuum pump operation");
+      break;
   }
-  return pump->getRunDuration();
 }
 
-void WebServerManager::handleControl() {
-  if (server.method() != HTTP_POST) {
-    server.send(405, "application/json", "{\"success\": false, \"message\": \"Method not allowed\"}");
+// Several /api/control and /api/vacuum operations in one request, e.g.
+//   [{"target": "vacuum", "action": "start", "speed": 800, "duration": 3},
+//    {"action": "forward", "speed": 600, "duration": 3},
+//    {"channel": 1, "action": "reverse", "speed": 400, "duration": 3}]
+// All are checked before any is queued, and the control task applies them
+// back to back in one pass, so the motors start within microseconds of
+// each other.
+void WebServerManager::handleBatch(HttpExchange& ex) {
+  CommandBatch batch;
+  int badCommand;
+  CommandParseError error = parseCommandBatch(ex.body(), ex.bodyLength(), batch, badCommand);
+  char message[64];
+  if (error != CMD_OK) {
+    if (badCommand >= 0) {
+      snprintf(message, sizeof(message), "Operation %d: %s", badCommand + 1, commandParseErrorMessage(error));
+    } else {
+      snprintf(message, sizeof(message), "%s", commandParseErrorMessage(error));
+    }
+    LOG_WARN("[Web] Rejected batch: %s", message);
+    sendResult(ex, 400, false, message);
     return;
   }
-  
-  String body = server.arg("plain");
-  
-  // Debug: Print received JSON
-  Serial.println("[Web] Received JSON: " + body);
-  Serial.println("[Web] JSON length: " + String(body.length()));
-  
-  // Parse JSON
-  String action = parseAction(body);
-  uint16_t speed = parseSpeed(body);
-  uint32_t duration = parseDuration(body);
-  
-  // Debug: Print parsed values
-  Serial.println("[Web] Parsed - Action: " + action + ", Speed: " + String(speed) + ", Duration: " + String(duration));
-  
-  // Execute control operation
-  if (action == "forward") {
-    pump->controlPump(PUMP_FORWARD, speed, duration);
-    String message = "Forward started";
-    if (duration > 0) {
-      message += " for " + String(duration) + " seconds";
+
+  // An emergency stop anywhere in the batch stops every motor; the rest
+  // would only be stopped again
+  for (uint8_t i = 0; i < batch.count; i++) {
+    if (batch.commands[i].action != ACTION_EMERGENCY) continue;
+    if (!commands->emergencyStop(SOURCE_WEB)) {
+      sendResult(ex, 503, false, "Controller busy");
+      return;
+    }
+    sendResult(ex, 200, true, "Emergency stop activated");
+    return;
+  }
+
+  // One operation per motor; two in the same tick would just overwrite
+  // each other
+  PumpStatus status = commands->status();
+  for (uint8_t i = 0; i < batch.count; i++) {
+    PumpCommand& command = batch.commands[i];
+    if (command.target == TARGET_PUMP && !PumpManager::valid(command.channel)) {
+      snprintf(message, sizeof(message), "Operation %u: no pump channel %u", i + 1, command.channel);
+      sendResult(ex, 400, false, message);
+      return;
     }
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"" + message + "\"}");
-  } else if (action == "reverse") {
-    pump->controlPump(PUMP_REVERSE, speed, duration);
-    String message = "Reverse started";
-    if (duration > 0) {
-      message += " for " + String(duration) + " seconds";
+    for (uint8_t j = 0; j < i; j++) {
+      if (batch.commands[j].target == command.target && batch.commands[j].channel == command.channel) {
+        snprintf(message, sizeof(message), "Operation %u: %s already addressed", i + 1,
+                 command.target == TARGET_PUMP ? "pump" : "vacuum");
+        sendResult(ex, 400, false, message);
+        return;
+      }
     }
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"" + message + "\"}");
-  } else if (action == "stop") {
-    pump->controlPump(PUMP_STOPPED, speed, 0);
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"Stopped\"}");
-  } else {
-    server.send(400, "application/json", "{\"success\": false, \"message\": \"Invalid operation\"}");
+    command.hasVolume = false;  // Volumes are only honoured by /api/dose
+    commands->resolve(command, status, SOURCE_WEB);
+  }
+
+  if (!commands->submitBatch(batch)) {
+    sendResult(ex, 503, false, "Controller busy");
+    return;
   }
+  snprintf(message, sizeof(message), "Applied %u operations", batch.count);
+  sendResult(ex, 200, true, message);
 }
 
-String WebServerManager::generateStatusJSON() {
-  String json = "{";
-  json += "\"success\": true,";
-  
-  // Peristaltic pump status
-  json += "\"pump\": {";
-  json += "\"state\": ";
-  switch (pump->getCurrentState()) {
-    case PUMP_STOPPED:
-      json += "\"stopped\"";
-      break;
-    case PUMP_FORWARD:
-      json += "\"forward\"";
-      break;
-    case PUMP_REVERSE:
-      json += "\"reverse\"";
-      break;
+void WebServerManager::handleDose(HttpExchange& ex) {
+  PumpCommand command;
+  if (!readCommand(ex, TARGET_PUMP, command)) return;
+
+  if (command.action != ACTION_FORWARD && command.action != ACTION_REVERSE) {
+    sendResult(ex, 400, false, "Invalid operation");
+    return;
   }
-  json += ",\"speed\": " + String(pump->getCurrentSpeed());
-  json += ",\"speedPercent\": " + String((pump->getCurrentSpeed() * 100) / 255);
-  
-  // Add remaining time if running on timer
-  if (pump->getIsTimedRun() && pump->getCurrentState() != PUMP_STOPPED) {
-    uint32_t remainingTime = pump->getRemainingTime();
-    json += ",\"remainingTime\": " + String(remainingTime);
-    json += ",\"isTimedRun\": true";
-  } else {
-    json += ",\"remainingTime\": 0";
-    json += ",\"isTimedRun\": false";
+  if (!command.hasVolume || command.volume == 0) {
+    sendResult(ex, 400, false, "Missing volume");
+    return;
   }
-  json += "},";
-  
-  // Vacuum pump status
-  json += "\"vacuum\": {";
-  json += "\"state\": ";
-  switch (vacuumPump->getCurrentState()) {
-    case VACUUM_STOPPED:
-      json += "\"stopped\"";
+  if (!calibration->isCalibrated()) {
+    sendResult(ex, 409, false, "Pump not calibrated");
+    return;
+  }
+
+  // Without a flow rate, dose as fast as the calibration allows
+  uint32_t flowRate = command.hasFlowRate ? command.flowRate : calibration->maxFlowRate();
+  DosePlan plan;
+  if (!calibration->planDose(command.volume, flowRate, plan)) {
+    sendResult(ex, 400, false, "Flow rate outside calibrated range");
+    return;
+  }
+  if (plan.durationMs > CommandDispatcher::MAX_RUN_MS) {
+    sendResult(ex, 400, false, "Dose too long at this flow rate");
+    return;
+  }
+
+  command.speed = plan.duty;
+  command.duration = plan.durationMs;
+  command.hasFlowRate = true;
+  command.flowRate = plan.flowRate;
+  if (!submitCommand(ex, command)) return;
+
+  char message[96];
+  snprintf(message, sizeof(message), "Dosing %lu uL at %lu uL/min (%lu ms)",
+           (unsigned long)command.volume, (unsigned long)plan.flowRate, (unsigned long)plan.durationMs);
+  sendResult(ex, 200, true, message);
+}
+
+void WebServerManager::sendCalibration(HttpExchange& ex) {
+  char response[64 + FlowCalibration::MAX_POINTS * 40];
+  size_t len = snprintf(response, sizeof(response), "{\"success\": true,\"points\": [");
+  for (uint8_t i = 0; i < calibration->count(); i++) {
+    const FlowCalibration::Point& point = calibration->point(i);
+    len += snprintf(response + len, sizeof(response) - len, "%s{\"duty\": %u,\"flowRate\": %lu}",
+                    i > 0 ? "," : "", (unsigned)point.duty, (unsigned long)point.flowRate);
+  }
+  len += snprintf(response + len, sizeof(response) - len, "]}");
+  ex.send(200, "application/json", response, len);
+}
+
+// Calibration routine: "run" drives the pump forward at a duty for a fixed
+// time while the operator collects the output, "record" stores the measured
+// volume for that run as a duty/flow point, "clear" drops the table. A GET
+// returns the current table.
+void WebServerManager::handleCalibrate(HttpExchange& ex) {
+  if (ex.method() == HTTP_METHOD_GET) {
+    sendCalibration(ex);
+    return;
+  }
+
+  PumpCommand command;
+  if (!readCommand(ex, TARGET_CALIBRATION, command)) return;
+
+  char message[96];
+  switch (command.action) {
+    case ACTION_CAL_RUN: {
+      // parsePumpCommand() has already turned away a run without a duration
+      command.target = TARGET_PUMP;
+      command.action = ACTION_FORWARD;
+      command.hasVolume = false;
+      if (!submitCommand(ex, command)) return;
+      calibrationPending = true;
+      calibrationDuty = command.speed;
+      calibrationDurationMs = command.duration;
+      snprintf(message, sizeof(message), "Calibration run at duty %lu for %lu ms",
+               (unsigned long)command.speed, (unsigned long)command.duration);
+      sendResult(ex, 200, true, message);
       break;
-    case VACUUM_RUNNING:
-      json += "\"running\"";
+    }
+    case ACTION_CAL_RECORD: {
+      if (!calibrationPending) {
+        sendResult(ex, 409, false, "No calibration run to record");
+        return;
+      }
+      if (!command.hasVolume || command.volume == 0) {
+        sendResult(ex, 400, false, "Missing volume");
+        return;
+      }
+      uint32_t flowRate = flowRateFor(command.volume, calibrationDurationMs);
+      if (!calibration->addPoint(calibrationDuty, flowRate)) {
+        sendResult(ex, 400, false, "Point conflicts with calibration table");
+        return;
+      }
+      calibrationPending = false;
+      calibration->save();
+      LOG_INFO("[Calib] Duty %u -> %lu uL/min", calibrationDuty, (unsigned long)flowRate);
+      snprintf(message, sizeof(message), "Recorded %lu uL/min at duty %u", (unsigned long)flowRate, calibrationDuty);
+      sendResult(ex, 200, true, message);
+      break;
+    }
+    case ACTION_CAL_CLEAR:
+      calibration->clear();
+      calibration->save();
+      calibrationPending = false;
+      sendResult(ex, 200, true, "Calibration cleared");
+      break;
+    default:
+      sendResult(ex, 400, false, "Invalid calibration operation");
       break;
   }
-  json += ",\"speed\": " + String(vacuumPump->getCurrentSpeed());
-  json += ",\"speedPercent\": " + String((vacuumPump->getCurrentSpeed() * 100) / 255);
-  
-  // Add remaining time if running on timer
-  if (vacuumPump->getIsTimedRun() && vacuumPump->getCurrentState() != VACUUM_STOPPED) {
-    uint32_t remainingTime = vacuumPump->getRemainingTime();
-    json += ",\"remainingTime\": " + String(remainingTime);
-    json += ",\"isTimedRun\": true";
-  } else {
-    json += ",\"remainingTime\": 0";
-    json += ",\"isTimedRun\": false";
+}
+
+// GET returns the peristaltic ramp profile, POST changes it. The change is
+// applied by the control task like any other command.
+void WebServerManager::handleRamp(HttpExchange& ex) {
+  rampChannel(ex, 0);
+}
+
+void WebServerManager::rampChannel(HttpExchange& ex, uint8_t channel) {
+  RampConfig config = commands->status().channels[channel].ramp;
+  char response[96];
+
+  if (ex.method() != HTTP_METHOD_GET) {
+    CommandParseError error = parseRampConfig(ex.body(), ex.bodyLength(), config);
+    if (error != CMD_OK) {
+      LOG_WARN("[Web] Rejected ramp settings: %s", commandParseErrorMessage(error));
+      sendResult(ex, 400, false, commandParseErrorMessage(error));
+      return;
+    }
+    if (config.rampMs > MAX_RAMP_MS) config.rampMs = MAX_RAMP_MS;
+
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.channel = channel;
+    command.action = ACTION_SET_RAMP;
+    command.ramp = config;
+    command.source = SOURCE_WEB;
+    if (!submitCommand(ex, command)) return;
   }
-  json += "}";
-  
-  json += "}";
-  
-  return json;
+
+  int len = snprintf(response, sizeof(response), "{\"success\": true,\"shape\": \"%s\",\"rampMs\": %u}",
+                     rampShapeName(config.shape), (unsigned)config.rampMs);
+  ex.send(200, "application/json", response, len);
 }
 
-void WebServerManager::handleStatus() {
-  server.send(200, "application/json", generateStatusJSON());
+static size_t formatChannelJSON(uint8_t id, const ChannelStatus& channel, uint64_t nowUs, char* out, size_t max) {
+  int len = snprintf(out, max,
+    "{\"id\": %u,\"state\": \"%s\",\"speed\": %u,\"remainingMs\": %lu,\"runDurationMs\": %lu,"
+    "\"timedRun\": %s,\"ramp\": {\"shape\": \"%s\",\"rampMs\": %u},\"speedControl\": \"%s\",\"rpm\": %u}",
+    id, pumpStateName(channel.state), (unsigned)channel.speed,
+    (unsigned long)remainingMs(channel.timedRun, channel.stopDeadlineUs, nowUs),
+    (unsigned long)channel.runDurationMs, channel.timedRun ? "true" : "false",
+    rampShapeName(channel.ramp.shape), (unsigned)channel.ramp.rampMs,
+    speedControlName(channel.speedControl), (unsigned)channel.rpm);
+  if (len < 0) return 0;
+  return (size_t)len < max ? (size_t)len : max - 1;
 }
 
-void WebServerManager::handleVacuumControl() {
-  if (server.method() != HTTP_POST) {
-    server.send(405, "application/json", "{\"success\": false, \"message\": \"Method not allowed\"}");
+// Every peristaltic channel, written a few at a time as the connection
+// drains, so the response grows with the channel count but the memory used
+// doesn't. Each piece reads the latest status.
+void WebServerManager::handlePumps(HttpExchange& ex) {
+  CommandDispatcher* dispatcher = commands;
+  uint8_t next = 0;
+  ex.sendStream(200, "application/json", [dispatcher, next](char* out, size_t max) mutable -> size_t {
+    static const size_t CHANNEL_JSON_MAX = 240;
+    if (next > PumpManager::CHANNEL_COUNT) return 0;
+    PumpStatus status = dispatcher->status();
+    uint64_t now = esp_timer_get_time();
+    size_t len = 0;
+    if (next == 0) len = snprintf(out, max, "{\"channels\": [");
+    while (next < PumpManager::CHANNEL_COUNT && max - len >= CHANNEL_JSON_MAX) {
+      if (next > 0) out[len++] = ',';
+      len += formatChannelJSON(next, status.channels[next], now, out + len, max - len);
+      next++;
+    }
+    if (next == PumpManager::CHANNEL_COUNT && max - len >= 3) {
+      len += snprintf(out + len, max - len, "]}");
+      next++;
+    }
+    return len;
+  });
+}
+
+// /api/pumps/{id} (GET: the channel's status), /api/pumps/{id}/control
+// (POST: a /api/control body) and /api/pumps/{id}/ramp (as /api/ramp)
+void WebServerManager::handlePumpChannel(HttpExchange& ex) {
+  const char* rest = ex.request().path() + strlen("/api/pumps/");
+  uint32_t id = 0;
+  size_t digits = 0;
+  while (rest[digits] >= '0' && rest[digits] <= '9' && digits < 3) {
+    id = id * 10 + (rest[digits] - '0');
+    digits++;
+  }
+  if (digits == 0 || (rest[digits] != '\0' && rest[digits] != '/') || id >= PumpManager::CHANNEL_COUNT) {
+    sendResult(ex, 404, false, "No such pump channel");
     return;
   }
-  
-  String body = server.arg("plain");
-  
-  // Debug: Print received JSON
-  Serial.println("[Web] Received vacuum JSON: " + body);
-  
-  // Parse JSON
-  String action = parseVacuumAction(body);
-  uint8_t speed = parseVacuumSpeed(body);
-  uint32_t duration = parseDuration(body);
-  
-  // Debug: Print parsed values
-  Serial.println("[Web] Vacuum Parsed - Action: " + action + ", Speed: " + String(speed) + ", Duration: " + String(duration));
-  
-  // Execute vacuum pump control operation
-  if (action == "start") {
-    vacuumPump->controlVacuumPump(VACUUM_RUNNING, speed, duration);
-    String message = "Vacuum pump started";
-    if (duration > 0) {
-      message += " for " + String(duration) + " seconds";
+  const char* action = rest[digits] == '/' ? rest + digits + 1 : "";
+
+  if (strcmp(action, "") == 0) {
+    if (ex.method() != HTTP_METHOD_GET) {
+      sendResult(ex, 405, false, "Method not allowed");
+      return;
     }
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"" + message + "\"}");
-  } else if (action == "stop") {
-    vacuumPump->controlVacuumPump(VACUUM_STOPPED, speed, 0);
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"Vacuum pump stopped\"}");
-  } else if (action == "emergency") {
-    vacuumPump->emergencyStop();
-    server.send(200, "application/json", "{\"success\": true, \"message\": \"Emergency stop activated\"}");
+    char response[240];
+    size_t len = formatChannelJSON(id, commands->status().channels[id], esp_timer_get_time(),
+                                   response, sizeof(response));
+    ex.send(200, "application/json", response, len);
+  } else if (strcmp(action, "control") == 0) {
+    controlChannel(ex, id);
+  } else if (strcmp(action, "ramp") == 0) {
+    rampChannel(ex, id);
   } else {
-    server.send(400, "application/json", "{\"success\": false, \"message\": \"Invalid vacuum pump operation\"}");
+    sendResult(ex, 404, false, "Not found");
+  }
+}
+
+bool WebServerManager::readProtocol(HttpExchange& ex, Protocol& protocol) {
+  int badStep;
+  CommandParseError error = parseProtocol(ex.body(), ex.bodyLength(), protocol, badStep);
+  if (error == CMD_OK) return true;
+
+  char message[64];
+  if (badStep >= 0) {
+    snprintf(message, sizeof(message), "Step %d: %s", badStep + 1, commandParseErrorMessage(error));
+  } else {
+    snprintf(message, sizeof(message), "%s", commandParseErrorMessage(error));
+  }
+  LOG_WARN("[Web] Rejected protocol: %s", message);
+  sendResult(ex, 400, false, message);
+  return false;
+}
+
+// GET lists the stored protocols, POST validates and stores one by name
+void WebServerManager::handleProtocol(HttpExchange& ex) {
+  if (ex.method() == HTTP_METHOD_GET) {
+    char response[64 + ProtocolStore::MAX_PROTOCOLS * (Protocol::MAX_NAME_LEN + 4)];
+    size_t len = snprintf(response, sizeof(response), "{\"success\": true,\"protocols\": [");
+    for (uint8_t i = 0; i < protocols->count(); i++) {
+      len += snprintf(response + len, sizeof(response) - len, "%s\"%s\"", i > 0 ? "," : "", protocols->name(i));
+    }
+    len += snprintf(response + len, sizeof(response) - len, "]}");
+    ex.send(200, "application/json", response, len);
+    return;
+  }
+
+  Protocol protocol;
+  if (!readProtocol(ex, protocol)) return;
+  if (protocol.name[0] == '\0' || protocol.stepCount == 0) {
+    sendResult(ex, 400, false, "A stored protocol needs a name and steps");
+    return;
+  }
+  if (!protocols->save(protocol)) {
+    sendResult(ex, 409, false, "Protocol storage full");
+    return;
+  }
+
+  char message[64];
+  snprintf(message, sizeof(message), "Saved %s (%u steps)", protocol.name, protocol.stepCount);
+  sendResult(ex, 200, true, message);
+}
+
+// Runs a stored protocol ({"name": ...}) or one given inline with its steps
+void WebServerManager::handleProtocolRun(HttpExchange& ex) {
+  Protocol protocol;
+  if (!readProtocol(ex, protocol)) return;
+  if (protocol.stepCount == 0 && !protocols->load(protocol.name, protocol)) {
+    sendResult(ex, 404, false, "Unknown protocol");
+    return;
+  }
+  sequencer->start(protocol);
+
+  char message[64];
+  snprintf(message, sizeof(message), "Running %s (%u steps)",
+           protocol.name[0] ? protocol.name : "protocol", protocol.stepCount);
+  sendResult(ex, 200, true, message);
+}
+
+void WebServerManager::handleProtocolStop(HttpExchange& ex) {
+  sequencer->stop();
+  sendResult(ex, 200, true, "Protocol stopped");
+}
+
+void WebServerManager::handleProtocolDelete(HttpExchange& ex) {
+  Protocol protocol;
+  if (!readProtocol(ex, protocol)) return;
+  if (!protocols->remove(protocol.name)) {
+    sendResult(ex, 404, false, "Unknown protocol");
+    return;
   }
+  sendResult(ex, 200, true, "Protocol deleted");
 }
@@ -1,61 +1,161 @@
 #include "wifi_manager.h"
+#include "logger.h"
 
 WiFiManager::WiFiManager(const char* wifi_ssid, const char* wifi_password) {
   ssid = wifi_ssid;
   password = wifi_password;
-  connectionAttempts = 20;
-  isConnected = false;
+  state = WIFI_STATE_IDLE;
+  attemptStartMs = 0;
+  backoffStartMs = 0;
+  backoffMs = BACKOFF_MIN_MS;
+  downSinceMs = 0;
+  memset(&stats, 0, sizeof(stats));
+  pendingEvents.store(0);
+  disconnectReason.store(0);
+  isConnected.store(false);
+  wakeListener = NULL;
+  wakeListenerArg = NULL;
 }
 
-bool WiFiManager::connect() {
-  Serial.print("[WiFi] Connecting to WiFi: ");
-  Serial.println(ssid);
-  
+void WiFiManager::setWakeListener(void (*listener)(void* arg), void* arg) {
+  wakeListener = listener;
+  wakeListenerArg = arg;
+}
+
+void WiFiManager::begin() {
+  LOG_INFO("[WiFi] Connecting to WiFi: %s", ssid);
+
+  // Reconnects are ours: the driver's own retry has no backoff and no way
+  // to report what it is doing. Credentials are not rewritten to NVS on
+  // every attempt.
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
   WiFi.mode(WIFI_STA);
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) { onEvent(event, info); });
+
+  uint32_t now = millis();
+  downSinceMs = now;
+  startAttempt(now);
+}
+
+// Driver event task: record what happened and hand over to service()
+void WiFiManager::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  uint32_t flag;
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      flag = EVENT_GOT_IP;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      disconnectReason.store(info.wifi_sta_disconnected.reason, std::memory_order_relaxed);
+      flag = EVENT_DISCONNECTED;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      flag = EVENT_DISCONNECTED;
+      break;
+    default:
+      return;
+  }
+  pendingEvents.fetch_or(flag, std::memory_order_release);
+  if (wakeListener) wakeListener(wakeListenerArg);
+}
+
+void WiFiManager::startAttempt(uint32_t now) {
+  state = WIFI_STATE_CONNECTING;
+  attemptStartMs = now;
   WiFi.begin(ssid, password);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < connectionAttempts) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  publish();
+}
+
+// Each failure doubles the wait for the next one, up to BACKOFF_MAX_MS
+void WiFiManager::startBackoff(uint32_t now) {
+  state = WIFI_STATE_BACKOFF;
+  backoffStartMs = now;
+  stats.backoffMs = backoffMs;
+  LOG_WARN("[WiFi] Retrying in %lu ms", (unsigned long)backoffMs);
+  backoffMs = (backoffMs * 2 < BACKOFF_MAX_MS) ? backoffMs * 2 : BACKOFF_MAX_MS;
+  publish();
+}
+
+void WiFiManager::publish() {
+  stats.state = state;
+  published.store(stats);
+}
+
+uint32_t WiFiManager::service() {
+  uint32_t now = millis();
+  uint32_t events = pendingEvents.exchange(0, std::memory_order_acquire);
+
+  if (events & EVENT_DISCONNECTED) {
+    stats.lastReason = disconnectReason.load(std::memory_order_relaxed);
+    if (state == WIFI_STATE_CONNECTED) {
+      isConnected.store(false, std::memory_order_relaxed);
+      stats.drops++;
+      downSinceMs = now;
+      backoffMs = BACKOFF_MIN_MS;
+      LOG_WARN("[WiFi] Connection lost (reason %u)", (unsigned)stats.lastReason);
+      startBackoff(now);
+    } else if (state == WIFI_STATE_CONNECTING) {
+      stats.failedAttempts++;
+      LOG_WARN("[WiFi] Connection attempt failed (reason %u)", (unsigned)stats.lastReason);
+      startBackoff(now);
+    }
   }
-  
-  Serial.println();
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    isConnected = true;
-    Serial.println("[WiFi] WiFi connected successfully!");
-    Serial.print("[WiFi] IP address: ");
-    Serial.println(WiFi.localIP());
-    return true;
-  } else {
-    isConnected = false;
-    Serial.println("[WiFi] WiFi connection failed!");
-    Serial.println("[WiFi] Please check your WiFi credentials and try again.");
-    return false;
+
+  // Checked against the driver, so a drop that followed the IP wins
+  if ((events & EVENT_GOT_IP) && state != WIFI_STATE_IDLE && WiFi.status() == WL_CONNECTED) {
+    state = WIFI_STATE_CONNECTED;
+    backoffMs = BACKOFF_MIN_MS;
+    stats.backoffMs = 0;
+    stats.lastReconnectMs = now - downSinceMs;
+    stats.connectedSinceMs = now;
+    isConnected.store(true, std::memory_order_relaxed);
+    publish();
+    LOG_INFO("[WiFi] WiFi connected after %lu ms", (unsigned long)stats.lastReconnectMs);
+    LOG_INFO("[WiFi] IP address: %s", WiFi.localIP().toString().c_str());
+  }
+
+  switch (state) {
+    case WIFI_STATE_CONNECTING: {
+      uint32_t elapsed = now - attemptStartMs;
+      if (elapsed < CONNECT_TIMEOUT_MS) return CONNECT_TIMEOUT_MS - elapsed;
+      stats.failedAttempts++;
+      LOG_WARN("[WiFi] No connection after %lu ms", (unsigned long)elapsed);
+      WiFi.disconnect();
+      startBackoff(now);
+      return stats.backoffMs;
+    }
+    case WIFI_STATE_BACKOFF: {
+      uint32_t elapsed = now - backoffStartMs;
+      if (elapsed < stats.backoffMs) return stats.backoffMs - elapsed;
+      startAttempt(now);
+      return CONNECT_TIMEOUT_MS;
+    }
+    default:
+      return SCHEDULE_NEVER;
   }
 }
 
 String WiFiManager::getLocalIP() const {
-  if (isConnected) {
+  if (isWiFiConnected()) {
     return WiFi.localIP().toString();
   }
   return "Not connected";
 }
 
+// Stays down until begin() is called again
 void WiFiManager::disconnect() {
+  state = WIFI_STATE_IDLE;
+  isConnected.store(false, std::memory_order_relaxed);
   WiFi.disconnect();
-  isConnected = false;
-  Serial.println("[WiFi] WiFi disconnected");
+  publish();
+  LOG_INFO("[WiFi] WiFi disconnected");
 }
 
 void WiFiManager::printStatus() const {
-  if (isConnected) {
-    Serial.println("[WiFi] Status: Connected");
-    Serial.print("[WiFi] IP: ");
-    Serial.println(getLocalIP());
+  if (isWiFiConnected()) {
+    LOG_INFO("[WiFi] Status: Connected");
+    LOG_INFO("[WiFi] IP: %s", getLocalIP().c_str());
   } else {
-    Serial.println("[WiFi] Status: Disconnected");
+    LOG_INFO("[WiFi] Status: %s", wifiStateName(getStats().state));
   }
 }
@@ -0,0 +1,10 @@
+#include "wifi_stats.h"
+
+const char* wifiStateName(uint8_t state) {
+  switch (state) {
+    case WIFI_STATE_CONNECTING: return "connecting";
+    case WIFI_STATE_CONNECTED:  return "connected";
+    case WIFI_STATE_BACKOFF:    return "backoff";
+    default:                    return "idle";
+  }
+}
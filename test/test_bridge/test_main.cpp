@@ -0,0 +1,208 @@
+// Direction changes on simulated GPIO registers: replaying SimHal's trace
+// one output write at a time, neither bridge is ever in a state no command
+// asked for, whatever the ramps and the other motor are doing.
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+
+// A motor's inputs, duty and STBY as the bridge sees them
+struct BridgeState {
+  bool in1;
+  bool in2;
+  uint32_t duty;
+  bool stby;
+};
+
+static BridgeState bridgeNow(SimHal& hal, const ChannelConfig& channel, uint8_t stbyPin) {
+  BridgeState state = { hal.pinLevel(channel.in1Pin), hal.pinLevel(channel.in2Pin),
+                        hal.pwmDuty(channel.ledcChannel), hal.pinLevel(stbyPin) };
+  return state;
+}
+
+// As sim_main.cpp's checkBridge: brake (both inputs high), a drive
+// direction taking over from the other with the duty still up, or a duty
+// applied while the chip is in standby, counted per output write (changes
+// sharing a write happened in the same instant)
+struct BridgeCheck {
+  unsigned writes;
+  unsigned glitches;
+};
+
+static BridgeCheck checkBridge(const SimHal& hal, size_t from, const ChannelConfig& channel, uint8_t stbyPin,
+                               BridgeState state) {
+  BridgeCheck check = { 0, 0 };
+  int lastDirection = state.in1 != state.in2 ? (state.in1 ? 1 : -1) : 0;
+  const std::vector<SimHal::Event>& events = hal.events();
+  for (size_t i = from; i < events.size(); i++) {
+    const SimHal::Event& event = events[i];
+    if (event.kind == SimHal::EVENT_PIN) {
+      if (event.index == channel.in1Pin) state.in1 = event.value;
+      else if (event.index == channel.in2Pin) state.in2 = event.value;
+      else if (event.index == stbyPin) state.stby = event.value;
+      else continue;
+    } else if (event.index == channel.ledcChannel) {
+      state.duty = event.value;
+    } else {
+      continue;
+    }
+    if (i + 1 < events.size() && events[i + 1].write == event.write) continue;
+
+    check.writes++;
+    int direction = state.in1 != state.in2 ? (state.in1 ? 1 : -1) : 0;
+    bool glitch = (state.in1 && state.in2) || (direction != 0 && state.duty > 0 && !state.stby);
+    if (direction != 0 && lastDirection != 0 && direction != lastDirection && state.duty > 0) glitch = true;
+    if (glitch) check.glitches++;
+    if (direction != 0) lastDirection = direction;
+  }
+  return check;
+}
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+void setUp() {
+  rngState = 0xA5A5F00D;
+}
+
+void tearDown() {
+  logFlush();
+}
+
+// Both inputs move in one register write per level, clear first, so a
+// reversal passes through coast and never through brake
+static void test_set_inputs_single_write() {
+  SimHal hal;
+  const ChannelConfig& channel = PUMP_CHANNELS[0];
+  hal.pinModeOutput(channel.in1Pin);
+  hal.pinModeOutput(channel.in2Pin);
+  Tb6612Driver::setInputs(hal, channel, true, false);
+
+  hal.clearEvents();
+  Tb6612Driver::setInputs(hal, channel, false, true);
+  const std::vector<SimHal::Event>& events = hal.events();
+  TEST_ASSERT_EQUAL(2, events.size());
+  TEST_ASSERT_EQUAL(channel.in1Pin, events[0].index);
+  TEST_ASSERT_EQUAL(0, events[0].value);
+  TEST_ASSERT_EQUAL(channel.in2Pin, events[1].index);
+  TEST_ASSERT_EQUAL(1, events[1].value);
+  TEST_ASSERT_NOT_EQUAL(events[0].write, events[1].write);
+
+  Tb6612Driver::setInputs(hal, channel, false, false);
+  hal.clearEvents();
+  Tb6612Driver::setInputs(hal, channel, true, true);  // Brake on request: one instant, both inputs
+  TEST_ASSERT_EQUAL(2, hal.events().size());
+  TEST_ASSERT_EQUAL(hal.events()[0].write, hal.events()[1].write);
+  TEST_ASSERT_TRUE(hal.pinLevel(channel.in1Pin) && hal.pinLevel(channel.in2Pin));
+}
+
+// The check itself catches the glitch separate pin writes make
+static void test_check_catches_pin_by_pin_reversal() {
+  SimHal hal;
+  const ChannelConfig& channel = PUMP_CHANNELS[0];
+  uint8_t stby = MOTOR_DRIVERS[channel.driver].stbyPin;
+  hal.writePin(stby, true);
+  hal.writePin(channel.in1Pin, true);
+  hal.pwmWrite(channel.ledcChannel, 500);
+  BridgeState before = bridgeNow(hal, channel, stby);
+
+  size_t from = hal.events().size();
+  hal.writePin(channel.in2Pin, true);   // Brake for a moment
+  hal.writePin(channel.in1Pin, false);
+  BridgeCheck check = checkBridge(hal, from, channel, stby, before);
+  TEST_ASSERT_EQUAL(2, check.writes);
+  TEST_ASSERT_EQUAL(2, check.glitches);  // The brake, then the reversal at full duty
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+
+  Rig()
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+  }
+
+  void command(CommandTarget target, CommandAction action, uint32_t speed) {
+    PumpCommand command = {};
+    command.target = target;
+    command.action = action;
+    command.speed = speed;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+    logFlush();
+  }
+
+  void setRamp(RampShape shape, uint16_t rampMs) {
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.action = ACTION_SET_RAMP;
+    command.ramp.shape = shape;
+    command.ramp.rampMs = rampMs;
+    controller.execute(command);
+  }
+};
+
+// Random direction changes, speeds and stops on both motors, with each
+// ramp shape
+static void test_random_direction_changes() {
+  static const CommandAction PUMP_ACTIONS[] = { ACTION_FORWARD, ACTION_REVERSE, ACTION_STOP };
+  static const CommandAction VACUUM_ACTIONS[] = { ACTION_START, ACTION_STOP, ACTION_EMERGENCY };
+  static const RampShape SHAPES[] = { RAMP_OFF, RAMP_LINEAR, RAMP_SCURVE };
+  const ChannelConfig& pumpPins = PUMP_CHANNELS[0];
+
+  for (uint8_t s = 0; s < 3; s++) {
+    Rig rig;
+    uint8_t stby = MOTOR_DRIVERS[pumpPins.driver].stbyPin;
+    rig.setRamp(SHAPES[s], 40);
+    BridgeState pumpBefore = bridgeNow(rig.hal, pumpPins, stby);
+    BridgeState vacuumBefore = bridgeNow(rig.hal, VACUUM_CHANNEL, stby);
+    size_t from = rig.hal.events().size();
+
+    for (int i = 0; i < 1500; i++) {
+      if (nextRandom() % 3) {
+        rig.command(TARGET_PUMP, PUMP_ACTIONS[nextRandom() % 3], 100 + nextRandom() % 924);
+      } else {
+        rig.command(TARGET_VACUUM, VACUUM_ACTIONS[nextRandom() % 3], 10 + nextRandom() % 71);
+      }
+      // Often in the middle of a ramp, sometimes well past it
+      rig.hal.advanceUs(nextRandom() % 60000);
+      rig.controller.service();
+    }
+
+    BridgeCheck pump = checkBridge(rig.hal, from, pumpPins, stby, pumpBefore);
+    BridgeCheck vacuum = checkBridge(rig.hal, from, VACUUM_CHANNEL, stby, vacuumBefore);
+    char report[120];
+    snprintf(report, sizeof(report), "ramp %s: pump %u writes %u glitches, vacuum %u writes %u glitches",
+             rampShapeName(SHAPES[s]), pump.writes, pump.glitches, vacuum.writes, vacuum.glitches);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_GREATER_THAN(1000, pump.writes);
+    TEST_ASSERT_GREATER_THAN(500, vacuum.writes);
+    TEST_ASSERT_EQUAL(0, pump.glitches);
+    TEST_ASSERT_EQUAL(0, vacuum.glitches);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_set_inputs_single_write);
+  RUN_TEST(test_check_catches_pin_by_pin_reversal);
+  RUN_TEST(test_random_direction_changes);
+  return UNITY_END();
+}
@@ -0,0 +1,381 @@
+// Request body parsing (parsePumpCommand, parseCommandBatch): a corpus of
+// well-formed and malformed bodies, randomized properties over generated
+// and mutated ones, and commands parsed per second against the substring
+// helpers the web server used before.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include "pump_command.h"
+
+// Every operator new in the process, so a test can tell whether the code
+// under it touched the heap
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+static CommandParseError parse(const char* body, CommandTarget target, PumpCommand& command) {
+  return parsePumpCommand(body, strlen(body), target, command);
+}
+
+void setUp() {
+  rngState = 0x2545F491;
+}
+
+void tearDown() {}
+
+static void test_fields_and_whitespace() {
+  PumpCommand command;
+  TEST_ASSERT_EQUAL(CMD_OK, parse(" {\n\t\"action\" : \"forward\" ,\r\n \"speed\":512, \"duration\" : 5 } ",
+                                  TARGET_PUMP, command));
+  TEST_ASSERT_EQUAL(TARGET_PUMP, command.target);
+  TEST_ASSERT_EQUAL(ACTION_FORWARD, command.action);
+  TEST_ASSERT_TRUE(command.hasSpeed);
+  TEST_ASSERT_EQUAL_UINT32(512, command.speed);
+  TEST_ASSERT_TRUE(command.hasDuration);
+  TEST_ASSERT_EQUAL_UINT32(5000, command.duration);
+  TEST_ASSERT_FALSE(command.hasVolume);
+
+  TEST_ASSERT_EQUAL(CMD_OK, parse("{\"durationMs\":1500,\"action\":\"start\",\"speed\":800,\"targetPa\":20000}",
+                                  TARGET_VACUUM, command));
+  TEST_ASSERT_EQUAL(ACTION_START, command.action);
+  TEST_ASSERT_EQUAL_UINT32(1500, command.duration);
+  TEST_ASSERT_TRUE(command.hasPressure);
+  TEST_ASSERT_EQUAL_UINT32(20000, command.pressure);
+
+  TEST_ASSERT_EQUAL(CMD_OK, parse("{\"action\":\"forward\",\"volume\":500,\"flowRate\":300}", TARGET_PUMP, command));
+  TEST_ASSERT_EQUAL_UINT32(500, command.volume);
+  TEST_ASSERT_EQUAL_UINT32(300, command.flowRate);
+  TEST_ASSERT_FALSE(command.hasSpeed);
+  TEST_ASSERT_FALSE(command.hasDuration);
+
+  // Unknown fields are skipped whatever their value
+  TEST_ASSERT_EQUAL(CMD_OK, parse("{\"note\":{\"a\":[1,2.5e3,true,null,\"x\\\"}\"]},\"action\":\"stop\",\"neg\":-4}",
+                                  TARGET_PUMP, command));
+  TEST_ASSERT_EQUAL(ACTION_STOP, command.action);
+}
+
+struct ErrorCase {
+  const char* body;
+  CommandTarget target;
+  CommandParseError expected;
+};
+
+static void test_malformed_corpus() {
+  static const ErrorCase cases[] = {
+    { "", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "   ", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "[]", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\"", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\",}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\" \"stop\"}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{action:\"stop\"}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\"} x", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\"}{}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\",\"speed\":012}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop\",\"x\":[[[[[[[[[[1]]]]]]]]]]}", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{\"action\":\"stop", TARGET_PUMP, CMD_ERR_SYNTAX },
+    { "{}", TARGET_PUMP, CMD_ERR_MISSING_ACTION },
+    { "{\"speed\":500}", TARGET_PUMP, CMD_ERR_MISSING_ACTION },
+    { "{\"action\":\"start\"}", TARGET_PUMP, CMD_ERR_UNKNOWN_ACTION },
+    { "{\"action\":\"forward\"}", TARGET_VACUUM, CMD_ERR_UNKNOWN_ACTION },
+    { "{\"action\":\"FORWARD\"}", TARGET_PUMP, CMD_ERR_UNKNOWN_ACTION },
+    { "{\"action\":\"\"}", TARGET_PUMP, CMD_ERR_UNKNOWN_ACTION },
+    { "{\"action\":1}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"speed\":\"500\"}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"speed\":-1}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"speed\":1.5}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"speed\":1e3}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"speed\":4294967296}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"duration\":4294968}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"forward\",\"targetPa\":20000}", TARGET_PUMP, CMD_ERR_BAD_FIELD },
+    { "{\"action\":\"stop\",\"action\":\"stop\"}", TARGET_PUMP, CMD_ERR_DUPLICATE_FIELD },
+    { "{\"action\":\"forward\",\"speed\":1,\"speed\":2}", TARGET_PUMP, CMD_ERR_DUPLICATE_FIELD },
+    { "{\"action\":\"forward\",\"duration\":1,\"durationMs\":2}", TARGET_PUMP, CMD_ERR_DUPLICATE_FIELD },
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    PumpCommand command;
+    char message[160];
+    snprintf(message, sizeof(message), "case %u: %s", (unsigned)i, cases[i].body);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(cases[i].expected, parse(cases[i].body, cases[i].target, command), message);
+    TEST_ASSERT_NOT_NULL(commandParseErrorMessage(cases[i].expected));
+  }
+}
+
+static void test_batch() {
+  static const char BODY[] =
+    "[ {\"target\":\"vacuum\",\"action\":\"start\",\"speed\":60},"
+    "  {\"action\":\"forward\",\"channel\":0,\"durationMs\":500} ]";
+  CommandBatch batch;
+  int bad;
+  TEST_ASSERT_EQUAL(CMD_OK, parseCommandBatch(BODY, strlen(BODY), batch, bad));
+  TEST_ASSERT_EQUAL(2, batch.count);
+  TEST_ASSERT_EQUAL(TARGET_VACUUM, batch.commands[0].target);
+  TEST_ASSERT_EQUAL(ACTION_START, batch.commands[0].action);
+  TEST_ASSERT_EQUAL(TARGET_PUMP, batch.commands[1].target);
+  TEST_ASSERT_EQUAL_UINT32(500, batch.commands[1].duration);
+
+  static const char VACUUM_CHANNEL_BODY[] = "[{\"action\":\"stop\"},{\"target\":\"vacuum\",\"channel\":1,\"action\":\"stop\"}]";
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseCommandBatch(VACUUM_CHANNEL_BODY, strlen(VACUUM_CHANNEL_BODY), batch, bad));
+  TEST_ASSERT_EQUAL(1, bad);
+
+  TEST_ASSERT_EQUAL(CMD_ERR_MISSING_FIELD, parseCommandBatch("[]", 2, batch, bad));
+  TEST_ASSERT_EQUAL(-1, bad);
+
+  std::string tooMany = "[";
+  for (int i = 0; i <= CommandBatch::MAX_COMMANDS; i++) tooMany += i ? ",{\"action\":\"stop\"}" : "{\"action\":\"stop\"}";
+  tooMany += "]";
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseCommandBatch(tooMany.c_str(), tooMany.size(), batch, bad));
+  TEST_ASSERT_EQUAL(CommandBatch::MAX_COMMANDS, bad);
+}
+
+// Random whitespace between tokens, as any JSON encoder might emit it
+static void appendSpace(std::string& body) {
+  static const char SPACE[] = " \t\r\n";
+  uint32_t n = nextRandom() % 4;
+  for (uint32_t i = 0; i < n; i++) body += SPACE[nextRandom() % 4];
+}
+
+static void appendField(std::string& body, bool& first, const char* key, const std::string& value) {
+  appendSpace(body);
+  if (!first) {
+    body += ',';
+    appendSpace(body);
+  }
+  first = false;
+  body += '"';
+  body += key;
+  body += '"';
+  appendSpace(body);
+  body += ':';
+  appendSpace(body);
+  body += value;
+}
+
+// Commands built field by field in random order, with random whitespace and
+// unknown fields mixed in, parse back to exactly what was put in
+static void test_generated_commands_round_trip() {
+  static const char* const ACTIONS[] = { "stop", "forward", "reverse" };
+  static const char* const UNKNOWN[] = { "1", "\"text\"", "[1, {\"a\": null}]", "false", "-2.5e-3" };
+  for (int run = 0; run < 5000; run++) {
+    uint32_t action = nextRandom() % 3;
+    bool hasSpeed = nextRandom() & 1, hasDuration = nextRandom() & 1, inMs = nextRandom() & 1;
+    bool hasVolume = nextRandom() & 1, hasUnknown = nextRandom() & 1;
+    uint32_t speed = nextRandom() % 2000, duration = nextRandom() % 100000, volume = nextRandom();
+    char number[16];
+
+    // Fields placed in a random order by picking from the remaining ones
+    int order[5] = { 0, 1, 2, 3, 4 };
+    for (int i = 4; i > 0; i--) {
+      int j = nextRandom() % (i + 1);
+      int t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+    std::string body;
+    appendSpace(body);
+    body += '{';
+    bool first = true;
+    for (int i = 0; i < 5; i++) {
+      switch (order[i]) {
+        case 0:
+          appendField(body, first, "action", std::string("\"") + ACTIONS[action] + "\"");
+          break;
+        case 1:
+          if (!hasSpeed) break;
+          snprintf(number, sizeof(number), "%lu", (unsigned long)speed);
+          appendField(body, first, "speed", number);
+          break;
+        case 2:
+          if (!hasDuration) break;
+          snprintf(number, sizeof(number), "%lu", (unsigned long)(inMs ? duration : duration / 1000));
+          appendField(body, first, inMs ? "durationMs" : "duration", number);
+          break;
+        case 3:
+          if (!hasVolume) break;
+          snprintf(number, sizeof(number), "%lu", (unsigned long)volume);
+          appendField(body, first, "volume", number);
+          break;
+        case 4:
+          if (hasUnknown) appendField(body, first, "extra", UNKNOWN[nextRandom() % 5]);
+          break;
+      }
+    }
+    appendSpace(body);
+    body += '}';
+    appendSpace(body);
+
+    PumpCommand command;
+    TEST_ASSERT_EQUAL_INT_MESSAGE(CMD_OK, parsePumpCommand(body.data(), body.size(), TARGET_PUMP, command), body.c_str());
+    TEST_ASSERT_EQUAL(ACTION_STOP + action, command.action);
+    TEST_ASSERT_EQUAL(hasSpeed, command.hasSpeed);
+    if (hasSpeed) TEST_ASSERT_EQUAL_UINT32(speed, command.speed);
+    TEST_ASSERT_EQUAL(hasDuration, command.hasDuration);
+    if (hasDuration) TEST_ASSERT_EQUAL_UINT32(inMs ? duration : duration / 1000 * 1000, command.duration);
+    TEST_ASSERT_EQUAL(hasVolume, command.hasVolume);
+    if (hasVolume) TEST_ASSERT_EQUAL_UINT32(volume, command.volume);
+  }
+}
+
+static const char* const SEEDS[] = {
+  "{\"action\":\"forward\",\"speed\":512,\"duration\":5}",
+  "{\"action\": \"reverse\", \"speed\": 1023, \"durationMs\": 250}",
+  "{\"action\":\"stop\"}",
+  "{\"action\":\"forward\",\"volume\":500,\"flowRate\":300,\"meta\":{\"k\":[1,\"a\\u0041\"]}}",
+};
+
+// A body cut short anywhere is never taken as a command
+static void test_truncated_bodies_rejected() {
+  for (size_t s = 0; s < sizeof(SEEDS) / sizeof(SEEDS[0]); s++) {
+    size_t length = strlen(SEEDS[s]);
+    for (size_t cut = 0; cut < length; cut++) {
+      PumpCommand command;
+      TEST_ASSERT_NOT_EQUAL(CMD_OK, parsePumpCommand(SEEDS[s], cut, TARGET_PUMP, command));
+    }
+  }
+}
+
+// Seeds with random bytes flipped, inserted or removed: the parser stays
+// within the length it is given (each body sits at the very end of its
+// buffer, with no terminator), and whatever it accepts is a sound command
+static void test_mutated_bodies() {
+  std::vector<char> buffer;
+  unsigned accepted = 0;
+  for (int run = 0; run < 20000; run++) {
+    std::string body = SEEDS[nextRandom() % (sizeof(SEEDS) / sizeof(SEEDS[0]))];
+    uint32_t edits = 1 + nextRandom() % 4;
+    for (uint32_t e = 0; e < edits && !body.empty(); e++) {
+      size_t at = nextRandom() % body.size();
+      switch (nextRandom() % 3) {
+        case 0: body[at] = (char)(nextRandom() & 0xFF); break;
+        case 1: body.insert(at, 1, "{}[]\":,0-9 \\"[nextRandom() % 12]); break;
+        case 2: body.erase(at, 1); break;
+      }
+    }
+    buffer.assign(body.begin(), body.end());
+    buffer.shrink_to_fit();
+
+    PumpCommand command;
+    CommandParseError error = parsePumpCommand(buffer.data(), buffer.size(), TARGET_PUMP, command);
+    TEST_ASSERT_LESS_OR_EQUAL(CMD_ERR_MISSING_FIELD, error);
+    if (error == CMD_OK) {
+      accepted++;
+      TEST_ASSERT_TRUE(command.action == ACTION_STOP || command.action == ACTION_FORWARD ||
+                       command.action == ACTION_REVERSE);
+      // Parsing is deterministic: the same bytes give the same command
+      PumpCommand again;
+      TEST_ASSERT_EQUAL(CMD_OK, parsePumpCommand(buffer.data(), buffer.size(), TARGET_PUMP, again));
+      TEST_ASSERT_EQUAL(command.action, again.action);
+      TEST_ASSERT_EQUAL_UINT32(command.speed, again.speed);
+      TEST_ASSERT_EQUAL_UINT32(command.duration, again.duration);
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(0, accepted);  // Some mutations land in skipped or numeric text
+}
+
+static void test_no_heap_use() {
+  PumpCommand command;
+  CommandBatch batch;
+  int bad;
+  static const char BATCH[] = "[{\"target\":\"vacuum\",\"action\":\"stop\"},{\"action\":\"forward\",\"speed\":300}]";
+  unsigned long before = allocations;
+  for (size_t s = 0; s < sizeof(SEEDS) / sizeof(SEEDS[0]); s++) parse(SEEDS[s], TARGET_PUMP, command);
+  parse("{\"action\": ", TARGET_PUMP, command);
+  parseCommandBatch(BATCH, strlen(BATCH), batch, bad);
+  TEST_ASSERT_EQUAL(before, allocations);
+}
+
+// The helpers /api/control used before the parser: one indexOf scan and a
+// substring per field, as WebServerManager::parseAction/parseSpeed/
+// parseDuration did with Arduino String. std::string keeps short
+// substrings inline where String allocated each one, so the allocation count
+// here is a lower bound of the old code's.
+static std::string legacyAction(const std::string& body) {
+  if (body.find("\"action\":\"forward\"") != std::string::npos) return "forward";
+  if (body.find("\"action\":\"reverse\"") != std::string::npos) return "reverse";
+  if (body.find("\"action\":\"stop\"") != std::string::npos) return "stop";
+  return "";
+}
+
+static uint32_t legacyNumber(const std::string& body, const char* key, uint32_t fallback) {
+  size_t start = body.find(key);
+  if (start == std::string::npos) return fallback;
+  start += strlen(key);
+  size_t end = body.find(",", start);
+  if (end == std::string::npos) end = body.find("}", start);
+  if (end == std::string::npos || end <= start) return fallback;
+  std::string digits = body.substr(start, end - start);
+  return (uint32_t)atol(digits.c_str());
+}
+
+static void test_benchmark_against_legacy_helpers() {
+  // The page's own request: field order and spacing as JSON.stringify sends it
+  static const char BODY[] = "{\"action\":\"forward\",\"speed\":512,\"duration\":5}";
+  const int RUNS = 200000;
+  volatile uint32_t sink = 0;
+
+  unsigned long before = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    std::string body(BODY);  // server.arg("plain") handed out a copy
+    std::string action = legacyAction(body);
+    sink += action.size() + legacyNumber(body, "\"speed\":", 0) + legacyNumber(body, "\"duration\":", 0);
+  }
+  double legacyUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long legacyAllocs = allocations - before;
+
+  before = allocations;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    PumpCommand command;
+    parsePumpCommand(BODY, sizeof(BODY) - 1, TARGET_PUMP, command);
+    sink += command.action + command.speed + command.duration;
+  }
+  double parserUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long parserAllocs = allocations - before;
+
+  char report[200];
+  snprintf(report, sizeof(report),
+           "legacy helpers: %.0f commands/s, %.1f allocations each; parser: %.0f commands/s, %.1f allocations each",
+           RUNS / legacyUs * 1e6, (double)legacyAllocs / RUNS, RUNS / parserUs * 1e6, (double)parserAllocs / RUNS);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL(0, parserAllocs);
+  TEST_ASSERT_GREATER_THAN(0, legacyAllocs);
+  (void)sink;
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fields_and_whitespace);
+  RUN_TEST(test_malformed_corpus);
+  RUN_TEST(test_batch);
+  RUN_TEST(test_generated_commands_round_trip);
+  RUN_TEST(test_truncated_bodies_rejected);
+  RUN_TEST(test_mutated_bodies);
+  RUN_TEST(test_no_heap_use);
+  RUN_TEST(test_benchmark_against_legacy_helpers);
+  return UNITY_END();
+}
@@ -0,0 +1,224 @@
+// Serial console (CommandConsole, parseConsoleLine) fed scripted input the
+// way the port delivers it, through the shared CommandDispatcher to the
+// pumps on SimHal.
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+#include "command_dispatcher.h"
+#include "command_console.h"
+
+// Stands in for the control task's queue, as sim_main.cpp does
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  return true;
+}
+
+// A sink whose queue is always full
+static bool rejectAll(void*, const CommandBatch&) {
+  return false;
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+  ProtocolSequencer sequencer;
+  CommandDispatcher dispatcher;
+  CommandConsole console;
+  std::vector<std::string> replies;
+
+  static void capture(void* arg, const char* line) {
+    static_cast<Rig*>(arg)->replies.push_back(line);
+  }
+
+  explicit Rig(CommandSink sink = executeNow)
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal), sequencer(controller, hal),
+      dispatcher(controller, sequencer, sink, &controller), console(dispatcher, hal, capture, this) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    sequencer.begin();
+  }
+
+  void type(const char* text) {
+    console.feed(text, strlen(text));
+    logFlush();
+  }
+
+  void runMs(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 20) {
+      hal.advanceMs(20);
+      controller.service();
+    }
+    logFlush();
+  }
+
+  const std::string& lastReply() const {
+    static const std::string none;
+    return replies.empty() ? none : replies.back();
+  }
+};
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+static CommandParseError parseLine(const char* line, ConsoleRequest& request) {
+  return parseConsoleLine(line, strlen(line), request);
+}
+
+static void test_parse_lines() {
+  ConsoleRequest request;
+  TEST_ASSERT_EQUAL(CMD_OK, parseLine("  pump\tforward speed=700  duration=2 ", request));
+  TEST_ASSERT_EQUAL(CONSOLE_COMMAND, request.verb);
+  TEST_ASSERT_EQUAL(TARGET_PUMP, request.command.target);
+  TEST_ASSERT_EQUAL(ACTION_FORWARD, request.command.action);
+  TEST_ASSERT_EQUAL_UINT32(700, request.command.speed);
+  TEST_ASSERT_EQUAL_UINT32(2000, request.command.duration);
+
+  TEST_ASSERT_EQUAL(CMD_OK, parseLine("vacuum start targetPa=20000 durationMs=150", request));
+  TEST_ASSERT_EQUAL(TARGET_VACUUM, request.command.target);
+  TEST_ASSERT_TRUE(request.command.hasPressure);
+  TEST_ASSERT_EQUAL_UINT32(150, request.command.duration);
+
+  TEST_ASSERT_EQUAL(CMD_OK, parseLine("estop", request));
+  TEST_ASSERT_EQUAL(CONSOLE_ESTOP, request.verb);
+  TEST_ASSERT_EQUAL(CMD_OK, parseLine("status", request));
+  TEST_ASSERT_EQUAL(CONSOLE_STATUS, request.verb);
+
+  TEST_ASSERT_EQUAL(CMD_ERR_MISSING_ACTION, parseLine("   ", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_MISSING_ACTION, parseLine("pump", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_UNKNOWN_ACTION, parseLine("pmup forward", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_UNKNOWN_ACTION, parseLine("pump start", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_UNKNOWN_ACTION, parseLine("vacuum emergency", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_SYNTAX, parseLine("pump forward 700", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_SYNTAX, parseLine("status now", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseLine("pump forward sped=700", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseLine("pump forward speed=-1", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseLine("pump forward speed=", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_BAD_FIELD, parseLine("pump forward targetPa=20000", request));
+  TEST_ASSERT_EQUAL(CMD_ERR_DUPLICATE_FIELD, parseLine("pump forward duration=1 durationMs=5", request));
+}
+
+// Reads split mid-line, every line ending, a backspace, and a line too
+// long for the buffer
+static void test_scripted_session() {
+  Rig rig;
+  rig.type("pump forward spe");
+  TEST_ASSERT_TRUE(rig.replies.empty());
+  rig.type("ed=700 durationMs=300\r");
+  TEST_ASSERT_EQUAL_STRING("ok pump forward speed=700 durationMs=300", rig.lastReply().c_str());
+  TEST_ASSERT_EQUAL(PUMP_FORWARD, rig.controller.status().pumpState);
+
+  rig.type("\n");  // The LF of a CRLF
+  TEST_ASSERT_EQUAL(1, rig.replies.size());
+
+  rig.type("vacuum startX\b speed=1023 duration=2\r\n");
+  TEST_ASSERT_EQUAL_STRING("ok vacuum start speed=100% durationMs=2000", rig.lastReply().c_str());
+  TEST_ASSERT_EQUAL(VACUUM_RUNNING, rig.controller.status().vacuumState);
+
+  rig.replies.clear();
+  rig.type("status\n");
+  TEST_ASSERT_EQUAL(3, rig.replies.size());
+  TEST_ASSERT_EQUAL_STRING("pump forward speed=700 remainingMs=300", rig.replies[0].c_str());
+
+  rig.runMs(300);
+  TEST_ASSERT_EQUAL(PUMP_STOPPED, rig.controller.status().pumpState);
+
+  std::string tooLong(CommandConsole::LINE_SIZE + 10, 'x');
+  rig.type((tooLong + "\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("error: line too long", rig.lastReply().c_str());
+  rig.type("pump stop\n");  // The console carries on with the next line
+  TEST_ASSERT_EQUAL_STRING("ok pump stop", rig.lastReply().c_str());
+
+  rig.type("pump reverse sped=300\n");
+  TEST_ASSERT_EQUAL(0, rig.lastReply().find("error: "));
+  TEST_ASSERT_EQUAL(PUMP_STOPPED, rig.controller.status().pumpState);
+}
+
+// Values are limited exactly as an HTTP request's are
+static void test_limits_match_web() {
+  Rig rig;
+  rig.type("pump forward speed=5 durationMs=999999999\n");
+  TEST_ASSERT_EQUAL_STRING("ok pump forward speed=100 durationMs=300000", rig.lastReply().c_str());
+  rig.type("vacuum start speed=0 durationMs=0\n");
+  TEST_ASSERT_EQUAL_STRING("ok vacuum start speed=10% durationMs=1", rig.lastReply().c_str());
+}
+
+// A start that leaves the speed out falls back to the stored one, held to
+// the same limits as a given speed. Below them here, as left by commands
+// applied straight to the controller.
+static void test_fallback_speed_clamped() {
+  Rig rig;
+  PumpCommand command = {};
+  command.action = ACTION_FORWARD;
+  command.speed = 40;
+  rig.controller.execute(command);
+  command.target = TARGET_VACUUM;
+  command.action = ACTION_START;
+  command.speed = 3;
+  rig.controller.execute(command);
+  rig.type("pump stop\n");
+  rig.type("vacuum stop\n");
+  TEST_ASSERT_EQUAL(40, rig.controller.status().pumpSpeed);
+  TEST_ASSERT_EQUAL(3, rig.controller.status().vacuumSpeed);
+
+  rig.type("pump forward durationMs=100\n");
+  TEST_ASSERT_EQUAL_STRING("ok pump forward speed=100 durationMs=100", rig.lastReply().c_str());
+  TEST_ASSERT_EQUAL(100, rig.controller.status().pumpSpeed);
+  rig.type("vacuum start durationMs=100\n");
+  TEST_ASSERT_EQUAL_STRING("ok vacuum start speed=10% durationMs=100", rig.lastReply().c_str());
+  TEST_ASSERT_EQUAL(10, rig.controller.status().vacuumSpeed);
+}
+
+// estop cuts every motor, not only the vacuum pump
+static void test_estop_stops_everything() {
+  Rig rig;
+  rig.type("pump forward speed=600\n");
+  rig.type("vacuum start speed=800\n");
+  rig.runMs(100);
+  TEST_ASSERT_EQUAL(PUMP_FORWARD, rig.controller.status().pumpState);
+
+  rig.type("estop\n");
+  TEST_ASSERT_EQUAL_STRING("ok emergency stop", rig.lastReply().c_str());
+  PumpStatus status = rig.controller.status();
+  TEST_ASSERT_EQUAL(VACUUM_STOPPED, status.vacuumState);
+  for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) TEST_ASSERT_EQUAL(PUMP_STOPPED, status.channels[i].state);
+  rig.runMs(200);  // Past any ramp down
+  for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) TEST_ASSERT_EQUAL(0, rig.hal.pwmDuty(PUMP_CHANNELS[i].ledcChannel));
+  TEST_ASSERT_EQUAL(0, rig.hal.pwmDuty(VACUUM_CHANNEL.ledcChannel));
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(VACUUM_CHANNEL.in1Pin));
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(VACUUM_CHANNEL.in2Pin));
+}
+
+static void test_busy_controller_reported() {
+  Rig rig(rejectAll);
+  rig.type("pump forward speed=600\n");
+  TEST_ASSERT_EQUAL_STRING("error: controller busy", rig.lastReply().c_str());
+  rig.type("estop\n");
+  TEST_ASSERT_EQUAL_STRING("error: controller busy", rig.lastReply().c_str());
+  TEST_ASSERT_EQUAL(PUMP_STOPPED, rig.controller.status().pumpState);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_lines);
+  RUN_TEST(test_scripted_session);
+  RUN_TEST(test_limits_match_web);
+  RUN_TEST(test_fallback_speed_clamped);
+  RUN_TEST(test_estop_stops_everything);
+  RUN_TEST(test_busy_controller_reported);
+  return UNITY_END();
+}
@@ -0,0 +1,321 @@
+// The control task's side of the split from the web server: the SeqLock
+// that publishes PumpStatus, read from real threads while it is written,
+// and timed stops under a synthetic storm of HTTP requests on SimHal's
+// clock, compared with where the old single loop() would have stopped.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "seqlock.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+#include "command_dispatcher.h"
+#include "http_request.h"
+
+static const uint32_t STOP_ERROR_BOUND_US = 1000;
+
+// Stands in for the control task's queue, as sim_main.cpp does
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  return true;
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+  ProtocolSequencer sequencer;
+  CommandDispatcher dispatcher;
+
+  Rig()
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal), sequencer(controller, hal),
+      dispatcher(controller, sequencer, executeNow, &controller) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    sequencer.begin();
+  }
+
+  void command(CommandTarget target, CommandAction action, uint32_t speed, uint32_t durationMs) {
+    PumpCommand command = {};
+    command.target = target;
+    command.action = action;
+    command.speed = speed;
+    command.duration = durationMs;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+  }
+};
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+void setUp() {
+  rngState = 0x2545F491;
+}
+
+void tearDown() {
+  logFlush();
+}
+
+// Every word derived from the sequence number, so a copy that mixes two
+// stores shows
+struct Sample {
+  uint32_t sequence;
+  uint32_t words[31];
+};
+
+static void fillSample(Sample& sample, uint32_t sequence) {
+  sample.sequence = sequence;
+  for (uint32_t i = 0; i < 31; i++) sample.words[i] = sequence * (i + 1) ^ 0x9E3779B9;
+}
+
+static bool sampleIntact(const Sample& sample) {
+  for (uint32_t i = 0; i < 31; i++) {
+    if (sample.words[i] != (sample.sequence * (i + 1) ^ 0x9E3779B9)) return false;
+  }
+  return true;
+}
+
+// One writer storing as fast as it can, readers on other threads: no torn
+// copy, and no reader ever sees the value go backwards
+static void test_seqlock_concurrent_readers() {
+  static SeqLock<Sample> lock;
+  const uint32_t STORES = 2000000;
+  const int READERS = 3;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> torn(0), backwards(0), loads(0);
+  Sample sample;
+  fillSample(sample, 0);
+  lock.store(sample);
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < READERS; r++) {
+    readers.push_back(std::thread([&]() {
+      uint32_t last = 0, count = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        Sample sample = lock.load();
+        if (!sampleIntact(sample)) torn++;
+        if (sample.sequence < last) backwards++;
+        last = sample.sequence;
+        count++;
+      }
+      loads += count;
+    }));
+  }
+
+  for (uint32_t i = 1; i <= STORES; i++) {
+    fillSample(sample, i);
+    lock.store(sample);
+  }
+  done.store(true, std::memory_order_release);
+  for (size_t r = 0; r < readers.size(); r++) readers[r].join();
+
+  char report[96];
+  snprintf(report, sizeof(report), "%lu stores, %lu concurrent loads", (unsigned long)STORES,
+           (unsigned long)loads.load());
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+  TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+  TEST_ASSERT_EQUAL_UINT32(STORES, lock.load().sequence);
+}
+
+// Status readers on other threads while commands are applied: the channel 0
+// copy and the pump* fields of every snapshot come from the same publish
+static void test_status_snapshots_consistent() {
+  Rig rig;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> mismatched(0), reads(0);
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; r++) {
+    readers.push_back(std::thread([&]() {
+      uint32_t count = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        PumpStatus status = rig.controller.status();
+        const ChannelStatus& first = status.channels[0];
+        if (status.pumpState != first.state || status.pumpSpeed != first.speed ||
+            status.pumpTimedRun != first.timedRun || status.pumpRunDurationMs != first.runDurationMs ||
+            status.pumpStopDeadlineUs != first.stopDeadlineUs) {
+          mismatched++;
+        }
+        count++;
+      }
+      reads += count;
+    }));
+  }
+
+  static const CommandAction PUMP_ACTIONS[] = { ACTION_FORWARD, ACTION_REVERSE, ACTION_STOP };
+  for (int i = 0; i < 20000; i++) {
+    if (nextRandom() % 4) {
+      rig.command(TARGET_PUMP, PUMP_ACTIONS[nextRandom() % 3], 100 + nextRandom() % 924, 1 + nextRandom() % 300000);
+    } else {
+      rig.command(TARGET_VACUUM, nextRandom() & 1 ? ACTION_START : ACTION_STOP, 10 + nextRandom() % 91, 0);
+    }
+    rig.hal.advanceUs(nextRandom() % 5000);
+    rig.controller.service();
+    if (i % 256 == 0) logFlush();
+  }
+  done.store(true, std::memory_order_release);
+  for (size_t r = 0; r < readers.size(); r++) readers[r].join();
+
+  char report[64];
+  snprintf(report, sizeof(report), "%lu concurrent status reads", (unsigned long)reads.load());
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL_UINT32(0, mismatched.load());
+}
+
+// What the web server does with one request: parse it, and either read the
+// status or resolve and submit a command, as WebServerManager's handlers do
+static void serveRequest(Rig& rig, const HttpRequest& request) {
+  if (request.method() == HTTP_METHOD_GET && strcmp(request.path(), "/api/status") == 0) {
+    PumpStatus status = rig.controller.status();
+    uint64_t now = rig.hal.nowUs();
+    char json[160];
+    snprintf(json, sizeof(json), "{\"pump\":\"%s\",\"remainingMs\":%lu,\"vacuum\":\"%s\",\"dose\":%lu}",
+             pumpStateName(status.pumpState),
+             (unsigned long)remainingMs(status.pumpTimedRun, status.pumpStopDeadlineUs, now),
+             vacuumStateName(status.vacuumState), (unsigned long)doseDeliveredUl(status, now));
+    return;
+  }
+  CommandTarget target = strcmp(request.path(), "/api/vacuum") == 0 ? TARGET_VACUUM : TARGET_PUMP;
+  PumpCommand command;
+  if (parsePumpCommand(request.body(), request.bodyLength(), target, command) != CMD_OK) return;
+  rig.dispatcher.resolve(command, rig.dispatcher.status(), SOURCE_WEB);
+  rig.dispatcher.submit(command);
+}
+
+static void feedRequest(Rig& rig, HttpRequest& request, const char* method, const char* path, const char* body) {
+  char text[512];
+  int length;
+  if (body) {
+    length = snprintf(text, sizeof(text),
+                      "%s %s HTTP/1.1\r\nHost: pump.local\r\nContent-Type: application/json\r\n"
+                      "Content-Length: %u\r\n\r\n%s", method, path, (unsigned)strlen(body), body);
+  } else {
+    length = snprintf(text, sizeof(text), "%s %s HTTP/1.1\r\nHost: pump.local\r\nConnection: keep-alive\r\n\r\n",
+                      method, path);
+  }
+  // In the pieces a slow client sends it in
+  request.clear();
+  int sent = 0;
+  while (sent < length) {
+    int piece = 1 + nextRandom() % 64;
+    if (piece > length - sent) piece = length - sent;
+    request.feed(text + sent, piece);
+    sent += piece;
+  }
+  TEST_ASSERT_EQUAL(HttpRequest::STATE_COMPLETE, request.getState());
+  serveRequest(rig, request);
+}
+
+// One request of the storm, mostly status polls
+static void stormRequest(Rig& rig, HttpRequest& request) {
+  char body[96];
+  switch (nextRandom() % 8) {
+    case 0:
+      snprintf(body, sizeof(body), "{\"action\": \"start\", \"speed\": %lu, \"durationMs\": %lu}",
+               (unsigned long)(nextRandom() % 1024), (unsigned long)(1 + nextRandom() % 2000));
+      feedRequest(rig, request, "POST", "/api/vacuum", body);
+      break;
+    case 1:
+      feedRequest(rig, request, "POST", "/api/vacuum", "{\"action\": \"stop\"}");
+      break;
+    case 2:
+      feedRequest(rig, request, "POST", "/api/vacuum", "{\"action\": \"start\", \"speed\": }");  // Rejected
+      break;
+    default:
+      feedRequest(rig, request, "GET", "/api/status", NULL);
+      break;
+  }
+}
+
+// When a request keeps the web server busy: mostly quick, now and then a
+// slow client or a flash write holding it for tens of milliseconds
+static uint32_t requestCostUs() {
+  if (nextRandom() % 20 == 0) return 20000 + nextRandom() % 60000;
+  return 200 + nextRandom() % 3000;
+}
+
+// Timed pump runs started over HTTP while requests arrive back to back. The
+// control task's stop timer ends each run on time wherever the web server
+// is; the old loop() only got to pump.update() once the request in hand
+// was done, so its stop error is measured to the end of that request.
+static void test_timed_stops_under_request_storm() {
+  Rig rig;
+  static HttpRequest request;
+  const int RUNS = 300;
+  uint32_t worstUs = 0, worstLoopUs = 0;
+  uint64_t totalLoopUs = 0;
+  unsigned requests = 0;
+
+  for (int run = 0; run < RUNS; run++) {
+    uint32_t durationMs = 5 + nextRandom() % 3000;
+    char body[96];
+    snprintf(body, sizeof(body), "{\"action\": \"forward\", \"speed\": %lu, \"durationMs\": %lu}",
+             (unsigned long)(100 + nextRandom() % 924), (unsigned long)durationMs);
+    rig.hal.clearEvents();
+    uint64_t startUs = rig.hal.nowUs();
+    feedRequest(rig, request, "POST", "/api/control", body);
+    TEST_ASSERT_TRUE(rig.controller.status().pumpTimedRun);
+    uint64_t deadlineUs = startUs + (uint64_t)durationMs * 1000;
+
+    // The storm, until the old loop would have seen the deadline pass
+    uint64_t loopStopUs = 0;
+    while (loopStopUs == 0) {
+      rig.hal.advanceUs(requestCostUs());
+      if (rig.hal.nowUs() >= deadlineUs) loopStopUs = rig.hal.nowUs();
+      stormRequest(rig, request);
+      requests++;
+    }
+    logFlush();
+
+    uint64_t stopUs = 0;
+    for (size_t i = 0; i < rig.hal.events().size(); i++) {
+      const SimHal::Event& event = rig.hal.events()[i];
+      if (event.kind == SimHal::EVENT_PWM && event.index == PUMP_CHANNELS[0].ledcChannel && event.value == 0 &&
+          event.timeUs > startUs) {
+        stopUs = event.timeUs;
+        break;
+      }
+    }
+    char message[64];
+    snprintf(message, sizeof(message), "run %d: %lu ms", run, (unsigned long)durationMs);
+    TEST_ASSERT_NOT_EQUAL_MESSAGE(0, stopUs, message);
+    TEST_ASSERT_TRUE_MESSAGE(stopUs >= deadlineUs, message);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(STOP_ERROR_BOUND_US, stopUs - deadlineUs, message);
+    TEST_ASSERT_EQUAL(PUMP_STOPPED, rig.controller.status().pumpState);
+    if (stopUs - deadlineUs > worstUs) worstUs = stopUs - deadlineUs;
+    if (loopStopUs - deadlineUs > worstLoopUs) worstLoopUs = (uint32_t)(loopStopUs - deadlineUs);
+    totalLoopUs += loopStopUs - deadlineUs;
+  }
+
+  char report[160];
+  snprintf(report, sizeof(report),
+           "%d runs under %u requests: control task worst %lu us; old loop() average %lu us, worst %lu us",
+           RUNS, requests, (unsigned long)worstUs, (unsigned long)(totalLoopUs / RUNS), (unsigned long)worstLoopUs);
+  TEST_MESSAGE(report);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_seqlock_concurrent_readers);
+  RUN_TEST(test_status_snapshots_consistent);
+  RUN_TEST(test_timed_stops_under_request_storm);
+  return UNITY_END();
+}
@@ -0,0 +1,251 @@
+// Volumetric dosing against a simulated pump: a tube whose flow is not
+// linear in duty is calibrated the way /api/calibrate does it, then doses
+// planned from that table are run on SimHal and the volume the model
+// actually pumped is compared with the volume asked for.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "flow_calibration.h"
+#include "pump_command.h"
+
+// The simulated tube: nothing below the motor's breakaway duty, then flow
+// that rises a little less than linearly as the tube stops refilling in
+// time
+static double trueFlowRate(uint32_t duty) {
+  if (duty <= 80) return 0.0;
+  double x = duty - 80.0;
+  return 1.6 * x * (1.0 - 0.00015 * x);  // uL/min
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+
+  Rig()
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+  }
+
+  void run(uint32_t duty, uint32_t durationMs, uint32_t volumeUl, uint32_t flowRate) {
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.action = ACTION_FORWARD;
+    command.speed = duty;
+    command.duration = durationMs;
+    command.hasVolume = volumeUl > 0;
+    command.volume = volumeUl;
+    command.hasFlowRate = flowRate > 0;
+    command.flowRate = flowRate;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+    logFlush();
+  }
+
+  void stop() {
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.action = ACTION_STOP;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+    logFlush();
+  }
+
+  void runMs(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 20) {
+      hal.advanceMs(20);
+      controller.service();
+    }
+    logFlush();
+  }
+
+  // What the tube delivered since event index from, integrating the model
+  // over the pump's PWM trace
+  double pumpedUl(size_t from) {
+    const uint8_t ledc = PUMP_CHANNELS[0].ledcChannel;
+    double volume = 0.0;
+    uint32_t duty = 0;
+    uint64_t lastUs = 0;
+    bool started = false;
+    for (size_t i = from; i < hal.events().size(); i++) {
+      const SimHal::Event& event = hal.events()[i];
+      if (event.kind != SimHal::EVENT_PWM || event.index != ledc) continue;
+      if (started) volume += trueFlowRate(duty) * (event.timeUs - lastUs) / 60e6;
+      duty = event.value;
+      lastUs = event.timeUs;
+      started = true;
+    }
+    if (started) volume += trueFlowRate(duty) * (hal.nowUs() - lastUs) / 60e6;
+    return volume;
+  }
+};
+
+static const uint16_t CAL_DUTIES[] = { 150, 300, 450, 600, 800, 1023 };
+static const uint32_t CAL_RUN_MS = 30000;
+
+// The calibration routine: a fixed-time run at each duty, the output
+// weighed to the microlitre and recorded as a flow point
+static void calibrate(Rig& rig, FlowCalibration& calibration) {
+  for (size_t i = 0; i < sizeof(CAL_DUTIES) / sizeof(CAL_DUTIES[0]); i++) {
+    size_t from = rig.hal.events().size();
+    rig.run(CAL_DUTIES[i], CAL_RUN_MS, 0, 0);
+    rig.runMs(CAL_RUN_MS + 100);
+    uint32_t weighed = (uint32_t)lround(rig.pumpedUl(from));
+    TEST_ASSERT_TRUE(calibration.addPoint(CAL_DUTIES[i], flowRateFor(weighed, CAL_RUN_MS)));
+  }
+}
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+static void test_table_rules_and_storage() {
+  SimHal hal;
+  FlowCalibration calibration(hal);
+  TEST_ASSERT_FALSE(calibration.isCalibrated());
+  TEST_ASSERT_TRUE(calibration.addPoint(500, 700));
+  TEST_ASSERT_TRUE(calibration.addPoint(200, 150));
+  TEST_ASSERT_FALSE(calibration.addPoint(300, 100));  // Less flow at more duty
+  TEST_ASSERT_FALSE(calibration.addPoint(600, 700));
+  TEST_ASSERT_FALSE(calibration.addPoint(400, 0));
+  TEST_ASSERT_TRUE(calibration.addPoint(500, 650));   // Replaces the point at 500
+  TEST_ASSERT_EQUAL(2, calibration.count());
+  TEST_ASSERT_EQUAL_UINT32(400, calibration.flowAt(350));
+  TEST_ASSERT_EQUAL_UINT32(150, calibration.flowAt(100));
+  TEST_ASSERT_EQUAL_UINT32(650, calibration.flowAt(1000));
+
+  DosePlan plan;
+  TEST_ASSERT_FALSE(calibration.planDose(100, 149, plan));
+  TEST_ASSERT_FALSE(calibration.planDose(100, 651, plan));
+  TEST_ASSERT_FALSE(calibration.planDose(0, 400, plan));
+  TEST_ASSERT_TRUE(calibration.planDose(100, 400, plan));
+  TEST_ASSERT_EQUAL(350, plan.duty);
+  TEST_ASSERT_EQUAL_UINT32(15000, plan.durationMs);
+
+  TEST_ASSERT_TRUE(calibration.save());
+  FlowCalibration reloaded(hal);
+  TEST_ASSERT_TRUE(reloaded.load());
+  TEST_ASSERT_EQUAL(2, reloaded.count());
+  TEST_ASSERT_EQUAL(500, reloaded.point(1).duty);
+  TEST_ASSERT_EQUAL_UINT32(650, reloaded.point(1).flowRate);
+}
+
+// Random volumes and flow rates across the calibrated range, each dose
+// within 1.5 % (or 1 uL for the smallest) of what was asked for
+static void test_dose_accuracy() {
+  Rig rig;
+  FlowCalibration calibration(rig.hal);
+  calibrate(rig, calibration);
+  TEST_ASSERT_TRUE(calibration.isCalibrated());
+
+  uint32_t rng = 0xC0FFEE;
+  double worst = 0.0;
+  const int DOSES = 300;
+  for (int i = 0; i < DOSES; i++) {
+    rng = rng * 1103515245 + 12345;
+    uint32_t volume = 20 + (rng >> 8) % 5000;
+    rng = rng * 1103515245 + 12345;
+    uint32_t flowSpan = calibration.maxFlowRate() - calibration.minFlowRate();
+    uint32_t flowRate = calibration.minFlowRate() + (rng >> 8) % (flowSpan + 1);
+    DosePlan plan;
+    TEST_ASSERT_TRUE(calibration.planDose(volume, flowRate, plan));
+
+    size_t from = rig.hal.events().size();
+    rig.run(plan.duty, plan.durationMs, volume, plan.flowRate);
+    TEST_ASSERT_TRUE(rig.controller.status().doseActive);
+    rig.runMs(plan.durationMs + 100);
+
+    PumpStatus status = rig.controller.status();
+    TEST_ASSERT_FALSE(status.doseActive);
+    TEST_ASSERT_UINT32_WITHIN(1, volume, status.doseDeliveredUl);
+
+    double pumped = rig.pumpedUl(from);
+    double error = fabs(pumped - volume);
+    char message[120];
+    snprintf(message, sizeof(message), "%lu uL at %lu uL/min: duty %u for %lu ms pumped %.1f uL",
+             (unsigned long)volume, (unsigned long)flowRate, plan.duty, (unsigned long)plan.durationMs, pumped);
+    TEST_ASSERT_TRUE_MESSAGE(error <= 1.0 || error <= 0.015 * volume, message);
+    if (error / volume > worst) worst = error / volume;
+  }
+
+  char report[80];
+  snprintf(report, sizeof(report), "%d doses, worst volume error %.2f %%", DOSES, worst * 100);
+  TEST_MESSAGE(report);
+}
+
+// A dose stopped early reports what had gone through by then
+static void test_stopped_dose_reports_partial_volume() {
+  Rig rig;
+  FlowCalibration calibration(rig.hal);
+  calibrate(rig, calibration);
+
+  DosePlan plan;
+  TEST_ASSERT_TRUE(calibration.planDose(2000, 600, plan));
+  size_t from = rig.hal.events().size();
+  rig.run(plan.duty, plan.durationMs, 2000, plan.flowRate);
+  rig.runMs(plan.durationMs / 2);
+  uint32_t midway = doseDeliveredUl(rig.controller.status(), rig.hal.nowUs());
+  rig.stop();
+
+  PumpStatus status = rig.controller.status();
+  TEST_ASSERT_FALSE(status.doseActive);
+  TEST_ASSERT_UINT32_WITHIN(10, 1000, status.doseDeliveredUl);
+  TEST_ASSERT_UINT32_WITHIN(1, midway, status.doseDeliveredUl);
+  TEST_ASSERT_UINT32_WITHIN(20, (uint32_t)lround(rig.pumpedUl(from)), status.doseDeliveredUl);
+}
+
+// A calibration run has to say how long it runs: without a duration the
+// body is refused at parse time, which /api/calibrate answers with 400,
+// rather than resolved to the pump's default run length
+static void test_calibration_run_needs_duration() {
+  const char* missing[] = {
+    "{\"action\": \"run\"}",
+    "{\"action\": \"run\", \"speed\": 600}",
+    "{\"speed\": 600, \"volume\": 500, \"action\": \"run\"}",
+  };
+  PumpCommand command;
+  for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(CMD_ERR_MISSING_FIELD,
+                              parsePumpCommand(missing[i], strlen(missing[i]), TARGET_CALIBRATION, command), missing[i]);
+  }
+
+  const char* timed[] = {
+    "{\"action\": \"run\", \"speed\": 600, \"duration\": 30}",
+    "{\"action\": \"run\", \"durationMs\": 30000}",
+  };
+  for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(CMD_OK, parsePumpCommand(timed[i], strlen(timed[i]), TARGET_CALIBRATION, command),
+                              timed[i]);
+    TEST_ASSERT_EQUAL(ACTION_CAL_RUN, command.action);
+    TEST_ASSERT_TRUE(command.hasDuration);
+    TEST_ASSERT_EQUAL_UINT32(30000, command.duration);
+  }
+
+  // The other calibration operations take no duration
+  const char* record = "{\"action\": \"record\", \"volume\": 500}";
+  TEST_ASSERT_EQUAL(CMD_OK, parsePumpCommand(record, strlen(record), TARGET_CALIBRATION, command));
+  const char* clear = "{\"action\": \"clear\"}";
+  TEST_ASSERT_EQUAL(CMD_OK, parsePumpCommand(clear, strlen(clear), TARGET_CALIBRATION, command));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_rules_and_storage);
+  RUN_TEST(test_dose_accuracy);
+  RUN_TEST(test_stopped_dose_reports_partial_volume);
+  RUN_TEST(test_calibration_run_needs_duration);
+  return UNITY_END();
+}
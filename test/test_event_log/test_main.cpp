@@ -0,0 +1,229 @@
+// The flash event log on SimHal's log region: power lost part way through
+// a write or an erase, and a small region wrapped many times over. After
+// each "reboot" (a new EventLog on the same flash) every whole record must
+// read back, in order, and numbering must carry on where it left off.
+#include <unity.h>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump.h"
+#include "event_log.h"
+
+static const size_t SLOTS = EventLog::RECORDS_PER_SECTOR;
+
+// Records are told apart by a tag in durationMs; boot records have none
+static void recordTagged(EventLog& log, uint32_t tag) {
+  log.record(EVENT_PUMP, SOURCE_WEB, PUMP_FORWARD, (uint16_t)(tag & 0x3FF), tag);
+}
+
+// Tags first to last, written out a page at a time as the flushing task
+// would; the queue is far shorter than a sector
+static void recordRange(EventLog& log, uint32_t first, uint32_t last) {
+  for (uint32_t tag = first; tag <= last; tag++) {
+    recordTagged(log, tag);
+    if ((tag - first + 1) % EventLog::FLUSH_RECORDS == 0) log.flush();
+  }
+  log.flush();
+  logFlush();
+}
+
+static std::vector<EventRecord> readAll(EventLog& log) {
+  std::vector<EventRecord> all;
+  EventRecord records[16];
+  uint32_t fromSeq = 0, resumeSeq;
+  size_t n;
+  while ((n = log.read(fromSeq, records, 16, resumeSeq)) > 0) {
+    all.insert(all.end(), records, records + n);
+    fromSeq = resumeSeq;
+  }
+  logFlush();
+  return all;
+}
+
+// Sequence numbers one apart from first, oldest first
+static void assertContiguous(const std::vector<EventRecord>& records, uint32_t first) {
+  for (size_t i = 0; i < records.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(first + i, records[i].seq);
+  }
+}
+
+// The record in a slot as it is on flash; false if it doesn't decode
+static bool slotRecord(SimHal& hal, size_t sector, size_t slot, EventRecord& record) {
+  uint8_t data[EventLog::RECORD_SIZE];
+  TEST_ASSERT_TRUE(hal.logFlashRead(sector * LOG_FLASH_SECTOR_SIZE + slot * EventLog::RECORD_SIZE, data,
+                                    sizeof(data)));
+  return decodeEventRecord(data, record);
+}
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+// Power lost two and a half records into a page write: the whole records
+// are kept, the torn one is skipped and the next boot numbers on from the
+// last whole record, in the slot after the torn one
+static void test_torn_write() {
+  SimHal hal;
+  EventLog log(hal);
+  TEST_ASSERT_TRUE(log.begin());
+  for (uint32_t tag = 1; tag <= 3; tag++) recordTagged(log, tag);
+  log.flush();
+  TEST_ASSERT_EQUAL_UINT32(5, log.endSeq());
+
+  for (uint32_t tag = 4; tag <= 6; tag++) recordTagged(log, tag);
+  hal.tearNextLogWrite(2 * EventLog::RECORD_SIZE + 8);
+  log.flush();
+
+  EventLog rebooted(hal);
+  TEST_ASSERT_TRUE(rebooted.begin());
+  TEST_ASSERT_EQUAL_UINT32(7, rebooted.endSeq());  // After tag 5, the last whole record
+  rebooted.flush();
+  TEST_ASSERT_EQUAL_UINT32(8, rebooted.endSeq());
+
+  std::vector<EventRecord> records = readAll(rebooted);
+  TEST_ASSERT_EQUAL(7, records.size());
+  assertContiguous(records, 1);
+  TEST_ASSERT_EQUAL(EVENT_BOOT, records[0].kind);
+  for (uint32_t tag = 1; tag <= 5; tag++) {
+    TEST_ASSERT_EQUAL(EVENT_PUMP, records[tag].kind);
+    TEST_ASSERT_EQUAL_UINT32(tag, records[tag].durationMs);
+  }
+  TEST_ASSERT_EQUAL(EVENT_BOOT, records[6].kind);
+
+  // Slot 6 still holds the torn record, unreadable; the boot went after it
+  EventRecord record;
+  TEST_ASSERT_FALSE(slotRecord(hal, 0, 6, record));
+  TEST_ASSERT_TRUE(slotRecord(hal, 0, 7, record));
+  TEST_ASSERT_EQUAL(EVENT_BOOT, record.kind);
+  TEST_ASSERT_EQUAL_UINT32(7, record.seq);
+}
+
+// The first write into a freshly erased sector torn after half a record:
+// that sector holds nothing readable, so the log carries on from the full
+// one before it and erases the torn sector again before using it
+static void test_torn_first_slot_in_fresh_sector() {
+  SimHal hal;
+  hal.setLogFlashSize(4 * LOG_FLASH_SECTOR_SIZE);
+  EventLog log(hal);
+  TEST_ASSERT_TRUE(log.begin());
+  recordRange(log, 1, SLOTS - 1);
+  TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, log.endSeq());  // Sector 0 full
+
+  recordTagged(log, SLOTS);
+  hal.tearNextLogWrite(EventLog::RECORD_SIZE / 2);
+  log.flush();
+  EventRecord record;
+  TEST_ASSERT_FALSE(slotRecord(hal, 1, 0, record));
+
+  EventLog rebooted(hal);
+  TEST_ASSERT_TRUE(rebooted.begin());
+  TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, rebooted.endSeq());
+  rebooted.flush();
+  TEST_ASSERT_TRUE(slotRecord(hal, 1, 0, record));
+  TEST_ASSERT_EQUAL(EVENT_BOOT, record.kind);
+  TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, record.seq);
+
+  recordRange(rebooted, 1000, 1019);
+  EventLog again(hal);
+  TEST_ASSERT_TRUE(again.begin());
+  again.flush();
+  std::vector<EventRecord> records = readAll(again);
+  TEST_ASSERT_EQUAL(SLOTS + 1 + 20 + 1, records.size());
+  assertContiguous(records, 1);
+  for (size_t i = 1; i < SLOTS; i++) TEST_ASSERT_EQUAL_UINT32(i, records[i].durationMs);
+  TEST_ASSERT_EQUAL(EVENT_BOOT, records[SLOTS].kind);
+  for (size_t i = 0; i < 20; i++) TEST_ASSERT_EQUAL_UINT32(1000 + i, records[SLOTS + 1 + i].durationMs);
+  TEST_ASSERT_EQUAL(EVENT_BOOT, records.back().kind);
+}
+
+// The ring full and power lost while the oldest sector was being erased
+// for reuse, leaving it half old records and half erased bits. Whatever
+// the erase got through, nothing from that sector is read back, every
+// other record is, and the next boot erases it properly and writes there.
+static void test_interrupted_erase() {
+  const size_t SECTORS = 4;
+  for (uint32_t seed = 1; seed <= 64; seed++) {
+    SimHal hal;
+    hal.setLogFlashSize(SECTORS * LOG_FLASH_SECTOR_SIZE);
+    EventLog log(hal);
+    TEST_ASSERT_TRUE(log.begin());
+    recordRange(log, 1, SECTORS * SLOTS - 1);
+    TEST_ASSERT_EQUAL_UINT32(SECTORS * SLOTS + 1, log.endSeq());
+
+    recordTagged(log, SECTORS * SLOTS);
+    hal.interruptNextLogErase(seed * 0x9E3779B9u);
+    log.flush();  // Needs sector 0, whose erase fails part done
+    logFlush();
+
+    EventLog rebooted(hal);
+    TEST_ASSERT_TRUE(rebooted.begin());
+    TEST_ASSERT_EQUAL_UINT32(SECTORS * SLOTS + 1, rebooted.endSeq());
+    rebooted.flush();
+
+    std::vector<EventRecord> records = readAll(rebooted);
+    TEST_ASSERT_EQUAL((SECTORS - 1) * SLOTS + 1, records.size());
+    assertContiguous(records, SLOTS + 1);
+    for (size_t i = 0; i + 1 < records.size(); i++) {
+      TEST_ASSERT_EQUAL(EVENT_PUMP, records[i].kind);
+      TEST_ASSERT_EQUAL_UINT32(records[i].seq - 1, records[i].durationMs);
+    }
+    TEST_ASSERT_EQUAL(EVENT_BOOT, records.back().kind);
+    TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, rebooted.firstSeq());
+
+    // The boot record went into a properly erased sector 0
+    EventRecord record;
+    TEST_ASSERT_TRUE(slotRecord(hal, 0, 0, record));
+    TEST_ASSERT_EQUAL_UINT32(SECTORS * SLOTS + 1, record.seq);
+    for (size_t slot = 1; slot < SLOTS; slot++) TEST_ASSERT_FALSE(slotRecord(hal, 0, slot, record));
+  }
+}
+
+// Three sectors written through many laps, stopping mid-sector and on a
+// sector boundary: the log holds exactly the newest three sectors' worth,
+// before and after a reboot
+static void test_ring_wrap_keeps_newest_sectors() {
+  const size_t SECTORS = 3;
+  const uint32_t totals[] = { 1000, 3 * SLOTS - 1, 8 * SLOTS - 1, 5000 };
+  for (size_t t = 0; t < sizeof(totals) / sizeof(totals[0]); t++) {
+    SimHal hal;
+    hal.setLogFlashSize(SECTORS * LOG_FLASH_SECTOR_SIZE);
+    EventLog log(hal);
+    TEST_ASSERT_TRUE(log.begin());
+    for (uint32_t tag = 1; tag <= totals[t]; tag++) {
+      recordTagged(log, tag);
+      log.service();
+      hal.advanceMs(10);
+    }
+    log.flush();
+    logFlush();
+
+    for (int boot = 0; boot < 2; boot++) {
+      EventLog reader(hal);
+      TEST_ASSERT_TRUE(reader.begin());
+      if (boot == 1) reader.flush();
+      uint32_t written = totals[t] + 1 + boot;  // Each boot adds a record
+      uint32_t lastSector = (written - 1) / SLOTS;
+      uint32_t first = lastSector < SECTORS ? 1 : (lastSector - (SECTORS - 1)) * SLOTS + 1;
+
+      std::vector<EventRecord> records = readAll(reader);
+      TEST_ASSERT_EQUAL(written - first + 1, records.size());
+      assertContiguous(records, first);
+      TEST_ASSERT_EQUAL_UINT32(first, reader.firstSeq());
+      TEST_ASSERT_EQUAL_UINT32(written + 1, reader.endSeq());
+      for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].kind == EVENT_PUMP) TEST_ASSERT_EQUAL_UINT32(records[i].seq - 1, records[i].durationMs);
+      }
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_torn_write);
+  RUN_TEST(test_torn_first_slot_in_fresh_sector);
+  RUN_TEST(test_interrupted_erase);
+  RUN_TEST(test_ring_wrap_keeps_newest_sectors);
+  return UNITY_END();
+}
@@ -0,0 +1,29 @@
+// Host stand-in for the parts of the Arduino core the HTTP server uses:
+// a millis() clock the test sets, and FreeRTOS mutexes that do nothing
+// since the test runs the server's callbacks on one thread.
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+inline unsigned long& fakeMillis() {
+  static unsigned long nowMs = 0;
+  return nowMs;
+}
+
+inline unsigned long millis() { return fakeMillis(); }
+
+typedef void* SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+#define pdTRUE 1
+#define portMAX_DELAY 0xFFFFFFFFu
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return NULL; }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t) { return pdTRUE; }
+
+#endif // FAKE_ARDUINO_H
@@ -0,0 +1,101 @@
+// Host stand-in for AsyncTCP. The test plays the network: it connects a
+// FakeClient to the listening server, delivers request bytes, acks what
+// was sent to reopen the window and disconnects, and each call runs the
+// server's callback straight away on the test's thread.
+#ifndef FAKE_ASYNC_TCP_H
+#define FAKE_ASYNC_TCP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include "Arduino.h"
+
+class AsyncClient;
+typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+typedef std::function<void(void*, AsyncClient*, size_t, uint32_t)> AcAckHandler;
+typedef std::function<void(void*, AsyncClient*, void*, size_t)> AcDataHandler;
+typedef std::function<void(void*, AsyncClient*, uint32_t)> AcTimeoutHandler;
+
+#define ASYNC_WRITE_FLAG_COPY 0x01
+
+class AsyncClient {
+private:
+  AcDataHandler dataHandler;
+  void* dataArg;
+  AcAckHandler ackHandler;
+  void* ackArg;
+  AcConnectHandler disconnectHandler;
+  void* disconnectArg;
+  std::string queued;  // add()ed, not yet send()
+
+public:
+  size_t window;       // What space() reports, less what is queued
+  std::string output;  // Everything send() has put on the wire
+  unsigned sendCalls;
+  bool closed;
+
+  explicit AsyncClient(size_t windowBytes = 5744)
+    : dataArg(NULL), ackArg(NULL), disconnectArg(NULL), window(windowBytes), sendCalls(0), closed(false) {}
+  virtual ~AsyncClient() {}
+
+  // Server side, as in AsyncTCP
+  void onData(AcDataHandler handler, void* arg = NULL) { dataHandler = handler; dataArg = arg; }
+  void onAck(AcAckHandler handler, void* arg = NULL) { ackHandler = handler; ackArg = arg; }
+  void onDisconnect(AcConnectHandler handler, void* arg = NULL) { disconnectHandler = handler; disconnectArg = arg; }
+  void onTimeout(AcTimeoutHandler, void* = NULL) {}
+  void setNoDelay(bool) {}
+  size_t space() { return closed ? 0 : window - queued.size(); }
+  size_t add(const char* data, size_t len, uint8_t = ASYNC_WRITE_FLAG_COPY) {
+    if (len > space()) len = space();
+    queued.append(data, len);
+    return len;
+  }
+  bool send() {
+    window -= queued.size();
+    output += queued;
+    queued.clear();
+    sendCalls++;
+    return true;
+  }
+  void close(bool = false) { closed = true; }
+  bool connected() { return !closed; }
+
+  // Network side, driven by the test
+  void receive(const char* data, size_t len) {
+    if (dataHandler) dataHandler(dataArg, this, (void*)data, len);
+  }
+  void receive(const std::string& data) { receive(data.data(), data.size()); }
+  // The peer acks bytes bytes, which reopens that much window
+  void ack(size_t bytes) {
+    window += bytes;
+    if (ackHandler) ackHandler(ackArg, this, bytes, 0);
+  }
+  // Connection gone; the server's handler deletes the client
+  void disconnect() {
+    if (disconnectHandler) disconnectHandler(disconnectArg, this);
+  }
+};
+
+class AsyncServer {
+private:
+  AcConnectHandler clientHandler;
+  void* clientArg;
+
+public:
+  explicit AsyncServer(uint16_t) : clientArg(NULL) { listening() = this; }
+  ~AsyncServer() { if (listening() == this) listening() = NULL; }
+
+  void onClient(AcConnectHandler handler, void* arg) { clientHandler = handler; clientArg = arg; }
+  void setNoDelay(bool) {}
+  void begin() {}
+
+  // The most recently constructed server, which the test connects to
+  static AsyncServer*& listening() {
+    static AsyncServer* server = NULL;
+    return server;
+  }
+  void connect(AsyncClient* client) { clientHandler(clientArg, client); }
+};
+
+#endif // FAKE_ASYNC_TCP_H
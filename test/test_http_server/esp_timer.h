@@ -0,0 +1,14 @@
+// Host stand-in for esp_timer_get_time(): the monotonic clock in us
+#ifndef FAKE_ESP_TIMER_H
+#define FAKE_ESP_TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+inline int64_t esp_timer_get_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif // FAKE_ESP_TIMER_H
@@ -0,0 +1,5 @@
+// The HTTP server and event stream are left out of the native build filter
+// since they need the Arduino core; this suite builds them against the
+// host stand-ins in this directory.
+#include "../../src/http_server.cpp"
+#include "../../src/event_stream.cpp"
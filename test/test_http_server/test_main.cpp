@@ -0,0 +1,459 @@
+// HttpServer and StatusEventStream over the fake AsyncTCP in this
+// directory: dashboards holding event streams open never take the last
+// connection slots, so a control request is still answered; and what
+// serving GET / from the flash asset costs per request - time, heap
+// allocations, send() calls and bytes on the wire - against the
+// String-built page the web server generated before.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include "logger.h"
+#include "http_server.h"
+#include "event_stream.h"
+#include "status_delta.h"
+#include "pump_controller.h"
+#include "web_page.h"
+
+// Every operator new in the process, with the bytes asked for, so a test
+// can tell whether the code under it touched the heap
+static unsigned long allocations = 0;
+static unsigned long allocatedBytes = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  allocatedBytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const char CONTROL_BODY[] = "{\"action\": \"stop\"}";
+
+// The routes WebServerManager answers these with, minus the pumps
+struct Rig {
+  HttpServer server;
+  StatusEventStream events;
+  unsigned controlRequests;
+
+  Rig() : server(80), events(server), controlRequests(0) {
+    server.on("/api/events", HTTP_METHOD_GET, [this](HttpExchange& ex) {
+      if (!events.add(ex, StatusEventStream::DEFAULT_INTERVAL_MS)) {
+        static const char BODY[] = "{\"success\": false, \"message\": \"Too many observers\"}";
+        ex.send(503, "application/json", BODY, sizeof(BODY) - 1);
+      }
+    });
+    server.on("/", HTTP_METHOD_GET, [](HttpExchange& ex) {
+      ex.sendStatic(200, "text/html", INDEX_HTML_GZ, INDEX_HTML_GZ_LEN,
+                    "Content-Encoding: gzip\r\nCache-Control: no-cache\r\n");
+    });
+    server.on("/api/control", HTTP_METHOD_POST, [this](HttpExchange& ex) {
+      controlRequests++;
+      static const char BODY[] = "{\"success\": true, \"message\": \"Pump stopped\"}";
+      ex.send(200, "application/json", BODY, sizeof(BODY) - 1);
+    });
+    server.begin();
+  }
+
+  // A new connection, or NULL if the server refused it
+  AsyncClient* connect(size_t windowBytes = 5744) {
+    AsyncClient* client = new AsyncClient(windowBytes);
+    AsyncServer::listening()->connect(client);
+    logFlush();
+    if (client->closed) {
+      client->disconnect();  // Deletes it
+      return NULL;
+    }
+    return client;
+  }
+
+  static void getEvents(AsyncClient* client) {
+    client->receive(std::string("GET /api/events HTTP/1.1\r\nHost: pump\r\n\r\n"));
+    logFlush();
+  }
+
+  static void postControl(AsyncClient* client) {
+    char request[160];
+    snprintf(request, sizeof(request),
+             "POST /api/control HTTP/1.1\r\nHost: pump\r\nContent-Type: application/json\r\n"
+             "Content-Length: %u\r\n\r\n%s", (unsigned)strlen(CONTROL_BODY), CONTROL_BODY);
+    client->receive(std::string(request));
+    logFlush();
+  }
+};
+
+static bool startsWith(const std::string& text, const char* prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string str(unsigned long value) {
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return text;
+}
+
+// Where the old handler's Serial.println() output went
+static size_t serialBytes = 0;
+
+static void serialPrintln(const std::string& line) {
+  serialBytes += line.size() + 2;
+}
+
+// generateHTML() from before the flash asset, with std::string for Arduino's String and the
+// pump getters read from a status snapshot. std::string keeps short values
+// inline, so its allocation count is a lower bound of what String did.
+static std::string baselineGenerateHtml(const PumpStatus& status, uint64_t nowUs) {
+  std::string html = "<!DOCTYPE html><html><head><meta charset='UTF-8'>";
+  html += "<title>Peristaltic Pump Controller</title>";
+  html += "<style>";
+  html += "body { font-family: Arial, sans-serif; margin: 40px; background-color: #f0f0f0; }";
+  html += ".container { background-color: white; padding: 30px; border-radius: 10px; box-shadow: 0 2px 10px rgba(0,0,0,0.1); }";
+  html += "h1 { color: #333; text-align: center; }";
+  html += ".control-group { margin: 20px 0; text-align: center; }";
+  html += "button { padding: 15px 30px; margin: 10px; font-size: 16px; border: none; border-radius: 5px; cursor: pointer; }";
+  html += ".forward { background-color: #4CAF50; color: white; }";
+  html += ".reverse { background-color: #f44336; color: white; }";
+  html += ".stop { background-color: #ff9800; color: white; }";
+  html += "button:hover { opacity: 0.8; }";
+  html += ".status { margin: 20px 0; padding: 15px; background-color: #e7f3ff; border-radius: 5px; }";
+  html += "input[type='range'] { width: 200px; margin: 10px; }";
+  html += "</style></head><body>";
+  html += "<div class='container'>";
+  html += "<h1>Peristaltic Pump Controller</h1>";
+ 
+  // Display Current Status - Peristaltic Pump
+  html += "<div class='status' id='pump-status'>";
+  html += "<h3>Peristaltic Pump Status:</h3>";
+  switch (status.pumpState) {
+    case PUMP_STOPPED:
+      html += "<p>Status: Stopped</p>";
+      break;
+    case PUMP_FORWARD:
+      html += "<p>Status: Forward (Sample Intake)</p>";
+      break;
+    case PUMP_REVERSE:
+      html += "<p>Status: Reverse (Liquid Extraction)</p>";
+      break;
+  }
+  html += "<p>Speed: " + str(status.pumpSpeed) + "/255 (" + str((status.pumpSpeed * 100) / 255) + "%)</p>";
+  if (status.pumpTimedRun && status.pumpState != PUMP_STOPPED) {
+    uint32_t remainingTime = (remainingMs(true, status.pumpStopDeadlineUs, nowUs) + 999) / 1000;
+    html += "<p>Remaining time: " + str(remainingTime) + " seconds</p>";
+  }
+  html += "</div>";
+ 
+  // Display Current Status - Vacuum Pump
+  html += "<div class='status' id='vacuum-status'>";
+  html += "<h3>Vacuum Pump Status:</h3>";
+  switch (status.vacuumState) {
+    case VACUUM_STOPPED:
+      html += "<p>Status: Stopped</p>";
+      break;
+    case VACUUM_RUNNING:
+    default:
+      html += "<p>Status: Running (Vacuum Generation)</p>";
+      break;
+  }
+  html += "<p>Speed: " + str(status.vacuumSpeed) + "/255 (" + str((status.vacuumSpeed * 100) / 255) + "%)</p>";
+  if (status.vacuumTimedRun && status.vacuumState != VACUUM_STOPPED) {
+    uint32_t remainingTime = (remainingMs(true, status.vacuumStopDeadlineUs, nowUs) + 999) / 1000;
+    html += "<p>Remaining time: " + str(remainingTime) + " seconds</p>";
+  }
+  html += "</div>";
+ 
+  // Control Buttons - Peristaltic Pump
+  html += "<div class='control-group'>";
+  html += "<h3>Peristaltic Pump Control:</h3>";
+  html += "<button class='forward' onclick=\"controlPump('forward')\">Forward (Sample Intake)</button>";
+  html += "<button class='reverse' onclick=\"controlPump('reverse')\">Reverse (Liquid Extraction)</button>";
+  html += "<button class='stop' onclick=\"controlPump('stop')\">Stop</button>";
+  html += "</div>";
+ 
+  // Control Buttons - Vacuum Pump
+  html += "<div class='control-group'>";
+  html += "<h3>Vacuum Pump Control:</h3>";
+  html += "<button class='forward' onclick=\"controlVacuumPump('start')\">Start Vacuum</button>";
+  html += "<button class='stop' onclick=\"controlVacuumPump('stop')\">Stop Vacuum</button>";
+  html += "<button class='stop' onclick=\"controlVacuumPump('emergency')\" style='background-color: #ff0000;'>Emergency Stop</button>";
+  html += "</div>";
+ 
+  // Speed Control
+  html += "<div class='control-group'>";
+  html += "<h3>Speed Control:</h3>";
+  html += "<input type='range' id='speedSlider' min='100' max='1023' value='" + str(status.pumpSpeed) + "' onchange=\"updateSpeed(this.value)\">";
+  html += "<span id='speedValue'>" + str(status.pumpSpeed) + "</span>";
+  html += "</div>";
+ 
+  // Duration Control
+  html += "<div class='control-group'>";
+  html += "<h3>Run Duration (seconds):</h3>";
+  html += "<input type='number' id='durationInput' min='1' max='300' value='" + str(status.pumpRunDurationMs / 1000) + "' style='width: 100px; padding: 5px; margin: 10px;'>";
+  html += "<span> seconds</span>";
+  html += "</div>";
+ 
+  html += "</div>";
+ 
+  // JavaScript
+  html += "<script>";
+  html += "function controlPump(action) {";
+  html += "  console.log('controlPump called with action:', action);";
+  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
+  html += "  var duration = parseInt(document.getElementById('durationInput').value);";
+  html += "  console.log('Sending:', {action: action, speed: speed, duration: duration});";
+  html += "  fetch('/api/control', {";
+  html += "    method: 'POST',";
+  html += "    headers: { 'Content-Type': 'application/json' },";
+  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
+  html += "  }).then(response => response.json())";
+  html += "    .then(data => {";
+  html += "      console.log('Response:', data);";
+  html += "      alert('Pump control: ' + (data.success ? 'Success' : 'Failed'));";
+  html += "    });";
+  html += "}";
+  html += "function controlVacuumPump(action) {";
+  html += "  console.log('controlVacuumPump called with action:', action);";
+  html += "  var speed = parseInt(document.getElementById('speedSlider').value);";
+  html += "  var duration = parseInt(document.getElementById('durationInput').value);";
+  html += "  console.log('Sending vacuum pump:', {action: action, speed: speed, duration: duration});";
+  html += "  fetch('/api/vacuum', {";
+  html += "    method: 'POST',";
+  html += "    headers: { 'Content-Type': 'application/json' },";
+  html += "    body: JSON.stringify({ action: action, speed: speed, duration: duration })";
+  html += "  }).then(response => response.json())";
+  html += "    .then(data => {";
+  html += "      console.log('Response:', data);";
+  html += "      alert('Vacuum control: ' + (data.success ? 'Success' : 'Failed'));";
+  html += "    });";
+  html += "}";
+  html += "function updateSpeed(value) {";
+  html += "  document.getElementById('speedValue').textContent = value;";
+  html += "  console.log('Speed updated to:', value);";
+  html += "}";
+  html += "function updateStatus() {";
+  html += "  fetch('/api/status')";
+  html += "    .then(response => response.json())";
+  html += "    .then(data => {";
+  html += "      console.log('Status response:', data);";
+  html += "    });";
+  html += "}";
+  html += "</script>";
+ 
+  html += "</body></html>";
+ 
+  return html;
+}
+
+// handleRoot() from before the flash asset: generate, log the length and a
+// preview, send with the head WebServer wrote
+static size_t baselineHandleRoot(const PumpStatus& status, uint64_t nowUs) {
+  serialPrintln("[Web] Handling root request");
+  std::string html = baselineGenerateHtml(status, nowUs);
+  serialPrintln("[Web] Generated HTML length: " + str(html.length()));
+  std::string debugHtml = html.substr(0, std::min<size_t>(500, html.length()));
+  serialPrintln("[Web] HTML preview: " + debugHtml);
+  std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " + str(html.length()) +
+                         "\r\nConnection: close\r\n\r\n" + html;
+  return response.size();
+}
+
+static void runningStatus(PumpStatus& status, uint64_t& nowUs) {
+  memset(&status, 0, sizeof(status));
+  nowUs = 120000000;
+  status.pumpState = PUMP_FORWARD;
+  status.pumpSpeed = 512;
+  status.pumpTimedRun = true;
+  status.pumpRunDurationMs = 30000;
+  status.pumpStopDeadlineUs = nowUs + 12500000;
+  status.vacuumState = VACUUM_RUNNING;
+  status.vacuumSpeed = 80;
+}
+
+// One GET / on a kept-alive connection, the peer acking everything sent
+// until the response is complete; returns its bytes, and the send() calls
+// and acks it took
+static size_t getPage(AsyncClient* client, size_t responseBytes, unsigned& sends, unsigned& acks) {
+  static const char REQUEST[] = "GET / HTTP/1.1\r\nHost: pump\r\nAccept-Encoding: gzip\r\n\r\n";
+  client->output.clear();
+  unsigned sendsBefore = client->sendCalls;
+  client->receive(REQUEST, sizeof(REQUEST) - 1);
+  size_t acked = 0;
+  acks = 0;
+  while (client->output.size() > acked) {
+    size_t sent = client->output.size() - acked;
+    acked += sent;
+    acks++;
+    client->ack(sent);
+    if (acked >= responseBytes) break;
+  }
+  sends = client->sendCalls - sendsBefore;
+  return client->output.size();
+}
+
+void setUp() {
+  fakeMillis() = 1000;
+}
+
+void tearDown() {
+  logFlush();
+}
+
+// Every observer slot taken by an open dashboard, and one dashboard too
+// many turned away: a control request still gets a connection and an
+// answer, and the observers keep getting events
+static void test_control_answered_with_all_observers_connected() {
+  Rig rig;
+  std::vector<AsyncClient*> observers;
+  for (uint8_t i = 0; i < StatusEventStream::MAX_OBSERVERS; i++) {
+    AsyncClient* client = rig.connect();
+    TEST_ASSERT_NOT_NULL(client);
+    Rig::getEvents(client);
+    TEST_ASSERT_TRUE(startsWith(client->output, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream"));
+    observers.push_back(client);
+  }
+  TEST_ASSERT_EQUAL(StatusEventStream::MAX_OBSERVERS, rig.events.count());
+
+  AsyncClient* extra = rig.connect();
+  TEST_ASSERT_NOT_NULL(extra);
+  Rig::getEvents(extra);
+  TEST_ASSERT_TRUE(startsWith(extra->output, "HTTP/1.1 503 Service Unavailable"));
+  TEST_ASSERT_EQUAL(StatusEventStream::MAX_OBSERVERS, rig.events.count());
+
+  AsyncClient* control = rig.connect();
+  TEST_ASSERT_NOT_NULL(control);
+  Rig::postControl(control);
+  TEST_ASSERT_EQUAL(1, rig.controlRequests);
+  TEST_ASSERT_TRUE(startsWith(control->output, "HTTP/1.1 200 OK"));
+  TEST_ASSERT_TRUE(control->output.find("Pump stopped") != std::string::npos);
+
+  StatusView view = {};
+  rig.events.poll(view, fakeMillis());
+  for (size_t i = 0; i < observers.size(); i++) {
+    TEST_ASSERT_TRUE(observers[i]->output.find("data: {") != std::string::npos);
+  }
+
+  // Once the control connection is gone the next one is served as well
+  control->disconnect();
+  extra->disconnect();
+  control = rig.connect();
+  TEST_ASSERT_NOT_NULL(control);
+  Rig::postControl(control);
+  TEST_ASSERT_EQUAL(2, rig.controlRequests);
+
+  control->disconnect();
+  for (size_t i = 0; i < observers.size(); i++) observers[i]->disconnect();
+}
+
+// More dashboards than observer slots, each retrying: however many are
+// turned away, the observers never grow past the cap
+static void test_observer_cap_enforced() {
+  Rig rig;
+  std::vector<AsyncClient*> clients;
+  unsigned accepted = 0, refused = 0;
+  for (int round = 0; round < 3; round++) {
+    for (uint8_t i = 0; i < StatusEventStream::MAX_OBSERVERS + 1; i++) {
+      AsyncClient* client = rig.connect();
+      if (client == NULL) continue;
+      Rig::getEvents(client);
+      if (startsWith(client->output, "HTTP/1.1 200")) {
+        accepted++;
+        clients.push_back(client);
+      } else {
+        refused++;
+        client->disconnect();  // The browser gives up on a 503
+      }
+      TEST_ASSERT_TRUE(rig.events.count() <= StatusEventStream::MAX_OBSERVERS);
+    }
+  }
+  TEST_ASSERT_EQUAL(StatusEventStream::MAX_OBSERVERS, accepted);
+  TEST_ASSERT_EQUAL(3 * (StatusEventStream::MAX_OBSERVERS + 1) - StatusEventStream::MAX_OBSERVERS, refused);
+  for (size_t i = 0; i < clients.size(); i++) clients[i]->disconnect();
+}
+
+// GET / answered by the real server from flash, against the generated
+// page. The fake client's window is 5744 bytes, four full segments as
+// lwIP's default TCP_WND. Allocations and time are per request on a
+// kept-alive connection, once its buffers have grown.
+static void test_page_against_generated_one() {
+  const int RUNS = 20000;
+  PumpStatus status;
+  uint64_t nowUs;
+  runningStatus(status, nowUs);
+
+  unsigned long before = allocations, beforeBytes = allocatedBytes;
+  size_t generatedWire = 0;
+  serialBytes = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    generatedWire = baselineHandleRoot(status, nowUs);
+    nowUs += 1000;
+  }
+  double generatedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long generatedAllocs = allocations - before, generatedBytes = allocatedBytes - beforeBytes;
+
+  Rig rig;
+  AsyncClient* client = rig.connect();
+  TEST_ASSERT_NOT_NULL(client);
+  unsigned sends, acks;
+  getPage(client, SIZE_MAX, sends, acks);
+  logFlush();
+  std::string response = client->output;
+  size_t headLength = response.find("\r\n\r\n") + 4;
+  TEST_ASSERT_TRUE(startsWith(response, "HTTP/1.1 200 OK\r\n"));
+  char lengthHeader[40];
+  snprintf(lengthHeader, sizeof(lengthHeader), "Content-Length: %u\r\n", (unsigned)INDEX_HTML_GZ_LEN);
+  TEST_ASSERT_TRUE(response.find(lengthHeader) < headLength);
+  TEST_ASSERT_TRUE(response.find("Content-Encoding: gzip\r\n") < headLength);
+  TEST_ASSERT_TRUE(response.find("Connection: keep-alive\r\n") < headLength);
+  TEST_ASSERT_EQUAL(headLength + INDEX_HTML_GZ_LEN, response.size());
+  TEST_ASSERT_EQUAL_MEMORY(INDEX_HTML_GZ, response.data() + headLength, INDEX_HTML_GZ_LEN);
+
+  before = allocations;
+  beforeBytes = allocatedBytes;
+  size_t servedWire = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) servedWire = getPage(client, response.size(), sends, acks);
+  double servedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long servedAllocs = allocations - before, servedBytes = allocatedBytes - beforeBytes;
+  logFlush();
+  TEST_ASSERT_TRUE(client->output == response);
+  client->disconnect();
+
+  // A single-segment window: the same bytes, a window's worth per send()
+  AsyncClient* narrow = rig.connect(1436);
+  TEST_ASSERT_NOT_NULL(narrow);
+  unsigned narrowSends, narrowAcks;
+  getPage(narrow, response.size(), narrowSends, narrowAcks);
+  TEST_ASSERT_TRUE(narrow->output == response);
+  TEST_ASSERT_EQUAL((response.size() + 1435) / 1436, narrowSends);
+  narrow->disconnect();
+
+  char report[360];
+  snprintf(report, sizeof(report),
+           "generated page: %.2f us, %lu allocations (%lu bytes), %u bytes sent and %u bytes of Serial "
+           "(%.0f us at 115200 baud) per request; flash asset through HttpServer: %.2f us, %lu allocations, "
+           "%u bytes sent in %u send() calls and %u acks",
+           generatedUs / RUNS, generatedAllocs / RUNS, generatedBytes / RUNS, (unsigned)generatedWire,
+           (unsigned)(serialBytes / RUNS), serialBytes / RUNS * 10 * 1e6 / 115200, servedUs / RUNS,
+           servedAllocs / RUNS, (unsigned)servedWire, sends, acks);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL(0, servedAllocs);
+  TEST_ASSERT_EQUAL(0, servedBytes);
+  TEST_ASSERT_GREATER_THAN(generatedWire / 2, generatedBytes / RUNS);  // At least the page itself, copied
+  TEST_ASSERT_LESS_THAN(generatedWire, servedWire);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_control_answered_with_all_observers_connected);
+  RUN_TEST(test_observer_cap_enforced);
+  RUN_TEST(test_page_against_generated_one);
+  return UNITY_END();
+}
@@ -0,0 +1,307 @@
+// The ring-buffer logger: compile-time levels, lines coming out whole and
+// in order, a full ring dropping rather than blocking, several producer
+// threads against one drain, and how long a pump command takes to reach
+// its PWM write with the logging it does on the way.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+
+static const size_t LOG_SLOTS = 64;       // As logger.cpp
+static const size_t LOG_LINE_SIZE = 128;
+
+// Points stdout, where the host build of the logger writes, at a temporary
+// file until finish()
+class StdoutCapture {
+private:
+  FILE* file;
+  int saved;
+
+public:
+  StdoutCapture() {
+    fflush(stdout);
+    file = tmpfile();
+    saved = dup(fileno(stdout));
+    dup2(fileno(file), fileno(stdout));
+  }
+
+  // Bytes written so far
+  long size() {
+    fflush(stdout);
+    return lseek(fileno(file), 0, SEEK_CUR);
+  }
+
+  std::string finish() {
+    fflush(stdout);
+    dup2(saved, fileno(stdout));
+    close(saved);
+    std::string text;
+    rewind(file);
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, n);
+    fclose(file);
+    return text;
+  }
+};
+
+static std::vector<std::string> splitLines(const std::string& text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\n') {
+      lines.push_back(text.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  return lines;
+}
+
+static int evaluations = 0;
+
+static int sideEffect() {
+  return ++evaluations;
+}
+
+void setUp() {
+  logFlush();
+}
+
+void tearDown() {
+  logFlush();
+}
+
+// A statement above the configured level is type-checked but never runs,
+// arguments included
+static void test_disabled_statement_costs_nothing() {
+  evaluations = 0;
+  LOG_DISABLED("[Test] %d", sideEffect());
+  TEST_ASSERT_EQUAL(0, evaluations);
+
+  StdoutCapture capture;
+  LOG_DEBUG("[Test] %d", sideEffect());  // The native build logs at DEBUG
+  logFlush();
+  TEST_ASSERT_EQUAL_STRING("[Test] 1\n", capture.finish().c_str());
+  TEST_ASSERT_EQUAL(1, evaluations);
+}
+
+// Lines come out in order; an overlong one is cut to a slot but keeps its
+// line break
+static void test_lines_in_order_and_truncated() {
+  StdoutCapture capture;
+  LOG_INFO("[Test] first");
+  LOG_WARN("[Test] second %s", "line");
+  std::string longText(300, 'x');
+  LOG_ERROR("[Test] %s", longText.c_str());
+  logFlush();
+  std::vector<std::string> lines = splitLines(capture.finish());
+
+  TEST_ASSERT_EQUAL(3, lines.size());
+  TEST_ASSERT_EQUAL_STRING("[Test] first", lines[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("[Test] second line", lines[1].c_str());
+  TEST_ASSERT_EQUAL(LOG_LINE_SIZE - 2, lines[2].size());
+  TEST_ASSERT_EQUAL_STRING(("[Test] " + longText).substr(0, LOG_LINE_SIZE - 2).c_str(), lines[2].c_str());
+}
+
+// With nothing draining, the ring takes one message per slot and counts the
+// rest as dropped; the next drain reports them first
+static void test_full_ring_drops() {
+  uint32_t droppedBefore = logDroppedCount();
+  const unsigned MESSAGES = LOG_SLOTS + 36;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < MESSAGES; i++) LOG_INFO("[Test] message %u", i);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  TEST_ASSERT_EQUAL_UINT32(36, logDroppedCount() - droppedBefore);
+  // Nowhere near blocking for a drain that never comes
+  TEST_ASSERT_TRUE(elapsed < std::chrono::milliseconds(100));
+
+  StdoutCapture capture;
+  logFlush();
+  std::vector<std::string> lines = splitLines(capture.finish());
+  TEST_ASSERT_EQUAL(LOG_SLOTS + 1, lines.size());
+  TEST_ASSERT_EQUAL_STRING("[Log] 36 message(s) dropped", lines[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("[Test] message 0", lines[1].c_str());
+  char last[32];
+  snprintf(last, sizeof(last), "[Test] message %u", (unsigned)LOG_SLOTS - 1);
+  TEST_ASSERT_EQUAL_STRING(last, lines.back().c_str());
+}
+
+// Producers on four threads while this one drains: every message either
+// comes out whole, in its producer's order, or is counted as dropped
+static void test_producers_against_one_drain() {
+  const int PRODUCERS = 4;
+  const unsigned PER_PRODUCER = 20000;
+  uint32_t droppedBefore = logDroppedCount();
+  std::atomic<int> running(PRODUCERS);
+
+  StdoutCapture capture;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; p++) {
+    producers.push_back(std::thread([p, &running]() {
+      for (unsigned i = 0; i < PER_PRODUCER; i++) {
+        LOG_INFO("[P%d] %u", p, i);
+        if (i % 8 == 0) std::this_thread::sleep_for(std::chrono::microseconds(20));  // Mostly keep up
+      }
+      running--;
+    }));
+  }
+  while (running.load() > 0) logFlush();
+  for (size_t p = 0; p < producers.size(); p++) producers[p].join();
+  logFlush();
+  std::vector<std::string> lines = splitLines(capture.finish());
+
+  uint32_t dropped = logDroppedCount() - droppedBefore;
+  long next[PRODUCERS] = { 0, 0, 0, 0 };
+  unsigned received = 0, reportedDrops = 0, malformed = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    int producer;
+    unsigned sequence;
+    unsigned long drops;
+    if (sscanf(lines[i].c_str(), "[Log] %lu message(s) dropped", &drops) == 1) {
+      reportedDrops += drops;
+    } else if (sscanf(lines[i].c_str(), "[P%d] %u", &producer, &sequence) == 2 && producer >= 0 &&
+               producer < PRODUCERS && (long)sequence >= next[producer]) {
+      next[producer] = sequence + 1;
+      received++;
+    } else {
+      malformed++;
+    }
+  }
+
+  char report[96];
+  snprintf(report, sizeof(report), "%u messages: %u written, %lu dropped", PRODUCERS * PER_PRODUCER, received,
+           (unsigned long)dropped);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL(0, malformed);
+  TEST_ASSERT_EQUAL(PRODUCERS * PER_PRODUCER, received + dropped);
+  TEST_ASSERT_EQUAL(dropped, reportedDrops);
+}
+
+// Stamps the wall clock at the pump's first PWM write after arm(), and
+// drains what the command logged before it, so the bytes that used to be
+// printed ahead of the edge can be counted
+class EdgeTimingHal : public SimHal {
+public:
+  bool armed;
+  std::chrono::steady_clock::time_point edge;
+  StdoutCapture* capture;
+  long bytesBeforeEdge;
+
+  EdgeTimingHal() : armed(false), capture(NULL), bytesBeforeEdge(0) {}
+
+  void arm(StdoutCapture* output) {
+    armed = true;
+    capture = output;
+  }
+
+  void pwmWrite(uint8_t channel, uint32_t duty) override {
+    if (armed && channel == PUMP_CHANNELS[0].ledcChannel && duty > 0) {
+      edge = std::chrono::steady_clock::now();
+      armed = false;
+      if (capture) {
+        logFlush();
+        bytesBeforeEdge = capture->size();
+      }
+    }
+    SimHal::pwmWrite(channel, duty);
+  }
+};
+
+struct Rig {
+  EdgeTimingHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+
+  Rig()
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    logFlush();
+  }
+
+  void command(CommandAction action, uint32_t speed) {
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.action = action;
+    command.speed = speed;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+  }
+
+  // Wall-clock time from execute() to the PWM edge, in ns
+  double edgeLatencyNs(uint32_t speed) {
+    hal.arm(NULL);
+    auto start = std::chrono::steady_clock::now();
+    command(ACTION_FORWARD, speed);
+    TEST_ASSERT_FALSE(hal.armed);
+    double latency = std::chrono::duration<double, std::nano>(hal.edge - start).count();
+    command(ACTION_STOP, 0);
+    hal.advanceMs(200);
+    return latency;
+  }
+};
+
+static double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+// Command to PWM edge with DEBUG logging going into the ring (drained
+// between commands, as the drain task would), and with the ring left full
+// so every statement is a failed slot claim, the nearest a running build
+// gets to logging off. Against that, what the old synchronous prints put
+// in front of the edge would take at 115200 baud.
+static void test_command_to_pwm_latency() {
+  Rig rig;
+  const int RUNS = 2000;
+  std::vector<double> ringNs, fullNs;
+  for (int i = 0; i < RUNS; i++) {
+    ringNs.push_back(rig.edgeLatencyNs(200 + i % 800));
+    logFlush();
+  }
+  for (unsigned i = 0; i < LOG_SLOTS; i++) LOG_DEBUG("[Test] filler");
+  for (int i = 0; i < RUNS; i++) fullNs.push_back(rig.edgeLatencyNs(200 + i % 800));
+  logFlush();
+
+  StdoutCapture capture;
+  rig.hal.arm(&capture);
+  rig.command(ACTION_FORWARD, 600);
+  long bytes = rig.hal.bytesBeforeEdge;
+  logFlush();
+  capture.finish();
+  double serialUs = bytes * 10 * 1e6 / 115200;  // 8N1
+
+  char report[160];
+  snprintf(report, sizeof(report),
+           "command to PWM edge, median: %.2f us logging to the ring, %.2f us ring full; "
+           "%ld bytes logged first, %.0f us as blocking serial",
+           median(ringNs) / 1000, median(fullNs) / 1000, bytes, serialUs);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_GREATER_THAN(0, bytes);
+  TEST_ASSERT_TRUE(median(ringNs) / 1000 < serialUs / 10);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_disabled_statement_costs_nothing);
+  RUN_TEST(test_lines_in_order_and_truncated);
+  RUN_TEST(test_full_ring_drops);
+  RUN_TEST(test_producers_against_one_drain);
+  RUN_TEST(test_command_to_pwm_latency);
+  return UNITY_END();
+}
@@ -0,0 +1,179 @@
+// Protocols (parseProtocol, ProtocolSequencer) run on SimHal's clock, and
+// what a stop or an abort leaves behind for the next command.
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "protocol.h"
+#include "protocol_sequencer.h"
+#include "command_dispatcher.h"
+
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  return true;
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+  ProtocolSequencer sequencer;
+  CommandDispatcher dispatcher;
+
+  Rig()
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal), sequencer(controller, hal),
+      dispatcher(controller, sequencer, executeNow, &controller) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    sequencer.begin();
+    hal.clearEvents();
+  }
+
+  // A body as the web page or a UDP client would send it, resolved and
+  // queued the same way
+  void send(CommandTarget target, const char* body) {
+    PumpCommand command;
+    TEST_ASSERT_EQUAL(CMD_OK, parsePumpCommand(body, strlen(body), target, command));
+    dispatcher.resolve(command, dispatcher.status(), SOURCE_WEB);
+    TEST_ASSERT_TRUE(dispatcher.submit(command));
+    logFlush();
+  }
+
+  bool start(const char* body) {
+    Protocol protocol;
+    int badStep;
+    if (parseProtocol(body, strlen(body), protocol, badStep) != CMD_OK) return false;
+    return sequencer.start(protocol);
+  }
+
+  void runMs(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 20) {
+      hal.advanceMs(20);
+      controller.service();
+    }
+    logFlush();
+  }
+
+  // Times a PWM channel's duty changed between zero and non-zero
+  std::vector<uint64_t> edges(uint8_t ledcChannel) const {
+    std::vector<uint64_t> times;
+    bool on = false;
+    for (size_t i = 0; i < hal.events().size(); i++) {
+      const SimHal::Event& event = hal.events()[i];
+      if (event.kind != SimHal::EVENT_PWM || event.index != ledcChannel) continue;
+      if ((event.value > 0) != on) {
+        on = event.value > 0;
+        times.push_back(event.timeUs);
+      }
+    }
+    return times;
+  }
+};
+
+static const char PRIME[] =
+  "{\"name\": \"prime\", \"steps\": ["
+  "{\"target\": \"vacuum\", \"action\": \"start\", \"speed\": 80, \"durationMs\": 3000},"
+  "{\"action\": \"forward\", \"speed\": 600, \"durationMs\": 2500},"
+  "{\"action\": \"wait\", \"durationMs\": 1000},"
+  "{\"action\": \"reverse\", \"speed\": 1023, \"duration\": 4}]}";
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+static void test_parse_rejects_bad_steps() {
+  Protocol protocol;
+  int badStep;
+  TEST_ASSERT_EQUAL(CMD_OK, parseProtocol(PRIME, strlen(PRIME), protocol, badStep));
+  TEST_ASSERT_EQUAL(4, protocol.stepCount);
+  TEST_ASSERT_EQUAL_STRING("prime", protocol.name);
+  TEST_ASSERT_EQUAL_UINT32(4000, protocol.steps[3].durationMs);
+
+  static const char BAD_SPEED[] =
+    "{\"steps\": [{\"action\": \"stop\"}, {\"target\": \"vacuum\", \"action\": \"start\", \"speed\": 95}]}";
+  TEST_ASSERT_NOT_EQUAL(CMD_OK, parseProtocol(BAD_SPEED, strlen(BAD_SPEED), protocol, badStep));
+  TEST_ASSERT_EQUAL(1, badStep);
+}
+
+// Each step starts when the one before ends, to the microsecond, however
+// the control task's service ticks fall
+static void test_steps_run_back_to_back() {
+  Rig rig;
+  uint64_t startUs = rig.hal.nowUs();
+  TEST_ASSERT_TRUE(rig.start(PRIME));
+  rig.runMs(12000);
+
+  std::vector<uint64_t> vacuum = rig.edges(VACUUM_CHANNEL.ledcChannel);
+  TEST_ASSERT_EQUAL(2, vacuum.size());
+  TEST_ASSERT_EQUAL_UINT64(startUs, vacuum[0]);
+  TEST_ASSERT_EQUAL_UINT64(startUs + 3000000, vacuum[1]);
+
+  std::vector<uint64_t> pump = rig.edges(PUMP_CHANNELS[0].ledcChannel);
+  TEST_ASSERT_EQUAL(4, pump.size());
+  TEST_ASSERT_EQUAL_UINT64(startUs + 3000000, pump[0]);
+  TEST_ASSERT_EQUAL_UINT64(startUs + 5500000, pump[1]);
+  TEST_ASSERT_EQUAL_UINT64(startUs + 6500000, pump[2]);
+  TEST_ASSERT_EQUAL_UINT64(startUs + 10500000, pump[3]);
+
+  ProtocolProgress progress = rig.sequencer.progress();
+  TEST_ASSERT_FALSE(progress.active);
+  TEST_ASSERT_FALSE(progress.aborted);
+}
+
+// A stop keeps the speed, so the next start without one runs as fast as
+// the last
+static void test_stop_keeps_speed() {
+  Rig rig;
+  rig.send(TARGET_PUMP, "{\"action\": \"forward\", \"speed\": 700}");
+  rig.send(TARGET_PUMP, "{\"action\": \"stop\"}");
+  TEST_ASSERT_EQUAL(700, rig.controller.status().pumpSpeed);
+  rig.send(TARGET_PUMP, "{\"action\": \"reverse\"}");
+  TEST_ASSERT_EQUAL(PUMP_REVERSE, rig.controller.status().pumpState);
+  TEST_ASSERT_EQUAL(700, rig.controller.status().pumpSpeed);
+
+  rig.send(TARGET_VACUUM, "{\"action\": \"start\", \"speed\": 512}");
+  rig.send(TARGET_VACUUM, "{\"action\": \"stop\"}");
+  rig.send(TARGET_VACUUM, "{\"action\": \"start\"}");
+  TEST_ASSERT_EQUAL(VACUUM_RUNNING, rig.controller.status().vacuumState);
+  TEST_ASSERT_EQUAL(50, rig.controller.status().vacuumSpeed);
+}
+
+// Aborting a protocol stops both motors but leaves their speeds for the
+// next command that doesn't give one
+static void test_abort_keeps_speed() {
+  Rig rig;
+  TEST_ASSERT_TRUE(rig.start(PRIME));
+  rig.runMs(3200);
+  TEST_ASSERT_EQUAL(PUMP_FORWARD, rig.controller.status().pumpState);
+  rig.sequencer.stop();
+  logFlush();
+
+  PumpStatus status = rig.controller.status();
+  TEST_ASSERT_EQUAL(PUMP_STOPPED, status.pumpState);
+  TEST_ASSERT_EQUAL(VACUUM_STOPPED, status.vacuumState);
+  TEST_ASSERT_TRUE(rig.sequencer.progress().aborted);
+  TEST_ASSERT_EQUAL(600, status.pumpSpeed);
+
+  rig.send(TARGET_PUMP, "{\"action\": \"forward\"}");
+  TEST_ASSERT_EQUAL(600, rig.controller.status().pumpSpeed);
+  TEST_ASSERT_EQUAL(600, rig.hal.pwmDuty(PUMP_CHANNELS[0].ledcChannel));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_rejects_bad_steps);
+  RUN_TEST(test_steps_run_back_to_back);
+  RUN_TEST(test_stop_keeps_speed);
+  RUN_TEST(test_abort_keeps_speed);
+  return UNITY_END();
+}
@@ -0,0 +1,180 @@
+// Ramp duty trajectories: RampGenerator's linear and S-curve segments, and
+// the PWM a pump on SimHal actually puts out when starting, reversing
+// through zero and stopping.
+#include <unity.h>
+#include <stdlib.h>
+#include <vector>
+#include "hal_sim.h"
+#include "logger.h"
+#include "ramp.h"
+#include "pump.h"
+#include "tb6612.h"
+
+static const uint32_t MAX_DUTY = 1023;
+static const uint32_t TICK_US = 1000;  // The pump's 1 kHz ramp timer
+
+static std::vector<uint32_t> segment(RampShape shape, uint16_t rampMs, uint32_t from, uint32_t to) {
+  RampGenerator ramp;
+  RampConfig config = { shape, rampMs };
+  ramp.configure(config);
+  ramp.start(from, to, MAX_DUTY, TICK_US);
+  std::vector<uint32_t> duties;
+  while (ramp.active()) duties.push_back(ramp.next());
+  return duties;
+}
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+static void test_off_is_one_step() {
+  std::vector<uint32_t> duties = segment(RAMP_OFF, 100, 0, 800);
+  TEST_ASSERT_EQUAL(0, duties.size());
+  RampGenerator ramp;
+  ramp.start(0, 800, MAX_DUTY, TICK_US);
+  TEST_ASSERT_FALSE(ramp.active());
+  TEST_ASSERT_EQUAL_UINT32(800, ramp.next());
+}
+
+// Constant slope: full scale over rampMs, one tick per millisecond
+static void test_linear_slope() {
+  std::vector<uint32_t> up = segment(RAMP_LINEAR, 100, 0, MAX_DUTY);
+  TEST_ASSERT_EQUAL(100, up.size());
+  TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, up.back());
+  uint32_t last = 0;
+  for (size_t i = 0; i < up.size(); i++) {
+    TEST_ASSERT_UINT32_WITHIN(1, 10, up[i] - last);
+    last = up[i];
+  }
+
+  // A smaller change takes proportionally less time at the same slope
+  std::vector<uint32_t> down = segment(RAMP_LINEAR, 100, 800, 400);
+  TEST_ASSERT_UINT32_WITHIN(1, 39, down.size());
+  TEST_ASSERT_EQUAL_UINT32(400, down.back());
+  last = 800;
+  for (size_t i = 0; i < down.size(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(last, down[i]);
+    TEST_ASSERT_UINT32_WITHIN(1, 10, last - down[i]);
+    last = down[i];
+  }
+}
+
+// Smoothstep: monotonic, symmetric about the midpoint, gentle at both ends
+// and steepest in the middle at 1.5x the linear slope
+static void test_scurve_shape() {
+  std::vector<uint32_t> up = segment(RAMP_SCURVE, 200, 0, MAX_DUTY);
+  const size_t n = up.size();
+  TEST_ASSERT_EQUAL(200, n);
+  TEST_ASSERT_EQUAL_UINT32(MAX_DUTY, up.back());
+
+  uint32_t last = 0, steepest = 0;
+  for (size_t i = 0; i < n; i++) {
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(last, up[i]);
+    if (up[i] - last > steepest) steepest = up[i] - last;
+    last = up[i];
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, up[0]);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, MAX_DUTY - up[n - 2]);
+  TEST_ASSERT_UINT32_WITHIN(1, MAX_DUTY * 3 / 2 / n, steepest);
+  for (size_t i = 0; i + 1 < n; i++) {
+    TEST_ASSERT_UINT32_WITHIN(2, MAX_DUTY, up[i] + up[n - 2 - i]);
+  }
+}
+
+// Output of a pump as the bridge sees it at each PWM update
+struct Sample {
+  uint64_t timeUs;
+  uint32_t duty;
+  int direction;  // 1 forward, -1 reverse, 0 coast
+};
+
+static std::vector<Sample> pwmTrace(const SimHal& hal, const ChannelConfig& channel) {
+  std::vector<Sample> trace;
+  bool in1 = false, in2 = false;
+  for (size_t i = 0; i < hal.events().size(); i++) {
+    const SimHal::Event& event = hal.events()[i];
+    if (event.kind == SimHal::EVENT_PIN && event.index == channel.in1Pin) in1 = event.value;
+    if (event.kind == SimHal::EVENT_PIN && event.index == channel.in2Pin) in2 = event.value;
+    if (event.kind == SimHal::EVENT_PWM && event.index == channel.ledcChannel) {
+      Sample sample = { event.timeUs, event.value, in1 != in2 ? (in1 ? 1 : -1) : 0 };
+      trace.push_back(sample);
+    }
+  }
+  return trace;
+}
+
+// Forward at 800, reverse at 600, stop: the duty falls to zero on the old
+// direction before the inputs change, and every step is a ramp step
+static void test_pump_reverses_through_zero() {
+  const RampShape shapes[] = { RAMP_LINEAR, RAMP_SCURVE };
+  const ChannelConfig& channel = PUMP_CHANNELS[0];
+  for (int s = 0; s < 2; s++) {
+    SimHal hal;
+    Tb6612Driver driver(hal, MOTOR_DRIVERS[channel.driver]);
+    PeristalticPump pump(hal, driver, channel, 0);
+    driver.makeSafe();
+    pump.makeSafe();
+    pump.begin();
+    RampConfig config = { shapes[s], 100 };
+    pump.setRampConfig(config);
+    hal.clearEvents();
+
+    pump.controlPump(PUMP_FORWARD, 800, 0);
+    hal.advanceMs(150);
+    uint64_t reverseUs = hal.nowUs();
+    pump.controlPump(PUMP_REVERSE, 600, 0);
+    hal.advanceMs(250);
+    uint64_t stopUs = hal.nowUs();
+    pump.controlPump(PUMP_STOPPED, 0, 0);
+    hal.advanceMs(150);
+    logFlush();
+
+    std::vector<Sample> trace = pwmTrace(hal, channel);
+    TEST_ASSERT_GREATER_THAN(100, trace.size());
+    uint32_t lastDuty = 0, maxStep = 0;
+    int lastDirection = 0;
+    uint64_t zeroUs = 0;
+    for (size_t i = 0; i < trace.size(); i++) {
+      const Sample& sample = trace[i];
+      uint32_t step = sample.duty > lastDuty ? sample.duty - lastDuty : lastDuty - sample.duty;
+      if (step > maxStep) maxStep = step;
+      if (sample.duty > 0) {
+        TEST_ASSERT_NOT_EQUAL(0, sample.direction);
+        // Only ever driven in a new direction from rest
+        if (lastDirection != 0 && sample.direction != lastDirection) TEST_ASSERT_EQUAL_UINT32(0, lastDuty);
+        lastDirection = sample.direction;
+      }
+      if (sample.timeUs > reverseUs && sample.timeUs < stopUs && sample.duty == 0) zeroUs = sample.timeUs;
+      lastDuty = sample.duty;
+    }
+    // 1.5x the linear slope at the steepest point of an S-curve
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_DUTY * 3 / 2 / 100 + 1, maxStep);
+
+    // Down 800 to 0 at 100 ms full scale, then up to 600 in the new direction
+    TEST_ASSERT_UINT32_WITHIN(2000, reverseUs + 78000, zeroUs);
+    TEST_ASSERT_EQUAL(PUMP_STOPPED, pump.getCurrentState());
+    TEST_ASSERT_EQUAL_UINT32(0, trace.back().duty);
+    TEST_ASSERT_EQUAL_UINT32(0, hal.pwmDuty(channel.ledcChannel));
+    TEST_ASSERT_UINT32_WITHIN(2000, stopUs + 59000, trace.back().timeUs);
+    TEST_ASSERT_FALSE(hal.pinLevel(channel.in1Pin));
+    TEST_ASSERT_FALSE(hal.pinLevel(channel.in2Pin));
+
+    // The reverse leg peaked at its set point before the stop
+    uint32_t peak = 0;
+    for (size_t i = 0; i < trace.size(); i++) {
+      if (trace[i].timeUs > zeroUs && trace[i].timeUs <= stopUs && trace[i].duty > peak) peak = trace[i].duty;
+    }
+    TEST_ASSERT_EQUAL_UINT32(600, peak);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_off_is_one_step);
+  RUN_TEST(test_linear_slope);
+  RUN_TEST(test_scurve_shape);
+  RUN_TEST(test_pump_reverses_through_zero);
+  return UNITY_END();
+}
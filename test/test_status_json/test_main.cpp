@@ -0,0 +1,482 @@
+// The /api/status serializer (writeStatusJson): a golden body, every field
+// the original String-concatenating generateStatusJSON() wrote still there
+// with the same value over randomized statuses, truncation into short
+// buffers, and bodies per second and allocations against that original.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include "hal_sim.h"
+#include "logger.h"
+#include "boot_profile.h"
+#include "status_json.h"
+
+// Every operator new in the process, so a test can tell whether the code
+// under it touched the heap
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const size_t STATUS_JSON_SIZE = 1280;  // WebServerManager's buffer
+
+static std::string str(unsigned long value) {
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return text;
+}
+
+static std::string str(long value) {
+  char text[24];
+  snprintf(text, sizeof(text), "%ld", value);
+  return text;
+}
+
+static std::string str(int value) {
+  return str((long)value);
+}
+
+// What the original server read off its two pump objects
+struct BaselinePumps {
+  PumpState pumpState;
+  uint16_t pumpSpeed;
+  bool pumpTimedRun;
+  uint32_t pumpRemainingTime;  // Whole seconds, as getRemainingTime() counted them
+  VacuumPumpState vacuumState;
+  uint8_t vacuumSpeed;
+  bool vacuumTimedRun;
+  uint32_t vacuumRemainingTime;
+};
+
+// generateStatusJSON() from before this series, line for line, with
+// std::string for Arduino's String and the getters read from pumps. It only
+// knew stopped, forward and reverse, and stopped and running. std::string
+// keeps short values inline, so its allocation count is a lower bound of
+// what String did on the heap.
+static std::string baselineStatusJson(const BaselinePumps& pumps) {
+  std::string json = "{";
+  json += "\"success\": true,";
+
+  json += "\"pump\": {";
+  json += "\"state\": ";
+  switch (pumps.pumpState) {
+    case PUMP_STOPPED:
+      json += "\"stopped\"";
+      break;
+    case PUMP_FORWARD:
+      json += "\"forward\"";
+      break;
+    case PUMP_REVERSE:
+      json += "\"reverse\"";
+      break;
+  }
+  json += ",\"speed\": " + str((unsigned long)pumps.pumpSpeed);
+  json += ",\"speedPercent\": " + str((pumps.pumpSpeed * 100) / 255);
+  if (pumps.pumpTimedRun && pumps.pumpState != PUMP_STOPPED) {
+    json += ",\"remainingTime\": " + str((unsigned long)pumps.pumpRemainingTime);
+    json += ",\"isTimedRun\": true";
+  } else {
+    json += ",\"remainingTime\": 0";
+    json += ",\"isTimedRun\": false";
+  }
+  json += "},";
+
+  json += "\"vacuum\": {";
+  json += "\"state\": ";
+  switch (pumps.vacuumState) {
+    case VACUUM_STOPPED:
+      json += "\"stopped\"";
+      break;
+    case VACUUM_RUNNING:
+      json += "\"running\"";
+      break;
+    default:
+      break;
+  }
+  json += ",\"speed\": " + str((unsigned long)pumps.vacuumSpeed);
+  json += ",\"speedPercent\": " + str((pumps.vacuumSpeed * 100) / 255);
+  if (pumps.vacuumTimedRun && pumps.vacuumState != VACUUM_STOPPED) {
+    json += ",\"remainingTime\": " + str((unsigned long)pumps.vacuumRemainingTime);
+    json += ",\"isTimedRun\": true";
+  } else {
+    json += ",\"remainingTime\": 0";
+    json += ",\"isTimedRun\": false";
+  }
+  json += "}";
+
+  json += "}";
+  return json;
+}
+
+// The raw value of key inside the object named section, or "" if either is
+// missing; good enough for the flat pump and vacuum objects
+static std::string field(const std::string& json, const char* section, const char* key) {
+  size_t open = json.find("\"" + std::string(section) + "\": {");
+  if (open == std::string::npos) return "";
+  size_t close = json.find('}', open);
+  size_t at = json.find("\"" + std::string(key) + "\": ", open);
+  if (at == std::string::npos || at > close) return "";
+  at += strlen(key) + 4;
+  return json.substr(at, json.find_first_of(",}", at) - at);
+}
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+// Everything /api/status reads, as it stands at nowUs
+struct Inputs {
+  PumpStatus status;
+  ProtocolProgress progress;
+  WiFiStats link;
+  uint64_t nowUs;
+  uint32_t nowMs;
+};
+
+static void fixedInputs(Inputs& in) {
+  memset(&in, 0, sizeof(in));
+  in.nowUs = 90000000;
+  in.nowMs = 90000;
+  in.status.pumpState = PUMP_FORWARD;
+  in.status.pumpSpeed = 600;
+  in.status.pumpTimedRun = true;
+  in.status.pumpRunDurationMs = 5000;
+  in.status.pumpStopDeadlineUs = in.nowUs + 3200500;
+  in.status.vacuumState = VACUUM_REGULATING;
+  in.status.vacuumSpeed = 80;
+  in.status.vacuumTargetPa = 40000;
+  in.status.vacuumPressurePa = -39812;
+  in.status.vacuumInterlock = PRESSURE_OK;
+  in.status.vacuumLastTrip = PRESSURE_OVER_VACUUM;
+  in.status.doseTargetUl = 2500;
+  in.status.doseFlowRate = 600;
+  in.status.doseDeliveredUl = 2498;
+  in.progress.active = true;
+  in.progress.step = 1;
+  in.progress.stepCount = 4;
+  strcpy(in.progress.name, "PRIME");
+  in.progress.stepDeadlineUs = in.nowUs + 1500000;
+  in.link.state = WIFI_STATE_CONNECTED;
+  in.link.drops = 2;
+  in.link.failedAttempts = 5;
+  in.link.lastReconnectMs = 3120;
+  in.link.connectedSinceMs = 60000;
+  in.link.backoffMs = 1000;
+  in.link.lastReason = 201;
+}
+
+static void randomInputs(Inputs& in) {
+  static const char* const NAMES[] = { "", "PRIME", "flush-all", "x", "Sample 12" };
+  memset(&in, 0, sizeof(in));
+  in.nowUs = (uint64_t)nextRandom() * 1000 + nextRandom() % 1000;
+  in.nowMs = nextRandom();
+  in.status.pumpState = (PumpState)(nextRandom() % 3);
+  in.status.pumpSpeed = nextRandom() % 1024;
+  in.status.pumpTimedRun = nextRandom() & 1;
+  in.status.pumpRunDurationMs = nextRandom() % 300001;
+  in.status.pumpStopDeadlineUs = in.nowUs - 5000 + nextRandom() % 400000000;
+  in.status.vacuumState = (VacuumPumpState)(nextRandom() % 3);
+  in.status.vacuumSpeed = nextRandom() % 101;
+  in.status.vacuumTimedRun = nextRandom() & 1;
+  in.status.vacuumRunDurationMs = nextRandom() % 300001;
+  in.status.vacuumStopDeadlineUs = in.nowUs - 5000 + nextRandom() % 400000000;
+  in.status.vacuumTargetPa = nextRandom() % 90000;
+  in.status.vacuumPressurePa = (int32_t)(nextRandom() % 200000) - 100000;
+  in.status.vacuumInterlock = (PressureState)(nextRandom() % 5);
+  in.status.vacuumLastTrip = (PressureState)(nextRandom() % 5);
+  in.status.doseActive = nextRandom() & 1;
+  in.status.doseTargetUl = nextRandom() % 100000;
+  in.status.doseFlowRate = nextRandom() % 5000;
+  in.status.doseDeliveredUl = nextRandom() % 100000;
+  in.progress.active = nextRandom() & 1;
+  in.progress.aborted = nextRandom() & 1;
+  in.progress.stepCount = nextRandom() % 17;
+  in.progress.step = in.progress.stepCount ? nextRandom() % in.progress.stepCount : 0;
+  strcpy(in.progress.name, NAMES[nextRandom() % 5]);
+  in.progress.stepDeadlineUs = in.nowUs - 5000 + nextRandom() % 400000000;
+  in.link.state = nextRandom() % 4;
+  in.link.drops = nextRandom() % 1000;
+  in.link.failedAttempts = nextRandom();
+  in.link.lastReconnectMs = nextRandom() % 100000;
+  in.link.connectedSinceMs = nextRandom();
+  in.link.backoffMs = nextRandom() % 60001;
+  in.link.lastReason = nextRandom() % 256;
+}
+
+static size_t writeStatus(const Inputs& in, const BootProfile& boot, char* buffer, size_t size) {
+  return writeStatusJson(in.status, in.progress, in.link, boot, in.nowUs, in.nowMs, buffer, size);
+}
+
+static std::string writeStatus(const Inputs& in, const BootProfile& boot) {
+  char buffer[STATUS_JSON_SIZE];
+  size_t length = writeStatus(in, boot, buffer, sizeof(buffer));
+  return std::string(buffer, length);
+}
+
+// A timed run of whole seconds, elapsedMs in, as both sides hold it: the
+// original pump kept the duration and start and counted whole seconds
+// gone, the controller keeps a stop deadline
+static void timedRun(uint32_t durationS, uint32_t elapsedMs, uint64_t nowUs, uint32_t& runDurationMs,
+                     uint64_t& stopDeadlineUs, uint32_t& remainingTime) {
+  runDurationMs = durationS * 1000;
+  stopDeadlineUs = nowUs + (uint64_t)(runDurationMs - elapsedMs) * 1000;
+  remainingTime = durationS - elapsedMs / 1000;
+}
+
+// Randomized inputs restricted to what the original pumps could be in, and
+// those pumps as it would have read them
+static void randomBaseline(Inputs& in, BaselinePumps& pumps) {
+  randomInputs(in);
+  memset(&pumps, 0, sizeof(pumps));
+  pumps.pumpState = in.status.pumpState;
+  pumps.pumpSpeed = in.status.pumpSpeed;
+  pumps.pumpTimedRun = in.status.pumpTimedRun = in.status.pumpState != PUMP_STOPPED && (nextRandom() & 1);
+  if (pumps.pumpTimedRun) {
+    uint32_t durationS = 1 + nextRandom() % 300;
+    timedRun(durationS, nextRandom() % (durationS * 1000), in.nowUs, in.status.pumpRunDurationMs,
+             in.status.pumpStopDeadlineUs, pumps.pumpRemainingTime);
+  }
+  in.status.vacuumState = pumps.vacuumState = (VacuumPumpState)(nextRandom() % 2);
+  in.status.vacuumTargetPa = 0;
+  pumps.vacuumSpeed = in.status.vacuumSpeed;
+  pumps.vacuumTimedRun = in.status.vacuumTimedRun = in.status.vacuumState != VACUUM_STOPPED && (nextRandom() & 1);
+  if (pumps.vacuumTimedRun) {
+    uint32_t durationS = 1 + nextRandom() % 300;
+    timedRun(durationS, nextRandom() % (durationS * 1000), in.nowUs, in.status.vacuumRunDurationMs,
+             in.status.vacuumStopDeadlineUs, pumps.vacuumRemainingTime);
+  }
+}
+
+// Every field the original body had, by object
+static const char* const BASELINE_SECTIONS[] = { "pump", "vacuum" };
+static const char* const BASELINE_KEYS[] = { "state", "speed", "speedPercent", "remainingTime", "isTimedRun" };
+
+// A boot profile that has finished, as it is whenever the server is up
+struct Boot {
+  SimHal hal;
+  BootProfile profile;
+
+  Boot() : profile(hal) {
+    profile.begin();
+    hal.advanceUs(41250);
+    profile.mark("hal");
+    hal.advanceUs(182000);
+    profile.mark("pumps");
+    profile.finish();
+    hal.advanceMs(2900);
+    profile.markNetworkUp();
+    logFlush();
+  }
+};
+
+void setUp() {
+  rngState = 0x5EED5EED;
+}
+
+void tearDown() {
+  logFlush();
+}
+
+static void test_golden_body() {
+  Boot boot;
+  Inputs in;
+  fixedInputs(in);
+  char buffer[STATUS_JSON_SIZE];
+  size_t length = writeStatus(in, boot.profile, buffer, sizeof(buffer));
+  static const char EXPECTED[] =
+    "{\"success\": true,"
+    "\"pump\": {\"state\": \"forward\",\"speed\": 600,\"speedPercent\": 235"
+    ",\"remainingTime\": 4,\"remainingMs\": 3201,\"durationMs\": 5000,\"isTimedRun\": true},"
+    "\"vacuum\": {\"state\": \"regulating\",\"speed\": 80,\"speedPercent\": 31"
+    ",\"remainingTime\": 0,\"remainingMs\": 0,\"durationMs\": 0,\"isTimedRun\": false"
+    ",\"targetPa\": 40000,\"pressurePa\": -39812,\"interlock\": \"ok\",\"lastTrip\": \"over-vacuum\"},"
+    "\"dose\": {\"active\": false,\"volume\": 2500,\"flowRate\": 600,\"delivered\": 2498},"
+    "\"protocol\": {\"active\": true,\"aborted\": false,\"name\": \"PRIME\",\"step\": 2,\"steps\": 4"
+    ",\"stepRemainingMs\": 1500},"
+    "\"wifi\": {\"state\": \"connected\",\"drops\": 2,\"failedAttempts\": 5,\"lastReconnectMs\": 3120"
+    ",\"connectedMs\": 30000,\"backoffMs\": 1000,\"lastReason\": 201},"
+    "\"boot\": {\"setup\": {\"setupStartUs\":0,\"stages\":{\"hal\":41250,\"pumps\":182000},\"readyUs\":223250}"
+    ",\"networkUpUs\": 3123250}"
+    "}";
+  TEST_ASSERT_EQUAL_STRING(EXPECTED, buffer);
+  TEST_ASSERT_EQUAL(sizeof(EXPECTED) - 1, length);
+}
+
+// The original body for a pump 1.8 s into a 5 s run and the vacuum pump
+// 12.25 s into a 30 s one, and today's body carrying the same values
+static void test_baseline_golden() {
+  Boot boot;
+  Inputs in;
+  fixedInputs(in);
+  BaselinePumps pumps = { PUMP_FORWARD, 600, true, 0, VACUUM_RUNNING, 80, true, 0 };
+  timedRun(5, 1800, in.nowUs, in.status.pumpRunDurationMs, in.status.pumpStopDeadlineUs, pumps.pumpRemainingTime);
+  in.status.vacuumState = VACUUM_RUNNING;
+  in.status.vacuumTargetPa = 0;
+  in.status.vacuumTimedRun = true;
+  timedRun(30, 12250, in.nowUs, in.status.vacuumRunDurationMs, in.status.vacuumStopDeadlineUs,
+           pumps.vacuumRemainingTime);
+
+  std::string baseline = baselineStatusJson(pumps);
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"success\": true,"
+    "\"pump\": {\"state\": \"forward\",\"speed\": 600,\"speedPercent\": 235,\"remainingTime\": 4,"
+    "\"isTimedRun\": true},"
+    "\"vacuum\": {\"state\": \"running\",\"speed\": 80,\"speedPercent\": 31,\"remainingTime\": 18,"
+    "\"isTimedRun\": true}"
+    "}",
+    baseline.c_str());
+
+  std::string current = writeStatus(in, boot.profile);
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t k = 0; k < sizeof(BASELINE_KEYS) / sizeof(BASELINE_KEYS[0]); k++) {
+      TEST_ASSERT_EQUAL_STRING(field(baseline, BASELINE_SECTIONS[s], BASELINE_KEYS[k]).c_str(),
+                               field(current, BASELINE_SECTIONS[s], BASELINE_KEYS[k]).c_str());
+    }
+  }
+  TEST_ASSERT_EQUAL(0, current.compare(0, strlen("{\"success\": true,"), "{\"success\": true,"));
+}
+
+// Randomized statuses the original pumps could have been in: every field
+// it wrote reads the same today
+static void test_keeps_baseline_fields() {
+  Boot boot;
+  for (int run = 0; run < 20000; run++) {
+    Inputs in;
+    BaselinePumps pumps;
+    randomBaseline(in, pumps);
+    std::string baseline = baselineStatusJson(pumps);
+    std::string current = writeStatus(in, boot.profile);
+    for (size_t s = 0; s < 2; s++) {
+      for (size_t k = 0; k < sizeof(BASELINE_KEYS) / sizeof(BASELINE_KEYS[0]); k++) {
+        char message[64];
+        snprintf(message, sizeof(message), "run %d, %s.%s", run, BASELINE_SECTIONS[s], BASELINE_KEYS[k]);
+        std::string expected = field(baseline, BASELINE_SECTIONS[s], BASELINE_KEYS[k]);
+        TEST_ASSERT_FALSE_MESSAGE(expected.empty(), message);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.c_str(),
+                                         field(current, BASELINE_SECTIONS[s], BASELINE_KEYS[k]).c_str(), message);
+      }
+    }
+  }
+}
+
+// Randomized statuses, including the largest values each field can take,
+// always inside the server's buffer
+static void test_fits_server_buffer() {
+  Boot boot;
+  char buffer[STATUS_JSON_SIZE];
+  size_t longest = 0;
+  for (int run = 0; run < 20000; run++) {
+    Inputs in;
+    randomInputs(in);
+    size_t length = writeStatus(in, boot.profile, buffer, sizeof(buffer));
+    if (length > longest) longest = length;
+  }
+
+  char report[64];
+  snprintf(report, sizeof(report), "longest body %u of %u bytes", (unsigned)longest, (unsigned)STATUS_JSON_SIZE);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_LESS_THAN(STATUS_JSON_SIZE - 1, longest);
+}
+
+// Every buffer size short of the body: cut at size - 1, terminated, and not
+// a byte written past the end
+static void test_truncation_stays_in_bounds() {
+  Boot boot;
+  Inputs in;
+  fixedInputs(in);
+  std::string full = writeStatus(in, boot.profile);
+  const size_t GUARD = 16;
+  char buffer[STATUS_JSON_SIZE + GUARD];
+
+  TEST_ASSERT_EQUAL(0, writeStatus(in, boot.profile, buffer, 0));
+  for (size_t size = 1; size <= full.size() + 1; size++) {
+    memset(buffer, 0xA5, sizeof(buffer));
+    size_t length = writeStatus(in, boot.profile, buffer, size);
+    TEST_ASSERT_EQUAL(size - 1, length);
+    TEST_ASSERT_EQUAL(0, buffer[length]);
+    TEST_ASSERT_EQUAL_MEMORY(full.data(), buffer, length);
+    for (size_t i = size; i < size + GUARD; i++) TEST_ASSERT_EQUAL_HEX8(0xA5, (uint8_t)buffer[i]);
+  }
+}
+
+static void test_no_heap_use() {
+  Boot boot;
+  char buffer[STATUS_JSON_SIZE];
+  Inputs in;
+  unsigned long before = allocations;
+  for (int run = 0; run < 1000; run++) {
+    randomInputs(in);
+    writeStatus(in, boot.profile, buffer, sizeof(buffer));
+    writeStatus(in, boot.profile, buffer, 100);
+  }
+  TEST_ASSERT_EQUAL(0, allocations - before);
+}
+
+// Bodies per second and allocations for the original serializer and this
+// one. The original body is the pump and vacuum objects only, a quarter
+// of today's, so bytes per second are reported as well.
+static void test_benchmark_against_baseline() {
+  Boot boot;
+  const int RUNS = 200000;
+  Inputs in;
+  fixedInputs(in);
+  BaselinePumps pumps = { PUMP_FORWARD, 600, true, 4, VACUUM_RUNNING, 80, false, 0 };
+  char buffer[STATUS_JSON_SIZE];
+  size_t baselineBytes = 0, writerBytes = 0;
+
+  unsigned long before = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    pumps.pumpSpeed = 200 + i % 800;
+    std::string json = baselineStatusJson(pumps);
+    baselineBytes += json.size();
+  }
+  double baselineUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long baselineAllocs = allocations - before;
+
+  before = allocations;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    in.nowUs += 250000;  // A poll every 250 ms
+    writerBytes += writeStatus(in, boot.profile, buffer, sizeof(buffer));
+  }
+  double writerUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  unsigned long writerAllocs = allocations - before;
+
+  char report[240];
+  snprintf(report, sizeof(report),
+           "original String concatenation: %.0f bodies/s, %.1f MB/s, %.1f allocations each; "
+           "fixed buffer: %.0f bodies/s, %.1f MB/s, %.1f allocations each",
+           RUNS / baselineUs * 1e6, baselineBytes / baselineUs, (double)baselineAllocs / RUNS,
+           RUNS / writerUs * 1e6, writerBytes / writerUs, (double)writerAllocs / RUNS);
+  TEST_MESSAGE(report);
+  TEST_ASSERT_EQUAL(0, writerAllocs);
+  TEST_ASSERT_GREATER_THAN(0, baselineAllocs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_golden_body);
+  RUN_TEST(test_baseline_golden);
+  RUN_TEST(test_keeps_baseline_fields);
+  RUN_TEST(test_fits_server_buffer);
+  RUN_TEST(test_truncation_stays_in_bounds);
+  RUN_TEST(test_no_heap_use);
+  RUN_TEST(test_benchmark_against_baseline);
+  return UNITY_END();
+}
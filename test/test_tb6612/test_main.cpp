@@ -0,0 +1,183 @@
+// The shared TB6612 standby line (Tb6612Driver): on simulated pins, one
+// motor stopping - by command, timer or emergency stop - never takes the
+// chip out from under the other.
+#include <unity.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  Tb6612Driver& driver;
+  VacuumPump vacuum;
+  PumpController controller;
+  uint8_t stby;
+
+  Rig()
+    : pumps(hal), driver(pumps.driver(VACUUM_CHANNEL.driver)), vacuum(hal, driver, VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    stby = driver.getStbyPin();
+    hal.clearEvents();
+  }
+
+  void command(CommandTarget target, CommandAction action, uint32_t speed, uint32_t durationMs) {
+    PumpCommand command = {};
+    command.target = target;
+    command.action = action;
+    command.speed = speed;
+    command.duration = durationMs;
+    command.source = SOURCE_WEB;
+    controller.execute(command);
+    logFlush();
+  }
+
+  void runMs(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 20) {
+      hal.advanceMs(20);
+      controller.service();
+    }
+    logFlush();
+  }
+
+  // Times STBY went low in the trace since event index from
+  unsigned stbyFalls(size_t from) const {
+    unsigned falls = 0;
+    for (size_t i = from; i < hal.events().size(); i++) {
+      const SimHal::Event& event = hal.events()[i];
+      if (event.kind == SimHal::EVENT_PIN && event.index == stby && event.value == 0) falls++;
+    }
+    return falls;
+  }
+};
+
+static uint32_t rngState = 1;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+void setUp() {
+  rngState = 0x9E3779B9;
+}
+
+void tearDown() {
+  logFlush();
+}
+
+static void test_reference_count() {
+  SimHal hal;
+  Tb6612Driver driver(hal, MOTOR_DRIVERS[0]);
+  uint8_t stby = driver.getStbyPin();
+  driver.makeSafe();
+  TEST_ASSERT_TRUE(driver.inStandby());
+  TEST_ASSERT_FALSE(hal.pinLevel(stby));
+
+  driver.acquire(Tb6612Driver::CHANNEL_A);
+  driver.acquire(Tb6612Driver::CHANNEL_A);  // A speed change drives again
+  TEST_ASSERT_EQUAL(1, driver.userCount());
+  TEST_ASSERT_TRUE(hal.pinLevel(stby));
+  driver.acquire(Tb6612Driver::CHANNEL_B);
+  TEST_ASSERT_EQUAL(2, driver.userCount());
+
+  driver.release(Tb6612Driver::CHANNEL_A);
+  TEST_ASSERT_TRUE(hal.pinLevel(stby));
+  driver.release(Tb6612Driver::CHANNEL_A);  // Twice still counts once
+  TEST_ASSERT_EQUAL(1, driver.userCount());
+  TEST_ASSERT_TRUE(hal.pinLevel(stby));
+  driver.release(Tb6612Driver::CHANNEL_B);
+  TEST_ASSERT_TRUE(driver.inStandby());
+  TEST_ASSERT_FALSE(hal.pinLevel(stby));
+}
+
+// The vacuum pump starting and stopping every way it can while the
+// peristaltic pump runs on
+static void test_vacuum_stops_keep_pump_running() {
+  Rig rig;
+  rig.command(TARGET_PUMP, ACTION_FORWARD, 600, 0);
+  size_t from = rig.hal.events().size();
+  uint32_t pumpDuty = rig.hal.pwmDuty(PUMP_CHANNELS[0].ledcChannel);
+  TEST_ASSERT_GREATER_THAN(0, pumpDuty);
+
+  rig.command(TARGET_VACUUM, ACTION_START, 80, 0);
+  rig.command(TARGET_VACUUM, ACTION_STOP, 0, 0);
+  rig.command(TARGET_VACUUM, ACTION_START, 50, 200);
+  rig.runMs(300);  // Timed stop
+  rig.command(TARGET_VACUUM, ACTION_START, 50, 0);
+  rig.command(TARGET_VACUUM, ACTION_EMERGENCY, 0, 0);
+
+  TEST_ASSERT_EQUAL(0, rig.stbyFalls(from));
+  TEST_ASSERT_EQUAL(PUMP_FORWARD, rig.controller.status().pumpState);
+  TEST_ASSERT_EQUAL(pumpDuty, rig.hal.pwmDuty(PUMP_CHANNELS[0].ledcChannel));
+  TEST_ASSERT_TRUE(rig.hal.pinLevel(PUMP_CHANNELS[0].in1Pin));
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(PUMP_CHANNELS[0].in2Pin));
+
+  // The emergency stop left the vacuum motor coasting on its own inputs
+  TEST_ASSERT_EQUAL(VACUUM_STOPPED, rig.controller.status().vacuumState);
+  TEST_ASSERT_EQUAL(0, rig.hal.pwmDuty(VACUUM_CHANNEL.ledcChannel));
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(VACUUM_CHANNEL.in1Pin));
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(VACUUM_CHANNEL.in2Pin));
+  TEST_ASSERT_TRUE(rig.hal.pinLevel(rig.stby));
+
+  rig.command(TARGET_PUMP, ACTION_STOP, 0, 0);
+  rig.runMs(200);  // Past any ramp down
+  TEST_ASSERT_TRUE(rig.driver.inStandby());
+  TEST_ASSERT_FALSE(rig.hal.pinLevel(rig.stby));
+}
+
+static void test_pump_stops_keep_vacuum_running() {
+  Rig rig;
+  rig.command(TARGET_VACUUM, ACTION_START, 70, 0);
+  size_t from = rig.hal.events().size();
+  uint32_t vacuumDuty = rig.hal.pwmDuty(VACUUM_CHANNEL.ledcChannel);
+
+  rig.command(TARGET_PUMP, ACTION_FORWARD, 800, 0);
+  rig.command(TARGET_PUMP, ACTION_STOP, 0, 0);
+  rig.command(TARGET_PUMP, ACTION_REVERSE, 500, 150);
+  rig.runMs(300);  // Timed stop
+
+  TEST_ASSERT_EQUAL(0, rig.stbyFalls(from));
+  TEST_ASSERT_EQUAL(VACUUM_RUNNING, rig.controller.status().vacuumState);
+  TEST_ASSERT_EQUAL(vacuumDuty, rig.hal.pwmDuty(VACUUM_CHANNEL.ledcChannel));
+  TEST_ASSERT_TRUE(rig.hal.pinLevel(VACUUM_CHANNEL.in1Pin));
+}
+
+// Random commands on both motors: after each, STBY is high exactly while
+// either motor is running
+static void test_random_interleaving() {
+  static const CommandAction PUMP_ACTIONS[] = { ACTION_FORWARD, ACTION_REVERSE, ACTION_STOP };
+  static const CommandAction VACUUM_ACTIONS[] = { ACTION_START, ACTION_STOP, ACTION_EMERGENCY };
+  Rig rig;
+  for (int i = 0; i < 2000; i++) {
+    uint32_t durationMs = nextRandom() % 3 == 0 ? 20 + nextRandom() % 200 : 0;
+    if (nextRandom() & 1) {
+      rig.command(TARGET_PUMP, PUMP_ACTIONS[nextRandom() % 3], 100 + nextRandom() % 924, durationMs);
+    } else {
+      rig.command(TARGET_VACUUM, VACUUM_ACTIONS[nextRandom() % 3], 10 + nextRandom() % 71, durationMs);
+    }
+    rig.runMs(20 * (nextRandom() % 5));
+
+    PumpStatus status = rig.controller.status();
+    bool running = status.pumpState != PUMP_STOPPED || status.vacuumState != VACUUM_STOPPED;
+    TEST_ASSERT_EQUAL(running, rig.hal.pinLevel(rig.stby));
+    TEST_ASSERT_EQUAL(!running, rig.driver.inStandby());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reference_count);
+  RUN_TEST(test_vacuum_stops_keep_pump_running);
+  RUN_TEST(test_pump_stops_keep_vacuum_running);
+  RUN_TEST(test_random_interleaving);
+  return UNITY_END();
+}
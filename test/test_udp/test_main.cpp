@@ -0,0 +1,284 @@
+// Binary UDP control (UdpCommandDispatcher) in front of the shared
+// CommandDispatcher and the pumps on SimHal: an emergency stop from UDP
+// stops every motor, as one from the web or the console does, and commands
+// get the web API's limits and defaults.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+#include "command_dispatcher.h"
+#include "pump_command.h"
+#include "udp_dispatcher.h"
+
+static const uint32_t SENDER = 0x0100007F;  // 127.0.0.1
+static const uint16_t SENDER_PORT = 40000;
+
+// Stands in for the control task's queue, as sim_main.cpp does
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  return true;
+}
+
+// A sink whose queue is always full
+static bool rejectAll(void*, const CommandBatch&) {
+  return false;
+}
+
+struct Rig {
+  SimHal hal;
+  PumpManager pumps;
+  VacuumPump vacuum;
+  PumpController controller;
+  ProtocolSequencer sequencer;
+  CommandDispatcher dispatcher;
+  UdpCommandDispatcher udp;
+
+  explicit Rig(CommandSink sink = executeNow)
+    : pumps(hal), vacuum(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL),
+      controller(pumps, vacuum, hal), sequencer(controller, hal),
+      dispatcher(controller, sequencer, sink, &controller), udp(dispatcher) {
+    pumps.makeSafe();
+    vacuum.makeSafe();
+    pumps.begin();
+    vacuum.begin();
+    sequencer.begin();
+  }
+
+  UdpAck send(uint16_t seq, UdpTarget target, UdpAction action, uint16_t speed, uint32_t durationMs) {
+    UdpRequest request = {};
+    request.seq = seq;
+    request.target = target;
+    request.action = action;
+    request.speed = speed;
+    request.durationMs = durationMs;
+    uint8_t packet[UDP_REQUEST_SIZE];
+    uint8_t reply[UDP_ACK_SIZE];
+    encodeUdpRequest(request, packet);
+    UdpAck ack = {};
+    size_t len = udp.handle(SENDER, SENDER_PORT, packet, sizeof(packet), reply, hal.nowUs());
+    TEST_ASSERT_EQUAL(UDP_ACK_SIZE, len);
+    TEST_ASSERT_TRUE(decodeUdpAck(reply, len, ack));
+    logFlush();
+    return ack;
+  }
+
+  void startChannel(uint8_t channel) {
+    PumpCommand command = {};
+    command.target = TARGET_PUMP;
+    command.channel = channel;
+    command.action = ACTION_FORWARD;
+    command.speed = 800;
+    command.hasSpeed = true;
+    command.duration = 60000;
+    command.hasDuration = true;
+    dispatcher.resolve(command, dispatcher.status(), SOURCE_WEB);
+    TEST_ASSERT_TRUE(dispatcher.submit(command));
+    logFlush();
+  }
+
+  void runMs(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 20) {
+      hal.advanceMs(20);
+      controller.service();
+    }
+    logFlush();
+  }
+
+  // The duty a PWM channel was last written, 0 if it never was
+  uint32_t duty(uint8_t ledcChannel) const {
+    uint32_t value = 0;
+    for (size_t i = 0; i < hal.events().size(); i++) {
+      const SimHal::Event& event = hal.events()[i];
+      if (event.kind == SimHal::EVENT_PWM && event.index == ledcChannel) value = event.value;
+    }
+    return value;
+  }
+};
+
+void setUp() {}
+
+void tearDown() {
+  logFlush();
+}
+
+static void assertAllRunning(Rig& rig) {
+  PumpStatus status = rig.controller.status();
+  for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) {
+    TEST_ASSERT_EQUAL(PUMP_FORWARD, status.channels[i].state);
+    TEST_ASSERT_NOT_EQUAL(0, rig.duty(PUMP_CHANNELS[i].ledcChannel));
+  }
+  TEST_ASSERT_EQUAL(VACUUM_RUNNING, status.vacuumState);
+  TEST_ASSERT_NOT_EQUAL(0, rig.duty(VACUUM_CHANNEL.ledcChannel));
+}
+
+static void assertAllStopped(Rig& rig) {
+  PumpStatus status = rig.controller.status();
+  for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) {
+    TEST_ASSERT_EQUAL(PUMP_STOPPED, status.channels[i].state);
+    TEST_ASSERT_EQUAL(0, rig.duty(PUMP_CHANNELS[i].ledcChannel));
+  }
+  TEST_ASSERT_EQUAL(VACUUM_STOPPED, status.vacuumState);
+  TEST_ASSERT_EQUAL(0, rig.duty(VACUUM_CHANNEL.ledcChannel));
+}
+
+// Every pump channel and the vacuum running; an emergency naming either
+// target stops them all
+static void test_emergency_stops_every_channel() {
+  UdpTarget targets[] = { UDP_TARGET_PUMP, UDP_TARGET_VACUUM };
+  for (size_t t = 0; t < 2; t++) {
+    Rig rig;
+    for (uint8_t i = 0; i < PUMP_CHANNEL_COUNT; i++) rig.startChannel(i);
+    TEST_ASSERT_EQUAL(UDP_RESULT_OK, rig.send(1, UDP_TARGET_VACUUM, UDP_ACTION_START, 50, 60000).result);
+    rig.runMs(2000);
+    assertAllRunning(rig);
+
+    UdpAck ack = rig.send(2, targets[t], UDP_ACTION_EMERGENCY, 0, 0);
+    TEST_ASSERT_EQUAL(UDP_RESULT_OK, ack.result);
+    TEST_ASSERT_EQUAL(PUMP_STOPPED, ack.pumpState);
+    TEST_ASSERT_EQUAL(VACUUM_STOPPED, ack.vacuumState);
+    rig.runMs(2000);
+    assertAllStopped(rig);
+  }
+}
+
+// A protocol running when the emergency arrives is stopped too, so its
+// next step can't restart a pump
+static void test_emergency_stops_running_protocol() {
+  Rig rig;
+  Protocol protocol = {};
+  strcpy(protocol.name, "udp");
+  protocol.stepCount = 2;
+  protocol.steps[0].target = TARGET_PUMP;
+  protocol.steps[0].action = ACTION_FORWARD;
+  protocol.steps[0].speed = 600;
+  protocol.steps[0].durationMs = 1000;
+  protocol.steps[1] = protocol.steps[0];
+  TEST_ASSERT_TRUE(rig.sequencer.start(protocol));
+  rig.runMs(500);
+  TEST_ASSERT_TRUE(rig.sequencer.progress().active);
+
+  TEST_ASSERT_EQUAL(UDP_RESULT_OK, rig.send(3, UDP_TARGET_PUMP, UDP_ACTION_EMERGENCY, 0, 0).result);
+  rig.runMs(3000);
+  TEST_ASSERT_FALSE(rig.sequencer.progress().active);
+  assertAllStopped(rig);
+}
+
+// With the queue full the emergency is answered busy and not remembered,
+// so the sender's retry is tried again rather than replayed
+static void test_busy_emergency_is_retried() {
+  Rig rig(rejectAll);
+  UdpAck ack = rig.send(4, UDP_TARGET_PUMP, UDP_ACTION_EMERGENCY, 0, 0);
+  TEST_ASSERT_EQUAL(UDP_RESULT_BUSY, ack.result);
+  ack = rig.send(4, UDP_TARGET_PUMP, UDP_ACTION_EMERGENCY, 0, 0);
+  TEST_ASSERT_EQUAL(UDP_RESULT_BUSY, ack.result);
+  TEST_ASSERT_EQUAL(0, ack.flags & UDP_FLAG_REPLAYED);
+  TEST_ASSERT_EQUAL_UINT32(0, rig.udp.replayedCount());
+}
+
+// What a request leaves the motor doing, to compare front ends by
+struct Outcome {
+  uint8_t state;
+  uint16_t speed;
+  bool timedRun;
+  uint32_t durationMs;
+};
+
+static Outcome pumpOutcome(Rig& rig) {
+  PumpStatus status = rig.controller.status();
+  Outcome outcome = { (uint8_t)status.pumpState, status.pumpSpeed, status.pumpTimedRun, status.pumpRunDurationMs };
+  return outcome;
+}
+
+static Outcome vacuumOutcome(Rig& rig) {
+  PumpStatus status = rig.controller.status();
+  Outcome outcome = { (uint8_t)status.vacuumState, status.vacuumSpeed, status.vacuumTimedRun,
+                      status.vacuumRunDurationMs };
+  return outcome;
+}
+
+// The same request as JSON to /api/control or /api/vacuum: parsed and
+// resolved the way WebServerManager::readCommand does
+static void sendWeb(Rig& rig, CommandTarget target, const char* json) {
+  PumpCommand command;
+  TEST_ASSERT_EQUAL(CMD_OK, parsePumpCommand(json, strlen(json), target, command));
+  rig.dispatcher.resolve(command, rig.dispatcher.status(), SOURCE_WEB);
+  TEST_ASSERT_TRUE(rig.dispatcher.submit(command));
+  logFlush();
+}
+
+static void assertSameOutcome(const Outcome& web, const Outcome& udp, const char* what) {
+  TEST_ASSERT_EQUAL_MESSAGE(web.state, udp.state, what);
+  TEST_ASSERT_EQUAL_MESSAGE(web.speed, udp.speed, what);
+  TEST_ASSERT_EQUAL_MESSAGE(web.timedRun, udp.timedRun, what);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(web.durationMs, udp.durationMs, what);
+}
+
+// Speeds and durations in and out of range, including none: a UDP request
+// and the equivalent web request leave the motor in the same state. A
+// duration of 0 is the channel's default run length, never an untimed run.
+static void test_limits_and_defaults_match_web() {
+  struct Case {
+    uint16_t speed;
+    uint32_t durationMs;
+  };
+  const Case pumpCases[] = {
+    { 600, 2500 }, { 600, 0 }, { 20, 1000 }, { 1023, 1 }, { 5000, 1000 }, { 600, 400000 }
+  };
+  for (size_t i = 0; i < sizeof(pumpCases) / sizeof(pumpCases[0]); i++) {
+    const Case& c = pumpCases[i];
+    char json[96], what[48];
+    if (c.durationMs > 0) {
+      snprintf(json, sizeof(json), "{\"action\": \"forward\", \"speed\": %u, \"durationMs\": %lu}", c.speed,
+               (unsigned long)c.durationMs);
+    } else {
+      snprintf(json, sizeof(json), "{\"action\": \"forward\", \"speed\": %u}", c.speed);
+    }
+    snprintf(what, sizeof(what), "pump speed %u duration %lu", c.speed, (unsigned long)c.durationMs);
+
+    Rig web, udp;
+    sendWeb(web, TARGET_PUMP, json);
+    TEST_ASSERT_EQUAL(UDP_RESULT_OK, udp.send(10, UDP_TARGET_PUMP, UDP_ACTION_FORWARD, c.speed, c.durationMs).result);
+    assertSameOutcome(pumpOutcome(web), pumpOutcome(udp), what);
+    TEST_ASSERT_TRUE_MESSAGE(pumpOutcome(udp).timedRun, what);
+  }
+
+  // Percent on the wire against the web API's 0-1023 scale
+  const Case vacuumCases[] = { { 50, 3000 }, { 5, 3000 }, { 100, 0 }, { 250, 1000 } };
+  for (size_t i = 0; i < sizeof(vacuumCases) / sizeof(vacuumCases[0]); i++) {
+    const Case& c = vacuumCases[i];
+    uint32_t raw = c.speed >= 100 ? 1023 : (c.speed * 1023 + 99) / 100;
+    char json[96], what[48];
+    if (c.durationMs > 0) {
+      snprintf(json, sizeof(json), "{\"action\": \"start\", \"speed\": %lu, \"durationMs\": %lu}",
+               (unsigned long)raw, (unsigned long)c.durationMs);
+    } else {
+      snprintf(json, sizeof(json), "{\"action\": \"start\", \"speed\": %lu}", (unsigned long)raw);
+    }
+    snprintf(what, sizeof(what), "vacuum %u %% duration %lu", c.speed, (unsigned long)c.durationMs);
+
+    Rig web, udp;
+    sendWeb(web, TARGET_VACUUM, json);
+    TEST_ASSERT_EQUAL(UDP_RESULT_OK, udp.send(11, UDP_TARGET_VACUUM, UDP_ACTION_START, c.speed, c.durationMs).result);
+    assertSameOutcome(vacuumOutcome(web), vacuumOutcome(udp), what);
+  }
+
+  Rig rig;
+  TEST_ASSERT_EQUAL(UDP_RESULT_OK, rig.send(12, UDP_TARGET_VACUUM, UDP_ACTION_START, 50, 1000).result);
+  TEST_ASSERT_EQUAL(50, rig.controller.status().vacuumSpeed);
+  TEST_ASSERT_EQUAL(UDP_RESULT_BAD_COMMAND, rig.send(13, UDP_TARGET_VACUUM, UDP_ACTION_FORWARD, 50, 0).result);
+  TEST_ASSERT_EQUAL(UDP_RESULT_BAD_COMMAND, rig.send(14, UDP_TARGET_PUMP, UDP_ACTION_START, 50, 0).result);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_emergency_stops_every_channel);
+  RUN_TEST(test_emergency_stops_running_protocol);
+  RUN_TEST(test_busy_emergency_is_retried);
+  RUN_TEST(test_limits_and_defaults_match_web);
+  return UNITY_END();
+}
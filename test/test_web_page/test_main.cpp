@@ -0,0 +1,28 @@
+// The control page (web_page.cpp): the embedded asset is a well-formed
+// gzip stream. What serving it costs against the page the web server
+// generated before is measured through HttpServer in test_http_server.
+#include <unity.h>
+#include "web_page.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+// RFC 1952: magic, deflate, and a trailer whose length field is the page's
+// size before compression
+static void test_asset_is_gzip() {
+  TEST_ASSERT_GREATER_THAN(18, INDEX_HTML_GZ_LEN);
+  TEST_ASSERT_EQUAL_HEX8(0x1f, INDEX_HTML_GZ[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x8b, INDEX_HTML_GZ[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x08, INDEX_HTML_GZ[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, INDEX_HTML_GZ[3] & 0xE0);  // Reserved flags
+  const uint8_t* trailer = INDEX_HTML_GZ + INDEX_HTML_GZ_LEN - 4;
+  uint32_t originalSize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+  TEST_ASSERT_GREATER_THAN(INDEX_HTML_GZ_LEN, originalSize);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_asset_is_gzip);
+  return UNITY_END();
+}
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Compress web/index.html and embed it as a PROGMEM array in src/web_page.cpp.
+
+Run this after editing anything under web/:
+
+    python3 tools/embed_web.py
+"""
+import gzip
+import os
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "web", "index.html")
+OUTPUT = os.path.join(ROOT, "src", "web_page.cpp")
+BYTES_PER_LINE = 16
+
+
+def main():
+    with open(SOURCE, "rb") as f:
+        html = f.read()
+    # mtime=0 keeps the output reproducible so the generated file only
+    # changes when the page itself changes.
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+
+    lines = []
+    for i in range(0, len(data), BYTES_PER_LINE):
+        chunk = data[i:i + BYTES_PER_LINE]
+        lines.append("  " + ", ".join("0x%02x" % b for b in chunk) + ",")
+
+    with open(OUTPUT, "w", newline="\n") as f:
+        f.write("// Generated by tools/embed_web.py from web/index.html - do not edit.\n")
+        f.write("// Original size: %d bytes, gzip size: %d bytes\n" % (len(html), len(data)))
+        f.write('#include "web_page.h"\n\n')
+        f.write("const uint8_t INDEX_HTML_GZ[] PROGMEM = {\n")
+        f.write("\n".join(lines) + "\n")
+        f.write("};\n\n")
+        f.write("const size_t INDEX_HTML_GZ_LEN = sizeof(INDEX_HTML_GZ);\n")
+
+    print("Embedded %s: %d -> %d bytes" % (os.path.relpath(SOURCE, ROOT), len(html), len(data)))
+
+
+if __name__ == "__main__":
+    main()
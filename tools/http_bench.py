@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Measure request throughput and latency of the device's HTTP server.
+
+N concurrent clients request a path back to back for a fixed time, either
+opening a new connection per request or reusing one (keep-alive). Run the
+same sweep against two firmware builds to compare servers:
+
+    python3 tools/http_bench.py 192.168.1.50 --clients 1 2 4 6
+    python3 tools/http_bench.py 192.168.1.50 --clients 1 2 4 6 --keep-alive
+
+Only the standard library is used.
+"""
+import argparse
+import asyncio
+import time
+
+
+async def read_response(reader, timeout):
+    head = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), timeout)
+    length = 0
+    close = head.startswith(b"HTTP/1.0")
+    for line in head.split(b"\r\n")[1:]:
+        name, _, value = line.partition(b":")
+        name = name.strip().lower()
+        if name == b"content-length":
+            length = int(value)
+        elif name == b"connection" and b"close" in value.lower():
+            close = True
+    if length:
+        await asyncio.wait_for(reader.readexactly(length), timeout)
+    return close
+
+
+async def client(args, latencies, counts, stop):
+    request = ("GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n"
+               % (args.path, args.host, "" if args.keep_alive else "Connection: close\r\n")).encode()
+    writer = None
+    while not stop.is_set():
+        start = time.monotonic()
+        try:
+            if writer is None:
+                reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, 80), args.timeout)
+            writer.write(request)
+            await writer.drain()
+            close = await read_response(reader, args.timeout)
+            latencies.append((time.monotonic() - start) * 1000)
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError):
+            counts["errors"] += 1
+            close = True
+        if close or not args.keep_alive:
+            if writer is not None:
+                writer.close()
+            writer = None
+    if writer is not None:
+        writer.close()
+
+
+async def run(args, clients):
+    latencies = []
+    counts = {"errors": 0}
+    stop = asyncio.Event()
+    running = [asyncio.ensure_future(client(args, latencies, counts, stop)) for _ in range(clients)]
+    await asyncio.sleep(args.seconds)
+    stop.set()
+    await asyncio.wait(running, timeout=args.timeout + 1)
+
+    latencies.sort()
+    if not latencies:
+        print("%3d clients: every request failed" % clients)
+        return
+
+    def percentile(p):
+        return latencies[min(len(latencies) - 1, int(len(latencies) * p))]
+
+    print("%3d clients: %7.1f req/s  p50 %6.1f ms  p99 %6.1f ms  max %6.1f ms  errors %d"
+          % (clients, len(latencies) / args.seconds, percentile(0.50), percentile(0.99),
+             latencies[-1], counts["errors"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("host")
+    parser.add_argument("--path", default="/api/status")
+    parser.add_argument("--clients", type=int, nargs="+", default=[1, 2, 4, 6])
+    parser.add_argument("--keep-alive", action="store_true")
+    parser.add_argument("--seconds", type=int, default=20)
+    parser.add_argument("--timeout", type=float, default=5)
+    args = parser.parse_args()
+
+    print("%s%s, %s" % (args.host, args.path, "keep-alive" if args.keep_alive else "connection per request"))
+    for clients in args.clients:
+        asyncio.run(run(args, clients))
+
+
+if __name__ == "__main__":
+    main()
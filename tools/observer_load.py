@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Compare dashboard observers that poll /api/status with ones that use the
+/api/events push stream, against a real device.
+
+Each run opens N observers of one kind for a fixed time while a probe
+measures how long /api/status takes to answer - the latency a control
+command would see. Run it for increasing N in both modes to find where
+the device stops keeping up:
+
+    python3 tools/observer_load.py 192.168.1.50 --mode poll --observers 4
+    python3 tools/observer_load.py 192.168.1.50 --mode sse --observers 4
+
+Only the standard library is used.
+"""
+import argparse
+import asyncio
+import statistics
+import time
+
+
+async def http_get(host, path, timeout):
+    reader, writer = await asyncio.wait_for(asyncio.open_connection(host, 80), timeout)
+    try:
+        writer.write(("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n" % (path, host)).encode())
+        await writer.drain()
+        return await asyncio.wait_for(reader.read(), timeout)
+    finally:
+        writer.close()
+
+
+async def poller(host, interval, stats, stop):
+    while not stop.is_set():
+        try:
+            await http_get(host, "/api/status", 5)
+            stats["updates"] += 1
+        except (OSError, asyncio.TimeoutError):
+            stats["errors"] += 1
+        await asyncio.sleep(interval)
+
+
+async def subscriber(host, interval_ms, stats, stop):
+    try:
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(host, 80), 5)
+    except (OSError, asyncio.TimeoutError):
+        stats["errors"] += 1
+        return
+    writer.write(("GET /api/events?interval=%d HTTP/1.1\r\nHost: %s\r\n\r\n" % (interval_ms, host)).encode())
+    await writer.drain()
+    try:
+        while not stop.is_set():
+            line = await asyncio.wait_for(reader.readline(), 20)
+            if not line:
+                stats["errors"] += 1
+                break
+            if line.startswith(b"data:"):
+                stats["updates"] += 1
+    except (OSError, asyncio.TimeoutError):
+        stats["errors"] += 1
+    finally:
+        writer.close()
+
+
+async def probe(host, latencies, stop):
+    while not stop.is_set():
+        start = time.monotonic()
+        try:
+            await http_get(host, "/api/status", 5)
+            latencies.append((time.monotonic() - start) * 1000)
+        except (OSError, asyncio.TimeoutError):
+            latencies.append(float("inf"))
+        await asyncio.sleep(0.5)
+
+
+async def run(args):
+    stats = {"updates": 0, "errors": 0}
+    latencies = []
+    stop = asyncio.Event()
+    if args.mode == "poll":
+        tasks = [poller(args.host, args.interval / 1000.0, stats, stop) for _ in range(args.observers)]
+    else:
+        tasks = [subscriber(args.host, args.interval, stats, stop) for _ in range(args.observers)]
+    tasks.append(probe(args.host, latencies, stop))
+
+    running = [asyncio.ensure_future(t) for t in tasks]
+    await asyncio.sleep(args.seconds)
+    stop.set()
+    await asyncio.wait(running, timeout=25)
+
+    finite = sorted(l for l in latencies if l != float("inf"))
+    print("mode=%s observers=%d seconds=%d" % (args.mode, args.observers, args.seconds))
+    print("  observer updates: %d (%.1f/s), errors: %d"
+          % (stats["updates"], stats["updates"] / args.seconds, stats["errors"]))
+    if finite:
+        p95 = finite[min(len(finite) - 1, int(len(finite) * 0.95))]
+        print("  probe latency ms: median %.0f, p95 %.0f, max %.0f, failed %d"
+              % (statistics.median(finite), p95, finite[-1], len(latencies) - len(finite)))
+    else:
+        print("  probe failed every request")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("host")
+    parser.add_argument("--mode", choices=["poll", "sse"], default="sse")
+    parser.add_argument("--observers", type=int, default=4)
+    parser.add_argument("--interval", type=int, default=1000, help="poll period / max event rate in ms")
+    parser.add_argument("--seconds", type=int, default=30)
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,192 @@
+// Host comparison of the old fixed-period main loop (delay(10) per pass)
+// with the event-driven Scheduler, on simulated time (SimHal).
+//
+// Both run the same main loop work against the real PumpController and
+// EventLog: idle-connection housekeeping, one live status observer at the
+// default 250 ms interval, and event log flushes. Commands arrive at random
+// (mean gap 2 s) from "another task", the way the control task applies
+// them. Reported per mode: the average and worst time from a command to
+// the observer's status push, loop wakeups per second, and CPU duty from a
+// fixed cost per wakeup and per job (see the constants; they are
+// estimates for the ESP32-S3 at 240 MHz, not measurements).
+//
+// Build from the repository root (one command):
+//
+//   g++ -std=gnu++11 -O2 -DLOG_LEVEL=LOG_LEVEL_WARN -Iinclude tools/scheduler_sim.cpp
+//       src/scheduler.cpp src/metrics.cpp src/event_log.cpp src/pump_controller.cpp
+//       src/tb6612.cpp src/pump.cpp src/pump_manager.cpp src/ramp.cpp src/speed_loop.cpp src/vacuum_pump.cpp
+//       src/pressure_monitor.cpp
+//       src/flow_calibration.cpp src/pump_command.cpp src/json_reader.cpp src/hal_sim.cpp src/logger.cpp
+//       -o scheduler_sim
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "event_log.h"
+#include "scheduler.h"
+
+static const uint32_t SIM_SECONDS = 600;
+static const uint32_t MEAN_COMMAND_GAP_MS = 2000;
+static const uint32_t OBSERVER_INTERVAL_MS = 250;
+static const uint32_t OLD_LOOP_DELAY_MS = 10;
+
+// Modeled CPU cost, in us
+static const uint32_t WAKEUP_COST_US = 15;        // Context switch, tick and scheduler pass
+static const uint32_t CONNECTIONS_COST_US = 5;    // Scan of the connection slots
+static const uint32_t POLL_COST_US = 20;          // Status snapshot and delta check
+static const uint32_t PUSH_COST_US = 120;         // Delta JSON and TCP write
+
+struct Workload {
+  SimHal* hal;
+  PumpController* controller;
+  HalTimer commandTimer;
+  uint32_t commandCount;
+
+  // The observer
+  bool changed;
+  uint64_t changedUs;
+  uint64_t lastPushUs;
+  uint32_t pushes;
+  uint64_t latencySumUs;
+  uint64_t latencyMaxUs;
+
+  uint64_t busyUs;
+};
+
+static void spend(Workload& w, uint32_t us) {
+  w.busyUs += us;
+  w.hal->delayUs(us);
+}
+
+static void armNextCommand(Workload& w) {
+  // Exponential gaps: commands arrive independently of each other
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  uint64_t gapUs = (uint64_t)(-log(u) * MEAN_COMMAND_GAP_MS * 1000);
+  w.hal->startTimerOnce(w.commandTimer, gapUs > 0 ? gapUs : 1);
+}
+
+static void onCommand(void* arg) {
+  Workload& w = *static_cast<Workload*>(arg);
+  PumpCommand command = {};
+  command.target = TARGET_PUMP;
+  command.action = (w.commandCount++ % 2 == 0) ? ACTION_FORWARD : ACTION_STOP;
+  command.speed = 600;
+  command.source = SOURCE_WEB;
+  w.controller->execute(command);
+  if (!w.changed) {
+    w.changed = true;
+    w.changedUs = w.hal->nowUs();
+  }
+  armNextCommand(w);
+}
+
+// The observer poll: push a pending change once the interval allows it
+static uint32_t pollObserver(Workload& w) {
+  spend(w, POLL_COST_US);
+  uint64_t now = w.hal->nowUs();
+  uint64_t sinceUs = now - w.lastPushUs;
+  if (w.changed && sinceUs >= OBSERVER_INTERVAL_MS * 1000ULL) {
+    spend(w, PUSH_COST_US);
+    uint64_t latency = now - w.changedUs;
+    w.latencySumUs += latency;
+    if (latency > w.latencyMaxUs) w.latencyMaxUs = latency;
+    w.pushes++;
+    w.changed = false;
+    w.lastPushUs = now;
+    return OBSERVER_INTERVAL_MS;
+  }
+  return sinceUs < OBSERVER_INTERVAL_MS * 1000ULL
+    ? (uint32_t)((OBSERVER_INTERVAL_MS * 1000ULL - sinceUs + 999) / 1000)
+    : OBSERVER_INTERVAL_MS;
+}
+
+struct Jobs {
+  Workload* w;
+  EventLog* log;
+  Scheduler* scheduler;
+  Scheduler::JobId events;
+  Scheduler::JobId flush;
+};
+
+static uint32_t runConnections(void* arg) {
+  spend(*static_cast<Jobs*>(arg)->w, CONNECTIONS_COST_US);
+  return 1000;
+}
+static uint32_t runEvents(void* arg) { return pollObserver(*static_cast<Jobs*>(arg)->w); }
+static uint32_t runLog(void* arg) { return static_cast<Jobs*>(arg)->log->service(); }
+static void wakeEvents(void* arg) {
+  Jobs* jobs = static_cast<Jobs*>(arg);
+  jobs->scheduler->wake(jobs->events);
+}
+static void wakeLog(void* arg) {
+  Jobs* jobs = static_cast<Jobs*>(arg);
+  jobs->scheduler->wake(jobs->flush);
+}
+
+static void report(const char* mode, const Workload& w, uint32_t wakeups, uint64_t elapsedUs) {
+  double seconds = elapsedUs / 1e6;
+  printf("%-10s commands %4u  push latency avg %7.2f ms max %7.2f ms  wakeups/s %6.1f  CPU duty %.3f%%\n",
+         mode, w.commandCount, w.pushes ? w.latencySumUs / 1000.0 / w.pushes : 0.0, w.latencyMaxUs / 1000.0,
+         wakeups / seconds, 100.0 * w.busyUs / elapsedUs);
+}
+
+static void simulate(bool useScheduler) {
+  srand(1);  // Same command arrivals in both modes
+  SimHal hal;
+  hal.setLogFlashSize(64 * LOG_FLASH_SECTOR_SIZE);
+  PumpManager pumps(hal);
+  VacuumPump vacuumPump(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL);
+  PumpController controller(pumps, vacuumPump, hal);
+  EventLog eventLog(hal);
+  Scheduler scheduler(hal);
+  pumps.makeSafe();
+  pumps.begin();
+  vacuumPump.begin();
+  eventLog.begin();
+  controller.setEventLog(&eventLog);
+
+  Workload w = {};
+  w.hal = &hal;
+  w.controller = &controller;
+  w.commandTimer = hal.createTimer(onCommand, &w, "command");
+  armNextCommand(w);
+  Jobs jobs = { &w, &eventLog, &scheduler, -1, -1 };
+
+  uint64_t start = hal.nowUs();
+  uint64_t end = start + SIM_SECONDS * 1000000ULL;
+  uint32_t wakeups = 0;
+
+  if (useScheduler) {
+    scheduler.add("connections", runConnections, &jobs, 1000);
+    jobs.events = scheduler.add("events", runEvents, &jobs, 0);
+    jobs.flush = scheduler.add("event_log", runLog, &jobs, 0);
+    controller.setCommandListener(wakeEvents, &jobs);
+    eventLog.setWakeListener(wakeLog, &jobs);
+    while (hal.nowUs() < end) {
+      spend(w, WAKEUP_COST_US);
+      scheduler.run();
+      wakeups++;
+    }
+  } else {
+    // The old loop(): everything polled, then delay(10)
+    while (hal.nowUs() < end) {
+      spend(w, WAKEUP_COST_US + CONNECTIONS_COST_US);
+      pollObserver(w);
+      eventLog.service();
+      hal.delayMs(OLD_LOOP_DELAY_MS);
+      wakeups++;
+    }
+  }
+  logFlush();
+  report(useScheduler ? "scheduler" : "delay(10)", w, wakeups, hal.nowUs() - start);
+}
+
+int main() {
+  simulate(false);
+  simulate(true);
+  return 0;
+}
@@ -0,0 +1,251 @@
+// Host model of a peristaltic head on a DC gearmotor, for tuning the
+// closed-loop speed control (SpeedLoop) and catching regressions in it.
+//
+// The real PeristalticPump and Tb6612Driver run on SimHal. The model reads
+// the bridge pins and the LEDC duty they leave, integrates the motor and the
+// tube load in 50 us steps, and feeds encoder edges back into the simulated
+// pulse counter. Each scenario runs twice: open loop (no encoder in the
+// channel config) and closed loop. A flow calibration made under nominal
+// conditions absorbs any constant error, so the open loop column is drift
+// from its own nominal speed; the closed loop one is error against the
+// speed asked for. Settling and overshoot are judged on the speed averaged
+// over each roller pitch: the speed ripples as each roller occludes, but
+// the volume delivered per pitch is what a dose adds up.
+//
+// Exits 1 when the closed loop misses a limit (see the constants), so it
+// can gate changes to the loop or its gains. The motor constants are a
+// typical 12 V, 30:1 gearmotor with an 11-pulse hall encoder, referred to
+// the head; they are representative, not measured.
+//
+// Build from the repository root (one command):
+//
+//   g++ -std=gnu++11 -O2 -DLOG_LEVEL=LOG_LEVEL_WARN -Iinclude tools/speed_loop_sim.cpp
+//       src/pump.cpp src/tb6612.cpp src/ramp.cpp src/speed_loop.cpp src/metrics.cpp
+//       src/hal_sim.cpp src/logger.cpp -o speed_loop_sim
+#include <math.h>
+#include <stdio.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump.h"
+#include "tb6612.h"
+
+static const DriverConfig SIM_DRIVER = { 10 };
+static const EncoderConfig SIM_ENCODER = { 17, 0, 330, 120, 1.5f, 8.0f };
+
+static const uint32_t STEP_US = 50;
+static const uint32_t RUN_MS = 5000;
+static const uint32_t DISTURB_MS = 2000;   // When a scenario's disturbance hits
+static const uint32_t TAIL_MS = 3000;      // Steady state is the mean from here to the end
+
+// Closed loop limits
+static const float MAX_ERROR_PCT = 1.5f;
+static const float MAX_OVERSHOOT_PCT = 5.0f;
+static const uint32_t MAX_SETTLE_PITCHES = 3;  // Roller pitches out of the band, from start or disturbance
+static const float SETTLE_BAND_PCT = 2.0f;
+
+// DC motor and tube, head-referred (gearbox included)
+struct MotorModel {
+  float supplyV;
+  float resistance;  // Ohm
+  float ke;          // V s/rad, and N m/A
+  float inertia;     // kg m^2
+  float viscous;     // N m s/rad
+  float tubeTorque;  // N m to turn a nominal tube
+  float stiffness;   // Tube stiffness relative to nominal: softer when warm, stiffer when cold or new
+  float ripple;      // Load variation as each roller occludes
+  uint8_t rollers;
+  float omega;       // rad/s
+  float angle;       // rad, unwrapped
+  float edgeAccum;
+
+  MotorModel()
+    : supplyV(12.0f), resistance(4.0f), ke(0.573f), inertia(0.0025f), viscous(0.001f),
+      tubeTorque(0.4f), stiffness(1.0f), ripple(0.25f), rollers(3), omega(0), angle(0), edgeAccum(0) {}
+
+  // One step with the bridge as the pins leave it. Returns encoder edges.
+  uint32_t step(SimHal& hal, const ChannelConfig& config, float dt) {
+    bool stby = hal.pinLevel(SIM_DRIVER.stbyPin);
+    bool in1 = hal.pinLevel(config.in1Pin);
+    bool in2 = hal.pinLevel(config.in2Pin);
+    float duty = (float)hal.pwmDuty(config.ledcChannel) / ((1 << config.pwmRes) - 1);
+
+    // The TB6612 short-brakes in the PWM off phase, so a driven winding
+    // sees the duty-averaged supply
+    float current = 0.0f;
+    if (stby && in1 != in2) {
+      float volts = (in1 ? 1.0f : -1.0f) * duty * supplyV;
+      current = (volts - ke * omega) / resistance;
+    } else if (stby && in1 && in2) {
+      current = -ke * omega / resistance;
+    }
+    float drive = ke * current - viscous * omega;
+    float load = tubeTorque * stiffness * (1.0f + ripple * sinf(rollers * angle));
+
+    if (fabsf(omega) < 1e-3f && fabsf(drive) <= load) {
+      omega = 0.0f;  // Held by the occlusion
+    } else {
+      float direction = omega != 0.0f ? (omega > 0 ? 1.0f : -1.0f) : (drive > 0 ? 1.0f : -1.0f);
+      float next = omega + (drive - direction * load) / inertia * dt;
+      // Friction stops the head; it doesn't turn it back
+      omega = (next * direction < 0.0f) ? 0.0f : next;
+    }
+    angle += omega * dt;
+    edgeAccum += fabsf(omega) * dt * SIM_ENCODER.pulsesPerRev / (2.0f * (float)M_PI);
+    uint32_t edges = (uint32_t)edgeAccum;
+    edgeAccum -= edges;
+    return edges;
+  }
+};
+
+enum Disturbance {
+  DISTURB_NONE,
+  DISTURB_LOAD,     // Tube stiffness steps from the scenario's value to `to`
+  DISTURB_SUPPLY,   // Supply steps to `to` volts
+  DISTURB_ENCODER   // Encoder unplugged
+};
+
+struct Scenario {
+  const char* name;
+  uint16_t speed;
+  float supplyV;
+  float stiffness;
+  Disturbance disturbance;
+  float to;
+  RampShape ramp;
+};
+
+struct RunResult {
+  float rpm;            // Mean over the whole pitches after TAIL_MS
+  float peakRpm;        // Fastest roller pitch before any disturbance
+  uint32_t settlePitches;  // Last pitch out of the band, counted from start or the disturbance
+  uint32_t finalDuty;
+  SpeedControl control;
+};
+
+static RunResult run(const Scenario& s, bool closedLoop, float targetRpm) {
+  SimHal hal;
+  ChannelConfig config = { 13, 11, 12, 2, 20000, 10, 0, 0, closedLoop ? SIM_ENCODER : NO_ENCODER };
+  Tb6612Driver driver(hal, SIM_DRIVER);
+  PeristalticPump pump(hal, driver, config, 0);
+  driver.makeSafe();
+  pump.begin();
+  if (s.ramp != RAMP_OFF) {
+    RampConfig ramp = { s.ramp, 500 };
+    pump.setRampConfig(ramp);
+  }
+
+  MotorModel motor;
+  motor.supplyV = s.supplyV;
+  motor.stiffness = s.stiffness;
+  bool encoderConnected = true;
+  pump.controlPump(PUMP_FORWARD, s.speed, 0);
+
+  RunResult result = {};
+  const float pitch = 2.0f * (float)M_PI / motor.rollers;
+  float nextPitch = pitch;
+  uint32_t pitchStartUs = 0;
+  float tailAngle = -1.0f;
+  uint32_t tailUs = 0;
+  float endAngle = 0.0f;
+  uint32_t endUs = 0;
+  uint32_t pitches = 0;
+  uint32_t disturbPitch = 0;
+  uint32_t lastOutside = 0;
+  for (uint32_t t = 0; t < RUN_MS * 1000; t += STEP_US) {
+    uint32_t ms = t / 1000;
+    if (t == DISTURB_MS * 1000) {
+      if (s.disturbance == DISTURB_LOAD) motor.stiffness = s.to;
+      if (s.disturbance == DISTURB_SUPPLY) motor.supplyV = s.to;
+      if (s.disturbance == DISTURB_ENCODER) encoderConnected = false;
+      disturbPitch = pitches;
+    }
+    if (motor.angle >= nextPitch) {
+      float pitchRpm = 60e6f / (motor.rollers * (float)(t - pitchStartUs));
+      if (ms <= DISTURB_MS && pitchRpm > result.peakRpm) result.peakRpm = pitchRpm;
+      pitches++;
+      if (fabsf(pitchRpm - targetRpm) > targetRpm * SETTLE_BAND_PCT / 100.0f) lastOutside = pitches;
+      pitchStartUs = t;
+      nextPitch += pitch;
+      if (ms >= TAIL_MS && tailAngle < 0.0f) {
+        tailAngle = motor.angle;
+        tailUs = t;
+      }
+      endAngle = motor.angle;
+      endUs = t;
+    }
+
+    uint32_t edges = motor.step(hal, config, STEP_US * 1e-6f);
+    if (closedLoop && encoderConnected && edges > 0) hal.addPulses(SIM_ENCODER.pcntUnit, edges);
+    hal.advanceUs(STEP_US);
+  }
+  logFlush();
+
+  if (tailAngle >= 0.0f && endUs > tailUs) {
+    result.rpm = (endAngle - tailAngle) / ((endUs - tailUs) * 1e-6f) * 60.0f / (2.0f * (float)M_PI);
+  }
+  uint32_t from = s.disturbance != DISTURB_NONE ? disturbPitch : 0;
+  result.settlePitches = lastOutside > from ? lastOutside - from : 0;
+  result.finalDuty = hal.pwmDuty(config.ledcChannel);
+  result.control = pump.getSpeedControl();
+  return result;
+}
+
+static const Scenario SCENARIOS[] = {
+  { "nominal 25%",          256, 12.0f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "nominal 50%",          512, 12.0f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "nominal 90%",          921, 12.0f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "supply 10.8 V",        512, 10.8f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "supply 13.2 V",        512, 13.2f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "warm tube",            512, 12.0f, 0.80f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "cold tube",            512, 12.0f, 1.25f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "worst case 90%",       921, 10.8f, 1.25f, DISTURB_NONE,   0.0f,  RAMP_OFF },
+  { "s-curve start",        512, 12.0f, 1.00f, DISTURB_NONE,   0.0f,  RAMP_SCURVE },
+  { "load step +30%",       512, 12.0f, 1.00f, DISTURB_LOAD,   1.30f, RAMP_OFF },
+  { "supply sag to 10.5 V", 512, 12.0f, 1.00f, DISTURB_SUPPLY, 10.5f, RAMP_OFF },
+};
+
+int main() {
+  int failures = 0;
+  printf("%-22s %6s | %8s %7s | %8s %7s %9s %7s\n", "scenario", "target", "open rpm", "drift",
+         "rpm", "error", "overshoot", "pitches");
+
+  // Open loop drift is measured against the nominal run at the same speed
+  float nominalOpen[3] = { 0, 0, 0 };
+  const uint16_t nominalSpeeds[3] = { 256, 512, 921 };
+  for (uint8_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+    const Scenario& s = SCENARIOS[i];
+    float target = (float)s.speed * SIM_ENCODER.maxRpm / 1023;
+    RunResult open = run(s, false, target);
+    RunResult closed = run(s, true, target);
+
+    float reference = 0.0f;
+    for (uint8_t n = 0; n < 3; n++) {
+      if (s.speed != nominalSpeeds[n]) continue;
+      if (nominalOpen[n] == 0.0f) nominalOpen[n] = open.rpm;
+      reference = nominalOpen[n];
+    }
+    float drift = reference > 0 ? (open.rpm - reference) * 100.0f / reference : 0.0f;
+    float error = (closed.rpm - target) * 100.0f / target;
+    float overshoot = closed.peakRpm > target ? (closed.peakRpm - target) * 100.0f / target : 0.0f;
+
+    bool pass = fabsf(error) <= MAX_ERROR_PCT && closed.settlePitches <= MAX_SETTLE_PITCHES &&
+                (s.disturbance != DISTURB_NONE || overshoot <= MAX_OVERSHOOT_PCT) &&
+                closed.control == SPEED_CLOSED_LOOP;
+    printf("%-22s %6.1f | %8.1f %6.1f%% | %8.1f %6.2f%% %8.1f%% %7lu %s\n", s.name, target, open.rpm, drift,
+           closed.rpm, error, overshoot, (unsigned long)closed.settlePitches, pass ? "" : "FAIL");
+    if (!pass) failures++;
+  }
+
+  // A lost encoder must drop the channel back to open loop, not leave the
+  // loop winding the duty up to full
+  Scenario lost = { "encoder lost", 512, 12.0f, 1.00f, DISTURB_ENCODER, 0.0f, RAMP_OFF };
+  RunResult result = run(lost, true, (float)lost.speed * SIM_ENCODER.maxRpm / 1023);
+  bool pass = result.control == SPEED_ENCODER_FAULT && result.finalDuty == lost.speed;
+  printf("%-22s control %s, duty %lu (commanded %u) %s\n", lost.name,
+         result.control == SPEED_ENCODER_FAULT ? "fault" : "closed",
+         (unsigned long)result.finalDuty, lost.speed, pass ? "" : "FAIL");
+  if (!pass) failures++;
+
+  printf("%s\n", failures ? "FAILED" : "all within limits");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+// Reference client for the binary UDP control protocol (include/udp_protocol.h).
+//
+// Build on Linux from the repository root:
+//
+//   g++ -std=gnu++11 -O2 -Iinclude tools/udp_client.cpp src/udp_protocol.cpp -o udp_client
+//
+// Single commands print the ack:
+//
+//   ./udp_client 192.168.1.50 forward 600 2500   # speed, duration ms (0 = default length)
+//   ./udp_client 192.168.1.50 reverse 1023 0
+//   ./udp_client 192.168.1.50 stop
+//   ./udp_client 192.168.1.50 vacuum-start 60 3000
+//   ./udp_client 192.168.1.50 vacuum-stop
+//   ./udp_client 192.168.1.50 emergency
+//   ./udp_client 192.168.1.50 status
+//
+// "bench N [drop%]" sends N commands back to back, each waiting for its ack,
+// and reports the command rate and round-trip latency. drop% ignores that
+// share of first acks, as if they were lost, so the retry is answered with
+// the replayed ack instead of running the command twice. Run it against the
+// device, or against tools/udp_loopback.cpp for the host cost of the
+// dispatcher on its own:
+//
+//   ./udp_client 127.0.0.1:5005 bench 10000 5
+//
+// A command is retried with the same sequence number until acked, so the
+// device applies it once however many copies arrive.
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "udp_protocol.h"
+
+static const int DEFAULT_PORT = 5005;
+static const int RETRY_TIMEOUT_MS = 200;
+static const int MAX_ATTEMPTS = 5;
+
+static const char* const PUMP_STATES[] = {"stopped", "forward", "reverse"};
+static const char* const VACUUM_STATES[] = {"stopped", "running"};
+static const char* const RESULTS[] = {"ok", "busy", "bad command"};
+
+static double nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int openSocket(const char* target) {
+  char host[256];
+  snprintf(host, sizeof(host), "%s", target);
+  int port = DEFAULT_PORT;
+  char* colon = strrchr(host, ':');
+  if (colon != NULL) {
+    *colon = '\0';
+    port = atoi(colon + 1);
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo* addr;
+  if (getaddrinfo(host, NULL, &hints, &addr) != 0) {
+    fprintf(stderr, "Unknown host %s\n", host);
+    return -1;
+  }
+  ((struct sockaddr_in*)addr->ai_addr)->sin_port = htons(port);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  // connect() fixes the peer, so only its datagrams are received
+  if (fd < 0 || connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+    perror("socket");
+    freeaddrinfo(addr);
+    return -1;
+  }
+  freeaddrinfo(addr);
+
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = RETRY_TIMEOUT_MS * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  return fd;
+}
+
+// Send until an ack for this sequence number arrives. Returns the number of
+// attempts, or 0 if there was never an answer.
+static int transact(int fd, const UdpRequest& request, UdpAck& ack, int dropPercent) {
+  uint8_t packet[UDP_REQUEST_SIZE];
+  uint8_t reply[64];
+  encodeUdpRequest(request, packet);
+  bool dropAck = dropPercent > 0 && rand() % 100 < dropPercent;
+
+  for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+    if (send(fd, packet, sizeof(packet), 0) < 0) {
+      perror("send");
+      return 0;
+    }
+    double deadline = nowMs() + RETRY_TIMEOUT_MS;
+    while (nowMs() < deadline) {
+      ssize_t n = recv(fd, reply, sizeof(reply), 0);
+      if (n < 0) break;  // Timed out
+      // Late acks for earlier requests are skipped
+      if (!decodeUdpAck(reply, n, ack) || ack.seq != request.seq) continue;
+      if (!dropAck) return attempt;
+      dropAck = false;
+    }
+  }
+  return 0;
+}
+
+static void printAck(const UdpAck& ack) {
+  printf("seq %u: %s%s\n", ack.seq, ack.result < 3 ? RESULTS[ack.result] : "?",
+         (ack.flags & UDP_FLAG_REPLAYED) ? " (replayed)" : "");
+  printf("  pump   %-8s speed %-4u remaining %lu ms\n", ack.pumpState < 3 ? PUMP_STATES[ack.pumpState] : "?",
+         ack.pumpSpeed, (unsigned long)ack.pumpRemainingMs);
+  printf("  vacuum %-8s speed %-3u%% remaining %lu ms\n", ack.vacuumState < 2 ? VACUUM_STATES[ack.vacuumState] : "?",
+         ack.vacuumSpeed, (unsigned long)ack.vacuumRemainingMs);
+}
+
+static bool parseCommand(int argc, char** argv, UdpRequest& request) {
+  const char* name = argv[0];
+  request.speed = argc > 1 ? (uint16_t)atoi(argv[1]) : 0;
+  request.durationMs = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+  request.target = UDP_TARGET_PUMP;
+  if (strcmp(name, "forward") == 0) request.action = UDP_ACTION_FORWARD;
+  else if (strcmp(name, "reverse") == 0) request.action = UDP_ACTION_REVERSE;
+  else if (strcmp(name, "stop") == 0) request.action = UDP_ACTION_STOP;
+  else if (strcmp(name, "emergency") == 0) request.action = UDP_ACTION_EMERGENCY;
+  else if (strcmp(name, "status") == 0) request.action = UDP_ACTION_STATUS;
+  else if (strcmp(name, "vacuum-start") == 0) request.action = UDP_ACTION_START;
+  else if (strcmp(name, "vacuum-stop") == 0) request.action = UDP_ACTION_STOP;
+  else return false;
+  if (strncmp(name, "vacuum-", 7) == 0) request.target = UDP_TARGET_VACUUM;
+  return true;
+}
+
+static int bench(int fd, uint16_t seq, int count, int dropPercent) {
+  std::vector<double> latencies;
+  latencies.reserve(count);
+  int retries = 0, replayed = 0, failed = 0, rejected = 0;
+
+  double start = nowMs();
+  for (int i = 0; i < count; i++) {
+    // Alternate a timed forward run and a stop
+    UdpRequest request;
+    request.seq = seq++;
+    request.target = UDP_TARGET_PUMP;
+    request.action = (i % 2 == 0) ? UDP_ACTION_FORWARD : UDP_ACTION_STOP;
+    request.speed = (i % 2 == 0) ? 600 : 0;
+    request.durationMs = (i % 2 == 0) ? 1000 : 0;
+
+    UdpAck ack;
+    double sent = nowMs();
+    int attempts = transact(fd, request, ack, dropPercent);
+    if (attempts == 0) {
+      failed++;
+      continue;
+    }
+    latencies.push_back(nowMs() - sent);
+    retries += attempts - 1;
+    if (ack.flags & UDP_FLAG_REPLAYED) replayed++;
+    if (ack.result != UDP_RESULT_OK) rejected++;
+  }
+  double elapsed = nowMs() - start;
+
+  if (latencies.empty()) {
+    printf("no command was acknowledged\n");
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double p50 = latencies[latencies.size() / 2];
+  double p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+  printf("%d commands in %.0f ms: %.0f cmd/s\n", count, elapsed, latencies.size() * 1000.0 / elapsed);
+  printf("round trip ms: p50 %.3f  p99 %.3f  max %.3f\n", p50, p99, latencies.back());
+  printf("retries %d, replayed acks %d, not ok %d, unanswered %d\n", retries, replayed, rejected, failed);
+  return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s HOST[:PORT] COMMAND [SPEED [DURATION_MS]] | bench COUNT [DROP%%]\n", argv[0]);
+    return 2;
+  }
+  int fd = openSocket(argv[1]);
+  if (fd < 0) return 1;
+
+  // A random starting sequence keeps a restarted client from being
+  // mistaken for a retry of its previous run
+  srand((unsigned)time(NULL) ^ (unsigned)getpid());
+  uint16_t seq = (uint16_t)rand();
+
+  if (strcmp(argv[2], "bench") == 0) {
+    int count = argc > 3 ? atoi(argv[3]) : 1000;
+    int drop = argc > 4 ? atoi(argv[4]) : 0;
+    return bench(fd, seq, count, drop);
+  }
+
+  UdpRequest request;
+  request.seq = seq;
+  if (!parseCommand(argc - 2, argv + 2, request)) {
+    fprintf(stderr, "Unknown command %s\n", argv[2]);
+    return 2;
+  }
+  UdpAck ack;
+  if (transact(fd, request, ack, 0) == 0) {
+    fprintf(stderr, "No answer from %s\n", argv[1]);
+    return 1;
+  }
+  printAck(ack);
+  return ack.result == UDP_RESULT_OK ? 0 : 1;
+}
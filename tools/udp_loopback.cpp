@@ -0,0 +1,99 @@
+// Host build of the UDP command dispatcher for benchmarking the protocol
+// without a board. Serves the binary protocol on a local port with the
+// real dispatcher and PumpController driving simulated pumps (SimHal),
+// whose clock follows the wall clock.
+//
+// Build from the repository root (one command):
+//
+//   g++ -std=gnu++11 -O2 -DLOG_LEVEL=LOG_LEVEL_WARN -Iinclude tools/udp_loopback.cpp
+//       src/udp_protocol.cpp src/udp_dispatcher.cpp src/pump_controller.cpp src/tb6612.cpp src/pump.cpp
+//       src/pump_manager.cpp src/ramp.cpp src/vacuum_pump.cpp src/flow_calibration.cpp src/protocol.cpp
+//       src/protocol_sequencer.cpp src/command_dispatcher.cpp src/json_reader.cpp src/pump_command.cpp
+//       src/hal_sim.cpp src/logger.cpp src/metrics.cpp src/speed_loop.cpp
+//       src/pressure_monitor.cpp src/event_log.cpp -lpthread -o udp_loopback
+//
+// then run it and point tools/udp_client.cpp at it:
+//
+//   ./udp_loopback 5005 &
+//   ./udp_client 127.0.0.1:5005 bench 10000
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pump_manager.h"
+#include "vacuum_pump.h"
+#include "pump_controller.h"
+#include "protocol_sequencer.h"
+#include "command_dispatcher.h"
+#include "udp_dispatcher.h"
+
+static uint64_t wallUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool executeNow(void* arg, const CommandBatch& batch) {
+  static_cast<PumpController*>(arg)->executeBatch(batch);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int port = argc > 1 ? atoi(argv[1]) : 5005;
+
+  SimHal hal;
+  PumpManager pumps(hal);
+  VacuumPump vacuumPump(hal, pumps.driver(VACUUM_CHANNEL.driver), VACUUM_CHANNEL);
+  PumpController controller(pumps, vacuumPump, hal);
+  ProtocolSequencer sequencer(controller, hal);
+  CommandDispatcher commands(controller, sequencer, executeNow, &controller);
+  UdpCommandDispatcher dispatcher(commands);
+  pumps.makeSafe();
+  pumps.begin();
+  vacuumPump.begin();
+  sequencer.begin();
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    perror("bind");
+    return 1;
+  }
+  printf("Dispatcher listening on 127.0.0.1:%d\n", port);
+  fflush(stdout);
+
+  uint64_t last = wallUs();
+  uint32_t handled = 0;
+  for (;;) {
+    uint8_t packet[64];
+    uint8_t reply[UDP_ACK_SIZE];
+    struct sockaddr_in peer;
+    socklen_t peerLen = sizeof(peer);
+    ssize_t n = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&peer, &peerLen);
+    if (n < 0) continue;
+
+    // Let timed runs end on schedule between packets
+    uint64_t now = wallUs();
+    hal.advanceUs(now - last);
+    last = now;
+    controller.service();
+
+    size_t len = dispatcher.handle(ntohl(peer.sin_addr.s_addr), ntohs(peer.sin_port), packet, n,
+                                   reply, hal.nowUs());
+    if (len > 0) sendto(fd, reply, len, 0, (struct sockaddr*)&peer, peerLen);
+
+    if (++handled % 1024 == 0) {
+      hal.clearEvents();  // The pin trace is not needed here
+      logFlush();
+    }
+  }
+}
@@ -0,0 +1,283 @@
+// Host model of a vacuum chamber on the diaphragm pump, for tuning the
+// vacuum regulation (VACUUM_SENSOR gains) and checking the gauge interlock.
+//
+// The real VacuumPump, PressureMonitor and Tb6612Driver run on SimHal. The
+// model reads the bridge pins and the LEDC duty they leave, integrates the
+// motor speed and the chamber pressure in 1 ms steps, and sets the gauge's
+// analog input, which SimHal's ADC stream hands to the monitor every
+// reading. The control task's update() runs every 20 ms, as on the board.
+//
+// Regulation scenarios hold a target vacuum in chambers of different sizes
+// and leaks, through a bleed valve opening and a target step; they report
+// the rise time, overshoot and settling (on the true chamber vacuum, not
+// the reading) and the steady error and ripple. Interlock scenarios run the
+// pump open loop into the cutoff, unplug the gauge and stall the ADC, and
+// report how long the motor kept running after the condition arose.
+//
+// Exits 1 when a limit is missed (see the constants), so it can gate
+// changes to the regulator, its gains or the interlock. The pump is a
+// typical 12 V diaphragm pump (6 L/min free air, 93 kPa ultimate vacuum);
+// the constants are representative, not measured.
+//
+// Build from the repository root (one command):
+//
+//   g++ -std=gnu++11 -O2 -DLOG_LEVEL=LOG_LEVEL_WARN -Iinclude tools/vacuum_sim.cpp
+//       src/vacuum_pump.cpp src/pressure_monitor.cpp src/tb6612.cpp src/metrics.cpp
+//       src/hal_sim.cpp src/logger.cpp -o vacuum_sim
+#include <math.h>
+#include <stdio.h>
+#include "hal_sim.h"
+#include "logger.h"
+#include "pressure_monitor.h"
+#include "tb6612.h"
+#include "vacuum_pump.h"
+
+static const uint32_t STEP_US = 1000;
+static const uint32_t UPDATE_MS = 20;   // ControlTask::SERVICE_PERIOD_MS
+static const uint32_t RUN_MS = 40000;
+static const uint32_t EVENT_MS = 20000;  // When a scenario's disturbance hits
+static const uint32_t TAIL_MS = 10000;   // Steady state: the last this many ms
+
+// Regulation limits
+static const float MAX_ERROR_KPA = 0.5f;
+static const float MAX_RIPPLE_KPA = 1.0f;     // Peak to peak
+static const float MAX_OVERSHOOT_KPA = 2.0f;  // Well inside the margin the dispatcher leaves below the cutoff
+static const float MAX_SETTLE_S = 5.0f;       // Last time out of the band, from first reaching it or the event
+static const float SETTLE_BAND_KPA = 1.0f;
+
+// Interlock limits: one reading, plus a step of the model
+static const uint32_t MAX_CUT_US = PressureMonitor::READING_US + STEP_US;
+static const uint32_t MAX_STALE_CUT_US = (PressureMonitor::STALE_MS + UPDATE_MS) * 1000 + STEP_US;
+
+static const float ATM_PA = 101325.0f;
+
+// Chamber, line and pump
+struct ChamberModel {
+  float supplyV;
+  float volumeL;
+  float leakLpm;      // Free air let in, in L/min, with the chamber at full vacuum
+  float freeAirLpm;   // Pump displacement at full speed
+  float ultimatePa;   // Absolute pressure where the pump stops gaining
+  float stallV;       // Below this the motor doesn't turn
+  float lagS;         // Motor speed time constant
+  float speed;        // Fraction of full
+  float pressure;     // Pa absolute
+  bool gaugeUnplugged;
+  uint32_t noiseSeed;
+
+  ChamberModel()
+    : supplyV(12.0f), volumeL(1.0f), leakLpm(0.3f), freeAirLpm(6.0f), ultimatePa(8000.0f), stallV(2.0f),
+      lagS(0.08f), speed(0.0f), pressure(ATM_PA), gaugeUnplugged(false), noiseSeed(12345) {}
+
+  float vacuumPa() const { return ATM_PA - pressure; }
+
+  void step(SimHal& hal, float dt) {
+    bool stby = hal.pinLevel(MOTOR_DRIVERS[VACUUM_CHANNEL.driver].stbyPin);
+    bool in1 = hal.pinLevel(VACUUM_CHANNEL.in1Pin);
+    bool in2 = hal.pinLevel(VACUUM_CHANNEL.in2Pin);
+    float duty = (float)hal.pwmDuty(VACUUM_CHANNEL.ledcChannel) / ((1 << VACUUM_CHANNEL.pwmRes) - 1);
+
+    // A diaphragm pump only pumps one way; anything but forward lets it stop
+    float volts = (stby && in1 && !in2) ? duty * supplyV : 0.0f;
+    float target = volts > stallV ? (volts - stallV) / (12.0f - stallV) : 0.0f;
+    speed += (target - speed) * dt / lagS;
+
+    float removed = freeAirLpm / 60000.0f * speed * (pressure > ultimatePa ? 1.0f - ultimatePa / pressure : 0.0f);
+    float leak = leakLpm / 60000.0f * (ATM_PA - pressure) / ATM_PA * ATM_PA;
+    pressure += (leak - removed * pressure) / (volumeL / 1000.0f) * dt;
+    if (pressure > ATM_PA) pressure = ATM_PA;
+  }
+
+  // The gauge as the ADC sees it after a block's averaging: a few mV of
+  // noise left. Unplugged, the input's pull-down reads 0.
+  uint32_t gaugeMv() {
+    if (gaugeUnplugged) return 0;
+    noiseSeed = noiseSeed * 1103515245u + 12345u;
+    float noise = ((noiseSeed >> 16) % 9) - 4.0f;
+    float mv = VACUUM_SENSOR.zeroMv +
+               ((float)VACUUM_SENSOR.fullScaleMv - VACUUM_SENSOR.zeroMv) * vacuumPa() / VACUUM_SENSOR.fullScalePa + noise;
+    return mv < 0.0f ? 0 : (uint32_t)(mv + 0.5f);
+  }
+};
+
+enum Event {
+  EVENT_NONE,
+  EVENT_BLEED,        // Leak steps to `to` L/min
+  EVENT_TARGET,       // Target steps to `to` Pa
+  EVENT_UNPLUG,       // Gauge wire comes off
+  EVENT_ADC_STALL     // The ADC stream stops
+};
+
+struct Scenario {
+  const char* name;
+  uint32_t targetPa;  // 0: open loop at MAX speed
+  float volumeL;
+  float leakLpm;
+  Event event;
+  float to;
+};
+
+struct RunResult {
+  float riseS;          // To 90% of the target
+  float overshootKpa;   // Most past the target at any time
+  float settleS;        // Last time outside the band, from first reaching it or the event
+  float errorKpa;       // Mean over the tail
+  float rippleKpa;      // Peak to peak over the tail
+  bool tripped;
+  PressureState trip;
+  uint32_t cutUs;       // From the condition arising to the motor inputs going low
+  float cutVacuumKpa;
+  bool restartRefused;  // A start after the trip, with the condition still there
+};
+
+static RunResult run(const Scenario& s) {
+  SimHal hal;
+  Tb6612Driver driver(hal, MOTOR_DRIVERS[VACUUM_CHANNEL.driver]);
+  VacuumPump pump(hal, driver, VACUUM_CHANNEL);
+  PressureMonitor gauge(hal, VACUUM_SENSOR);
+  driver.makeSafe();
+  pump.setPressureMonitor(gauge);
+  pump.begin();
+
+  ChamberModel chamber;
+  chamber.volumeL = s.volumeL;
+  chamber.leakLpm = s.leakLpm;
+  hal.setAnalogInput(VACUUM_SENSOR.adcPin, chamber.gaugeMv());
+  gauge.begin();
+  gauge.awaitFirstReading(PressureMonitor::STALE_MS);
+
+  uint32_t targetPa = s.targetPa;
+  if (targetPa > 0) {
+    pump.regulateVacuum(targetPa);
+  } else {
+    pump.controlVacuumPump(VACUUM_RUNNING, 80);  // motorForward()'s cap
+  }
+
+  RunResult result = {};
+  result.riseS = -1.0f;
+  float overshoot = 0.0f;
+  float tailSum = 0.0f, tailMin = 1e9f, tailMax = 0.0f;
+  uint32_t tailSamples = 0;
+  uint32_t lastOutsideMs = 0;
+  uint32_t settleFromMs = UINT32_MAX;
+  uint64_t conditionUs = 0;  // When the interlock condition arose; 0 until it does
+  uint64_t cutAtUs = 0;
+  for (uint32_t ms = 0; ms < RUN_MS; ms++) {
+    uint64_t now = hal.nowUs();
+    if (ms == EVENT_MS) {
+      settleFromMs = UINT32_MAX;
+      lastOutsideMs = 0;
+      if (s.event == EVENT_BLEED) chamber.leakLpm = s.to;
+      if (s.event == EVENT_TARGET) {
+        targetPa = (uint32_t)s.to;
+        pump.regulateVacuum(targetPa);
+      }
+      if (s.event == EVENT_UNPLUG) {
+        chamber.gaugeUnplugged = true;
+        conditionUs = now;
+      }
+      if (s.event == EVENT_ADC_STALL) {
+        hal.setAdcStalled(true);
+        conditionUs = now;
+      }
+    }
+    if (targetPa == 0 && conditionUs == 0 && chamber.vacuumPa() >= VACUUM_SENSOR.cutoffPa) conditionUs = now;
+
+    float vacuumKpa = chamber.vacuumPa() / 1000.0f;
+    if (targetPa > 0) {
+      float targetKpa = targetPa / 1000.0f;
+      if (result.riseS < 0.0f && vacuumKpa >= 0.9f * targetKpa) result.riseS = ms / 1000.0f;
+      if (vacuumKpa - targetKpa > overshoot) overshoot = vacuumKpa - targetKpa;
+      if (fabsf(vacuumKpa - targetKpa) > SETTLE_BAND_KPA) {
+        lastOutsideMs = ms;
+      } else if (settleFromMs == UINT32_MAX) {
+        settleFromMs = ms;
+      }
+      if (ms >= RUN_MS - TAIL_MS) {
+        tailSum += vacuumKpa - targetKpa;
+        tailSamples++;
+        if (vacuumKpa < tailMin) tailMin = vacuumKpa;
+        if (vacuumKpa > tailMax) tailMax = vacuumKpa;
+      }
+    }
+    if (cutAtUs == 0 && conditionUs > 0 && !hal.pinLevel(VACUUM_CHANNEL.in1Pin)) {
+      cutAtUs = now;
+      result.cutVacuumKpa = vacuumKpa;
+    }
+
+    chamber.step(hal, STEP_US * 1e-6f);
+    hal.setAnalogInput(VACUUM_SENSOR.adcPin, chamber.gaugeMv());
+    if (ms % UPDATE_MS == 0) pump.update();
+    hal.advanceUs(STEP_US);
+  }
+  result.trip = pump.getLastTrip();
+  result.tripped = result.trip != PRESSURE_OK;
+  if (result.tripped) {
+    pump.controlVacuumPump(VACUUM_RUNNING, 80);
+    result.restartRefused = pump.getCurrentState() == VACUUM_STOPPED && !hal.pinLevel(VACUUM_CHANNEL.in1Pin);
+  }
+  logFlush();
+
+  result.overshootKpa = overshoot;
+  if (settleFromMs == UINT32_MAX) {
+    result.settleS = RUN_MS / 1000.0f;
+  } else {
+    result.settleS = lastOutsideMs > settleFromMs ? (lastOutsideMs - settleFromMs) / 1000.0f : 0.0f;
+  }
+  if (tailSamples > 0) {
+    result.errorKpa = tailSum / tailSamples;
+    result.rippleKpa = tailMax - tailMin;
+  }
+  result.cutUs = cutAtUs > conditionUs ? (uint32_t)(cutAtUs - conditionUs) : 0;
+  if (conditionUs > 0 && cutAtUs == 0) result.cutUs = UINT32_MAX;
+  return result;
+}
+
+static const Scenario REGULATION[] = {
+  { "hold 40 kPa, 1 L",       40000, 1.00f, 0.3f, EVENT_NONE,   0.0f },
+  { "hold 20 kPa, 1 L",       20000, 1.00f, 0.3f, EVENT_NONE,   0.0f },
+  { "hold 75 kPa, 1 L",       75000, 1.00f, 0.3f, EVENT_NONE,   0.0f },
+  { "hold 40 kPa, 0.25 L",    40000, 0.25f, 0.1f, EVENT_NONE,   0.0f },
+  { "hold 40 kPa, 2 L",       40000, 2.00f, 0.5f, EVENT_NONE,   0.0f },
+  { "tight chamber",          40000, 1.00f, 0.02f, EVENT_NONE,  0.0f },
+  { "bleed valve opens",      40000, 1.00f, 0.3f, EVENT_BLEED,  2.0f },
+  { "target 30 -> 60 kPa",    30000, 1.00f, 0.3f, EVENT_TARGET, 60000.0f },
+};
+
+static const Scenario INTERLOCK[] = {
+  { "open loop into cutoff",  0,     0.50f, 0.02f, EVENT_NONE,      0.0f },
+  { "gauge unplugged",        40000, 1.00f, 0.3f,  EVENT_UNPLUG,    0.0f },
+  { "ADC stalls",             40000, 1.00f, 0.3f,  EVENT_ADC_STALL, 0.0f },
+};
+
+static const PressureState EXPECTED_TRIP[] = { PRESSURE_OVER_VACUUM, PRESSURE_SENSOR_FAULT, PRESSURE_STALE };
+
+int main() {
+  int failures = 0;
+  printf("%-24s %6s | %6s %9s %7s %7s %7s\n", "scenario", "target", "rise", "overshoot", "settle", "error",
+         "ripple");
+  for (uint8_t i = 0; i < sizeof(REGULATION) / sizeof(REGULATION[0]); i++) {
+    const Scenario& s = REGULATION[i];
+    RunResult r = run(s);
+    bool pass = fabsf(r.errorKpa) <= MAX_ERROR_KPA && r.rippleKpa <= MAX_RIPPLE_KPA &&
+                r.overshootKpa <= MAX_OVERSHOOT_KPA && r.settleS <= MAX_SETTLE_S && !r.tripped;
+    printf("%-24s %4.0f k | %5.1fs %6.2f kPa %6.1fs %7.2f %7.2f %s%s\n", s.name, s.targetPa / 1000.0f, r.riseS,
+           r.overshootKpa, r.settleS, r.errorKpa, r.rippleKpa, r.tripped ? "tripped " : "", pass ? "" : "FAIL");
+    if (!pass) failures++;
+  }
+
+  printf("\n%-24s %-14s %9s %10s %s\n", "interlock", "trip", "cut after", "at vacuum", "restart");
+  for (uint8_t i = 0; i < sizeof(INTERLOCK) / sizeof(INTERLOCK[0]); i++) {
+    const Scenario& s = INTERLOCK[i];
+    RunResult r = run(s);
+    uint32_t limit = s.event == EVENT_ADC_STALL ? MAX_STALE_CUT_US : MAX_CUT_US;
+    bool pass = r.trip == EXPECTED_TRIP[i] && r.cutUs <= limit && r.restartRefused &&
+                (s.event != EVENT_NONE || r.cutVacuumKpa <= VACUUM_SENSOR.cutoffPa / 1000.0f + 1.0f);
+    printf("%-24s %-14s %7lu us %6.1f kPa %-7s %s\n", s.name, pressureStateName(r.trip), (unsigned long)r.cutUs,
+           r.cutVacuumKpa, r.restartRefused ? "refused" : "allowed", pass ? "" : "FAIL");
+    if (!pass) failures++;
+  }
+
+  printf("%s\n", failures ? "FAILED" : "all within limits");
+  return failures ? 1 : 0;
+}